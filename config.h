@@ -61,6 +61,8 @@ typedef struct {
 	 int color_map;
 	 int port, port_ext;
 	 struct mg_server *server;
+	 int web_server_tid;     // woken by app_to_web() when there is output to send
+	 bool output_pending;
 } user_iface_t;
 
 extern user_iface_t user_iface[];
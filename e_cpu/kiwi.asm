@@ -457,6 +457,7 @@ Commands:
 				u16		CmdPause
 				u16		CmdGetGPSSamples
 				u16		CmdGetChan
+				u16		CmdGetChans
 				u16		CmdGetClocks
 				u16		CmdGetGlitches
 				u16		CmdIQLogReset
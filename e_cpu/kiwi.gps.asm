@@ -636,6 +636,13 @@ CmdGetChan:     rdReg	HOST_RX				; chan#
                 call	UploadChan			; this++
                 drop.r
 
+CmdGetChans:    wrEvt	HOST_RST
+                push	GPS_channels		; &GPS_channels[0]
+                REPEAT	GPS_CHANS
+                 call	UploadChan			; &GPS_channels[n+1]
+                ENDR
+                drop.r
+
 CmdGetClocks:   wrEvt	HOST_RST
                 rdReg	GET_SNAPSHOT		; 0
                 rdBit16z					; 48-bit system clock
@@ -56,6 +56,12 @@ static void drm_pushback_file_data(int rx_chan, int chan, int nsamps, TYPECPX *s
     for (int i = 0; i < nsamps; i++) {
         u2_t t;
         if (d->s2p >= ((d->test == 1)? d->info->s2p_end1 : d->info->s2p_end2)) {
+            // a pass through the test file must have decoded some audio
+            if (d->test_msc_ok)
+                rcprintf(rx_chan, "DRM test file %d: MSC ok in %d status updates\n", d->test, d->test_msc_ok);
+            else
+                lprintf("DRM rx%d: test file %d played through without decoding any MSC audio\n", rx_chan, d->test);
+            d->test_msc_ok = 0;
             d->s2p = ((d->test == 1)? d->info->s2p_start1 : d->info->s2p_start2);
             d->tsamp = 0;
             ext_send_msg(d->rx_chan, false, "EXT annotate=0");
@@ -164,6 +170,7 @@ bool DRM_msgs(char *msg, int rx_chan)
         if (d->test) {
             d->s2p = ((d->test == 1)? d->info->s2p_start1 : d->info->s2p_start2);
             d->tsamp = 0;
+            d->test_msc_ok = 0;
             
             // misuse ext_register_receive_iq_samps() to pushback audio samples from the test file
             ext_register_receive_iq_samps(drm_pushback_file_data, rx_chan);
@@ -28,6 +28,11 @@
     #define DRM_SHMEM_DISABLE
 #endif
 
+#if defined(MULTI_CORE) && !defined(DRM_SHMEM_DISABLE)
+    // DRM receiver stages in threads of their own (dream/DRMPipeline.cpp)
+    #define DRM_PIPELINE
+#endif
+
 #define DRM_CHECKING
 #ifdef DRM_CHECKING
     #define drm_array_dim(d,l) assert_array_dim(d,l)
@@ -88,6 +93,7 @@ typedef struct {
         int test;
         s2_t *s2p;
         u4_t tsamp;
+        u4_t test_msc_ok;       // status updates with MSC audio ok in this pass of the test file
     #endif
 
     // stats
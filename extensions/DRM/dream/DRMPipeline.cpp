@@ -0,0 +1,241 @@
+/******************************************************************************\
+ *
+ * Description:
+ *	Control of the DRM receiver stages running in threads of their own.
+ *	The front end (input, synchronization, OFDM demodulation) stays in the
+ *	receiver process, channel estimation with cell demapping and the decoding
+ *	chain each get a thread. The stages only meet at the queues and at the
+ *	exclusive sections which reconfigure the receiver.
+ *
+ ******************************************************************************
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+\******************************************************************************/
+
+#include "DRMPipeline.h"
+#include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+
+/* Like WSPR_WORKER_NICE, so the real-time work sharing the core comes first */
+#define DRM_STAGE_NICE 10
+
+/* Set while the calling thread is between Enter() and Leave() */
+static __thread bool bStageActive = false;
+
+
+/* Implementation *************************************************************/
+CDRMPipeline::CDRMPipeline() : iNumActive(0), bExclusive(false),
+    iExclusiveDepth(0), bOwnerWasActive(false), iEpoch(0), bRunning(false),
+    iNumExclusive(0), iExclusiveWaitUs(0), iLastReport(0)
+{
+    pthread_mutex_init(&Mutex, nullptr);
+    pthread_cond_init(&Cond, nullptr);
+
+    for (int i = 0; i < NUM_PIPE_STAGES; i++)
+        iBusyUs[i] = iBlocks[i] = iDropped[i] = 0;
+}
+
+CDRMPipeline::~CDRMPipeline()
+{
+    Stop();
+    pthread_cond_destroy(&Cond);
+    pthread_mutex_destroy(&Mutex);
+}
+
+void CDRMPipeline::Start(StageFunc Equalize, StageFunc Decode, void* pArg)
+{
+    if (bRunning)
+        return;
+    bRunning = true;
+
+    /* After a Stop() the queues hold what was in flight and are shut down */
+    SymbolQueue.Reset();
+    CellQueue.Reset();
+
+    StageFunc Funcs[2] = {Equalize, Decode};
+    for (int i = 0; i < 2; i++)
+    {
+        Stages[i].Func = Funcs[i];
+        Stages[i].pArg = pArg;
+        if (pthread_create(&Threads[i], nullptr, StageThread, &Stages[i]) != 0)
+            throw CGenErr("DRM pipeline: can't create stage thread");
+    }
+}
+
+/* The stage threads may run on any core but 0, where the server runs, and
+   the scheduler spreads them over those. On a 2-core board that leaves only
+   core 1, shared with the front end (the receiver process is pinned there),
+   so the stages then overlap the front end's waits but add no CPU. Nothing
+   is pinned on a single core */
+void* CDRMPipeline::StageThread(void* pArg)
+{
+    CStage* pStage = (CStage*) pArg;
+
+#ifdef MULTI_CORE
+    int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu > 1)
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (int cpu = 1; cpu < ncpu; cpu++)
+            CPU_SET(cpu, &cpu_set);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+    }
+#endif
+
+    /* On Linux the nice value is per thread */
+    setpriority(PRIO_PROCESS, 0, DRM_STAGE_NICE);
+
+    return pStage->Func(pStage->pArg);
+}
+
+void CDRMPipeline::Stop()
+{
+    if (!bRunning)
+        return;
+
+    SymbolQueue.Shutdown();
+    CellQueue.Shutdown();
+    for (int i = 0; i < 2; i++)
+        pthread_join(Threads[i], nullptr);
+
+    bRunning = false;
+}
+
+void CDRMPipeline::Enter()
+{
+    if (!bRunning)
+        return;
+
+    pthread_mutex_lock(&Mutex);
+    while (bExclusive && !pthread_equal(ExclusiveOwner, pthread_self()))
+        pthread_cond_wait(&Cond, &Mutex);
+    iNumActive++;
+    bStageActive = true;
+    pthread_mutex_unlock(&Mutex);
+}
+
+void CDRMPipeline::Leave()
+{
+    if (!bStageActive)
+        return;
+
+    pthread_mutex_lock(&Mutex);
+    iNumActive--;
+    bStageActive = false;
+    pthread_cond_broadcast(&Cond);
+    pthread_mutex_unlock(&Mutex);
+}
+
+void CDRMPipeline::ExclusiveBegin()
+{
+    if (!bRunning)
+        return;
+
+    pthread_mutex_lock(&Mutex);
+
+    /* Nested, e.g. SetInStartMode() from within the use of a FAC block */
+    if (bExclusive && pthread_equal(ExclusiveOwner, pthread_self()))
+    {
+        iExclusiveDepth++;
+        pthread_mutex_unlock(&Mutex);
+        return;
+    }
+
+    uint32_t iStart = timer_us();
+
+    /* A stage asking from inside its bracket must not wait for itself, nor
+       hold up another stage that got its exclusive request in first */
+    bool bWasActive = bStageActive;
+    if (bWasActive)
+    {
+        iNumActive--;
+        bStageActive = false;
+        pthread_cond_broadcast(&Cond);
+    }
+
+    while (bExclusive)
+        pthread_cond_wait(&Cond, &Mutex);
+    bExclusive = true;
+    ExclusiveOwner = pthread_self();
+    iExclusiveDepth = 1;
+    bOwnerWasActive = bWasActive;
+
+    /* The other stages finish the block they are on */
+    while (iNumActive > 0)
+        pthread_cond_wait(&Cond, &Mutex);
+
+    iNumExclusive++;
+    iExclusiveWaitUs += timer_us() - iStart;
+    pthread_mutex_unlock(&Mutex);
+}
+
+void CDRMPipeline::ExclusiveEnd()
+{
+    if (!bRunning)
+        return;
+
+    pthread_mutex_lock(&Mutex);
+    if (bExclusive && pthread_equal(ExclusiveOwner, pthread_self()) &&
+        --iExclusiveDepth == 0)
+    {
+        bExclusive = false;
+        if (bOwnerWasActive)
+        {
+            iNumActive++;
+            bStageActive = true;
+        }
+        pthread_cond_broadcast(&Cond);
+    }
+    pthread_mutex_unlock(&Mutex);
+}
+
+/* One line per second: per stage the msec busy, the msec waited on the queues,
+   the blocks done and the stale blocks dropped, then the queue high water
+   marks and the exclusive sections with the msec the requests waited */
+void CDRMPipeline::Report()
+{
+    u4_t iNow = timer_sec();
+    if (iNow == iLastReport)
+        return;
+    iLastReport = iNow;
+
+    static const char* pcName[NUM_PIPE_STAGES] = {"fe", "eq", "dec"};
+    uint32_t iWaitUs[NUM_PIPE_STAGES];
+    iWaitUs[PS_FRONT_END] = SymbolQueue.GetWaitFree();
+    iWaitUs[PS_EQUALIZE] = SymbolQueue.GetWaitFilled() + CellQueue.GetWaitFree();
+    iWaitUs[PS_DECODE] = CellQueue.GetWaitFilled();
+
+    for (int i = 0; i < NUM_PIPE_STAGES; i++)
+    {
+        uint32_t iBusy = iBusyUs[i].exchange(0), iDone = iBlocks[i].exchange(0);
+        uint32_t iDrop = iDropped[i].exchange(0);
+        printf("%s%d/%d/%d", pcName[i], iBusy/1000, iWaitUs[i]/1000, iDone);
+        if (iDrop)
+            printf("-%d", iDrop);
+        printf(" ");
+    }
+
+    pthread_mutex_lock(&Mutex);
+    uint32_t iNumEx = iNumExclusive, iExWaitUs = iExclusiveWaitUs;
+    iNumExclusive = iExclusiveWaitUs = 0;
+    pthread_mutex_unlock(&Mutex);
+
+    printf("q%d,%d x%d/%d ", SymbolQueue.GetHiWat(), CellQueue.GetHiWat(),
+        iNumEx, iExWaitUs/1000);
+    fflush(stdout);
+}
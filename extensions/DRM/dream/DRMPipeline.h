@@ -0,0 +1,284 @@
+/******************************************************************************\
+ *
+ * Description:
+ *	See DRMPipeline.cpp
+ *
+ ******************************************************************************
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+\******************************************************************************/
+
+#ifndef DRMPIPELINE_H
+#define DRMPIPELINE_H
+
+#include "GlobalDefinitions.h"
+#include "util/Buffer.h"
+#include "printf.h"
+#include "spsc.h"
+#include "timer.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <atomic>
+
+
+/* Definitions ****************************************************************/
+/* Blocks in flight between two stages. One block is one OFDM symbol, so this
+   is a bit more than the jitter of the slowest stage */
+#define DRM_PIPE_DEPTH				8
+
+enum EPipeStage {PS_FRONT_END, PS_EQUALIZE, PS_DECODE, NUM_PIPE_STAGES};
+
+
+/* Classes ********************************************************************/
+/* Output buffer of a stage which remembers being cleared. The Dream modules
+   clear their output buffer to drop a partial frame (OFDMCellDemapping when
+   the symbol or frame ID jumps), and that has to happen to the buffer the
+   next stage reads from, not to this one which is emptied every block */
+template<class TData> class CPipeBuffer : public CCyclicBuffer<TData>
+{
+public:
+    CPipeBuffer() : bCleared(false) {}
+
+    virtual void Clear() {CCyclicBuffer<TData>::Clear(); bCleared = true;}
+
+    bool				bCleared;
+};
+
+/* Contents of a receiver buffer on its way to the next stage */
+template<class TData> class CPipeBlock
+{
+public:
+    CPipeBlock() : iFill(0), iBufSize(0), bClear(false) {}
+
+    /* Take everything that is in the buffer */
+    void Get(CBuffer<TData>& Buf)
+    {
+        iBufSize = Buf.GetBufferSize();
+        iFill = Buf.GetFillLevel();
+        bClear = false;
+        if (vecData.Size() < iFill)
+            vecData.Init(iBufSize);
+
+        CVectorEx<TData>* pvecIn = Buf.Get(iFill);
+        for (int i = 0; i < iFill; i++)
+            vecData[i] = (*pvecIn)[i];
+        vecData.SetExData(pvecIn->GetExData());
+    }
+
+    /* Same, and whether it was cleared since the last block */
+    void Get(CPipeBuffer<TData>& Buf)
+    {
+        Get((CBuffer<TData>&) Buf);
+        bClear = Buf.bCleared;
+        Buf.bCleared = false;
+    }
+
+    /* Something to hand over, if only a clear */
+    bool IsEmpty() const {return iFill == 0 && !bClear;}
+
+    /* Append it to the buffer of the same size on the other side, everything
+       put there before a clear goes */
+    void Put(CBuffer<TData>& Buf)
+    {
+        if (bClear)
+            Buf.Clear();
+        if (iFill == 0)
+            return;
+        if (Buf.GetBufferSize() != iBufSize)
+            Buf.Init(iBufSize);
+
+        CVectorEx<TData>* pvecOut = Buf.QueryWriteBuffer();
+        for (int i = 0; i < iFill; i++)
+            (*pvecOut)[i] = vecData[i];
+        pvecOut->SetExData(vecData.GetExData());
+        Buf.Put(iFill);
+    }
+
+protected:
+    CVectorEx<TData>	vecData;
+    int					iFill;
+    int					iBufSize;
+    bool				bClear;
+};
+
+/* Output of the front end: one synchronized OFDM symbol */
+class CPipeSymbol
+{
+public:
+    CPipeBlock<_COMPLEX>	Symbol;
+    uint32_t				iEpoch;
+};
+
+/* Output of the equalizer: the cells demapped from one OFDM symbol */
+class CPipeCells
+{
+public:
+    CPipeBlock<CEquSig>		MSC;
+    CPipeBlock<CEquSig>		FAC;
+    CPipeBlock<CEquSig>		SDC;
+    uint32_t				iEpoch;
+};
+
+/* Bounded queue between two stages. The slots are handed over through a
+   lock-free spsc ring, the semaphores are only there to sleep on when the
+   queue is full or empty */
+template<class TBlock> class CPipeQueue
+{
+public:
+    CPipeQueue() : bStop(false), iWaitFreeUs(0), iWaitFilledUs(0)
+    {
+        spsc_init(&Ring, DRM_PIPE_DEPTH);
+        sem_init(&semFilled, 0, 0);
+        sem_init(&semFree, 0, DRM_PIPE_DEPTH);
+    }
+    virtual ~CPipeQueue()
+    {
+        sem_destroy(&semFilled);
+        sem_destroy(&semFree);
+    }
+
+    /* Producer: wait for a free slot, fill it, then Produce(). Release() it
+       when there was nothing to put into it after all */
+    TBlock* WaitFree() {return Wait(semFree, iWaitFreeUs)? &vecSlots[spsc_wr_slot(&Ring)] : nullptr;}
+    void Produce() {spsc_produce(&Ring); sem_post(&semFilled);}
+    void Release() {sem_post(&semFree);}
+
+    /* Consumer: wait for a filled slot, use it, then Consume() */
+    TBlock* WaitFilled() {return Wait(semFilled, iWaitFilledUs)? &vecSlots[spsc_rd_slot(&Ring)] : nullptr;}
+    void Consume() {spsc_consume(&Ring); sem_post(&semFree);}
+
+    /* Wake both sides for good */
+    void Shutdown() {bStop.store(true); sem_post(&semFilled); sem_post(&semFree);}
+
+    /* Empty again for the next Start(), only while neither side is running */
+    void Reset()
+    {
+        while (sem_trywait(&semFilled) == 0)
+            ;
+        while (sem_trywait(&semFree) == 0)
+            ;
+        for (int i = 0; i < DRM_PIPE_DEPTH; i++)
+            sem_post(&semFree);
+        spsc_init(&Ring, DRM_PIPE_DEPTH);
+        bStop.store(false);
+    }
+
+    /* Taken and reset by the report while the two sides go on adding */
+    int GetHiWat() {return __atomic_exchange_n(&Ring.hiwat, 0, __ATOMIC_RELAXED);}
+    uint32_t GetWaitFree() {return iWaitFreeUs.exchange(0);}
+    uint32_t GetWaitFilled() {return iWaitFilledUs.exchange(0);}
+
+protected:
+    bool Wait(sem_t& sem, std::atomic<uint32_t>& iWaitUs);
+
+    spsc_t				Ring;
+    TBlock				vecSlots[DRM_PIPE_DEPTH];
+    sem_t				semFilled;
+    sem_t				semFree;
+    std::atomic<bool>	bStop;
+    std::atomic<uint32_t>	iWaitFreeUs;
+    std::atomic<uint32_t>	iWaitFilledUs;
+};
+
+template<class TBlock> bool CPipeQueue<TBlock>::Wait(sem_t& sem, std::atomic<uint32_t>& iWaitUs)
+{
+    if (sem_trywait(&sem) != 0)
+    {
+        uint32_t iStart = timer_us();
+        while (sem_wait(&sem) != 0)
+            ;
+        iWaitUs += timer_us() - iStart;
+    }
+    return !bStop.load();
+}
+
+/* Control of the receiver stages running in their own threads.
+   A stage brackets the work on each block with Enter() / Leave(). Everything
+   that changes the receiver configuration (start / tracking mode, new
+   robustness mode or spectrum occupancy, services from FAC / SDC, GUI
+   requests) runs between ExclusiveBegin() / ExclusiveEnd() and so only while
+   no other stage is inside its bracket. Blocks that were produced before a
+   change of the OFDM geometry carry an old epoch and are dropped */
+class CDRMPipeline
+{
+public:
+    CDRMPipeline();
+    virtual ~CDRMPipeline();
+
+    typedef void* (*StageFunc)(void*);
+
+    void Start(StageFunc Equalize, StageFunc Decode, void* pArg);
+    void Stop();
+    bool IsRunning() const {return bRunning;}
+
+    void Enter();
+    void Leave();
+    void ExclusiveBegin();
+    void ExclusiveEnd();
+
+    uint32_t GetEpoch() const {return iEpoch;}
+    void NewEpoch() {iEpoch++;}
+
+    /* Per stage accounting for the timing report */
+    void StageDone(EPipeStage eStage, uint32_t iUs) {iBusyUs[eStage] += iUs; iBlocks[eStage]++;}
+    void Dropped(EPipeStage eStage) {iDropped[eStage]++;}
+    void Report();
+
+    /* Scoped exclusive section, a no-op while the threads are not running */
+    class CExclusive
+    {
+    public:
+        CExclusive(CDRMPipeline& p) : Pipeline(p) {Pipeline.ExclusiveBegin();}
+        ~CExclusive() {Pipeline.ExclusiveEnd();}
+    protected:
+        CDRMPipeline& Pipeline;
+    };
+
+    CPipeQueue<CPipeSymbol>	SymbolQueue;	/* front end -> equalizer */
+    CPipeQueue<CPipeCells>	CellQueue;		/* equalizer -> decoder */
+
+protected:
+    pthread_mutex_t		Mutex;
+    pthread_cond_t		Cond;
+    int					iNumActive;
+    bool				bExclusive;
+    pthread_t			ExclusiveOwner;
+    int					iExclusiveDepth;
+    bool				bOwnerWasActive;
+    volatile uint32_t	iEpoch;
+
+    bool				bRunning;
+    pthread_t			Threads[2];
+
+    /* What StageThread() runs in each of the threads */
+    struct CStage
+    {
+        StageFunc	Func;
+        void*		pArg;
+    } Stages[2];
+    static void* StageThread(void* pArg);
+
+    /* Statistics, each stage adds to its own while Report() takes and resets them
+       from the front end. The exclusive section ones are under the mutex */
+    std::atomic<uint32_t>	iBusyUs[NUM_PIPE_STAGES];
+    std::atomic<uint32_t>	iBlocks[NUM_PIPE_STAGES];
+    std::atomic<uint32_t>	iDropped[NUM_PIPE_STAGES];
+    uint32_t			iNumExclusive;
+    uint32_t			iExclusiveWaitUs;
+    uint32_t			iLastReport;
+};
+
+#endif
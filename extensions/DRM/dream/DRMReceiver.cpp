@@ -66,7 +66,8 @@ CDRMReceiver::CDRMReceiver(CSettings* nPsettings) : CDRMTransceiver(),
     rInitResampleOffset((_REAL) 0.0),
     iBwAM(10000), iBwLSB(5000), iBwUSB(5000), iBwCW(150), iBwFM(6000),
     time_keeper(0),
-    PlotManager(), iPrevSigSampleRate(0),Parameters(*(new CParameter())), pSettings(nPsettings)
+    PlotManager(), iPrevSigSampleRate(0),Parameters(*(new CParameter())), pSettings(nPsettings),
+    bPipelined(false)
 {
     Parameters.SetReceiver(this);
     downstreamRSCI.SetReceiver(this);
@@ -79,6 +80,7 @@ CDRMReceiver::CDRMReceiver(CSettings* nPsettings) : CDRMTransceiver(),
 
 CDRMReceiver::~CDRMReceiver()
 {
+    Pipeline.Stop();
     delete pUpstreamRSCI;
 }
 
@@ -232,6 +234,12 @@ CDRMReceiver::DemodulateDRM(bool& bEnoughData)
     drm_next_task("FreqSyncAcq");
 
     /* Time synchronization ------------------------------------- */
+    /* A robustness mode detected during acquisition changes the OFDM geometry
+       of all stages */
+    bool bRMDetAcqu = TimeSync.GetRMDetAcqu();
+    if (bRMDetAcqu)
+        Pipeline.ExclusiveBegin();
+
     if (TimeSync.ProcessData(Parameters, FreqSyncAcqBuf, TimeSyncBuf))
     {
         bEnoughData = true;
@@ -247,6 +255,9 @@ CDRMReceiver::DemodulateDRM(bool& bEnoughData)
                 SetInStartMode();
         }
     }
+
+    if (bRMDetAcqu)
+        Pipeline.ExclusiveEnd();
     drm_next_task("TimeSync");
 
     /* OFDM-demodulation ---------------------------------------- */
@@ -264,10 +275,16 @@ CDRMReceiver::DemodulateDRM(bool& bEnoughData)
         bEnoughData = true;
     }
     drm_next_task("SyncUsingPil");
+}
 
+void
+CDRMReceiver::EqualizeDRM(bool& bEnoughData, CSingleBuffer<_COMPLEX>& InBuf,
+                          CCyclicBuffer<CEquSig>& MSCBuf,
+                          CCyclicBuffer<CEquSig>& FACBuf, CCyclicBuffer<CEquSig>& SDCBuf)
+{
     /* Channel estimation and equalisation ---------------------- */
     if (ChannelEstimation.
-            ProcessData(Parameters, SyncUsingPilBuf, ChanEstBuf))
+            ProcessData(Parameters, InBuf, ChanEstBuf))
     {
         bEnoughData = true;
 
@@ -280,8 +297,7 @@ CDRMReceiver::DemodulateDRM(bool& bEnoughData)
 
     /* Demapping of the MSC, FAC, SDC and pilots off the carriers */
     if (OFDMCellDemapping.ProcessData(Parameters, ChanEstBuf,
-                                      MSCCarDemapBuf,
-                                      FACCarDemapBuf, SDCCarDemapBuf))
+                                      MSCBuf, FACBuf, SDCBuf))
     {
         bEnoughData = true;
     }
@@ -333,6 +349,12 @@ CDRMReceiver::DecodeDRM(bool& bEnoughData, bool& bFrameToSend)
 void
 CDRMReceiver::UtilizeDRM(bool& bEnoughData)
 {
+    /* FAC and SDC can reconfigure the whole receiver, keep the other stages
+       out while a block of them is used */
+    bool bReconfig = (FACUseBuf.GetFillLevel() > 0) || (SDCUseBuf.GetFillLevel() > 0);
+    if (bReconfig)
+        Pipeline.ExclusiveBegin();
+
     if (UtilizeFACData.WriteData(Parameters, FACUseBuf))
     {
         bEnoughData = true;
@@ -350,6 +372,9 @@ CDRMReceiver::UtilizeDRM(bool& bEnoughData)
     {
         bEnoughData = true;
     }
+
+    if (bReconfig)
+        Pipeline.ExclusiveEnd();
     drm_next_task("UtilizeSDCData");
 
     /* Data decoding */
@@ -543,6 +568,8 @@ CDRMReceiver::DetectAcquiFAC()
 void
 CDRMReceiver::InitReceiverMode()
 {
+    CDRMPipeline::CExclusive Exclusive(Pipeline);
+
     switch (eNewReceiverMode)
     {
     case RM_AM:
@@ -691,6 +718,8 @@ CDRMReceiver::InitReceiverMode()
 void
 CDRMReceiver::CloseSoundInterfaces()
 {
+    CDRMPipeline::CExclusive Exclusive(Pipeline);
+
     ReceiveData.Stop();
     WriteData.Stop();
 }
@@ -710,6 +739,8 @@ CDRMReceiver::SetAMDemodAcq(_REAL rNewNorCen)
 void
 CDRMReceiver::SetInStartMode()
 {
+    CDRMPipeline::CExclusive Exclusive(Pipeline);
+
     iUnlockedCount = MAX_UNLOCKED_COUNT;
 
     Parameters.Lock();
@@ -897,30 +928,23 @@ CDRMReceiver::process()
     }
     else
     {
-
-        if (WriteIQFile.IsRecording())
+#ifdef DRM_PIPELINE
+        if (bPipelined)
         {
-            /* Receive data in RecDataBuf */
-            ReceiveData.ReadData(Parameters, RecDataBuf);
-
-            /* Split samples, one output to the demodulation, another for IQ recording */
-            if (SplitForIQRecord.ProcessData(Parameters, RecDataBuf, DemodDataBuf, IQRecordDataBuf))
-            {
-                bEnoughData = true;
-            }
-            drm_next_task("WriteIQFile");
-        }
-        else
-        {
-            /* No I/Q recording then receive data directly in DemodDataBuf */
-            MEASURE_TIME("r", 4, ReceiveData.ReadData(Parameters, DemodDataBuf));
-            drm_next_task("read");
+            /* The other stages run in their own threads */
+            ProcessFrontEnd();
+            return;
         }
+#endif
+
+        ReadInput(bEnoughData);
 
         switch (eReceiverMode)
         {
         case RM_DRM:
-            MEASURE_TIME("d", 1, DemodulateDRM(bEnoughData); DecodeDRM(bEnoughData, bFrameToSend));
+            MEASURE_TIME("d", 1, DemodulateDRM(bEnoughData);
+                EqualizeDRM(bEnoughData, SyncUsingPilBuf, MSCCarDemapBuf, FACCarDemapBuf, SDCCarDemapBuf);
+                DecodeDRM(bEnoughData, bFrameToSend));
             break;
         case RM_AM:
             DemodulateAM(bEnoughData);
@@ -935,6 +959,40 @@ CDRMReceiver::process()
         }
     }
 
+    ProcessOutput(bFrameToSend);
+}
+
+void
+CDRMReceiver::ReadInput(bool& bEnoughData)
+{
+    if (WriteIQFile.IsRecording())
+    {
+        /* Receive data in RecDataBuf */
+        ReceiveData.ReadData(Parameters, RecDataBuf);
+
+        /* Split samples, one output to the demodulation, another for IQ recording */
+        if (SplitForIQRecord.ProcessData(Parameters, RecDataBuf, DemodDataBuf, IQRecordDataBuf))
+        {
+            bEnoughData = true;
+        }
+
+        // Write output I/Q file
+        WriteIQFile.WriteData(Parameters, IQRecordDataBuf);
+        drm_next_task("WriteIQFile");
+    }
+    else
+    {
+        /* No I/Q recording then receive data directly in DemodDataBuf */
+        MEASURE_TIME("r", 4, ReceiveData.ReadData(Parameters, DemodDataBuf));
+        drm_next_task("read");
+    }
+}
+
+void
+CDRMReceiver::ProcessOutput(bool bFrameToSend)
+{
+    bool bEnoughData = true;
+
     /* Split the data for downstream RSCI and local processing. TODO make this conditional */
     switch (eReceiverMode)
     {
@@ -968,15 +1026,6 @@ CDRMReceiver::process()
         /* Init flag */
         bEnoughData = false;
 
-        // Write output I/Q file
-        if (WriteIQFile.IsRecording())
-        {
-            if (WriteIQFile.WriteData(Parameters, IQRecordDataBuf))
-            {
-                bEnoughData = true;
-            }
-        }
-
         switch (eReceiverMode)
         {
         case RM_DRM:
@@ -1051,6 +1100,145 @@ CDRMReceiver::process()
     }
 }
 
+/* -----------------------------------------------------------------------------
+   DRM receiver stages in their own threads: the front end (input, sync and
+   OFDM demodulation) runs in the caller of process(), the channel estimation
+   and cell demapping and the decoding (MLC, source decoders, output) each in a
+   thread of their own. Everything a stage hands over is copied into a slot of
+   a bounded queue, so the stages never share a buffer */
+void
+CDRMReceiver::ProcessFrontEnd()
+{
+    bool bEnoughData = false;
+
+    if (!Pipeline.IsRunning())
+        Pipeline.Start(EqualizeThread, DecodeThread, this);
+
+    /* Wait for room before entering, inside a stage must never wait for
+       another one */
+    CPipeSymbol* pSymbol = Pipeline.SymbolQueue.WaitFree();
+    if (pSymbol == nullptr)
+        return;
+
+    Pipeline.Enter();
+
+    MEASURE_STAGE(Pipeline, PS_FRONT_END,
+        ReadInput(bEnoughData);
+        MEASURE_TIME("d", 1, DemodulateDRM(bEnoughData)));
+
+    bool bSymbol = (SyncUsingPilBuf.GetFillLevel() > 0);
+    if (bSymbol)
+    {
+        pSymbol->Symbol.Get(SyncUsingPilBuf);
+        pSymbol->iEpoch = Pipeline.GetEpoch();
+    }
+
+    Pipeline.Leave();
+
+    if (bSymbol)
+        Pipeline.SymbolQueue.Produce();
+    else
+        Pipeline.SymbolQueue.Release();
+
+    MEASURE_PIPELINE(Pipeline);
+}
+
+bool
+CDRMReceiver::EqualizeBlock()
+{
+    CPipeSymbol* pSymbol = Pipeline.SymbolQueue.WaitFilled();
+    if (pSymbol == nullptr)
+        return false;
+    CPipeCells* pCells = Pipeline.CellQueue.WaitFree();
+    if (pCells == nullptr)
+        return false;
+
+    Pipeline.Enter();
+
+    bool bSymbol = (pSymbol->iEpoch == Pipeline.GetEpoch());
+    if (bSymbol)
+        pSymbol->Symbol.Put(SymbolPipeBuf);
+    else
+        Pipeline.Dropped(PS_EQUALIZE);
+    Pipeline.SymbolQueue.Consume();
+
+    bool bCells = false;
+    if (bSymbol)
+    {
+        bool bEnoughData = false;
+
+        MEASURE_STAGE(Pipeline, PS_EQUALIZE,
+            EqualizeDRM(bEnoughData, SymbolPipeBuf, MSCCellPipeBuf, FACCellPipeBuf, SDCCellPipeBuf));
+
+        /* A clear of the cell buffers is handed over even without new cells */
+        pCells->MSC.Get(MSCCellPipeBuf);
+        pCells->FAC.Get(FACCellPipeBuf);
+        pCells->SDC.Get(SDCCellPipeBuf);
+        pCells->iEpoch = Pipeline.GetEpoch();
+        bCells = !pCells->MSC.IsEmpty() || !pCells->FAC.IsEmpty() || !pCells->SDC.IsEmpty();
+    }
+
+    Pipeline.Leave();
+
+    if (bCells)
+        Pipeline.CellQueue.Produce();
+    else
+        Pipeline.CellQueue.Release();
+    return true;
+}
+
+bool
+CDRMReceiver::DecodeBlock()
+{
+    CPipeCells* pCells = Pipeline.CellQueue.WaitFilled();
+    if (pCells == nullptr)
+        return false;
+
+    Pipeline.Enter();
+
+    bool bCells = (pCells->iEpoch == Pipeline.GetEpoch());
+    if (bCells)
+    {
+        pCells->MSC.Put(MSCCarDemapBuf);
+        pCells->FAC.Put(FACCarDemapBuf);
+        pCells->SDC.Put(SDCCarDemapBuf);
+    }
+    else
+        Pipeline.Dropped(PS_DECODE);
+    Pipeline.CellQueue.Consume();
+
+    if (bCells)
+    {
+        bool bEnoughData = false;
+        bool bFrameToSend = false;
+
+        MEASURE_STAGE(Pipeline, PS_DECODE,
+            DecodeDRM(bEnoughData, bFrameToSend);
+            ProcessOutput(bFrameToSend));
+    }
+
+    Pipeline.Leave();
+    return true;
+}
+
+void*
+CDRMReceiver::EqualizeThread(void* pArg)
+{
+    CDRMReceiver* pReceiver = (CDRMReceiver*) pArg;
+    while (pReceiver->EqualizeBlock())
+        ;
+    return nullptr;
+}
+
+void*
+CDRMReceiver::DecodeThread(void* pArg)
+{
+    CDRMReceiver* pReceiver = (CDRMReceiver*) pArg;
+    while (pReceiver->DecodeBlock())
+        ;
+    return nullptr;
+}
+
 void CDRMReceiver::updatePosition()
 {
 #ifdef HAVE_LIBGPS
@@ -1106,6 +1294,14 @@ CDRMReceiver::InitsForAllModules()
             Parameters.bMeasurePSD = false;
     }
 
+#ifdef DRM_PIPELINE
+    /* Run the DRM stages in their own threads unless the input comes already
+       decoded from upstream RSCI */
+    bPipelined = (eReceiverMode == RM_DRM) && !pUpstreamRSCI->GetInEnabled();
+#endif
+    /* Drop the blocks still on their way between the stages */
+    Pipeline.NewEpoch();
+
     /* Set init flags */
     SplitFAC.SetInitFlag();
     SplitSDC.SetInitFlag();
@@ -1174,7 +1370,11 @@ CDRMReceiver::InitsForAllModules()
     TimeSyncBuf.Clear();
     OFDMDemodBuf.Clear();
     SyncUsingPilBuf.Clear();
+    SymbolPipeBuf.Clear();
     ChanEstBuf.Clear();
+    MSCCellPipeBuf.Clear();
+    FACCellPipeBuf.Clear();
+    SDCCellPipeBuf.Clear();
     MSCCarDemapBuf.Clear();
     FACCarDemapBuf.Clear();
     SDCCarDemapBuf.Clear();
@@ -1202,6 +1402,9 @@ CDRMReceiver::InitsForWaveMode()
        a bit more time for its job */
     iAcquDetecCnt = 0;
 
+    /* Blocks on their way between the stages have the old symbol length */
+    Pipeline.NewEpoch();
+
     /* Set init flags */
     ReceiveData.SetInitFlag();
     InputResample.SetInitFlag();
@@ -1230,6 +1433,9 @@ CDRMReceiver::InitsForWaveMode()
 void
 CDRMReceiver::InitsForSpectrumOccup()
 {
+    /* Blocks on their way between the stages have the old carrier layout */
+    Pipeline.NewEpoch();
+
     /* Set init flags */
     FreqSyncAcq.SetInitFlag();	// Because of bandpass filter
     OFDMDemodulation.SetInitFlag();
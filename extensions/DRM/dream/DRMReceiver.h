@@ -59,6 +59,7 @@
 #include "sound/soundinterface.h"
 #include "PlotManager.h"
 #include "DrmTransceiver.h"
+#include "DRMPipeline.h"
 
 /* Definitions ****************************************************************/
 /* Number of FAC frames until the acquisition is activated in case a signal
@@ -316,6 +317,10 @@ public:
         return &PlotManager;
     }
 
+    CDRMPipeline&			GetPipeline() {
+        return Pipeline;
+    }
+
     void					InitsForWaveMode();
     void					InitsForSpectrumOccup();
     void					InitsForNoDecBitsSDC();
@@ -337,7 +342,12 @@ protected:
     void					SetInTrackingMode();
     void					SetInTrackingModeDelayed();
     void					InitsForAllModules();
+    void					ReadInput(bool&);
     void					DemodulateDRM(bool&);
+    void					EqualizeDRM(bool&, CSingleBuffer<_COMPLEX>&,
+                                        CCyclicBuffer<CEquSig>&,
+                                        CCyclicBuffer<CEquSig>&,
+                                        CCyclicBuffer<CEquSig>&);
     void					DecodeDRM(bool&, bool&);
     void					UtilizeDRM(bool&);
     void					DemodulateAM(bool&);
@@ -346,6 +356,12 @@ protected:
     void					DemodulateFM(bool&);
     void					DecodeFM(bool&);
     void					UtilizeFM(bool&);
+    void					ProcessOutput(bool);
+    void					ProcessFrontEnd();
+    bool					EqualizeBlock();
+    bool					DecodeBlock();
+    static void*			EqualizeThread(void*);
+    static void*			DecodeThread(void*);
     void					DetectAcquiFAC();
     void					DetectAcquiSymbol();
     void					saveSDCtoFile();
@@ -424,6 +440,12 @@ protected:
     CCyclicBuffer<_SAMPLE>			AMAudioBuf;
     CCyclicBuffer<_SAMPLE>			AMSoEncBuf; // For encoding
 
+    /* Own buffers of the equalizer stage when the stages are in threads */
+    CSingleBuffer<_COMPLEX>			SymbolPipeBuf;
+    CPipeBuffer<CEquSig>			MSCCellPipeBuf;
+    CPipeBuffer<CEquSig>			FACCellPipeBuf;
+    CPipeBuffer<CEquSig>			SDCCellPipeBuf;
+
     int						iAcquRestartCnt;
     int						iAcquDetecCnt;
     int						iGoodSignCnt;
@@ -456,6 +478,9 @@ protected:
     int						iPrevSigSampleRate; /* sample rate before sound file */
     CParameter&             Parameters;
     CSettings*              pSettings;
+
+    CDRMPipeline			Pipeline;
+    bool					bPipelined;
 };
 
 
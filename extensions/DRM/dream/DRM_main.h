@@ -88,5 +88,19 @@ static const char *drm_argv[] = {
     #define MEASURE_TIME(id, acc, func) func;
 #endif
 
+// same for the stages of the pipelined receiver, one report line per second for all of them
+#ifdef USE_MEASURE_TIME
+    #define MEASURE_STAGE(pipe, stage, func) \
+        { \
+            u4_t start = timer_us(); \
+            func; \
+            (pipe).StageDone(stage, timer_us() - start); \
+        }
+    #define MEASURE_PIPELINE(pipe) (pipe).Report();
+#else
+    #define MEASURE_STAGE(pipe, stage, func) func;
+    #define MEASURE_PIPELINE(pipe)
+#endif
+
 
 void DRM_loop(int rx_chan);
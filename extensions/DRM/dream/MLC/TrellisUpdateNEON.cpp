@@ -0,0 +1,81 @@
+/******************************************************************************\
+ *
+ * Description:
+ *
+	NEON implementation of trellis update
+
+	Other than the MMX / SSE2 versions this one stays with the floating-point
+	metric of the c++ version. The additions and comparisons are the same, in
+	the same order, only done for four butterflies at a time. So the new
+	metrics, the decisions and therefore the decoded bits are identical to the
+	c++ version (tools/drm_viterbi_bench checks this).
+
+	Butterfly "j" has the previous states "j" and "j + 32" and gives the
+	states "2j" and "2j + 1". The metrics of the two transitions were reordered
+	into "pchMet1[j]" and "pchMet2[j]" by the BUTTERFLY() unroll in
+	ViterbiDecoder.cpp. vst2q interleaves the results of the first and second
+	state of four butterflies back into the state order.
+ *
+ ******************************************************************************
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+\******************************************************************************/
+
+#include "ViterbiDecoder.h"
+
+
+/* Implementation *************************************************************/
+#ifdef USE_NEON
+#include <arm_neon.h>
+
+void CViterbiDecoder::TrellisUpdateNEON(_DECISIONTYPE* pCurDec,
+                                        _VITMETRTYPE* pCurTrelMetric, const _VITMETRTYPE* pOldTrelMetric,
+                                        const _VITMETRTYPE* pchMet1, const _VITMETRTYPE* pchMet2)
+{
+    const uint8x8_t vecOne = vdup_n_u8(1);
+
+    for (int j = 0; j < MC_NUM_STATES / 2; j += 4)
+    {
+        const float32x4_t vecOld0 = vld1q_f32(&pOldTrelMetric[j]);
+        const float32x4_t vecOld1 = vld1q_f32(&pOldTrelMetric[j + MC_NUM_STATES / 2]);
+        const float32x4_t vecMet1 = vld1q_f32(&pchMet1[j]);
+        const float32x4_t vecMet2 = vld1q_f32(&pchMet2[j]);
+
+        /* First state of the butterflies, for the second state the metric
+           sets are swapped */
+        const float32x4_t vecFiPrev0 = vaddq_f32(vecOld0, vecMet1);
+        const float32x4_t vecFiPrev1 = vaddq_f32(vecOld1, vecMet2);
+        const float32x4_t vecSecPrev0 = vaddq_f32(vecOld0, vecMet2);
+        const float32x4_t vecSecPrev1 = vaddq_f32(vecOld1, vecMet1);
+
+        /* Take path with smallest metric. Like in the c++ version the path
+           from "prev1" wins if both are equal */
+        const uint32x4_t vecFiTake0 = vcltq_f32(vecFiPrev0, vecFiPrev1);
+        const uint32x4_t vecSecTake0 = vcltq_f32(vecSecPrev0, vecSecPrev1);
+
+        float32x4x2_t vecNewMetric;
+        vecNewMetric.val[0] = vbslq_f32(vecFiTake0, vecFiPrev0, vecFiPrev1);
+        vecNewMetric.val[1] = vbslq_f32(vecSecTake0, vecSecPrev0, vecSecPrev1);
+        vst2q_f32(&pCurTrelMetric[2 * j], vecNewMetric);
+
+        /* Decisions in the same order, narrowed from the 32-bit masks to one
+           byte per state: 0 for "prev0", 1 for "prev1" */
+        const uint16x4x2_t vecTake0 = vzip_u16(vmovn_u32(vecFiTake0), vmovn_u32(vecSecTake0));
+        const uint8x8_t vecTake0Bytes = vmovn_u16(vcombine_u16(vecTake0.val[0], vecTake0.val[1]));
+        vst1_u8(&pCurDec[2 * j], vbic_u8(vecOne, vecTake0Bytes));
+    }
+}
+#endif
@@ -198,7 +198,7 @@ _REAL CViterbiDecoder::Decode(CVector<CDistance>& vecNewDistance,
 
 
         /* Update trellis --------------------------------------------------- */
-        #ifdef USE_SIMD
+        #if defined(USE_SIMD) || defined(USE_NEON)
             /* Use the butterfly unroll for reordering the metrics for SIMD trellis */
             #define BUTTERFLY(cur, next, prev0, prev1, met0, met1) { \
                 /* At this point we convert from float to char! No overflow-check is done here */ \
@@ -293,6 +293,10 @@ _REAL CViterbiDecoder::Decode(CVector<CDistance>& vecNewDistance,
                 (&matdecDecisions[i][0], pCurTrelMetric, pOldTrelMetric, chMet1, chMet2);
         #endif
 
+        #ifdef USE_NEON
+            TrellisUpdateNEON(&matdecDecisions[i][0], pCurTrelMetric, pOldTrelMetric, chMet1, chMet2);
+        #endif
+
         #ifdef USE_MAX_LOG_MAP
             /* Store accumulated metrics for backward Viterbi */
             for (int j = 0; j < MC_NUM_STATES; j++)
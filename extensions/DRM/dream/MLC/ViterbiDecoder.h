@@ -46,12 +46,23 @@
 #undef USE_MMX
 
 
+/* NEON implementation for ARM. Other than the x86 versions it keeps the
+   floating-point metric and does exactly what the c++ version does, only for
+   four butterflies at once, so the decoded bits are the same. Needs _REAL to
+   be float */
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(KIWISDR)
+# define USE_NEON
+#endif
+
+
 /* No MAP implementation for SIMD! */
 #ifdef USE_MAX_LOG_MAP
 # undef USE_SIMD
+# undef USE_NEON
 #endif
 
 #ifdef USE_SIMD
+# undef USE_NEON
 # ifndef USE_MMX
 #  define USE_SSE2
 # endif
@@ -122,10 +133,13 @@ protected:
 
     CMatrix<_DECISIONTYPE>	matdecDecisions;
 
-#ifdef USE_SIMD
+#if defined(USE_SIMD) || defined(USE_NEON)
     /* Fields for storing the reodered metrics for MMX trellis */
     _VITMETRTYPE			chMet1[MC_NUM_STATES / 2];
     _VITMETRTYPE			chMet2[MC_NUM_STATES / 2];
+#endif
+
+#ifdef USE_SIMD
 
 #ifdef USE_MMX
     void TrellisUpdateMMX(
@@ -137,6 +151,12 @@ protected:
             const _VITMETRTYPE* pCurTrelMetric, const _VITMETRTYPE* pOldTrelMetric,
             const _VITMETRTYPE* pchMet1, const _VITMETRTYPE* pchMet2);
 #endif
+
+#ifdef USE_NEON
+    void TrellisUpdateNEON(_DECISIONTYPE* pCurDec,
+            _VITMETRTYPE* pCurTrelMetric, const _VITMETRTYPE* pOldTrelMetric,
+            const _VITMETRTYPE* pchMet1, const _VITMETRTYPE* pchMet2);
+#endif
     };
 
 
@@ -101,6 +101,9 @@ CConsoleIO::Update(drm_t *drm)
 	}
     //printf("."); fflush(stdout);
 	time = curtime;
+
+	/* Keep the receiver stages still while we look at and change their state */
+	CDRMPipeline::CExclusive Exclusive(pDRMReceiver->GetPipeline());
 	
 	if (drm->send_iq) {
         pDRMReceiver->GetFACMLC()->GetVectorSpace(facIQ);
@@ -134,6 +137,9 @@ CConsoleIO::Update(drm_t *drm)
     int fac = ETypeRxStatus2int(Parameters.ReceiveStatus.FAC.GetStatus());
     int time = ETypeRxStatus2int(Parameters.ReceiveStatus.TSync.GetStatus());
     int frame = ETypeRxStatus2int(Parameters.ReceiveStatus.FSync.GetStatus());
+    #ifdef DRM_TEST_FILE
+        if (drm->test && msc == 0) drm->test_msc_ok++;      // checked by drm_pushback_file_data()
+    #endif
     ETypeRxStatus soundCardStatusI = Parameters.ReceiveStatus.InterfaceI.GetStatus(); /* Input */
     ETypeRxStatus soundCardStatusO = Parameters.ReceiveStatus.InterfaceO.GetStatus(); /* Output */
     int inter = ETypeRxStatus2int(soundCardStatusO == NOT_PRESENT ||
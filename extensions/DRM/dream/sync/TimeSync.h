@@ -97,6 +97,7 @@ public:
 	void StartAcquisition();
 	void StopTimingAcqu() {bTimingAcqu = false;}
 	void StopRMDetAcqu() {bRobModAcqu = false;}
+	bool GetRMDetAcqu() const {return bRobModAcqu;}
 
 protected:
 	int							iSampleRate;
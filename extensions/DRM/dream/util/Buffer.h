@@ -45,6 +45,7 @@ public:
 	void			SetRequestFlag(const bool bNewRequestFlag)
 						{bRequestFlag = bNewRequestFlag;}
 	bool		GetRequestFlag() const {return bRequestFlag;}
+	int			GetBufferSize() const {return iBufferSize;}
 
 	/* Virtual function to be declared by the derived object */
 	virtual void				Init(const int iNewBufferSize);
@@ -127,13 +127,13 @@ bool sstv_msgs(char *msg, int rx_chan)
         assert(e->fft.in1k != NULL);
         e->fft.out1k = SSTV_FFTW_ALLOC_COMPLEX(1024);
         assert(e->fft.out1k != NULL);
-        e->fft.Plan1024 = SSTV_FFTW_PLAN_DFT_R2C_1D(1024, e->fft.in1k, e->fft.out1k, FFTW_ESTIMATE);
+        e->fft.Plan1024 = SSTV_FFTW_PLAN_DFT_R2C_1D("SSTV", 1024, e->fft.in1k, e->fft.out1k, FFTW_ESTIMATE);
 
         e->fft.in2k = SSTV_FFTW_ALLOC_REAL(2048);
         assert(e->fft.in2k != NULL);
         e->fft.out2k = SSTV_FFTW_ALLOC_COMPLEX(2048);
         assert(e->fft.out2k != NULL);
-        e->fft.Plan2048 = SSTV_FFTW_PLAN_DFT_R2C_1D(2048, e->fft.in2k, e->fft.out2k, FFTW_ESTIMATE);
+        e->fft.Plan2048 = SSTV_FFTW_PLAN_DFT_R2C_1D("SSTV", 2048, e->fft.in2k, e->fft.out2k, FFTW_ESTIMATE);
 
         sstv_pcm_once(e);
         sstv_video_once(e);
@@ -12,6 +12,7 @@
 #include "kiwi_assert.h"
 #include "coroutines.h"
 #include "data_pump.h"
+#include "fft_plan.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -53,11 +54,11 @@
 	#define SSTV_FFTW_ALLOC_REAL fftwf_alloc_real
 	#define SSTV_FFTW_ALLOC_COMPLEX fftwf_alloc_complex
 	#define SSTV_FFTW_FREE fftwf_free
-	#define SSTV_FFTW_PLAN fftwf_plan
-	#define SSTV_FFTW_PLAN_DFT_1D fftwf_plan_dft_1d
-	#define SSTV_FFTW_PLAN_DFT_R2C_1D fftwf_plan_dft_r2c_1d
-	#define SSTV_FFTW_DESTROY_PLAN fftwf_destroy_plan
-	#define SSTV_FFTW_EXECUTE fftwf_execute
+	#define SSTV_FFTW_PLAN fft_plan_t *
+	#define SSTV_FFTW_PLAN_DFT_1D fft_plan_dft_1d
+	#define SSTV_FFTW_PLAN_DFT_R2C_1D fft_plan_dft_r2c_1d
+	#define SSTV_FFTW_DESTROY_PLAN(plan)
+	#define SSTV_FFTW_EXECUTE_R2C fft_execute_r2c
 #else
 	typedef double SSTV_REAL;
     #define SSTV_MSIN(x) sin(x)
@@ -81,10 +82,10 @@
 	#define SSTV_FFTW_ALLOC_COMPLEX fftw_alloc_complex
 	#define SSTV_FFTW_FREE fftw_free
 	#define SSTV_FFTW_PLAN fftw_plan
-	#define SSTV_FFTW_PLAN_DFT_1D fftw_plan_dft_1d
-	#define SSTV_FFTW_PLAN_DFT_R2C_1D fftw_plan_dft_r2c_1d
+	#define SSTV_FFTW_PLAN_DFT_1D(name, n, in, out, sign, flags) fftw_plan_dft_1d(n, in, out, sign, flags)
+	#define SSTV_FFTW_PLAN_DFT_R2C_1D(name, n, in, out, flags) fftw_plan_dft_r2c_1d(n, in, out, flags)
 	#define SSTV_FFTW_DESTROY_PLAN fftw_destroy_plan
-	#define SSTV_FFTW_EXECUTE fftw_execute
+	#define SSTV_FFTW_EXECUTE_R2C fftw_execute_dft_r2c
 #endif
 
 #define SSTV_TEST_FILE
@@ -64,7 +64,7 @@ void sstv_get_fsk(sstv_chan_t *e, char *fsk_id)
         e->pcm.WindowPtr += samps_half_full;
     
         // FFT of last 22 ms
-        SSTV_FFTW_EXECUTE(e->fft.Plan2048);
+        SSTV_FFTW_EXECUTE_R2C(e->fft.Plan2048, e->fft.in2k, e->fft.out2k);
         NextTask("sstv FFT FSK");
     
         LoBin  = GET_BIN(1900+e->pic.HeaderShift, FFTLen)-1;
@@ -279,7 +279,7 @@ bool sstv_video_get(sstv_chan_t *e, const char *from, int Skip, bool Redraw)
             for (i = 0; i < 64; i++)
                 e->fft.in1k[i] = e->pcm.Buffer[e->pcm.WindowPtr+i-32] / 32768.0 * Hann[1][i];
 
-            SSTV_FFTW_EXECUTE(e->fft.Plan1024);
+            SSTV_FFTW_EXECUTE_R2C(e->fft.Plan1024, e->fft.in1k, e->fft.out1k);
             NextTask("sstv FFT sync");
 
             for (i=GET_BIN(1500+e->pic.HeaderShift,FFTLen); i<=GET_BIN(2300+e->pic.HeaderShift, FFTLen); i++)
@@ -316,7 +316,7 @@ bool sstv_video_get(sstv_chan_t *e, const char *from, int Skip, bool Redraw)
             for (i = 0; i < FFTLen; i++)
                 e->fft.in1k[i] = e->pcm.Buffer[e->pcm.WindowPtr + i - FFTLen/2] / 32768.0 * Hann[6][i];
     
-            SSTV_FFTW_EXECUTE(e->fft.Plan1024);
+            SSTV_FFTW_EXECUTE_R2C(e->fft.Plan1024, e->fft.in1k, e->fft.out1k);
             NextTask("sstv FFT SNR");
     
             // Calculate video-plus-noise power (1500-2300 Hz)
@@ -386,7 +386,7 @@ bool sstv_video_get(sstv_chan_t *e, const char *from, int Skip, bool Redraw)
             for (i = 0; i < WinLength; i++)
                 e->fft.in1k[i] = e->pcm.Buffer[e->pcm.WindowPtr + i - WinLength/2] / 32768.0 * Hann[WinIdx][i];
     
-            SSTV_FFTW_EXECUTE(e->fft.Plan1024);
+            SSTV_FFTW_EXECUTE_R2C(e->fft.Plan1024, e->fft.in1k, e->fft.out1k);
             NextTask("sstv FFT FM");
 
             MaxBin = 0;
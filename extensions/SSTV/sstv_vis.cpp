@@ -52,7 +52,7 @@ u1_t sstv_get_vis(sstv_chan_t *e)
             e->fft.in2k[i] = e->pcm.Buffer[e->pcm.WindowPtr + i - samps_10ms] / 32768.0 * Hann[i];
         
         // FFT of last 20 ms
-        SSTV_FFTW_EXECUTE(e->fft.Plan2048);
+        SSTV_FFTW_EXECUTE_R2C(e->fft.Plan2048, e->fft.in2k, e->fft.out2k);
         
         // Find the bin with most power
         MaxBin = 0;
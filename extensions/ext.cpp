@@ -25,6 +25,7 @@ Boston, MA  02110-1301, USA.
 #include "cfg.h"
 #include "gps.h"
 #include "rx.h"
+#include "rx_cmd_key.h"
 #include "ext_int.h"
 
 #include <stdio.h>
@@ -303,13 +304,20 @@ void extint_c2s(void *param)
 			//printf("extint_c2s: %s CONN%d(%p) RX=%d(%p) %d <%s>\n", conn_ext->ext? conn_ext->ext->name:"?", conn_ext->self_idx,
 			//    conn_ext, conn_ext->ext_rx_chan, (conn_ext->ext_rx_chan == -1)? 0:ext_users[conn_ext->ext_rx_chan].conn_ext, strlen(cmd), cmd);
 
+			switch (rx_cmd_key(cmd)) {
+
 			// answer from client ext about who they are
 			// match against list of known extensions and register msg handler
-			char *client_m = NULL;
-			int first_time;
+			case CMD_SET_EXT_SWITCH_TO_CLIENT: {
+				char *client_m = NULL;
+				int first_time;
+
+				i = sscanf(cmd, "SET ext_switch_to_client=%32ms first_time=%d rx_chan=%d", &client_m, &first_time, &rx_chan);
+				if (i != 3) {
+				    free(client_m);
+				    break;
+				}
 
-			i = sscanf(cmd, "SET ext_switch_to_client=%32ms first_time=%d rx_chan=%d", &client_m, &first_time, &rx_chan);
-			if (i == 3) {
 				for (i=0; i < n_exts; i++) {
 					ext = ext_list[i];
 					if (strcmp(client_m, ext->name) == 0) {
@@ -351,24 +359,24 @@ void extint_c2s(void *param)
 			    free(client_m);
 				continue;
 			}
-			free(client_m);
 			
-			i = sscanf(cmd, "SET ext_blur=%d", &rx_chan);
-			if (i == 1) {
+			case CMD_SET_EXT_BLUR: {
+				i = sscanf(cmd, "SET ext_blur=%d", &rx_chan);
+				if (i != 1) break;
 				extint_ext_users_init(rx_chan);
 				continue;
 			}
 			
-			i = strcmp(cmd, "SET init");
-			if (i == 0) {
+			case CMD_SET_INIT:
 				continue;
-			}
 
-			i = strcmp(cmd, "SET ext_is_locked_status");
-			if (i == 0) {
+			case CMD_SET_EXT_IS_LOCKED_STATUS:
 			    //printf("%d SET ext_is_locked_status\n", conn_ext->ext_rx_chan);
                 send_msg(conn_ext, false, "MSG ext_client_init=%d", is_locked);
 				continue;
+
+			default:
+				break;
 			}
 
 			ext_rx_chan = conn_ext->ext_rx_chan;
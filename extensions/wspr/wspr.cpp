@@ -27,6 +27,11 @@
 
 #include "wspr.h"
 #include "shmem.h"
+#include "simd.h"
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
 
 static const unsigned char pr3[NSYM_162]=
 {1,1,0,0,0,0,0,0,1,0,0,0,1,1,1,0,0,0,1,0,
@@ -39,7 +44,63 @@ static const unsigned char pr3[NSYM_162]=
     0,0,0,0,0,0,0,1,1,0,1,0,1,1,0,0,0,1,1,0,
     0,0};
 
-void sync_and_demodulate(
+static float tone_c[4][SPS], tone_s[4][SPS];
+
+static void tone_osc_init()
+{
+	for (int t = 0; t < 4; t++) {
+		for (int j = 0; j < SPS; j++) {
+			double ph = 2.0 * K_PI * t * j / FSPS;
+			tone_c[t][j] = cos(ph);
+			tone_s[t][j] = sin(ph);
+		}
+	}
+}
+
+static void tone_osc(wspr_osc_t *o, float f0, float drift1)
+{
+	int i, j, t;
+	float dt = 1.0/FSRATE, df = FSRATE/FSPS;
+	float fp, fplast = 0;
+	float twopidt = 2*K_PI*dt, df15 = df*1.5;
+	
+	o->f0 = f0;
+	o->drift1 = drift1;
+	o->nosc = 0;
+
+	for (i=0; i<NSYM_162; i++) {
+		fp = f0 + (drift1/2.0)*((float)i-FHSYM_81)/FHSYM_81;
+		if (i == 0 || fp != fplast) {
+			int n = o->nosc++;
+			float *c0 = o->osc[n].c[0], *s0 = o->osc[n].s[0];
+			
+			// lowest tone by recursion in double as before
+			double dphi0 = twopidt*(fp-df15), cdphi0 = cos(dphi0), sdphi0 = sin(dphi0);
+			double c = 1, s = 0, cc;
+			c0[0] = 1; s0[0] = 0;
+			for (j=1; j<SPS; j++) {
+				cc = c*cdphi0 - s*sdphi0;
+				s = c*sdphi0 + s*cdphi0;
+				c = cc;
+				c0[j] = c; s0[j] = s;
+			}
+			
+			for (t=1; t<4; t++) {
+				float *ct = o->osc[n].c[t], *st = o->osc[n].s[t];
+				for (j=0; j<SPS; j++) {
+					ct[j] = c0[j]*tone_c[t][j] - s0[j]*tone_s[t][j];
+					st[j] = c0[j]*tone_s[t][j] + s0[j]*tone_c[t][j];
+				}
+			}
+			WSPR_SHMEM_YIELD;
+			fplast = fp;
+		}
+		o->osc_idx[i] = o->nosc-1;
+	}
+	o->valid = true;
+}
+
+void sync_and_demodulate(wspr_osc_t *osc,
 	WSPR_CPX_t *id, WSPR_CPX_t *qd, long np,
 	unsigned char *symbols, float *f1, int ifmin, int ifmax, float fstep,
 	int *shift1,
@@ -53,29 +114,10 @@ void sync_and_demodulate(
      *                              symbols using passed frequency and shift.
      ************************************************************************/
     
-    static float fplast=-10000.0;
-    static float dt=1.0/FSRATE, df=FSRATE/FSPS;
-    static float pi=K_PI;
-    float twopidt, df15=df*1.5, df05=df*0.5;
-
-    int i, j, k, lag;
-    float
-		i0[NSYM_162], q0[NSYM_162],
-		i1[NSYM_162], q1[NSYM_162],
-		i2[NSYM_162], q2[NSYM_162],
-		i3[NSYM_162], q3[NSYM_162];
+    int i, lag;
+    float ip[4], qp[4];
     double p0, p1, p2, p3, cmet, totp, syncmax, fac;
-    double
-		c0[SPS], s0[SPS],
-		c1[SPS], s1[SPS],
-		c2[SPS], s2[SPS],
-		c3[SPS], s3[SPS];
-    double
-		dphi0, cdphi0, sdphi0,
-		dphi1, cdphi1, sdphi1,
-		dphi2, cdphi2, sdphi2,
-		dphi3, cdphi3, sdphi3;
-    float f0=0.0, fp, ss, fbest=0.0, fsum=0.0, f2sum=0.0, fsymb[NSYM_162];
+    float f0=0.0, ss, fbest=0.0, fsum=0.0, f2sum=0.0, fsymb[NSYM_162];
     int best_shift = 0, ifreq;
     
     syncmax=-1e30;
@@ -84,78 +126,30 @@ void sync_and_demodulate(
     if (mode == FIND_BEST_FREQ)     { lagmin=*shift1; lagmax=*shift1; }
     if (mode == CALC_SOFT_SYMS)     { lagmin=*shift1; lagmax=*shift1; ifmin=0; ifmax=0; }
 
-    twopidt=2*pi*dt;
     for(ifreq=ifmin; ifreq<=ifmax; ifreq++) {
         f0=*f1+ifreq*fstep;
+        if (!osc->valid || f0 != osc->f0 || drift1 != osc->drift1)
+            tone_osc(osc, f0, drift1);
+
         for(lag=lagmin; lag<=lagmax; lag=lag+lagstep) {
             ss=0.0;
             totp=0.0;
             for (i=0; i<NSYM_162; i++) {
-                fp = f0 + (drift1/2.0)*((float)i-FHSYM_81)/FHSYM_81;
-                if( i==0 || (fp != fplast) ) {  // only calculate sin/cos if necessary
-                    dphi0=twopidt*(fp-df15);
-                    cdphi0=cos(dphi0);
-                    sdphi0=sin(dphi0);
-                    
-                    dphi1=twopidt*(fp-df05);
-                    cdphi1=cos(dphi1);
-                    sdphi1=sin(dphi1);
-                    
-                    dphi2=twopidt*(fp+df05);
-                    cdphi2=cos(dphi2);
-                    sdphi2=sin(dphi2);
-                    
-                    dphi3=twopidt*(fp+df15);
-                    cdphi3=cos(dphi3);
-                    sdphi3=sin(dphi3);
-                    
-                    c0[0]=1; s0[0]=0;
-                    c1[0]=1; s1[0]=0;
-                    c2[0]=1; s2[0]=0;
-                    c3[0]=1; s3[0]=0;
-                    
-                    for (j=1; j<SPS; j++) {
-                        c0[j]=c0[j-1]*cdphi0 - s0[j-1]*sdphi0;
-                        s0[j]=c0[j-1]*sdphi0 + s0[j-1]*cdphi0;
-                        c1[j]=c1[j-1]*cdphi1 - s1[j-1]*sdphi1;
-                        s1[j]=c1[j-1]*sdphi1 + s1[j-1]*cdphi1;
-                        c2[j]=c2[j-1]*cdphi2 - s2[j-1]*sdphi2;
-                        s2[j]=c2[j-1]*sdphi2 + s2[j-1]*cdphi2;
-                        c3[j]=c3[j-1]*cdphi3 - s3[j-1]*sdphi3;
-                        s3[j]=c3[j-1]*sdphi3 + s3[j-1]*cdphi3;
-						
-						if ((j%YIELD_EVERY_N_TIMES)==(YIELD_EVERY_N_TIMES-1)) WSPR_SHMEM_YIELD;
-                    }
-                    fplast = fp;
-                }
-                
-                i0[i]=0.0; q0[i]=0.0;
-                i1[i]=0.0; q1[i]=0.0;
-                i2[i]=0.0; q2[i]=0.0;
-                i3[i]=0.0; q3[i]=0.0;
+                int k0 = lag+i*SPS;
                 
-                for (j=0; j<SPS; j++) {
-                    k=lag+i*SPS+j;
-                    wspr_array_dim(i, TPOINTS);
-                    wspr_array_dim(j, SPS);
-                    if( (k>0) && (k<np) ) {
-                        wspr_array_dim(k, TPOINTS);
-                        i0[i]=i0[i] + id[k]*c0[j] + qd[k]*s0[j];
-                        q0[i]=q0[i] - id[k]*s0[j] + qd[k]*c0[j];
-                        i1[i]=i1[i] + id[k]*c1[j] + qd[k]*s1[j];
-                        q1[i]=q1[i] - id[k]*s1[j] + qd[k]*c1[j];
-                        i2[i]=i2[i] + id[k]*c2[j] + qd[k]*s2[j];
-                        q2[i]=q2[i] - id[k]*s2[j] + qd[k]*c2[j];
-                        i3[i]=i3[i] + id[k]*c3[j] + qd[k]*s3[j];
-                        q3[i]=q3[i] - id[k]*s3[j] + qd[k]*c3[j];
-						
-						if ((j%YIELD_EVERY_N_TIMES)==(YIELD_EVERY_N_TIMES-1)) WSPR_SHMEM_YIELD;
-                    }
+                // only samples 0 < k < np, so partial symbols at the ends
+                int j0 = MAX(0, 1-k0), j1 = MIN(SPS, np-k0);
+                if (j1 > j0) {
+                    int n = osc->osc_idx[i];
+                    simd_tone4_corr_f(j1-j0, &id[k0+j0], &qd[k0+j0], &osc->osc[n].c[0][j0], &osc->osc[n].s[0][j0], SPS, ip, qp);
+                } else {
+                    ip[0] = ip[1] = ip[2] = ip[3] = 0;
+                    qp[0] = qp[1] = qp[2] = qp[3] = 0;
                 }
-                p0=i0[i]*i0[i] + q0[i]*q0[i];
-                p1=i1[i]*i1[i] + q1[i]*q1[i];
-                p2=i2[i]*i2[i] + q2[i]*q2[i];
-                p3=i3[i]*i3[i] + q3[i]*q3[i];
+                p0=ip[0]*ip[0] + qp[0]*qp[0];
+                p1=ip[1]*ip[1] + qp[1]*qp[1];
+                p2=ip[2]*ip[2] + qp[2]*qp[2];
+                p3=ip[3]*ip[3] + qp[3]*qp[3];
 
                 p0=sqrt(p0);
                 p1=sqrt(p1);
@@ -172,6 +166,7 @@ void sync_and_demodulate(
                         fsymb[i]=p2-p0;
                     }
                 }
+				if ((i%(YIELD_EVERY_N_TIMES/16))==(YIELD_EVERY_N_TIMES/16-1)) WSPR_SHMEM_YIELD;
             }
             ss=ss/totp;
             if( ss > syncmax ) {          //Save best parameters
@@ -480,6 +475,8 @@ void wspr_init()
         mettab[1][i] = round(10 * (metric_tables[2][SPS-1-i] - bias));
     }
     
+    tone_osc_init();
+    
     wspr_update_vars_from_config();
 }
 
@@ -504,6 +501,373 @@ void wspr_init()
     #define send_decode(w, seq) w->send_decode_seq = seq
 #endif
 
+// Parameters used for performance-tuning
+static const float minsync1=0.10;					//First sync limit
+static const float minsync2=0.12;					//Second sync limit
+static const int jig_range=128;
+static const int symfac=50;							//Soft-symbol normalizing factor
+static const int maxdrift=4;						//Maximum (+/-) drift
+static const float minrms=52.0 * (symfac/64.0);		//Final test for plausible decoding
+static const int delta=60;							//Fano threshold step
+
+// what a process needs to decode candidates, not shared
+typedef struct {
+	u1_t symbols[NSYM_162];
+	struct snode *stack;
+	wspr_osc_t *osc;
+} wspr_dec_t;
+
+static wspr_dec_t wspr_dec[MAX_RX_CHANS], wspr_worker_dec;
+
+static void wspr_candidate(wspr_t *w, wspr_dec_t *dec, wspr_job_t *job)
+{
+    wspr_buf_t *wb = w->buf;
+	WSPR_CPX_t *idat = wb->i_data[w->decode_ping_pong];
+	WSPR_CPX_t *qdat = wb->q_data[w->decode_ping_pong];
+	int pki = job->pki;
+	wspr_pk_t *p = &wb->pk_snr[pki];
+	int i, k;
+    float df = FSRATE/FSPS/2;
+	u4_t decode_start = timer_ms();
+	
+	if (dec->osc == NULL) {
+		dec->osc = (wspr_osc_t *) malloc(sizeof(wspr_osc_t));
+		dec->osc->valid = false;
+	}
+
+	/* Make coarse estimates of shift (DT), freq, and drift
+	 
+	 * Look for time offsets up to +/- 8 symbols (about +/- 5.4 s) relative
+	 to nominal start time, which is 2 seconds into the file
+	 
+	 * Calculates shift relative to the beginning of the file
+	 
+	 * Negative shifts mean that signal started before start of file
+	 
+	 * The program prints DT = shift-2 s
+	 
+	 * Shifts that cause sync vector to fall off of either end of the data
+	 vector are accommodated by "partial decoding", such that missing
+	 symbols produce a soft-decision symbol value of 128
+	 
+	 * The frequency drift model is linear, deviation of +/- drift/2 over the
+	 span of 162 symbols, with deviation equal to 0 at the center of the
+	 signal vector.
+	 */
+
+	int idrift,ifr,if0,ifd,k0;
+	int kindex;
+	float smax,ss,power,p0,p1,p2,p3,sync1;
+
+	smax = -1e30;
+	if0 = p->freq0/df+SPS;
+
+	for (ifr=if0-2; ifr<=if0+2; ifr++) {                      //Freq search
+		for( k0=-10; k0<22; k0++) {                             //Time search
+			for (idrift=-maxdrift; idrift<=maxdrift; idrift++) {  //Drift search
+				ss=0.0;
+				power=0.0;
+				for (k=0; k<NSYM_162; k++) {				//Sum over symbols
+					ifd=ifr+((float)k-FHSYM_81)/FHSYM_81*( (float)idrift )/(2.0*df);
+					kindex=k0+2*k;
+					if( kindex >= 0 && kindex < nffts ) {
+						wspr_array_dim(w->decode_ping_pong, N_PING_PONG);
+						wspr_array_dim(ifd-3, NFFT);
+						wspr_array_dim(ifd+3, NFFT);
+						wspr_array_dim(kindex, FPG*GROUPS);
+						p0=wb->pwr_samp[w->decode_ping_pong][ifd-3][kindex];
+						p1=wb->pwr_samp[w->decode_ping_pong][ifd-1][kindex];
+						p2=wb->pwr_samp[w->decode_ping_pong][ifd+1][kindex];
+						p3=wb->pwr_samp[w->decode_ping_pong][ifd+3][kindex];
+						
+						p0=sqrt(p0);
+						p1=sqrt(p1);
+						p2=sqrt(p2);
+						p3=sqrt(p3);
+						
+						ss=ss+(2*pr3[k]-1)*((p1+p3)-(p0+p2));
+						power=power+p0+p1+p2+p3;
+					}
+				}
+				sync1=ss/power;
+				if( sync1 > smax ) {                  //Save coarse parameters
+					smax=sync1;
+					p->shift0=HSPS*(k0+1);
+					p->drift0=idrift;
+					p->freq0=(ifr-SPS)*df;
+					p->sync0=sync1;
+				}
+				//wspr_d1printf("drift %d  k0 %d  sync %f\n", idrift, k0, smax);
+			}
+			WSPR_SHMEM_YIELD;
+		}
+	}
+	wspr_d1printf("npeak     #%02ld %6.1f snr  %9.6f (%7.2f) freq  %4.1f drift  %5d shift  %6.3f sync  %3d bin\n",
+		pki, p->snr0, w->dialfreq_MHz+(w->bfo+p->freq0)/1e6, w->cf_offset+p->freq0, p->drift0, p->shift0, p->sync0, p->bin0);
+
+	/*
+	 Refine the estimates of freq, shift using sync as a metric.
+	 Sync is calculated such that it is a float taking values in the range
+	 [0.0,1.0].
+	 
+	 Function sync_and_demodulate has three modes of operation:
+		no frequency or drift search. find best time lag.
+		no time lag or drift search. find best frequency.
+		no frequency or time lag search. Calculate soft-decision
+			symbols using passed frequency and shift.
+	 */
+	int shift1, lagmin, lagmax, lagstep, ifmin, ifmax;
+	unsigned int metric, cycles, maxnp;
+	unsigned int maxcycles = w->maxcycles;
+	int iifac = w->iifac;
+	float f1, fstep, drift1, snr;
+
+	f1 = p->freq0;
+	snr = p->snr0;
+	drift1 = p->drift0;
+	shift1 = p->shift0;
+	sync1 = p->sync0;
+	(void) snr;
+
+	wspr_d1printf("start     #%02ld %6.1f snr  %9.6f (%7.2f) freq  %4.1f drift  %5d shift  %6.3f sync\n",
+		pki, snr, w->dialfreq_MHz+(w->bfo+f1)/1e6, w->cf_offset+f1, drift1, shift1, sync1);
+
+	// coarse-grid lag and freq search, then if sync > minsync1 continue
+	fstep=0.0; ifmin=0; ifmax=0;
+	lagmin = shift1-128;
+	lagmax = shift1+128;
+	lagstep = 64;
+	sync_and_demodulate(dec->osc, idat, qdat, TPOINTS, dec->symbols, &f1, ifmin, ifmax, fstep, &shift1,
+						lagmin, lagmax, lagstep, drift1, symfac, &sync1, FIND_BEST_TIME_LAG);
+
+	fstep = 0.25; ifmin = -2; ifmax = 2;
+	sync_and_demodulate(dec->osc, idat, qdat, TPOINTS, dec->symbols, &f1, ifmin, ifmax, fstep, &shift1,
+						lagmin, lagmax, lagstep, drift1, symfac, &sync1, FIND_BEST_FREQ);
+
+	// refine drift estimate
+	fstep=0.0; ifmin=0; ifmax=0;
+	float driftp,driftm,syncp,syncm;
+	driftp = drift1+0.5;
+	sync_and_demodulate(dec->osc, idat, qdat, TPOINTS, dec->symbols, &f1, ifmin, ifmax, fstep, &shift1,
+						lagmin, lagmax, lagstep, driftp, symfac, &syncp, FIND_BEST_FREQ);
+	
+	driftm = drift1-0.5;
+	sync_and_demodulate(dec->osc, idat, qdat, TPOINTS, dec->symbols, &f1, ifmin, ifmax, fstep, &shift1,
+						lagmin, lagmax, lagstep, driftm, symfac, &syncm, FIND_BEST_FREQ);
+	
+	if (syncp > sync1) {
+		drift1 = driftp;
+		sync1 = syncp;
+	} else
+	
+	if (syncm > sync1) {
+		drift1 = driftm;
+		sync1 = syncm;
+	}
+
+	wspr_d1printf("coarse    #%02ld %6.1f snr  %9.6f (%7.2f) freq  %4.1f drift  %5d shift  %6.3f sync\n",
+		pki, snr, w->dialfreq_MHz+(w->bfo+f1)/1e6, w->cf_offset+f1, drift1, shift1, sync1);
+
+	// fine-grid lag and freq search
+	bool r_minsync1 = (sync1 > minsync1);
+
+	if (r_minsync1) {
+		lagmin = shift1-32; lagmax = shift1+32; lagstep = 16;
+		sync_and_demodulate(dec->osc, idat, qdat, TPOINTS, dec->symbols, &f1, ifmin, ifmax, fstep, &shift1,
+							lagmin, lagmax, lagstep, drift1, symfac, &sync1, FIND_BEST_TIME_LAG);
+	
+		// fine search over frequency
+		fstep = 0.05; ifmin = -2; ifmax = 2;
+		sync_and_demodulate(dec->osc, idat, qdat, TPOINTS, dec->symbols, &f1, ifmin, ifmax, fstep, &shift1,
+						lagmin, lagmax, lagstep, drift1, symfac, &sync1, FIND_BEST_FREQ);
+	} else {
+		wspr_d1printf("MINSYNC1  #%02ld\n", pki);
+	}
+	
+	int idt=0, ii=0, jiggered_shift;
+	float y, sq, rms;
+	int r_decoded = 0;
+	bool r_tooWeak = true;
+	
+	// ii: 0 +1 -1 +2 -2 +3 -3 ... (*iifac)
+	// ii always covers jig_range, stepped by iifac resolution
+	while (!w->abort_decode && r_minsync1 && !r_decoded && idt <= (jig_range/iifac)) {
+		ii = (idt+1)/2;
+		if ((idt&1) == 1) ii = -ii;
+		ii = iifac*ii;
+		jiggered_shift = shift1+ii;
+		
+		// Use mode 2 to get soft-decision symbols
+		sync_and_demodulate(dec->osc, idat, qdat, TPOINTS, dec->symbols, &f1, ifmin, ifmax, fstep,
+							&jiggered_shift, lagmin, lagmax, lagstep, drift1, symfac,
+							&sync1, CALC_SOFT_SYMS);
+
+		sq = 0.0;
+		for (i=0; i<NSYM_162; i++) {
+			y = (float) dec->symbols[i] - 128.0;
+			sq += y*y;
+		}
+		rms = sqrt(sq/FNSYM_162);
+
+		bool weak = true;
+		if ((sync1 > minsync2) && (rms > minrms)) {
+			deinterleave(dec->symbols);
+			
+			wspr_d2printf("decoder   #%02ld maxcycles %5d %s\n", pki, maxcycles, w->stack_decoder? "Jelinek" : "Fano");
+			if (w->stack_decoder) {
+				if (!dec->stack)
+					dec->stack = (struct snode *) malloc(WSPR_STACKSIZE * sizeof(struct snode));
+				r_decoded = jelinek(&metric, &cycles, job->decdata, dec->symbols, NBITS,
+									WSPR_STACKSIZE, dec->stack, mettab, maxcycles);
+			} else {
+				r_decoded = fano(&metric, &cycles, &maxnp, job->decdata, dec->symbols, NBITS,
+								mettab, delta, maxcycles);
+			}
+
+			r_tooWeak = weak = false;
+		}
+		
+		wspr_d2printf("jig <>%3d #%02ld %6.1f snr  %9.6f (%7.2f) freq  %4.1f drift  %5d(%+4d) shift  %6.3f sync  %4.1f rms",
+			idt, pki, snr, w->dialfreq_MHz+(w->bfo+f1)/1e6, w->cf_offset+f1, drift1, jiggered_shift, ii, sync1, rms);
+		if (!weak) {
+			wspr_d2printf("  %4ld metric  %3ld cycles\n", metric, cycles);
+		} else {
+			if (sync1 <= minsync2) wspr_d2printf("  SYNC-WEAK");
+			if (rms <= minrms) wspr_d2printf("  RMS-WEAK");
+			wspr_d2printf("\n");
+		}
+		
+		idt++;
+		if (w->quickmode) break;
+	}
+	
+	job->minsync1 = r_minsync1;
+	job->decoded = r_decoded;
+	job->too_weak = r_tooWeak;
+	job->time_up = (!w->abort_decode && r_minsync1 && !r_decoded && idt > (jig_range/iifac));
+	job->f1 = f1;
+	job->drift1 = drift1;
+	job->shift1 = shift1;
+	job->sync1 = sync1;
+	job->msec = timer_ms() - decode_start;
+}
+
+// claim and run the next queued job of the channel, false if there are none
+static bool wspr_job_run(wspr_t *w, wspr_dec_t *dec, int worker)
+{
+	if (w->next_job >= w->njobs) return false;
+	__sync_synchronize();
+	if (worker != WSPR_JOB_CHANNEL && !w->use_pool) return false;
+	int n = __sync_fetch_and_add(&w->next_job, 1);
+	if (n >= w->njobs) return false;
+
+	wspr_job_t *job = &w->job[n];
+	job->worker = worker;
+	job->state = WSPR_JOB_RUNNING;
+	wspr_candidate(w, dec, job);
+	__sync_synchronize();
+	job->state = WSPR_JOB_DONE;
+	return true;
+}
+
+static void wspr_jobs_open(wspr_t *w, int njobs, bool use_pool)
+{
+	__sync_synchronize();
+	w->njobs = njobs;
+	w->use_pool = use_pool;
+	__sync_synchronize();
+	w->next_job = 0;
+	
+	#ifndef WSPR_SHMEM_DISABLE
+		wspr_pool_t *pool = &WSPR_SHMEM->pool;
+		if (!use_pool || njobs <= 1) return;
+		pool->seq++;
+		__sync_synchronize();
+		for (int i = 0; i < pool->n; i++) {
+			if (pool->pid[i]) kill(pool->pid[i], SIG_WSPR_POOL);
+		}
+	#endif
+}
+
+// run jobs until job n is done
+static void wspr_job_wait(wspr_t *w, wspr_dec_t *dec, int n)
+{
+	while (w->job[n].state != WSPR_JOB_DONE) {
+		if (!wspr_job_run(w, dec, WSPR_JOB_CHANNEL))
+			kiwi_usleep(10000);		// taken by a worker
+	}
+}
+
+// no more jobs are handed out, wait for the ones that were (early exit due to abort_decode)
+static void wspr_jobs_close(wspr_t *w)
+{
+	int claimed = __sync_lock_test_and_set(&w->next_job, WSPR_JOBS_CLOSED);
+	claimed = MIN(claimed, w->njobs);
+	for (int n = 0; n < claimed; n++) {
+		while (w->job[n].state != WSPR_JOB_DONE)
+			kiwi_usleep(10000);
+	}
+}
+
+#ifndef WSPR_SHMEM_DISABLE
+
+#define WSPR_WORKER_NICE 10
+
+// Helps the channel decode processes with the jobs of all channels open to the pool.
+// Worker wn is pinned to the single core 1 + wn % (ncpu - 1), so by default (one worker per core
+// but core 0, where main() runs the server) each has a core of its own. On a single-core
+// machine it isn't pinned. Niced so the real-time work on its core comes first.
+static void wspr_worker(void *param)
+{
+	int wn = (int) FROM_VOID_PARAM(param);
+	wspr_pool_t *pool = &WSPR_SHMEM->pool;
+	int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	
+	if (ncpu > 1) set_cpu_affinity(1 + wn % (ncpu - 1));
+	setpriority(PRIO_PROCESS, 0, WSPR_WORKER_NICE);
+
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIG_WSPR_POOL);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	pool->pid[wn] = getpid();
+
+	while (1) {
+		u4_t seq = pool->seq;
+		bool ran;
+		do {
+			ran = false;
+			for (int ch = 0; ch < rx_chans; ch++) {
+				if (wspr_job_run(&WSPR_SHMEM->wspr[ch], &wspr_worker_dec, wn)) {
+					pool->jobs[wn]++;
+					ran = true;
+				}
+			}
+		} while (ran);
+		
+		// jobs queued since the scan started have changed seq, the signal stays pending until sigwait()
+		if (pool->seq == seq) {
+			int sig;
+			sigwait(&mask, &sig);
+		}
+	}
+}
+
+#endif
+
+void wspr_pool_init(int nworkers)
+{
+	#ifndef WSPR_SHMEM_DISABLE
+		wspr_pool_t *pool = &WSPR_SHMEM->pool;
+		memset(pool, 0, sizeof(*pool));
+		if (nworkers == 0) nworkers = MAX(sysconf(_SC_NPROCESSORS_ONLN) - 1, 1);
+		pool->n = CLAMP(nworkers, 0, N_WSPR_WORKERS);
+		for (int i = 0; i < pool->n; i++)
+			child_task(stprintf("kiwi.wspr-w%d", i), wspr_worker, NO_WAIT, TO_VOID_PARAM(i));
+		printf("WSPR %d decode workers\n", pool->n);
+	#endif
+}
+
 void wspr_decode(int rx_chan)
 {
     char cr[] = "(C) 2016, Steven Franke - K9AN";
@@ -511,11 +875,10 @@ void wspr_decode(int rx_chan)
 
     wspr_t *w = &WSPR_SHMEM->wspr[rx_chan];
     wspr_buf_t *wb = w->buf;
-    int i,j,k;
+    int i,j,n;
 
     int ipass, npasses = 1;
-    int shift1, lagmin, lagmax, lagstep, ifmin, ifmax;
-    unsigned int metric, cycles, maxnp;
+    int shift1;
 
     float df = FSRATE/FSPS/2;
     float dt = 1.0/FSRATE, dt_print;
@@ -523,7 +886,7 @@ void wspr_decode(int rx_chan)
 	int pki, npk=0;
 
     double freq_print;
-    float f1, fstep, sync1, drift1, snr;
+    float f1, drift1, snr;
 
     int ndecodes_pass;
     
@@ -531,23 +894,12 @@ void wspr_decode(int rx_chan)
     //	more_candidates
     //	subtraction
     
-    // Parameters used for performance-tuning:
+    // Parameters used for performance-tuning (more in wspr_candidate):
     unsigned int maxcycles=200;				//Decoder timeout limit
-    float minsync1=0.10;					//First sync limit
-    float minsync2=0.12;					//Second sync limit
     int iifac=2;							//Step size in final DT peakup
-    int jig_range=128;
-    int symfac=50;							//Soft-symbol normalizing factor
-    int maxdrift=4;							//Maximum (+/-) drift
-    float minrms=52.0 * (symfac/64.0);		//Final test for plausible decoding
-    int delta=60;							//Fano threshold step
     
 	wspr_aprintf("DECO-C START decode_ping_pong=%d\n", w->decode_ping_pong);
 
-    wspr_array_dim(w->decode_ping_pong, N_PING_PONG);
-	WSPR_CPX_t *idat = wb->i_data[w->decode_ping_pong];
-	WSPR_CPX_t *qdat = wb->q_data[w->decode_ping_pong];
-
     if (!w->init) {
     	w->init = true;
     }
@@ -665,263 +1017,80 @@ void wspr_decode(int rx_chan)
         wspr_d1printf("PASS %d npeaks=%d valid_peaks=%d maxcycles=%d jig_range=%+d..%d jig_step=%d ---------------------------------------------\n",
         	ipass+1, npk, valid_peaks, maxcycles, jig_range/2, -jig_range/2, iifac);
 
-        /* Make coarse estimates of shift (DT), freq, and drift
-         
-         * Look for time offsets up to +/- 8 symbols (about +/- 5.4 s) relative
-         to nominal start time, which is 2 seconds into the file
-         
-         * Calculates shift relative to the beginning of the file
-         
-         * Negative shifts mean that signal started before start of file
-         
-         * The program prints DT = shift-2 s
-         
-         * Shifts that cause sync vector to fall off of either end of the data
-         vector are accommodated by "partial decoding", such that missing
-         symbols produce a soft-decision symbol value of 128
-         
-         * The frequency drift model is linear, deviation of +/- drift/2 over the
-         span of 162 symbols, with deviation equal to 0 at the center of the
-         signal vector.
+        /*
+         Refine the estimates of freq, shift using sync as a metric and try to decode,
+         see wspr_candidate(). The candidates still in play are queued as jobs, strongest first.
+         The jobs are run in parallel by the pool workers and this process while the
+         results are taken here in order.
          */
+		int candidates = 0;
+        ndecodes_pass = 0;
 
-        int idrift,ifr,if0,ifd,k0;
-        int kindex;
-        float smax,ss,power,p0,p1,p2,p3;
-
-        for (pki=0; pki < npk; pki++) {			//For each candidate...
-        	wspr_pk_t *p = &wb->pk_snr[pki];
-            smax = -1e30;
-            if0 = p->freq0/df+SPS;
-
+        for (pki=0; pki < npk; pki++) {
 			#if defined(MORE_EFFORT)
-				if (ipass != 0 && p->ignore)
+				if (ipass != 0 && wb->pk_snr[pki].ignore)
 					continue;
 			#endif
-			
-            for (ifr=if0-2; ifr<=if0+2; ifr++) {                      //Freq search
-                for( k0=-10; k0<22; k0++) {                             //Time search
-                    for (idrift=-maxdrift; idrift<=maxdrift; idrift++) {  //Drift search
-                        ss=0.0;
-                        power=0.0;
-                        for (k=0; k<NSYM_162; k++) {				//Sum over symbols
-                            ifd=ifr+((float)k-FHSYM_81)/FHSYM_81*( (float)idrift )/(2.0*df);
-                            kindex=k0+2*k;
-                            if( kindex >= 0 && kindex < nffts ) {
-                                wspr_array_dim(w->decode_ping_pong, N_PING_PONG);
-                                wspr_array_dim(ifd-3, NFFT);
-                                wspr_array_dim(ifd+3, NFFT);
-                                wspr_array_dim(kindex, FPG*GROUPS);
-								p0=wb->pwr_samp[w->decode_ping_pong][ifd-3][kindex];
-								p1=wb->pwr_samp[w->decode_ping_pong][ifd-1][kindex];
-								p2=wb->pwr_samp[w->decode_ping_pong][ifd+1][kindex];
-								p3=wb->pwr_samp[w->decode_ping_pong][ifd+3][kindex];
-                                
-                                p0=sqrt(p0);
-                                p1=sqrt(p1);
-                                p2=sqrt(p2);
-                                p3=sqrt(p3);
-                                
-                                ss=ss+(2*pr3[k]-1)*((p1+p3)-(p0+p2));
-                                power=power+p0+p1+p2+p3;
-                            }
-                        }
-                        sync1=ss/power;
-                        if( sync1 > smax ) {                  //Save coarse parameters
-                            smax=sync1;
-							p->shift0=HSPS*(k0+1);
-							p->drift0=idrift;
-							p->freq0=(ifr-SPS)*df;
-							p->sync0=sync1;
-                        }
-						//wspr_d1printf("drift %d  k0 %d  sync %f\n", idrift, k0, smax);
-                    }
-					WSPR_SHMEM_YIELD;
-                }
-            }
-			wspr_d1printf("npeak     #%02ld %6.1f snr  %9.6f (%7.2f) freq  %4.1f drift  %5d shift  %6.3f sync  %3d bin\n",
-				pki, p->snr0, w->dialfreq_MHz+(w->bfo+p->freq0)/1e6, w->cf_offset+p->freq0, p->drift0, p->shift0, p->sync0, p->bin0);
+			wspr_job_t *job = &w->job[candidates++];
+			job->pki = pki;
+			job->state = WSPR_JOB_QUEUED;
         }
+        w->maxcycles = maxcycles;
+        w->iifac = iifac;
 
-        /*
-         Refine the estimates of freq, shift using sync as a metric.
-         Sync is calculated such that it is a float taking values in the range
-         [0.0,1.0].
-         
-         Function sync_and_demodulate has three modes of operation:
-            no frequency or drift search. find best time lag.
-            no time lag or drift search. find best frequency.
-            no frequency or time lag search. Calculate soft-decision
-                symbols using passed frequency and shift.
-         
-         NB: best possibility for OpenMP may be here: several worker threads
-         could each work on one candidate at a time.
-         */
-		int candidates = 0;
-        ndecodes_pass = 0;
+		#if defined(SUBTRACT_SIGNAL)
+        	wspr_jobs_open(w, candidates, false);	// in order, each subtraction changes the data for the next
+        #else
+        	wspr_jobs_open(w, candidates, true);
+        #endif
 		
-        for (pki=0; pki < npk && !w->abort_decode; pki++) {
+        for (n=0; n < candidates && !w->abort_decode; n++) {
         	bool f_decoded = false, f_delete = false, f_image = false, f_decoding = false;
 
+        	wspr_job_t *job = &w->job[n];
+        	pki = job->pki;
         	wspr_pk_t *p = &wb->pk_snr[pki];
-			u4_t decode_start = timer_ms();
-
-			#if defined(MORE_EFFORT)
-				if (ipass != 0 && p->ignore)
-					continue;
-			#endif
-			
-			candidates++;
-            f1 = p->freq0;
-            snr = p->snr0;
-            drift1 = p->drift0;
-            shift1 = p->shift0;
-            sync1 = p->sync0;
 
 			f_decoding = true;
 			w->pk_freq[p->freq_idx].flags |= WSPR_F_DECODING;
 			send_peak_single(w, p->freq_idx);
 	
-			wspr_d1printf("start     #%02ld %6.1f snr  %9.6f (%7.2f) freq  %4.1f drift  %5d shift  %6.3f sync\n",
-				pki, snr, w->dialfreq_MHz+(w->bfo+f1)/1e6, w->cf_offset+f1, drift1, shift1, sync1);
-
-            // coarse-grid lag and freq search, then if sync > minsync1 continue
-            fstep=0.0; ifmin=0; ifmax=0;
-            lagmin = shift1-128;
-            lagmax = shift1+128;
-            lagstep = 64;
-            sync_and_demodulate(idat, qdat, TPOINTS, w->symbols, &f1, ifmin, ifmax, fstep, &shift1,
-                                lagmin, lagmax, lagstep, drift1, symfac, &sync1, FIND_BEST_TIME_LAG);
-
-            fstep = 0.25; ifmin = -2; ifmax = 2;
-            sync_and_demodulate(idat, qdat, TPOINTS, w->symbols, &f1, ifmin, ifmax, fstep, &shift1,
-                                lagmin, lagmax, lagstep, drift1, symfac, &sync1, FIND_BEST_FREQ);
-
-            // refine drift estimate
-            fstep=0.0; ifmin=0; ifmax=0;
-            float driftp,driftm,syncp,syncm;
-            driftp = drift1+0.5;
-            sync_and_demodulate(idat, qdat, TPOINTS, w->symbols, &f1, ifmin, ifmax, fstep, &shift1,
-                                lagmin, lagmax, lagstep, driftp, symfac, &syncp, FIND_BEST_FREQ);
-            
-            driftm = drift1-0.5;
-            sync_and_demodulate(idat, qdat, TPOINTS, w->symbols, &f1, ifmin, ifmax, fstep, &shift1,
-                                lagmin, lagmax, lagstep, driftm, symfac, &syncm, FIND_BEST_FREQ);
-            
-            if (syncp > sync1) {
-                drift1 = driftp;
-                sync1 = syncp;
-            } else
-            
-            if (syncm > sync1) {
-                drift1 = driftm;
-                sync1 = syncm;
-            }
-
-			wspr_d1printf("coarse    #%02ld %6.1f snr  %9.6f (%7.2f) freq  %4.1f drift  %5d shift  %6.3f sync\n",
-				pki, snr, w->dialfreq_MHz+(w->bfo+f1)/1e6, w->cf_offset+f1, drift1, shift1, sync1);
-
-            // fine-grid lag and freq search
-			bool r_minsync1 = (sync1 > minsync1);
-
-            if (r_minsync1) {
-                lagmin = shift1-32; lagmax = shift1+32; lagstep = 16;
-                sync_and_demodulate(idat, qdat, TPOINTS, w->symbols, &f1, ifmin, ifmax, fstep, &shift1,
-                                    lagmin, lagmax, lagstep, drift1, symfac, &sync1, FIND_BEST_TIME_LAG);
+			wspr_job_wait(w, &wspr_dec[rx_chan], n);
+            f1 = job->f1;
+            snr = p->snr0;
+            drift1 = job->drift1;
+            shift1 = job->shift1;
             
-                // fine search over frequency
-                fstep = 0.05; ifmin = -2; ifmax = 2;
-                sync_and_demodulate(idat, qdat, TPOINTS, w->symbols, &f1, ifmin, ifmax, fstep, &shift1,
-                                lagmin, lagmax, lagstep, drift1, symfac, &sync1, FIND_BEST_FREQ);
-            } else {
+            if (!job->minsync1) {
             	p->ignore = true;
-				wspr_d1printf("MINSYNC1  #%02ld\n", pki);
 				f_delete = true;
             }
             
-            int idt=0, ii=0, jiggered_shift;
-            float y, sq, rms;
-        	int r_decoded = 0;
-        	bool r_tooWeak = true;
-            
-            // ii: 0 +1 -1 +2 -2 +3 -3 ... (*iifac)
-            // ii always covers jig_range, stepped by iifac resolution
-            while (!w->abort_decode && r_minsync1 && !r_decoded && idt <= (jig_range/iifac)) {
-                ii = (idt+1)/2;
-                if ((idt&1) == 1) ii = -ii;
-                ii = iifac*ii;
-                jiggered_shift = shift1+ii;
-                
-                // Use mode 2 to get soft-decision symbols
-                sync_and_demodulate(idat, qdat, TPOINTS, w->symbols, &f1, ifmin, ifmax, fstep,
-                                    &jiggered_shift, lagmin, lagmax, lagstep, drift1, symfac,
-                                    &sync1, CALC_SOFT_SYMS);
-
-                sq = 0.0;
-                for (i=0; i<NSYM_162; i++) {
-                    y = (float) w->symbols[i] - 128.0;
-                    sq += y*y;
-                }
-                rms = sqrt(sq/FNSYM_162);
-
-				bool weak = true;
-                if ((sync1 > minsync2) && (rms > minrms)) {
-                    deinterleave(w->symbols);
-                    
-                    wspr_d2printf("decoder   #%02ld maxcycles %5d %s\n", pki, maxcycles, w->stack_decoder? "Jelinek" : "Fano");
-                    if (w->stack_decoder) {
-                        if (!w->stack)
-			                w->stack = (struct snode *) malloc(WSPR_STACKSIZE * sizeof(struct snode));
-                        r_decoded = jelinek(&metric, &cycles, w->decdata, w->symbols, NBITS,
-											WSPR_STACKSIZE, w->stack, mettab, maxcycles);
-                    } else {
-                        r_decoded = fano(&metric, &cycles, &maxnp, w->decdata, w->symbols, NBITS,
-										mettab, delta, maxcycles);
-                    }
-
-                    r_tooWeak = weak = false;
-                }
-                
-				wspr_d2printf("jig <>%3d #%02ld %6.1f snr  %9.6f (%7.2f) freq  %4.1f drift  %5d(%+4d) shift  %6.3f sync  %4.1f rms",
-					idt, pki, snr, w->dialfreq_MHz+(w->bfo+f1)/1e6, w->cf_offset+f1, drift1, jiggered_shift, ii, sync1, rms);
-				if (!weak) {
-					wspr_d2printf("  %4ld metric  %3ld cycles\n", metric, cycles);
-				} else {
-					if (sync1 <= minsync2) wspr_d2printf("  SYNC-WEAK");
-					if (rms <= minrms) wspr_d2printf("  RMS-WEAK");
-					wspr_d2printf("\n");
-				}
-				
-                idt++;
-                if (w->quickmode) break;
-            }
-            
-            bool r_timeUp = (!w->abort_decode && r_minsync1 && !r_decoded && idt > (jig_range/iifac));
-            int r_valid = 0;
-            
-            //if (r_timeUp && r_tooWeak && iifac == 1) {
-            if (r_timeUp && r_tooWeak) {
+            //if (job->time_up && job->too_weak && iifac == 1) {
+            if (job->time_up && job->too_weak) {
 				wspr_d1printf("NO CHANGE #%02ld\n", pki);
 				p->ignore = true;	// situation not going to get any better
 				f_delete = true;
 			}
 			
 			// result priority: abort, minSync1, tooWeak, noChange, timeUp, image, decoded
+            int r_valid = 0;
             
-            if (r_decoded) {
+            if (job->decoded) {
                 ndecodes_pass++;
                 p->ignore = true;
                 
                 // Unpack the decoded message, update the hashtable, apply
                 // sanity checks on grid and power, and return
                 // call_loc_pow string and also callsign (for de-duping).
-                r_valid = unpk_(w->decdata, w->call_loc_pow, w->callsign, w->grid, &w->dBm);
+                r_valid = unpk_(job->decdata, w->call_loc_pow, w->callsign, w->grid, &w->dBm);
 
                 // subtract even on last pass
                 #ifdef SUBTRACT_SIGNAL
 					if (w->subtraction && (ipass < npasses) && r_valid > 0) {
 						if (get_wspr_channel_symbols(w->call_loc_pow, w->channel_symbols)) {
-							subtract_signal2(idat, qdat, TPOINTS, f1, shift1, drift1, w->channel_symbols);
+							subtract_signal2(wb->i_data[w->decode_ping_pong], wb->q_data[w->decode_ping_pong], TPOINTS,
+								f1, shift1, drift1, w->channel_symbols);
 						} else {
 							break;
 						}
@@ -944,7 +1113,7 @@ void wspr_decode(int rx_chan)
 								f_image = true;
 							}
 							wspr_d1printf("%s     #%02ld  with #%02ld %s, %.3f secs\n", f_image? "IMAGE" : "DUPE ",
-								pki, i, dp->call, (float)(timer_ms()-decode_start)/1e3);
+								pki, i, dp->call, (float) job->msec/1e3);
 							r_dupe = true;
 							break;
 						}
@@ -954,10 +1123,10 @@ void wspr_decode(int rx_chan)
 				if (r_valid <= 0 && !r_dupe) {
 					if (r_valid < 0) {
 						wspr_d1printf("UNPK ERR! #%02ld  error code %d, %.3f secs\n",
-							pki, r_valid, (float)(timer_ms()-decode_start)/1e3);
+							pki, r_valid, (float) job->msec/1e3);
 					} else {
 						wspr_d1printf("NOT VALID #%02ld  %.3f secs\n",
-							pki, (float)(timer_ms()-decode_start)/1e3);
+							pki, (float) job->msec/1e3);
 					}
 					f_delete = true;
 				}
@@ -977,7 +1146,7 @@ void wspr_decode(int rx_chan)
             
 					wspr_d1printf("TYPE%d %02d%02d %3.0f %4.1f %10.6f %2d %-s %4s %2d [%s] in %.3f secs --------------------------------------------------------------------\n",
 					   r_valid, hour, min, snr, dt_print, freq_print, (int) drift1,
-					   w->callsign, w->grid, w->dBm, w->call_loc_pow, (float)(timer_ms()-decode_start)/1e3);
+					   w->callsign, w->grid, w->dBm, w->call_loc_pow, (float) job->msec/1e3);
 					
 					wspr_decode_t *dp = &w->deco[w->uniques];
 					dp->r_valid = r_valid;
@@ -998,8 +1167,8 @@ void wspr_decode(int rx_chan)
 					send_decode(w, w->uniques);
                 }
 			} else {
-				if (r_timeUp) {
-					wspr_d1printf("TIME UP   #%02ld %.3f secs\n", pki, (float)(timer_ms()-decode_start)/1e3);
+				if (job->time_up) {
+					wspr_d1printf("TIME UP   #%02ld %.3f secs\n", pki, (float) job->msec/1e3);
 					#if defined(MORE_EFFORT)
 						f_decoding = false;
 					#else
@@ -1026,6 +1195,8 @@ void wspr_decode(int rx_chan)
 			send_peak_single(w, p->freq_idx);
         }	// peak list
         
+        wspr_jobs_close(w);
+        
 		if (candidates == 0)
 			break;		// nothing left to do
 			
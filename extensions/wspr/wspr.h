@@ -33,6 +33,7 @@
 #include "misc.h"
 #include "fano.h"
 #include "jelinek.h"
+#include "fft_plan.h"
 
 #include <time.h>
 #include <fftw3.h>
@@ -128,19 +129,19 @@
 	#define WSPR_FFTW_COMPLEX fftwf_complex
 	#define WSPR_FFTW_MALLOC fftwf_malloc
 	#define WSPR_FFTW_FREE fftwf_free
-	#define WSPR_FFTW_PLAN fftwf_plan
-	#define WSPR_FFTW_PLAN_DFT_1D fftwf_plan_dft_1d
-	#define WSPR_FFTW_DESTROY_PLAN fftwf_destroy_plan
-	#define WSPR_FFTW_EXECUTE fftwf_execute
+	#define WSPR_FFTW_PLAN fft_plan_t *
+	#define WSPR_FFTW_PLAN_DFT_1D fft_plan_dft_1d
+	#define WSPR_FFTW_DESTROY_PLAN(plan)
+	#define WSPR_FFTW_EXECUTE_DFT fft_execute_dft
 #else
 	typedef double WSPR_CPX_t;
 	#define WSPR_FFTW_COMPLEX fftw_complex
 	#define WSPR_FFTW_MALLOC fftw_malloc
 	#define WSPR_FFTW_FREE fftw_free
 	#define WSPR_FFTW_PLAN fftw_plan
-	#define WSPR_FFTW_PLAN_DFT_1D fftw_plan_dft_1d
+	#define WSPR_FFTW_PLAN_DFT_1D(name, n, in, out, sign, flags) fftw_plan_dft_1d(n, in, out, sign, flags)
 	#define WSPR_FFTW_DESTROY_PLAN fftw_destroy_plan
-	#define WSPR_FFTW_EXECUTE fftw_execute
+	#define WSPR_FFTW_EXECUTE_DFT fftw_execute_dft
 #endif
 
 #define	SYMTIME		(FSPS / FSRATE)		// symbol time: 256 samps @ 375 srate, 683 ms, 1.46 Hz
@@ -186,6 +187,39 @@
 #define NPK 256
 #define MAX_NPK 12
 
+// Each pass the candidates are queued as jobs. They are run by the channel's decode process and,
+// with MULTI_CORE, by a pool of worker processes shared by all channels (one per core).
+// Only the channel's decode process unpacks and reports the results, in candidate order,
+// so the callsign hash table and the de-duping see the decodes in the same order as before.
+#define WSPR_JOB_QUEUED		0
+#define WSPR_JOB_RUNNING	1
+#define WSPR_JOB_DONE		2
+
+#define WSPR_JOBS_CLOSED	0x1000000	// next_job between passes
+#define WSPR_JOB_CHANNEL	-1			// job run by the channel's decode process, else worker number
+
+typedef struct {
+	int state, pki, worker;
+	bool minsync1, decoded, time_up, too_weak;
+	float f1, drift1, sync1;
+	int shift1;
+	u1_t decdata[LEN_DECODE];
+	u4_t msec;
+} wspr_job_t;
+
+#ifdef WSPR_SHMEM_DISABLE
+	#define N_WSPR_WORKERS 0
+#else
+	#define N_WSPR_WORKERS 4			// max, the number of cores are used
+#endif
+
+typedef struct {
+	int n;
+	u4_t seq;							// incremented when jobs are queued
+	pid_t pid[N_WSPR_WORKERS + 1];		// set by the worker once it can be signalled
+	u4_t jobs[N_WSPR_WORKERS + 1];
+} wspr_pool_t;
+
 typedef struct {
 	bool ignore;
 	float freq0, snr0, drift0, sync0;
@@ -287,9 +321,8 @@ typedef struct {
 	// decode task
     int bfo;
 	float min_snr, snr_scaling_factor;
-	struct snode *stack;
 	float dialfreq_MHz, cf_offset;
-	u1_t symbols[NSYM_162], decdata[LEN_DECODE], channel_symbols[NSYM_162];
+	u1_t channel_symbols[NSYM_162];
 	char callsign[LEN_CALL], call_loc_pow[LEN_C_L_P], grid[LEN_GRID];
 	int dBm;
 	#define NDECO 32
@@ -302,6 +335,13 @@ typedef struct {
     wspr_pk_t pk_freq[MAX_NPK], pk_save[MAX_NPK];
     int send_decode_seq_parent, send_decode_seq;
 
+	// candidate jobs of the current pass
+	int njobs, next_job;
+	bool use_pool;		// the workers may run them, else only the channel itself
+	u4_t maxcycles;
+	int iifac;
+	wspr_job_t job[MAX_NPK];
+
     WSPR_CHECK(u4_t magic2;)
 } wspr_t;
 
@@ -318,6 +358,7 @@ extern wspr_conf_t wspr_c;
 struct wspr_shmem_t {
     wspr_t wspr[MAX_RX_CHANS];
     wspr_buf_t wspr_buf[MAX_RX_CHANS];
+    wspr_pool_t pool;
 };
 
 #ifdef WSPR_SHMEM_DISABLE
@@ -331,13 +372,29 @@ void wspr_init();
 bool wspr_update_vars_from_config();
 void wspr_data(int rx_chan, int ch, int nsamps, TYPECPX *samps);
 void wspr_decode(int rx_chan);
+void wspr_pool_init(int nworkers = 0);    // 0: one per core other than core 0
 void wspr_send_peaks(wspr_t *w, int start, int stop);
 void wspr_send_decode(wspr_t *w, int seq);
 void wspr_autorun(int which, int idx);
 
 typedef enum { FIND_BEST_TIME_LAG, FIND_BEST_FREQ, CALC_SOFT_SYMS } wspr_mode_e;
 
-void sync_and_demodulate(
+// Tone oscillator tables of all the symbols for one (f0, drift1), kept by the decoder
+// (see wspr.cpp) because the lag searches and the soft symbol jiggering ask for the same ones again and again.
+// Symbol tables are shared by consecutive symbols with the same frequency (e.g. no drift).
+// The four tones are the lowest one times fixed exp(j*2*pi*t*n/SPS) since they are df apart.
+typedef struct wspr_osc_t {
+	bool valid;
+	float f0, drift1;
+	int nosc;
+	short osc_idx[NSYM_162];
+	struct {
+		float c[4][SPS], s[4][SPS];
+	} osc[NSYM_162];
+} wspr_osc_t;
+
+
+void sync_and_demodulate(wspr_osc_t *osc,
 	WSPR_CPX_t *id, WSPR_CPX_t *qd, long np,
 	unsigned char *symbols, float *f1, int ifmin, int ifmax, float fstep,
 	int *shift1,
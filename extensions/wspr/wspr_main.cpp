@@ -152,7 +152,7 @@ void WSPR_FFT(void *param)
 			
 			//u4_t start = timer_us();
 			WSPR_YIELD;
-			WSPR_FFTW_EXECUTE(w->fftplan);
+			WSPR_FFTW_EXECUTE_DFT(w->fftplan, w->fftin, w->fftout);
 			WSPR_YIELD;
 			//if (i==0) wspr_printf("512 FFT %.1f us\n", (float)(timer_us()-start));
 			
@@ -829,13 +829,14 @@ void wspr_main()
 		WSPR_CHECK(w->magic1 = 0xcafe; w->magic2 = 0xbabe;)
 		w->rx_chan = i;
 		w->buf = &WSPR_SHMEM->wspr_buf[i];
+		w->next_job = WSPR_JOBS_CLOSED;
 		
 		w->medium_effort = 1;
 		w->wspr_type = WSPR_TYPE_2MIN;
 		
 		w->fftin = (WSPR_FFTW_COMPLEX*) WSPR_FFTW_MALLOC(sizeof(WSPR_FFTW_COMPLEX)*NFFT);
 		w->fftout = (WSPR_FFTW_COMPLEX*) WSPR_FFTW_MALLOC(sizeof(WSPR_FFTW_COMPLEX)*NFFT);
-		w->fftplan = WSPR_FFTW_PLAN_DFT_1D(NFFT, w->fftin, w->fftout, FFTW_FORWARD, FFTW_ESTIMATE);
+		w->fftplan = WSPR_FFTW_PLAN_DFT_1D("WSPR", NFFT, w->fftin, w->fftout, FFTW_FORWARD, FFTW_ESTIMATE);
 	
 		w->status_resume = IDLE;
 		w->tsync = FALSE;
@@ -851,6 +852,7 @@ void wspr_main()
             shmem_ipc_setup(stprintf("kiwi.wspr-%02d", i), SIG_IPC_WSPR + i, wspr_decode);
         #endif
 	}
+	wspr_pool_init();
 	
 	for (i=0; i < NFFT; i++) {
 		window[i] = sin(i * K_PI/(NFFT-1));
@@ -394,7 +394,7 @@ extern int decode_e1b(sdrnav_t *nav, int *error)
     #endif
 
     /* initialize viterbi decoder */
-    init_viterbi27_port(nav->fec,0);
+    init_viterbi27(nav->fec,0);
         
     /* deinterleave (30 rows x 8 columns) see Galileo SISICD Table 28, pp. 27 */
     interleave(&bits[10],30,8,bits_e1b);
@@ -408,11 +408,11 @@ extern int decode_e1b(sdrnav_t *nav, int *error)
     }
 
     /* decode first page part */
-    update_viterbi27_blk_port(nav->fec,enc_e1b,120);
-    chainback_viterbi27_port(nav->fec,dec_e1b1,120-6,0);
+    update_viterbi27_blk(nav->fec,enc_e1b,120);
+    chainback_viterbi27(nav->fec,dec_e1b1,120-6,0);
 
     /* initialize viterbi decoder */
-    init_viterbi27_port(nav->fec,0);
+    init_viterbi27(nav->fec,0);
     
     #ifdef TEST_VECTOR
         printf("\n");
@@ -441,8 +441,8 @@ extern int decode_e1b(sdrnav_t *nav, int *error)
     }
 
     /* decode second page part */
-    update_viterbi27_blk_port(nav->fec,enc_e1b,120);
-    chainback_viterbi27_port(nav->fec,dec_e1b2,120-6,0);
+    update_viterbi27_blk(nav->fec,enc_e1b,120);
+    chainback_viterbi27(nav->fec,dec_e1b2,120-6,0);
     
     #ifdef TEST_VECTOR
         printf("second page part\n");
@@ -24,6 +24,7 @@
 #include "shmem.h"
 #include "ephemeris.h"
 #include "fec.h"
+#include "nav_sync.h"
 
 #undef B
 #undef K
@@ -70,10 +71,13 @@ struct CHANNEL { // Locally-held channel data
     int alert;                      // Subframe alert flag
     int probation;                  // Temporarily disables use if channel noisy
     int holding, rd_pos;            // NAV data bit counters
+    nav_sync_t nav_sync;            // Bits held, packed for the preamble search
     u4_t id;
     int codegen_init;
     int subframe_bits, nsync, total_bits, bits_tow, expecting_preamble, drop_seq;
     bool abort;
+    bool upload_wait;               // In WaitUpload()
+    u4_t upload_gen;                // Counts the WaitUpload() calls
     //jks2
     int LASTsub;
     sdrnav_t nav;
@@ -91,6 +95,8 @@ struct CHANNEL { // Locally-held channel data
     void  Tracking();
     void  SignalLost();
     void  UploadEmbeddedState();
+    void  WaitUpload();
+    int   PreambleSearch();
     int   ParityCheck(char *buf, int *nbits);
     void  Subframe(char *buf);
     void  Status();
@@ -102,6 +108,20 @@ static CHANNEL Chans[GPS_CHANS];
 
 static unsigned BusyFlags;
 
+static const int POLLING_PS = 4;  // Tracking() polls 4 times per second
+static const int POLLING_US = 1000000 / POLLING_PS;
+
+// WaitUpload() fetches the state itself when ChanUploadTask() hasn't after a little over one poll
+static const int UPLOAD_TIMEOUT_US = POLLING_US + POLLING_US/4;
+
+// Embedded state of all channels, fetched with a single CmdGetChans per poll by
+// ChanUploadTask() and picked up by the channel tasks in WaitUpload().
+static struct {
+    SPI_MISO *miso;
+    UPLOAD ul[GPS_CHANS];
+    u4_t seq[GPS_CHANS];
+} Upload;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 static double Get32(uint16_t *u) {
@@ -126,6 +146,7 @@ static double GetFreq(uint16_t *u) { // Convert NCO command to Hertz
 
 const char L1preambleUpright [] = {1,0,0,0,1,0,1,1};
 const char L1preambleInverse [] = {0,1,1,1,0,1,0,0};
+#define L1_PREAMBLE     0x8b    // L1preambleUpright[] as bits
 
 static int parity(char *p, char *word, char D29, char D30) {
     char *d = word-1;
@@ -148,6 +169,7 @@ static int parity(char *p, char *word, char D29, char D30) {
 
 const char E1BpreambleUpright [] = {0,1,0,1,1,0,0,0,0,0};
 const char E1BpreambleInverse [] = {1,0,1,0,0,1,1,1,1,1};
+#define E1B_PREAMBLE    0x160   // E1BpreambleUpright[] as bits
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -159,6 +181,25 @@ void CHANNEL::UploadEmbeddedState() {
 		ul.nav_buf[0], ul.nav_buf[1], ul.nav_buf[2], ul.nav_buf[3]));
 }
 
+// Sleep until the next poll of ChanUploadTask() and take our copy of the embedded state.
+// Fetch it ourselves if that doesn't come in time.
+
+void CHANNEL::WaitUpload() {
+    u4_t seq = Upload.seq[ch];
+
+    upload_gen++;
+    upload_wait = true;
+    TaskSleepReasonUsec("gps upload", UPLOAD_TIMEOUT_US);
+    upload_wait = false;
+
+    if (Upload.seq[ch] == seq) {
+        UploadEmbeddedState();
+        return;
+    }
+
+    memcpy(&ul, &Upload.ul[ch], sizeof(ul));
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 int CHANNEL::GetGainAdjLO() {
@@ -375,10 +416,9 @@ void CHANNEL::Tracking() {
     //char buf[300 + MAX_NAV_BITS - 1];
     char buf[E1B_TSYM_PW + MAX_NAV_BITS - 1];
 
-    const int POLLING_PS = 4;  // Poll 4 times per second
-    const int POLLING_US = 1000000 / POLLING_PS;
-    
     assert(E1B_BPS/POLLING_PS < MAX_NAV_BITS/2);    // make sure there is enough buffering for poll rate
+    // and for the longest wait when WaitUpload() falls back, plus the < 16 bits left unread by the last poll
+    assert(E1B_BPS * UPLOAD_TIMEOUT_US / 1000000 + 15 < MAX_NAV_BITS - 16);
 
     const int TIMEOUT = 60 * POLLING_PS;   // Bail after 60 seconds on LOS
     const int TIMEOUT_E1B = 90 * POLLING_PS;
@@ -396,6 +436,7 @@ void CHANNEL::Tracking() {
 
 	float sumpwr=0;
     holding=0;
+    nav_sync.reset();
 
 	evGPS(EC_TRIG3, EV_GPS, ch, "GPS", "trig3 Tracking1");
 	static int firsttime[16];
@@ -411,8 +452,8 @@ void CHANNEL::Tracking() {
     if (isE1B) {
         //int polys[2] = { 0x4f, -0x6d };       // k=7; Galileo E1B; "-" means G2 inverted
         int polys[2] = { 0x4f, 0x6d };          // k=7; Galileo E1B
-        set_viterbi27_polynomial_port(polys);
-        nav.fec = create_viterbi27_port(E1B_NBIT);
+        set_viterbi27_polynomial(polys);
+        nav.fec = create_viterbi27(E1B_NBIT);
 
         spi_set(CmdSetPolarity, ch, 0);
     }
@@ -420,8 +461,7 @@ void CHANNEL::Tracking() {
     for (int watchdog=0; watchdog < (isE1B? TIMEOUT_E1B:TIMEOUT) && !abort; watchdog++) {
     
 	    //evGPS(EC_EVENT, EV_GPS, ch, "GPS", evprintf("TaskSleepMsec(250) ch %d", ch+1));
-        TaskSleepUsec(POLLING_US);
-        UploadEmbeddedState();
+        WaitUpload();
         TaskStat(TSTAT_INCR|TSTAT_ZERO, 0, "trk");
 
         // Process NAV data
@@ -439,6 +479,7 @@ void CHANNEL::Tracking() {
 		
         for(; avail; avail-=16) {
             int word = ul.nav_buf[rd_pos/16];
+            nav_sync.put16(word);
             for (int i=0; i<16; i++) {
                 word<<=1;
                 buf[holding++] = (word>>16) & 1;
@@ -451,6 +492,14 @@ void CHANNEL::Tracking() {
         while (holding >= subframe_bits) {      // Enough for a subframe?
             int nbits, err;
             
+            // Drop everything before the next preamble in one go rather than having
+            // ParityCheck() reject the bit offsets one at a time.
+            if ((nbits = PreambleSearch()) != 0) {
+                memmove(buf, buf+nbits, holding-=nbits);
+                nav_sync.drop(nbits);
+                continue;
+            }
+            
             if ((err = ParityCheck(buf, &nbits)) == 0) {
 				watchdog=0; sumpwr=0;
 			} else {
@@ -503,6 +552,7 @@ void CHANNEL::Tracking() {
             // won't have synchronized information for GetClock().
             
             memmove(buf, buf+nbits, holding-=nbits);
+            nav_sync.drop(nbits);
 			GPSstat(STAT_WDOG, 0, ch, watchdog/POLLING_PS, holding, ul.ca_unlocked);
 			
 			if (ch+1 == gps.kick_lo_pll_ch) {
@@ -545,7 +595,7 @@ void CHANNEL::Tracking() {
         }
     }
 
-    if (isE1B) delete_viterbi27_port(nav.fec);
+    if (isE1B) delete_viterbi27(nav.fec);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -727,6 +777,28 @@ void CHANNEL::Status() {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
+// Number of bits before the first offset at which ParityCheck() will find a preamble.
+// If there is none all offsets that leave a whole subframe are skipped.
+
+int CHANNEL::PreambleSearch() {
+    int noffsets = holding - subframe_bits + 1, k;
+    
+    if (isE1B) {
+        #ifdef TEST_VECTOR
+            return 0;
+        #endif
+        k = nav_sync.find(noffsets, E1B_PREAMBLE, E1B_PRELEN, E1B_TSYM_PP, NULL);
+    } else {
+        k = nav_sync.find(noffsets, L1_PREAMBLE, L1_PRELEN, 0, NULL);
+    }
+    
+    if (k < 0) k = noffsets;
+    if (expecting_preamble) expecting_preamble += k;     // as ParityCheck() would have counted them
+    return k;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
 int CHANNEL::ParityCheck(char *buf, int *nbits) {
     char p[6];
 
@@ -882,13 +954,46 @@ void ChanTask(void *param) { // one thread per channel
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
-int ChanReset(int sat, int codegen_init) {  // called from search thread before sampling
+void ChanUploadTask(void *param) { // one CmdGetChans per poll instead of a CmdGetChan per channel
+    assert(sizeof(Upload.ul) <= SPIBUF_B);
+    Upload.miso = &SPI_SHMEM->gps_chans_miso;
+
+    for (;;) {
+        TaskSleepUsec(POLLING_US);
+
+        unsigned waiting = 0;
+        u4_t gen[GPS_CHANS];
+        for (int ch = 0; ch < gps_chans; ch++) {
+            if (Chans[ch].upload_wait) waiting |= 1<<ch;
+            gen[ch] = Chans[ch].upload_gen;
+        }
+        if (!waiting) continue;
+
+        spi_get(CmdGetChans, Upload.miso, sizeof(Upload.ul));
+        memcpy(Upload.ul, Upload.miso->byte, sizeof(Upload.ul));
+
+        // spi_get() yields: a channel may have timed out meanwhile and fetched its own state,
+        // maybe even be waiting again, and must not get this older one
+        for (int ch = 0; ch < gps_chans; ch++) {
+            if (!(waiting & (1<<ch)) || !Chans[ch].upload_wait || Chans[ch].upload_gen != gen[ch]) continue;
+            Upload.seq[ch]++;
+            TaskWakeup(Chans[ch].id, TWF_CANCEL_DEADLINE);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// Channels in claimed have already been reset for other sats sharing the same sample block
+// and are treated as busy.
+int ChanReset(int sat, int codegen_init, u4_t claimed) {  // called from search thread before sampling
     int ch, nbusy, cur_QZSS;
+    u4_t busy = BusyFlags | claimed;
     
     bool QZSS_JA = (gps.acq_QZSS && gps.QZSS_prio);
 
     if (QZSS_JA) for (ch = nbusy = cur_QZSS = 0; ch < gps_chans; ch++) {
-        if (!(BusyFlags & (1<<ch))) continue;
+        if (!(busy & (1<<ch))) continue;
         if (Sats[Chans[ch].sat].type == QZSS) cur_QZSS++;
         nbusy++;
     }
@@ -899,7 +1004,7 @@ int ChanReset(int sat, int codegen_init) {  // called from search thread before
     bool QZSS_limit = (QZSS_JA && nfree <= nresv);
 
     for (ch = 0; ch < gps_chans; ch++) {
-        if (BusyFlags & (1<<ch)) continue;
+        if (busy & (1<<ch)) continue;
 
         // if QZSS_JA mode enabled don't let non-QZSS get last QZSS_RESERVED channels (reduced by number currently active)
         if (QZSS_limit && Sats[sat].type != QZSS) {
@@ -55,6 +55,7 @@ void gps_main(int argc, char *argv[])
     	CreateTaskSF(ChanTask, tname, TO_VOID_PARAM(i), GPS_PRIORITY, CTF_TNAME_FREE, 0);
     }
 
+    CreateTask(ChanUploadTask, 0, GPS_PRIORITY);
     CreateTask(SolveTask, 0, GPS_PRIORITY);
 
     if (!background_mode && (print_stats & (STATS_GPS | STATS_GPS_SOLN))) CreateTask(StatTask, 0, GPS_PRIORITY);
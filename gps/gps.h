@@ -29,6 +29,7 @@
 
 #include <inttypes.h>
 #include <math.h>
+#include <fftw3.h>
 
 // select debugging
 //#define TEST_VECTOR
@@ -145,6 +146,48 @@ void SearchTaskRun();
 void SearchEnable(int sat);
 void SearchParams(int argc, char *argv[]);
 
+// One sample block is correlated against every sat that could be given a free channel.
+// On multi-core hardware the correlation runs in a separate process and doppler bins
+// are inverse transformed GPS_ACQ_DOP_BATCH at a time. Otherwise it runs inline with a
+// yield after each bin's FFT, as before.
+
+#ifdef MULTI_CORE
+    //#define GPS_SHMEM_DISABLE
+#else
+    #define GPS_SHMEM_DISABLE
+#endif
+
+#ifdef GPS_SHMEM_DISABLE
+    #define GPS_ACQ_DOP_BATCH   1
+    #define GPS_ACQ_YIELD(s)    NextTask(s)
+    #define GPS_ACQ_YIELD_P(s)  NextTaskP(s, NT_LONG_RUN)
+#else
+    #define GPS_ACQ_DOP_BATCH   8
+    #define GPS_ACQ_YIELD(s)
+    #define GPS_ACQ_YIELD_P(s)
+#endif
+
+// ChanStart() code creep error is ~0.08 chip/sec with a half bin doppler error
+#define GPS_ACQ_MAX_AGE_MS  2000
+
+typedef struct {
+    // request: sats to search and the channel claimed for each
+    int nsats, sat[GPS_CHANS], ch[GPS_CHANS];
+    fftwf_complex data[FFT_LEN];    // forward FFT of the sample block
+    
+    // results
+    float snr[GPS_CHANS];
+    int lo_shift[GPS_CHANS], ca_shift[GPS_CHANS];
+    u4_t busy_us;
+} gps_acq_t;
+
+#ifdef GPS_SHMEM_DISABLE
+    extern gps_acq_t *gps_acq_p;
+    #define GPS_SHMEM gps_acq_p
+#else
+    #define GPS_SHMEM (&shmem->gps_acq)
+#endif
+
 //////////////////////////////////////////////////////////////
 // Tracking
 
@@ -152,7 +195,8 @@ void SearchParams(int argc, char *argv[]);
 #define PARITY 6
 
 void ChanTask(void *param);
-int  ChanReset(int sat, int codegen_init);
+void ChanUploadTask(void *param);
+int  ChanReset(int sat, int codegen_init, u4_t claimed=0);
 void ChanStart(int ch, int sat, int t_sample, int lo_shift, int ca_shift, int snr);
 bool ChanSnapshot(int ch, uint16_t wpos, int *p_sat, int *p_bits, int *p_bits_tow, float *p_pwr);
 void ChanRemove(sat_e type);
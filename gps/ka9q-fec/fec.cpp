@@ -5,9 +5,31 @@
 #include <stdio.h>
 #include "fec.h"
 
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
 unsigned char Partab[256];
 int P_init;
 
+enum cpu_mode Cpu_mode;
+
+/* Pick the SIMD versions the CPU can run, once */
+void find_cpu_mode(void){
+  if(Cpu_mode != UNKNOWN)
+    return;
+#if defined(__SSE2__)
+  Cpu_mode = __builtin_cpu_supports("sse2") ? SSE2 : PORT;
+#elif defined(__aarch64__)
+  Cpu_mode = NEON;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  Cpu_mode = (getauxval(AT_HWCAP) & HWCAP_NEON) ? NEON : PORT;
+#else
+  Cpu_mode = PORT;
+#endif
+}
+
 /* Create 256-entry odd-parity lookup table
  * Needed only on non-ia32 machines
  */
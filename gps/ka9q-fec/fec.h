@@ -59,6 +59,17 @@ int chainback_viterbi27_port(void *p,unsigned char *data,unsigned int nbits,unsi
 void delete_viterbi27_port(void *p);
 int update_viterbi27_blk_port(void *p,unsigned char *syms,int nbits);
 
+/* SIMD butterflies bit-exact with the portable version, which does everything
+ * else for them. update_viterbi27_blk() picks one at run time
+ */
+#ifdef __SSE2__
+int update_viterbi27_blk_sse2(void *p,unsigned char *syms,int nbits);
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+int update_viterbi27_blk_neon(void *p,unsigned char *syms,int nbits);
+#endif
+
 /* r=1/2 k=9 convolutional encoder polynomials */
 #define	V29POLYA	0x1af
 #define	V29POLYB	0x11d
@@ -257,7 +268,7 @@ extern unsigned char Taltab[],Tal1tab[];
 
 
 /* CPU SIMD instruction set available */
-extern enum cpu_mode {UNKNOWN=0,PORT,MMX,SSE,SSE2,ALTIVEC} Cpu_mode;
+extern enum cpu_mode {UNKNOWN=0,PORT,MMX,SSE,SSE2,ALTIVEC,NEON} Cpu_mode;
 void find_cpu_mode(void); /* Call this once at startup to set Cpu_mode */
 
 /* Determine parity of argument: 1 = odd, 0 = even */
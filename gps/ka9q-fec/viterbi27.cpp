@@ -0,0 +1,46 @@
+/* K=7 r=1/2 Viterbi decoder with the butterflies picked at run time
+ * May be used under the terms of the GNU Lesser General Public License (LGPL)
+ */
+#include <stdio.h>
+#include "fec.h"
+
+/* Create a new instance of a Viterbi decoder */
+void *create_viterbi27(int len){
+  find_cpu_mode();
+  return create_viterbi27_port(len);
+}
+
+void set_viterbi27_polynomial(int polys[2]){
+  set_viterbi27_polynomial_port(polys);
+}
+
+/* Initialize Viterbi decoder for start of new frame */
+int init_viterbi27(void *p,int starting_state){
+  return init_viterbi27_port(p,starting_state);
+}
+
+/* Viterbi chainback */
+int chainback_viterbi27(void *p,unsigned char *data,unsigned int nbits,unsigned int endstate){
+  return chainback_viterbi27_port(p,data,nbits,endstate);
+}
+
+/* Delete instance of a Viterbi decoder */
+void delete_viterbi27(void *p){
+  delete_viterbi27_port(p);
+}
+
+/* Update decoder with a block of demodulated symbols */
+int update_viterbi27_blk(void *p,unsigned char syms[],int nbits){
+  switch(Cpu_mode){
+#ifdef __SSE2__
+  case SSE2:
+    return update_viterbi27_blk_sse2(p,syms,nbits);
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  case NEON:
+    return update_viterbi27_blk_neon(p,syms,nbits);
+#endif
+  default:
+    return update_viterbi27_blk_port(p,syms,nbits);
+  }
+}
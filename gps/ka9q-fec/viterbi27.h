@@ -0,0 +1,23 @@
+/* K=7 r=1/2 Viterbi decoder state, shared by the portable and SIMD versions
+ * May be used under the terms of the GNU Lesser General Public License (LGPL)
+ */
+
+#ifndef _VITERBI27_H_
+#define _VITERBI27_H_
+
+typedef union { unsigned int w[64]; } metric_t;
+typedef union { unsigned long w[2];} decision_t;	/* only the low 32 bits of each word are used */
+extern union branchtab27 { unsigned char c[32]; } Branchtab27[2];
+
+/* State info for instance of Viterbi decoder
+ * Don't change this without also changing references in [mmx|sse|sse2]bfly29.s!
+ */
+struct v27 {
+  metric_t metrics1; /* path metric buffer 1 */
+  metric_t metrics2; /* path metric buffer 2 */
+  decision_t *dp;          /* Pointer to current decision */
+  metric_t *old_metrics,*new_metrics; /* Pointers to path metrics, swapped on every bit */
+  decision_t *decisions;   /* Beginning of decisions for block */
+};
+
+#endif /* _VITERBI27_H_ */
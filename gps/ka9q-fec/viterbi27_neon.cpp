@@ -0,0 +1,85 @@
+/* K=7 r=1/2 Viterbi decoder, NEON butterflies
+ * The same 32-bit metric arithmetic as the portable version, four butterflies
+ * at a time, so the decisions are bit-exact with it
+ * May be used under the terms of the GNU Lesser General Public License (LGPL)
+ */
+#include <stdio.h>
+#include "fec.h"
+#include "viterbi27.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+/* Update decoder with a block of demodulated symbols
+ * Note that nbits is the number of decoded data bits, not the number
+ * of symbols!
+ */
+int update_viterbi27_blk_neon(void *p,unsigned char *syms,int nbits){
+  struct v27 *vp = (struct v27 *) p;
+  metric_t *tmp;
+  decision_t *d;
+  uint32x4_t bt0[8],bt1[8];
+  static const uint32_t even_bits[4] = { 1,4,16,64 }, odd_bits[4] = { 2,8,32,128 };
+  const uint32x4_t keven = vld1q_u32(even_bits), kodd = vld1q_u32(odd_bits);
+  const uint32x4_t k510 = vdupq_n_u32(510);
+  const int32x4_t zero = vdupq_n_s32(0);
+  int i;
+
+  if(p == NULL)
+    return -1;
+
+  /* Branch table widened to the 32-bit metric lanes */
+  for(i=0;i<8;i++){
+    uint32_t b0[4],b1[4];
+    for(int j=0;j<4;j++){
+      b0[j] = Branchtab27[0].c[4*i+j];
+      b1[j] = Branchtab27[1].c[4*i+j];
+    }
+    bt0[i] = vld1q_u32(b0);
+    bt1[i] = vld1q_u32(b1);
+  }
+
+  d = (decision_t *)vp->dp;
+  while(nbits--){
+    const uint32x4_t sym0 = vdupq_n_u32(*syms++);
+    const uint32x4_t sym1 = vdupq_n_u32(*syms++);
+    unsigned int *old = vp->old_metrics->w, *nw = vp->new_metrics->w;
+
+    d->w[0] = d->w[1] = 0;
+
+    /* Butterflies i..i+3: states 2i and 2i+1 from i and i+32 */
+    for(i=0;i<32;i+=4){
+      uint32x4_t metric = vaddq_u32(veorq_u32(bt0[i/4],sym0),veorq_u32(bt1[i/4],sym1));
+      uint32x4_t imetric = vsubq_u32(k510,metric);
+      uint32x4_t old0 = vld1q_u32(&old[i]);
+      uint32x4_t old1 = vld1q_u32(&old[i+32]);
+      uint32x4x2_t surv;
+
+      uint32x4_t m0 = vaddq_u32(old0,metric);
+      uint32x4_t m1 = vaddq_u32(old1,imetric);
+      uint32x4_t dec0 = vcgtq_s32(vreinterpretq_s32_u32(vsubq_u32(m0,m1)),zero);
+      surv.val[0] = vbslq_u32(dec0,m1,m0);
+
+      m0 = vaddq_u32(old0,imetric);
+      m1 = vaddq_u32(old1,metric);
+      uint32x4_t dec1 = vcgtq_s32(vreinterpretq_s32_u32(vsubq_u32(m0,m1)),zero);
+      surv.val[1] = vbslq_u32(dec1,m1,m0);
+
+      vst2q_u32(&nw[2*i],surv);
+
+      /* Decisions of state 2i in the even bits, of 2i+1 in the odd bits */
+      uint32x4_t bits = vorrq_u32(vandq_u32(dec0,keven),vandq_u32(dec1,kodd));
+      uint32x2_t sum = vpadd_u32(vget_low_u32(bits),vget_high_u32(bits));
+      sum = vpadd_u32(sum,sum);
+      d->w[i/16] |= (unsigned long) vget_lane_u32(sum,0) << ((2*i)&31);
+    }
+    d++;
+    /* Swap pointers to old and new metrics */
+    tmp = vp->old_metrics;
+    vp->old_metrics = vp->new_metrics;
+    vp->new_metrics = tmp;
+  }
+  vp->dp = d;
+  return 0;
+}
+#endif
@@ -7,24 +7,12 @@
 #include <memory.h>
 #include <limits.h>
 #include "fec.h"
+#include "viterbi27.h"
 
 
-typedef union { unsigned int w[64]; } metric_t;
-typedef union { unsigned long w[2];} decision_t;
-static union branchtab27 { unsigned char c[32]; } Branchtab27[2] __attribute__ ((aligned(16)));
+union branchtab27 Branchtab27[2] __attribute__ ((aligned(16)));
 static int Init = 0;
 
-/* State info for instance of Viterbi decoder
- * Don't change this without also changing references in [mmx|sse|sse2]bfly29.s!
- */
-struct v27 {
-  metric_t metrics1; /* path metric buffer 1 */
-  metric_t metrics2; /* path metric buffer 2 */
-  decision_t *dp;          /* Pointer to current decision */
-  metric_t *old_metrics,*new_metrics; /* Pointers to path metrics, swapped on every bit */
-  decision_t *decisions;   /* Beginning of decisions for block */
-};
-
 /* Initialize Viterbi decoder for start of new frame */
 int init_viterbi27_port(void *p,int starting_state){
   struct v27 *vp = (struct v27 *) p;
@@ -0,0 +1,79 @@
+/* K=7 r=1/2 Viterbi decoder, SSE2 butterflies
+ * The same 32-bit metric arithmetic as the portable version, four butterflies
+ * at a time, so the decisions are bit-exact with it
+ * May be used under the terms of the GNU Lesser General Public License (LGPL)
+ */
+#include <stdio.h>
+#include "fec.h"
+#include "viterbi27.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* Update decoder with a block of demodulated symbols
+ * Note that nbits is the number of decoded data bits, not the number
+ * of symbols!
+ */
+int update_viterbi27_blk_sse2(void *p,unsigned char *syms,int nbits){
+  struct v27 *vp = (struct v27 *) p;
+  metric_t *tmp;
+  decision_t *d;
+  __m128i bt0[8],bt1[8];
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i k510 = _mm_set1_epi32(510);
+  int i;
+
+  if(p == NULL)
+    return -1;
+
+  /* Branch table widened to the 32-bit metric lanes */
+  for(i=0;i<8;i++){
+    bt0[i] = _mm_set_epi32(Branchtab27[0].c[4*i+3],Branchtab27[0].c[4*i+2],Branchtab27[0].c[4*i+1],Branchtab27[0].c[4*i]);
+    bt1[i] = _mm_set_epi32(Branchtab27[1].c[4*i+3],Branchtab27[1].c[4*i+2],Branchtab27[1].c[4*i+1],Branchtab27[1].c[4*i]);
+  }
+
+  d = (decision_t *)vp->dp;
+  while(nbits--){
+    const __m128i sym0 = _mm_set1_epi32(*syms++);
+    const __m128i sym1 = _mm_set1_epi32(*syms++);
+    unsigned int *old = vp->old_metrics->w, *nw = vp->new_metrics->w;
+
+    d->w[0] = d->w[1] = 0;
+
+    /* Butterflies i..i+3: states 2i and 2i+1 from i and i+32 */
+    for(i=0;i<32;i+=4){
+      __m128i metric = _mm_add_epi32(_mm_xor_si128(bt0[i/4],sym0),_mm_xor_si128(bt1[i/4],sym1));
+      __m128i imetric = _mm_sub_epi32(k510,metric);
+      __m128i old0 = _mm_loadu_si128((__m128i *) &old[i]);
+      __m128i old1 = _mm_loadu_si128((__m128i *) &old[i+32]);
+
+      __m128i m0 = _mm_add_epi32(old0,metric);
+      __m128i m1 = _mm_add_epi32(old1,imetric);
+      __m128i dec0 = _mm_cmpgt_epi32(_mm_sub_epi32(m0,m1),zero);
+      __m128i surv0 = _mm_or_si128(_mm_and_si128(dec0,m1),_mm_andnot_si128(dec0,m0));
+
+      m0 = _mm_add_epi32(old0,imetric);
+      m1 = _mm_add_epi32(old1,metric);
+      __m128i dec1 = _mm_cmpgt_epi32(_mm_sub_epi32(m0,m1),zero);
+      __m128i surv1 = _mm_or_si128(_mm_and_si128(dec1,m1),_mm_andnot_si128(dec1,m0));
+
+      _mm_storeu_si128((__m128i *) &nw[2*i],_mm_unpacklo_epi32(surv0,surv1));
+      _mm_storeu_si128((__m128i *) &nw[2*i+4],_mm_unpackhi_epi32(surv0,surv1));
+
+      /* Decisions of state 2i in the even bits, of 2i+1 in the odd bits */
+      unsigned int b0 = _mm_movemask_ps(_mm_castsi128_ps(dec0));
+      unsigned int b1 = _mm_movemask_ps(_mm_castsi128_ps(dec1));
+      unsigned int bits = (b0 & 1) | ((b0 & 2) << 1) | ((b0 & 4) << 2) | ((b0 & 8) << 3);
+      bits |= ((b1 & 1) | ((b1 & 2) << 1) | ((b1 & 4) << 2) | ((b1 & 8) << 3)) << 1;
+      d->w[i/16] |= bits << ((2*i)&31);
+    }
+    d++;
+    /* Swap pointers to old and new metrics */
+    tmp = vp->old_metrics;
+    vp->old_metrics = vp->new_metrics;
+    vp->new_metrics = tmp;
+  }
+  vp->dp = d;
+  return 0;
+}
+#endif
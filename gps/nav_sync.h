@@ -0,0 +1,85 @@
+// -*- C++ -*-
+
+#ifndef _GPS_NAV_SYNC_H_
+#define _GPS_NAV_SYNC_H_
+
+#include "types.h"
+
+//
+// NAV data bits held by a tracking channel, packed 64 to a word (earliest bit in the MSB),
+// and a sliding correlator that finds the subframe / page preamble in them.
+//
+// The correlator tests 64 bit offsets at a time: for each preamble bit the window of the
+// stream starting at that bit is ANDed (or its complement, for a zero preamble bit) into
+// a bitmap of candidate offsets, upright and inverted together. So a search costs a few
+// word operations per 64 held bits instead of a compare and a shift of the whole buffer
+// per bit offset.
+//
+
+// 1024 bits, must be a power of two. Tracking() holds less than a subframe plus MAX_NAV_BITS.
+#define NAV_SYNC_WORDS  16
+
+struct nav_sync_t {
+    u64_t w[NAV_SYNC_WORDS];
+    u4_t rd, wr;                // absolute bit positions: first bit held, next bit to be written
+
+    void reset() { rd = wr = 0; }
+    int held() { return wr - rd; }
+    void drop(int nbits) { rd += nbits; }
+
+    // 16 more bits, earliest in the MSB
+    void put16(u2_t bits) {
+        int sh = 48 - (wr & 63);    // wr only ever advances by 16
+        u64_t *p = &w[(wr >> 6) & (NAV_SYNC_WORDS-1)];
+        *p = (*p & ~(U8(0xffff) << sh)) | (U8(bits) << sh);
+        wr += 16;
+    }
+
+    // 64 bits starting at absolute position pos
+    u64_t get64(u4_t pos) {
+        int i = (pos >> 6) & (NAV_SYNC_WORDS-1), sh = pos & 63;
+        u64_t v = w[i] << sh;
+        if (sh) v |= w[(i+1) & (NAV_SYNC_WORDS-1)] >> (64 - sh);
+        return v;
+    }
+
+    // Bitmaps of the offsets pos+0 ... pos+63 (MSB first) at which the len-bit preamble
+    // (MSB first) starts upright / inverted.
+    void correlate(u4_t pos, u4_t preamble, int len, u64_t *up, u64_t *inv) {
+        u64_t u = ~U8(0), v = ~U8(0);
+        for (int i = 0; i < len; i++) {
+            u64_t s = get64(pos + i);
+            if ((preamble >> (len-1-i)) & 1) { u &= s; v &= ~s; } else { u &= ~s; v &= s; }
+        }
+        *up = u; *inv = v;
+    }
+
+    // First offset 0 ... noffsets-1 from the oldest held bit where the preamble starts.
+    // If pair is non-zero the preamble must also be repeated, with the same polarity, pair
+    // bits later (E1B even/odd page parts). The bits looked at must all be held.
+    // Returns -1 if there is no candidate.
+    int find(int noffsets, u4_t preamble, int len, int pair, int *inverted) {
+        for (int base = 0; base < noffsets; base += 64) {
+            u64_t up, inv;
+            correlate(rd + base, preamble, len, &up, &inv);
+            if (pair) {
+                u64_t up2, inv2;
+                correlate(rd + base + pair, preamble, len, &up2, &inv2);
+                up &= up2; inv &= inv2;
+            }
+            int n = noffsets - base;
+            if (n < 64) {
+                u64_t mask = ~U8(0) << (64 - n);
+                up &= mask; inv &= mask;
+            }
+            if (up | inv) {
+                int k = __builtin_clzll(up | inv);
+                if (inverted) *inverted = ((up >> (63-k)) & 1)? 0:1;
+                return base + k;
+            }
+        }
+        return -1;
+    }
+};
+
+#endif
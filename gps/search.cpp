@@ -30,6 +30,7 @@
 #include "e1bcode.h"
 #include "debug.h"
 #include "simd.h"
+#include "fft_plan.h"
 #include "shmem.h"
 
 #include <stdio.h>
@@ -47,14 +48,26 @@
 
 #define NTAPS	31
 
-static fftwf_plan fwd_plan, rev_plan;
+// +/- 5 kHz doppler search
+#define DOP_MAX     int(5000/BIN_SIZE)
+#define NDOP        (2*DOP_MAX + 1)
+
+// rev_plan transforms GPS_ACQ_DOP_BATCH doppler bins at once, rev_plan_rem the remainder
+static fft_plan_t *fwd_plan, *rev_plan, *rev_plan_rem;
 
 // code[sat][...] holds two copies of the FFT: modulo operation on the index is not needed
 static fftwf_complex code[MAX_SATS][2*FFT_LEN] __attribute__ ((aligned (16)));
 
 // fwd_buf is also used for decimating the data
 static fftwf_complex fwd_buf[NSAMPLES + 2*NTAPS] __attribute__ ((aligned (16)));
-static fftwf_complex rev_buf[FFT_LEN]  __attribute__ ((aligned (16)));
+static fftwf_complex rev_buf[GPS_ACQ_DOP_BATCH][FFT_LEN]  __attribute__ ((aligned (16)));
+
+#ifdef GPS_SHMEM_DISABLE
+    static gps_acq_t gps_acq;
+    gps_acq_t *gps_acq_p = &gps_acq;
+#endif
+
+static void SearchCorrelate(int which);
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -236,8 +249,10 @@ void SearchInit() {
 	#endif
 
 	printf("DECIM %d FFT %d planning..\n", DECIM, FFT_LEN);
-    fwd_plan = fftwf_plan_dft_1d(FFT_LEN, fwd_buf, fwd_buf, FFTW_FORWARD,  FFTW_ESTIMATE);
-    rev_plan = fftwf_plan_dft_1d(FFT_LEN, rev_buf, rev_buf, FFTW_BACKWARD, FFTW_ESTIMATE);
+    fwd_plan = fft_plan_dft_1d("GPS fwd", FFT_LEN, fwd_buf, fwd_buf, FFTW_FORWARD,  FFTW_ESTIMATE);
+    int rem = NDOP % GPS_ACQ_DOP_BATCH;
+    rev_plan = fft_plan_many_dft("GPS rev", FFT_LEN, GPS_ACQ_DOP_BATCH, rev_buf[0], rev_buf[0], FFTW_BACKWARD, FFTW_ESTIMATE);
+    if (rem) rev_plan_rem = fft_plan_many_dft("GPS rev rem", FFT_LEN, rem, rev_buf[0], rev_buf[0], FFTW_BACKWARD, FFTW_ESTIMATE);
 
     for (sp = Sats; sp->prn != -1; sp++) {
         if (sp->type != Navstar && sp->type != QZSS) continue;
@@ -276,7 +291,7 @@ void SearchInit() {
 
 		assert(nsamples == NSAMPLES/DECIM && nsamples == FFT_LEN);
 
-		fftwf_execute(fwd_plan);
+		fft_execute_dft(fwd_plan, fwd_buf, fwd_buf);
 
 		// make two copies of the FFT results in order to avoid modulo operation on the index in Correlate(..)
 		memcpy(code[sp->sat],          fwd_buf, nsamples*sizeof(fftwf_complex));
@@ -338,25 +353,32 @@ void SearchInit() {
 
 		assert(nsamples == NSAMPLES/DECIM && nsamples == FFT_LEN);
 
-		fftwf_execute(fwd_plan);
+		fft_execute_dft(fwd_plan, fwd_buf, fwd_buf);
 
 		memcpy(code[sp->sat],          fwd_buf, nsamples*sizeof(fftwf_complex));
 		memcpy(code[sp->sat]+nsamples, fwd_buf, nsamples*sizeof(fftwf_complex));
     }
 
     //printf("computing CODE FFTs DONE\n");
+
+    // NB: after code[] and the plans are setup since the child process references its copy of them
+    #ifndef GPS_SHMEM_DISABLE
+        shmem_ipc_setup("kiwi.gps_acq", SIG_IPC_GPS, SearchCorrelate);
+    #endif
+
     CreateTaskF(SearchTask, 0, GPS_ACQ_PRIORITY, CTF_NO_PRIO_INV);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
+// the plans belong to fft_plan.cpp
 void SearchFree() {
-    fftwf_destroy_plan(fwd_plan);
-    fftwf_destroy_plan(rev_plan);
+    fwd_plan = rev_plan = rev_plan_rem = NULL;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
+//#define GPS_SEARCH_ONLY
 //#define GPS_SAMPLES_FROM_FILE
 #ifdef GPS_SAMPLES_FROM_FILE
 
@@ -442,14 +464,13 @@ static void Sample() {
     
     assert(nsamples == NSAMPLES/DECIM && nsamples == FFT_LEN);
 	NextTask("samp4");
-	fftwf_execute(fwd_plan); // Transform to frequency domain
+	fft_execute_dft(fwd_plan, fwd_buf, fwd_buf); // Transform to frequency domain
     NextTask("samp5");
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 static float Correlate(int sat, const fftwf_complex *data, int *max_snr_dop, int *max_snr_i) {
-    fftwf_complex *prod = rev_buf;
     float max_snr=0;
     int code_period_ms = is_E1B(sat)? E1B_CODE_PERIOD : L1_CODE_PERIOD;
     int i;
@@ -460,42 +481,63 @@ static float Correlate(int sat, const fftwf_complex *data, int *max_snr_dop, int
     //if (test_mode) for (i=fft_len/2; i<fft_len; i++) data[i][0] = data[i][1] = 0;
 
 	// +/- 5 kHz doppler search
-    for (int dop = -5000/BIN_SIZE; dop <= 5000/BIN_SIZE; dop++) {
-        float max_pwr=0, tot_pwr=0;
-        int max_pwr_i=0;
+    for (int dop0 = -DOP_MAX; dop0 <= DOP_MAX; dop0 += GPS_ACQ_DOP_BATCH) {
+        int nbins = MIN(GPS_ACQ_DOP_BATCH, DOP_MAX - dop0 + 1);
 
 		// prod = conj(data)*code, with doppler shifting applied to C/A or E1B code FFT
-		#if 1
-		    simd_multiply_conjugate_ccc(FFT_LEN, data, code[sat]+FFT_LEN-dop, prod);
-		#else
-            for (i=0; i<FFT_LEN; i++) {
-                int j=(i-dop+FFT_LEN)%FFT_LEN;	// doppler shifting applied to C/A or E1B code FFT
-                prod[i][0] = data[i][0]*code[sat][j][0] + data[i][1]*code[sat][j][1];
-                prod[i][1] = data[i][0]*code[sat][j][1] - data[i][1]*code[sat][j][0];
-            }
-		#endif
-        NextTaskP("corr FFT LONG RUN", NT_LONG_RUN);
+        for (int b=0; b < nbins; b++) {
+		    #if 1
+		        simd_multiply_conjugate_ccc(FFT_LEN, data, code[sat]+FFT_LEN-(dop0+b), rev_buf[b]);
+		    #else
+                fftwf_complex *prod = rev_buf[b];
+                for (i=0; i<FFT_LEN; i++) {
+                    int j=(i-(dop0+b)+FFT_LEN)%FFT_LEN;	// doppler shifting applied to C/A or E1B code FFT
+                    prod[i][0] = data[i][0]*code[sat][j][0] + data[i][1]*code[sat][j][1];
+                    prod[i][1] = data[i][0]*code[sat][j][1] - data[i][1]*code[sat][j][0];
+                }
+		    #endif
+		}
+        GPS_ACQ_YIELD_P("corr FFT LONG RUN");
         //u4_t us = timer_us();
-		fftwf_execute(rev_plan);
+		fft_execute_dft((nbins == GPS_ACQ_DOP_BATCH)? rev_plan : rev_plan_rem, rev_buf[0], rev_buf[0]);
         //u4_t us2 = timer_us();
-        NextTask("corr FFT end");
+        GPS_ACQ_YIELD("corr FFT end");
         //printf("Correlate FFT %.1f msec\n", (float)(us2-us)/1e3);
 
-        for (i=0; i < SAMPLE_RATE/1000*code_period_ms; i++) {		// 1 msec of samples
-            const float pwr = prod[i][0]*prod[i][0] + prod[i][1]*prod[i][1];
-            if (pwr>max_pwr) max_pwr=pwr, max_pwr_i=i;
-            tot_pwr += pwr;
-        }
-        NextTask("corr pwr");
+        for (int b=0; b < nbins; b++) {
+            const fftwf_complex *prod = rev_buf[b];
+            float max_pwr=0, tot_pwr=0;
+            int max_pwr_i=0;
 
-        const float ave_pwr = tot_pwr/i;
-        const float snr = max_pwr/ave_pwr;
-        if (snr > max_snr) max_snr=snr, *max_snr_dop=dop, *max_snr_i=max_pwr_i;
+            for (i=0; i < SAMPLE_RATE/1000*code_period_ms; i++) {		// 1 msec of samples
+                const float pwr = prod[i][0]*prod[i][0] + prod[i][1]*prod[i][1];
+                if (pwr>max_pwr) max_pwr=pwr, max_pwr_i=i;
+                tot_pwr += pwr;
+            }
+
+            const float ave_pwr = tot_pwr/i;
+            const float snr = max_pwr/ave_pwr;
+            if (snr > max_snr) max_snr=snr, *max_snr_dop=dop0+b, *max_snr_i=max_pwr_i;
+        }
+        GPS_ACQ_YIELD("corr pwr");
     }
     
     return max_snr;
 }
 
+// Correlate the sample block against request slot "which".
+// Runs in the acquisition offload process on multi-core hardware, otherwise called directly.
+static void SearchCorrelate(int which) {
+    gps_acq_t *acq = GPS_SHMEM;
+    u4_t us = timer_us();
+
+    acq->lo_shift[which] = acq->ca_shift[which] = 0;
+    acq->snr[which] = Correlate(acq->sat[which], acq->data, &acq->lo_shift[which], &acq->ca_shift[which]);
+    acq->ca_shift[which] *= DECIM;
+
+    acq->busy_us += timer_us() - us;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -507,50 +549,62 @@ void SearchEnable(int sat) {
 
 static int searchTaskID = -1;
 
+// Would this sat be searched now?
+static bool SearchWanted(SATELLITE *sp) {
+    if (sp->type == Navstar && !gps.acq_Navstar) return false;
+    if (sp->type == QZSS && !gps.acq_QZSS) return false;
+    if (sp->type == E1B && !gps.acq_Galileo) return false;
+
+    //jks2
+    if (gps_debug > 0 && sp->prn != gps_debug) return false;    //jks2
+    if (gps_debug) if (sp->type == E1B) return false;
+    if (gps_e1b_only && sp->type != E1B) return false;
+    //if (sp->type != Navstar) return false;
+    //if (sp->type != E1B) return false;
+    //if (sp->prn != 14) return false;
+    //if (sp->prn != 14 && sp->prn != 30) return false;
+    //if (sp->prn != 11 && sp->prn != 12) return false;
+    //if (sp->prn != 11) return false;
+
+    return !sp->busy;   // sat already acquired?
+}
+
 void SearchTask(void *param) {
-    int i, us, ret, ch, last_ch=-1, sat, t_sample, min_sig, lo_shift=0, ca_shift=0;
+    int i, n, us, ch, sat, t_sample, min_sig, nsats, next=0, pass=0, acquired=0;
+    u4_t claimed, failed=0;
     SATELLITE *sp;
-    float snr=0;
+    gps_acq_t *acq = GPS_SHMEM;
     
     TaskSleepSec(20);   // jks2 TEMP due to printf/log shared memory malloc/free crash problem
 
 	searchTaskID = TaskID();
+    #if defined(GPS_SEARCH_ONLY) || defined(GPS_SAMPLES_FROM_FILE)
+	    u4_t start_ms = timer_ms();
+    #endif
 
     GPSstat(STAT_PARAMS, 0, DECIM, minimum_sig);
 	GPSstat(STAT_ACQUIRE, 0, 1);
 
+    for (nsats = 0; Sats[nsats].prn != -1; nsats++)
+        ;
+
     for(;;) {
         if (!gps.acq_Navstar && !gps.acq_QZSS && !gps.acq_Galileo) {
             TaskSleepSec(1);    // wait for UI to change acq settings
             continue;
         }
         
-        for (sp = Sats; sp->prn != -1; sp++) {
+        // Claim a free channel for as many wanted sats as possible, continuing round-robin
+        // from where the last pass stopped. The sampler reset in Sample() resets the code
+        // generators of all free channels, so the code phase found from the one sample
+        // block is valid for every channel claimed here.
+        acq->nsats = 0;
+        claimed = 0;
+        for (n=0; n < nsats && acq->nsats < gps_chans; n++) {
+            sp = &Sats[(next + n) % nsats];
+            if (!SearchWanted(sp)) continue;
             sat = sp->sat;
 
-            if (sp->type == Navstar && !gps.acq_Navstar) continue;
-            if (sp->type == QZSS && !gps.acq_QZSS) continue;
-            if (sp->type == E1B && !gps.acq_Galileo) continue;
-
-            //jks2
-            if (gps_debug > 0 && sp->prn != gps_debug) continue;    //jks2
-            if (gps_debug) if (sp->type == E1B) continue;
-            if (gps_e1b_only && sp->type != E1B) continue;
-            //if (sp->type != Navstar) continue;
-            //if (sp->type != E1B) continue;
-            //if (sp->prn != 14) continue;
-            //if (sp->prn != 14 && sp->prn != 30) continue;
-            //if (sp->prn != 11 && sp->prn != 12) continue;
-            //if (sp->prn != 11) continue;
-            
-            //jks2
-            min_sig = (sp->type == E1B)? 16 : minimum_sig;
-
-            if (sp->busy) {     // sat already acquired?
-            	NextTask("busy1");		// let cpu run
-                continue;
-            }
-
             int T1 = sp->T1, T2 = sp->T2;
             int codegen_init;
             
@@ -560,44 +614,91 @@ void SearchTask(void *param) {
                 case E1B: codegen_init = E1B_MODE | (sp->prn-1); break;
             }
 
-            if ((ch = ChanReset(sat, codegen_init)) < 0) {      // all channels busy?
+            if ((ch = ChanReset(sat, codegen_init, claimed)) < 0) {    // all channels busy?
                 continue;
             }
-			
-			if ((last_ch != ch) && (snr < min_sig)) GPSstat(STAT_SAT, 0, last_ch, -1, 0, 0);
 
-            us = t_sample = timer_us(); // sample time
-            Sample();
+            claimed |= 1<<ch;
+            acq->sat[acq->nsats] = sat;
+            acq->ch[acq->nsats] = ch;
+            acq->nsats++;
+        }
+        next = (next + n) % nsats;
+
+        // clear channels whose search failed last pass and weren't claimed again
+        for (ch = 0; ch < gps_chans; ch++)
+            if ((failed & ~claimed) & (1<<ch)) GPSstat(STAT_SAT, 0, ch, -1, 0, 0);
+        failed = 0;
 
-			snr = Correlate(sat, fwd_buf, &lo_shift, &ca_shift);
-			ca_shift *= DECIM;
-            
+        if (acq->nsats == 0) {
+            NextTask("no chans");   // let cpu run
+            continue;
+        }
+
+        t_sample = timer_us(); // sample time
+        Sample();
+        memcpy(acq->data, fwd_buf, sizeof(acq->data));
+        pass++;
+
+        // Each sat is started as soon as its correlation is done. ChanStart() corrects for the
+        // code creep since t_sample, but only to within the doppler bin size, so the pass ends
+        // once the sample block gets too old. The remaining sats are searched next pass.
+        for (i=0; i < acq->nsats; i++) {
+            sat = acq->sat[i];
+            ch = acq->ch[i];
+
+            if (i > 0 && (timer_us() - t_sample) > GPS_ACQ_MAX_AGE_MS * 1000) {
+                next = sat;
+                acq->nsats = i;
+                break;
+            }
+
+            us = timer_us();
+            #ifdef GPS_SHMEM_DISABLE
+                SearchCorrelate(i);
+            #else
+                shmem_ipc_invoke(SIG_IPC_GPS, i);
+            #endif
             us = timer_us()-us;
-            //printf("Correlate %s %.3f secs snr=%.0f\n", PRN(sat), (float)us/1000000.0, snr);
+            //printf("Correlate %s %.3f secs snr=%.0f\n", PRN(sat), (float)us/1000000.0, acq->snr[i]);
+
+            float snr = acq->snr[i];
+            int lo_shift = acq->lo_shift[i], ca_shift = acq->ca_shift[i];
+
+            //jks2
+            min_sig = (Sats[sat].type == E1B)? 16 : minimum_sig;
 
             GPSstat(STAT_SAT, snr, ch, sat, snr < min_sig, us);
-            last_ch = ch;
 
-//#define GPS_SEARCH_ONLY
 #if defined(GPS_SEARCH_ONLY) || defined(GPS_SAMPLES_FROM_FILE)
-            if (snr >= min_sig)
-			printf("ch%02d %s decim=%d pow2=%d %.3f sec lo_shift %5d ca_shift %5d snr %5.1f%c \n",
-			    ch+1, PRN(sat), DECIM, GPS_FFT_POW2, (float) us/1e6, (int) (lo_shift*BIN_SIZE), ca_shift, snr, (snr < 16)? '.':'*');
+            if (snr >= min_sig) {
+                acquired++;
+			    printf("ch%02d %s decim=%d pow2=%d %.3f sec lo_shift %5d ca_shift %5d snr %5.1f%c \n",
+			        ch+1, PRN(sat), DECIM, GPS_FFT_POW2, (float) us/1e6, (int) (lo_shift*BIN_SIZE), ca_shift, snr, (snr < 16)? '.':'*');
+            }
 			continue;
 #endif
 
             if (snr < min_sig) {
+                failed |= 1<<ch;
                 continue;
             }
             
             GPSstat(STAT_DOP, 0, ch, lo_shift*BIN_SIZE, ca_shift);
 
-            sp->busy = true;
+            Sats[sat].busy = true;
+            acquired++;
 
-			//printf("ChanStart ch%02d %s snr=%.0f init=0x%x lo_shift=%d ca_shift=%d\n",
-			//    ch+1, PRN(sat), snr, init, (int) (lo_shift*BIN_SIZE), ca_shift);
+			//printf("ChanStart ch%02d %s snr=%.0f lo_shift=%d ca_shift=%d\n",
+			//    ch+1, PRN(sat), snr, (int) (lo_shift*BIN_SIZE), ca_shift);
             ChanStart(ch, sat, t_sample, lo_shift, ca_shift, (int) snr);
     	}
+
+        #if defined(GPS_SEARCH_ONLY) || defined(GPS_SAMPLES_FROM_FILE)
+            printf("acq pass %d: %d sats %.3f sec, %d acquired, %.1f sec since start, correlate busy %.1f sec\n",
+                pass, acq->nsats, (float) (timer_us() - t_sample)/1e6, acquired,
+                (float) (timer_ms() - start_ms)/1e3, (float) acq->busy_us/1e6);
+        #endif
 	}
 }
 
@@ -64,47 +64,56 @@ static void cfg_test()
 
 	printf("\n");
 	buf = (char *) "{\"foo\":123,\"R\":2}";
+	json_release(&cfgx);
 	json_init(&cfgx, buf);
 	json_set_int(&cfgx, "foo", 9999);
 	
 	printf("\n");
 	buf = (char *) "{\"foo\":123}";
+	json_release(&cfgx);
 	json_init(&cfgx, buf);
 	json_set_int(&cfgx, "foo", 9999);
 
 	printf("\n");
 	buf = (char *) "{\"L\":1,\"foo\":123}";
+	json_release(&cfgx);
 	json_init(&cfgx, buf);
 	json_set_int(&cfgx, "foo", 9999);
 
 	printf("\n");
 	printf("test 2 new creation cases:\n");
 	buf = (char *) "{}";
+	json_release(&cfgx);
 	json_init(&cfgx, buf);
 	json_set_int(&cfgx, "foo", 9999);
 
 	printf("\n");
 	buf = (char *) "{\"L\":1}";
+	json_release(&cfgx);
 	json_init(&cfgx, buf);
 	json_set_int(&cfgx, "foo", 9999);
 
 	printf("\n");
 	printf("test cut/ins of other types:\n");
 	buf = (char *) "{\"L\":1,\"foo\":1.234,\"R\":2}";
+	json_release(&cfgx);
 	json_init(&cfgx, buf);
 	json_set_float(&cfgx, "foo", 5.678);
 
 	printf("\n");
 	buf = (char *) "{\"L\":1,\"foo\":false,\"R\":2}";
+	json_release(&cfgx);
 	json_init(&cfgx, buf);
 	json_set_bool(&cfgx, "foo", true);
 
 	printf("\n");
 	buf = (char *) "{\"L\":1,\"foo\":\"bar\",\"R\":2}";
+	json_release(&cfgx);
 	json_init(&cfgx, buf);
 	json_set_string(&cfgx, "foo", "baz");
 
 	//_cfg_walk(&cfgx, NULL, cfg_print_tok, NULL);
+	json_release(&cfgx);
 	kiwi_exit(0);
 }
 
@@ -217,95 +226,247 @@ void _cfg_release(cfg_t *cfg)
 	    kiwi_free("json buf", cfg->json);
 	}
 	cfg->json = NULL;
+	if (cfg->hash)
+	    kiwi_free("cfg hash", cfg->hash);
+	cfg->hash = NULL;
+	cfg->hash_size = cfg->hash_n = 0;
+	cfg->hash_valid = cfg->hash_scan = false;
 }
 
-static jsmntok_t *_cfg_lookup_id(cfg_t *cfg, jsmntok_t *jt_start, const char *id)
+// Hash index of ids so lookups don't scan every token (see cfg_hent_t).
+// Same results as the linear scan it replaces: a plain id is the first match at any level,
+// id1.id2 is the last id2 directly inside an object that is the value of an id1.
+// JSON nested deeper than CFG_HASH_DEPTH isn't indexed, lookups then use _cfg_lookup_scan().
+
+#define CFG_HASH_MIN		64
+#define CFG_HASH_DEPTH		32
+#define CFG_HASH_FNV_INIT	2166136261U
+#define CFG_HASH_FNV_PRIME	16777619U
+
+static u4_t _cfg_hash_str(u4_t h, const char *s, int n)
 {
-	if (!cfg->init) return NULL;
+	while (n--)
+		h = (h ^ (u1_t) *s++) * CFG_HASH_FNV_PRIME;
+	return h;
+}
+
+static bool _cfg_hash_tokeq(cfg_t *cfg, int tok, const char *s, int n)
+{
+	jsmntok_t *jt = &cfg->tokens[tok];
+	return (jt->end - jt->start == n && strncmp(&cfg->json[jt->start], s, n) == 0);
+}
+
+static bool _cfg_hash_same(cfg_t *cfg, cfg_hent_t *he, int key, int parent)
+{
+	jsmntok_t *kt = &cfg->tokens[key];
+	if (!_cfg_hash_tokeq(cfg, he->key, &cfg->json[kt->start], kt->end - kt->start)) return false;
+	if (parent < 0 || he->parent < 0) return (parent == he->parent);
+	jsmntok_t *pt = &cfg->tokens[parent];
+	return _cfg_hash_tokeq(cfg, he->parent, &cfg->json[pt->start], pt->end - pt->start);
+}
+
+static void _cfg_hash_place(cfg_t *cfg, cfg_hent_t *ent)
+{
+	u4_t mask = cfg->hash_size - 1;
+	u4_t i;
+	for (i = ent->hash & mask; cfg->hash[i].key >= 0; i = (i+1) & mask)
+		;
+	cfg->hash[i] = *ent;
+}
+
+static void _cfg_hash_grow(cfg_t *cfg)
+{
+	cfg_hent_t *prev = cfg->hash;
+	int prev_size = cfg->hash_size;
+	cfg->hash_size = prev_size? (prev_size * 2) : CFG_HASH_MIN;
+	cfg->hash = (cfg_hent_t *) kiwi_malloc("cfg hash", cfg->hash_size * sizeof(cfg_hent_t));
+	memset(cfg->hash, 0xff, cfg->hash_size * sizeof(cfg_hent_t));		// key = -1: empty
 	
-	int i, idlen = strlen(id);
-	jsmntok_t *jt;
+	for (int i = 0; i < prev_size; i++)
+		if (prev[i].key >= 0) _cfg_hash_place(cfg, &prev[i]);
+	if (prev)
+		kiwi_free("cfg hash", prev);
+}
+
+static void _cfg_hash_insert(cfg_t *cfg, u4_t hash, int key, int parent, bool replace)
+{
+	// keep the load factor <= 1/2
+	if ((cfg->hash_n + 1) * 2 > cfg->hash_size)
+		_cfg_hash_grow(cfg);
 	
-	for (jt = jt_start; jt != &cfg->tokens[cfg->ntok]; jt++) {
-		int n = jt->end - jt->start;
-		char *s = &cfg->json[jt->start];
-		if (JSMN_IS_ID(jt)) {
-			//printf("key %d: %d <%.*s> cmp %d\n", i, n, n, s, strncmp(id, s, n));
-			if (n == idlen && strncmp(id, s, n) == 0) {
-				return jt+1;
+	u4_t mask = cfg->hash_size - 1;
+	for (u4_t i = hash & mask;; i = (i+1) & mask) {
+		cfg_hent_t *he = &cfg->hash[i];
+		if (he->key < 0) {
+			he->hash = hash;
+			he->key = key;
+			he->parent = parent;
+			he->cached = CFG_CACHED_NONE;
+			cfg->hash_n++;
+			return;
+		}
+		if (he->hash == hash && _cfg_hash_same(cfg, he, key, parent)) {
+			if (replace) {
+				he->key = key;
+				he->parent = parent;
 			}
+			return;
 		}
 	}
+}
+
+static void _cfg_hash_build(cfg_t *cfg)
+{
+	jsmntok_t *tokens = cfg->tokens;
+	int stk[CFG_HASH_DEPTH], rem[CFG_HASH_DEPTH], sp = 0;
 	
+	cfg->hash_valid = true;
+	cfg->hash_scan = false;
+	cfg->hash_n = 0;
+	if (cfg->hash)
+		memset(cfg->hash, 0xff, cfg->hash_size * sizeof(cfg_hent_t));
+	
+	for (int i = 0; i < cfg->ntok; i++) {
+		jsmntok_t *jt = &tokens[i];
+
+		if (JSMN_IS_ID(jt)) {
+			char *s = &cfg->json[jt->start];
+			int n = jt->end - jt->start;
+			_cfg_hash_insert(cfg, _cfg_hash_str(CFG_HASH_FNV_INIT, s, n), i, -1, false);
+
+			// id1.id2: enclosing object is the value of id1 (which is always the token before it)
+			int obj = sp? stk[sp-1] : -1;
+			if (obj > 0 && JSMN_IS_OBJECT(&tokens[obj]) && JSMN_IS_ID(&tokens[obj-1])) {
+				jsmntok_t *pt = &tokens[obj-1];
+				u4_t h = _cfg_hash_str(CFG_HASH_FNV_INIT, &cfg->json[pt->start], pt->end - pt->start);
+				h = _cfg_hash_str(h, ".", 1);
+				_cfg_hash_insert(cfg, _cfg_hash_str(h, s, n), i, obj-1, true);
+			}
+		}
+
+		// track the enclosing object/array/id, token size is the number of direct children
+		if (sp) rem[sp-1]--;
+		if (jt->size) {
+			if (sp == CFG_HASH_DEPTH) {
+				// can come from remote JSON (e.g. services.cpp), so not a reason to panic
+				printf("cfg %s: JSON nested too deep to index, lookups will scan\n", cfg->filename);
+				cfg->hash_n = 0;
+				if (cfg->hash)
+					memset(cfg->hash, 0xff, cfg->hash_size * sizeof(cfg_hent_t));
+				cfg->hash_scan = true;
+				return;
+			}
+			stk[sp] = i;
+			rem[sp] = jt->size;
+			sp++;
+		}
+		while (sp && rem[sp-1] == 0)
+			sp--;
+	}
+}
+
+// id2 == NULL for a plain id
+static cfg_hent_t *_cfg_hash_find(cfg_t *cfg, const char *id, int idlen, const char *id2, int id2len)
+{
+	if (cfg->hash_size == 0) return NULL;
+	u4_t hash = _cfg_hash_str(CFG_HASH_FNV_INIT, id, idlen);
+	if (id2) {
+		hash = _cfg_hash_str(hash, ".", 1);
+		hash = _cfg_hash_str(hash, id2, id2len);
+	}
+
+	u4_t mask = cfg->hash_size - 1;
+	for (u4_t i = hash & mask; cfg->hash[i].key >= 0; i = (i+1) & mask) {
+		cfg_hent_t *he = &cfg->hash[i];
+		if (he->hash != hash) continue;
+		if (id2) {
+			if (he->parent >= 0 && _cfg_hash_tokeq(cfg, he->key, id2, id2len) && _cfg_hash_tokeq(cfg, he->parent, id, idlen))
+				return he;
+		} else {
+			if (he->parent < 0 && _cfg_hash_tokeq(cfg, he->key, id, idlen))
+				return he;
+		}
+	}
 	return NULL;
 }
 
-// should get called for every second-level object of id1
-// search for match with id2
-static bool _cfg_lookup_json_cb(cfg_t *cfg, void *param, jsmntok_t *jt, int seq, int hit, int lvl, int rem, void **rval)
+// Token after the id (i.e. its value) with the same results as _cfg_hash_find().
+// Uses the token offsets instead of a stack so there is no nesting limit.
+static jsmntok_t *_cfg_scan_id(cfg_t *cfg, const char *id, int idlen, const char *id2, int id2len)
 {
-	char *id2 = (char *) param;
-	int id2_len = strlen(id2);
+	jsmntok_t *tokens = cfg->tokens, *found = NULL;
 	
-	//cfg_print_tok(cfg, param, jt, seq, hit, lvl, rem, rval);
-	if (!JSMN_IS_ID(jt)) return false;
-	char *s = &cfg->json[jt->start];
-	int n = jt->end - jt->start;
-	//printf("_cfg_lookup_json_cb 2-scope: TEST id=\"%.*s\" WANT id2=\"%s\"\n", n, s, id2);
-	if (n != id2_len || strncmp(s, id2, n) != 0) return false;
-	if (rval) *rval = jt+1;
-	return true;
+	for (int i = 0; i < cfg->ntok; i++) {
+		if (!JSMN_IS_ID(&tokens[i]) || !_cfg_hash_tokeq(cfg, i, id, idlen)) continue;
+		if (!id2) return &tokens[i+1];
+		
+		// direct children of the object that is the value of id1: skip over the value of each child id
+		jsmntok_t *obj = &tokens[i+1];
+		if (i+1 >= cfg->ntok || !JSMN_IS_OBJECT(obj)) continue;
+		for (int k = i+2; k+1 < cfg->ntok && tokens[k].start < obj->end;) {
+			if (JSMN_IS_ID(&tokens[k]) && _cfg_hash_tokeq(cfg, k, id2, id2len))
+				found = &tokens[k+1];
+			int val_end = tokens[k+1].end;
+			for (k += 2; k < cfg->ntok && tokens[k].start < val_end; k++)
+				;
+		}
+	}
+	
+	return found;
 }
 
-jsmntok_t *_cfg_lookup_json(cfg_t *cfg, const char *id, cfg_lookup_e option)
+static jsmntok_t *_cfg_lookup_scan(cfg_t *cfg, const char *id, int id1_len, const char *id2, cfg_lookup_e option)
+{
+	if (id2 == NULL || option == CFG_OPT_ID1)
+		return _cfg_scan_id(cfg, id, id1_len, NULL, 0);
+	jsmntok_t *jt = _cfg_scan_id(cfg, id, id1_len, id2, strlen(id2));
+	if (jt == NULL && _cfg_scan_id(cfg, id, id1_len, NULL, 0) != NULL)
+		return CFG_LOOKUP_LVL1;
+	return jt;
+}
+
+static jsmntok_t *_cfg_lookup(cfg_t *cfg, const char *id, cfg_lookup_e option, cfg_hent_t **hep)
 {
 	if (!cfg->init) return NULL;
     assert(cfg->flags & CFG_PARSE_VALID);
+	if (!cfg->hash_valid) _cfg_hash_build(cfg);
 	
-	int i;
-	
-	jsmntok_t *jt;
-	//printf("_cfg_lookup_json: key=\"%s\" %d\n", id, strlen(id));
-	char *dot = (char *) strchr(id, '.');
-	char *dotdot = dot? (char *) strchr(dot+1, '.') : NULL;
+	cfg_hent_t *he;
+	//printf("_cfg_lookup: key=\"%s\" %d\n", id, strlen(id));
+	const char *dot = strchr(id, '.');
+	const char *dotdot = dot? strchr(dot+1, '.') : NULL;
 
 	// handle two levels of id scope, i.e. id1.id2, but ignore more like ip addresses with three dots
 	if (dot && !dotdot && option != CFG_OPT_NO_DOT) {
-		char *id1_m = NULL, *id2_m = NULL;
-		i = sscanf(id, "%m[^.].%ms", &id1_m, &id2_m);
-		//printf("_cfg_lookup_json 2-scope: key=\"%s\" n=%d id1=\"%s\" id2=\"%s\"\n", id, i, id1_m, id2_m);
-		if (i != 2) {
-            free(id1_m); free(id2_m);
-		    return NULL;
-		}
-		if (strchr(id2_m, '.') != NULL) panic("_cfg_lookup_json: more than two levels of scope in id");
+		int id1_len = dot - id;
+		const char *id2 = dot+1;
+		if (id1_len == 0 || *id2 == '\0') return NULL;
+		if (cfg->hash_scan) return _cfg_lookup_scan(cfg, id, id1_len, id2, option);
 		
 		// lookup just the id1 of a two-scope id
 		if (option == CFG_OPT_ID1) {
-		    jt = _cfg_lookup_id(cfg, cfg->tokens, id1_m);
-            free(id1_m); free(id2_m);
-		    return jt;
+		    he = _cfg_hash_find(cfg, id, id1_len, NULL, 0);
 		} else {
-            // run callback for all second scope objects of id1
-            void *rtn_rval = _cfg_walk(cfg, id1_m, _cfg_lookup_json_cb, (void *) id2_m);
+            he = _cfg_hash_find(cfg, id, id1_len, id2, strlen(id2));
             
-            if (rtn_rval == NULL && _cfg_lookup_id(cfg, cfg->tokens, id1_m) != NULL) {
+            if (he == NULL && _cfg_hash_find(cfg, id, id1_len, NULL, 0) != NULL) {
                 // if id1 exists but id2 is missing then return this fact
-                free(id1_m); free(id2_m);
                 return CFG_LOOKUP_LVL1;
             }
-            
-            //printf("_cfg_lookup_json 2-scope: rtn_rval=%p id=%s\n", rtn_rval, id);
-            free(id1_m); free(id2_m);
-            return (jsmntok_t *) rtn_rval;
         }
-        assert("not reached");
-		
 	} else {
-		return _cfg_lookup_id(cfg, cfg->tokens, id);
+		if (cfg->hash_scan) return _cfg_lookup_scan(cfg, id, strlen(id), NULL, option);
+		he = _cfg_hash_find(cfg, id, strlen(id), NULL, 0);
 	}
 
-	return NULL;
+	if (he == NULL) return NULL;
+	if (hep) *hep = he;
+	return &cfg->tokens[he->key + 1];
+}
+
+jsmntok_t *_cfg_lookup_json(cfg_t *cfg, const char *id, cfg_lookup_e option)
+{
+	return _cfg_lookup(cfg, id, option, NULL);
 }
 
 bool _cfg_type_json(cfg_t *cfg, jsmntype_t jt_type, jsmntok_t *jt, const char **str)
@@ -429,10 +590,17 @@ int _cfg_int(cfg_t *cfg, const char *name, bool *error, u4_t flags)
 	int num = 0;
 	bool err = false;
 
-	//jsmntok_t *jt = _cfg_lookup_json(cfg, name, CFG_OPT_NONE);
-	jsmntok_t *jt = _cfg_lookup_json(cfg, name, (flags & CFG_NO_DOT)? CFG_OPT_NO_DOT : CFG_OPT_NONE);
+	cfg_hent_t *he = NULL;
+	jsmntok_t *jt = _cfg_lookup(cfg, name, (flags & CFG_NO_DOT)? CFG_OPT_NO_DOT : CFG_OPT_NONE, &he);
+	if (he && he->cached == CFG_CACHED_INT) {
+		num = he->val.i;
+	} else
 	if (!jt || jt == CFG_LOOKUP_LVL1 || _cfg_int_json(cfg, jt, &num) == false) {
 		err = true;
+	} else
+	if (he) {	// no hash entry when the JSON is too deep to index
+		he->cached = CFG_CACHED_INT;
+		he->val.i = num;
 	}
 	if (error) *error = err;
 	if (err) {
@@ -543,9 +711,17 @@ double _cfg_float(cfg_t *cfg, const char *name, bool *error, u4_t flags)
 	double num = 0;
 	bool err = false;
 
-	jsmntok_t *jt = _cfg_lookup_json(cfg, name, CFG_OPT_NONE);
+	cfg_hent_t *he = NULL;
+	jsmntok_t *jt = _cfg_lookup(cfg, name, CFG_OPT_NONE, &he);
+	if (he && he->cached == CFG_CACHED_FLOAT) {
+		num = he->val.f;
+	} else
 	if (!jt || jt == CFG_LOOKUP_LVL1 || _cfg_float_json(cfg, jt, &num) == false) {
 		err = true;
+	} else
+	if (he) {	// no hash entry when the JSON is too deep to index
+		he->cached = CFG_CACHED_FLOAT;
+		he->val.f = num;
 	}
 	if (error) *error = err;
 	if (err) {
@@ -655,9 +831,17 @@ int _cfg_bool(cfg_t *cfg, const char *name, bool *error, u4_t flags)
 	int num = 0;
 	bool err = false;
 
-	jsmntok_t *jt = _cfg_lookup_json(cfg, name, CFG_OPT_NONE);
+	cfg_hent_t *he = NULL;
+	jsmntok_t *jt = _cfg_lookup(cfg, name, CFG_OPT_NONE, &he);
+	if (he && he->cached == CFG_CACHED_BOOL) {
+		num = he->val.i;
+	} else
 	if (!jt || jt == CFG_LOOKUP_LVL1 || _cfg_bool_json(cfg, jt, &num) == false) {
 		err = true;
+	} else
+	if (he) {	// no hash entry when the JSON is too deep to index
+		he->cached = CFG_CACHED_BOOL;
+		he->val.i = num;
 	}
 	if (error) *error = err;
 	if (err) {
@@ -1055,6 +1239,8 @@ void *_cfg_walk(cfg_t *cfg, const char *id, cfg_walk_cb_t cb, void *param)
 
 static bool _cfg_parse_json(cfg_t *cfg, bool doPanic)
 {
+    cfg->hash_valid = false;     // ids are re-indexed and values re-cached on the next lookup
+
     // the dx list can be huge, so yield during the time-consuming parsing process
     bool yield = (cfg == &cfg_dx && !cfg->init_load);
     TMEAS(printf("cfg_parse_json: START %s yield=%d\n", cfg->filename, yield);)
@@ -1112,6 +1298,7 @@ static bool _cfg_parse_json(cfg_t *cfg, bool doPanic)
 	cfg->ntok = rc;
     TMEAS(printf("cfg_parse_json: DONE json string -> json struct\n");)
     cfg->flags |= CFG_PARSE_VALID;
+    cfg->hash_valid = false;     // again: a lookup while the dx list parse yielded may have indexed a partial parse
 	return true;
 }
 
@@ -1208,6 +1395,7 @@ void _cfg_save_json(cfg_t *cfg, char *json)
             _cfg_parse_json(cfg, true);
         } else {
             cfg->flags &= ~CFG_PARSE_VALID;
+            cfg->hash_valid = false;
         }
     #else
         _cfg_parse_json(cfg, true);
@@ -26,6 +26,24 @@ Boston, MA  02110-1301, USA.
 
 // configuration
 
+// Hash index entry: "id" (any level, first in file wins) or "id1.id2" (id2 directly inside the object of id1).
+// Built on the first lookup after a parse, so an edit (which always re-parses) invalidates it and the cached values.
+#define CFG_CACHED_NONE     0
+#define CFG_CACHED_INT      1
+#define CFG_CACHED_FLOAT    2
+#define CFG_CACHED_BOOL     3
+
+typedef struct {
+	u4_t hash;
+	int key;        // token index of the id, value follows at key+1
+	int parent;     // token index of id1 for "id1.id2", -1 for a plain id
+	int cached;
+	union {
+		int i;      // int, bool
+		double f;
+	} val;
+} cfg_hent_t;
+
 typedef struct {
 	bool init, init_load, isJSON;
 	lock_t lock;    // FIXME: now that parsing the dx list is yielding probably need to lock
@@ -37,6 +55,11 @@ typedef struct {
 
 	int tok_size, ntok;
 	jsmntok_t *tokens;
+
+	bool hash_valid;
+	bool hash_scan;         // JSON nested too deep to index, lookups scan the tokens
+	int hash_size, hash_n;  // hash_size is a power of 2
+	cfg_hent_t *hash;
 } cfg_t;
 
 extern cfg_t cfg_cfg, cfg_adm, cfg_dx;
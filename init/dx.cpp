@@ -27,6 +27,7 @@ Boston, MA  02110-1301, USA.
 #include "cfg.h"
 #include "dx.h"
 #include "coroutines.h"
+#include "non_block.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -34,6 +35,10 @@ Boston, MA  02110-1301, USA.
 #include <stdlib.h>
 #include <time.h>
 #include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 // maintains a dx_t/dxlist_t struct parallel to JSON for fast lookups
 
@@ -42,25 +47,94 @@ Boston, MA  02110-1301, USA.
 
 dxlist_t dx;
 
-// create JSON string from dx_t struct representation
-void dx_save_as_json()
+// Edits (SET DX_UPD) are made to the dx_t list in place and appended to a journal file next to dx.json,
+// one line per change: '+' and the dx.json form of an entry added, '-' and that of an entry removed
+// (a modify is both). So an edit doesn't rewrite the whole file. dx_compact_task() rewrites dx.json
+// from the list after DX_JOURNAL_MAX edits, or once edits have stopped for DX_COMPACT_IDLE_SEC,
+// and then removes the journal. dx_reload() replays any journal left over from before a restart.
+
+#define DX_JOURNAL_MAX          256
+#define DX_COMPACT_IDLE_SEC     30
+#define DX_COMPACT_POLL_SEC     5
+
+static char *dx_journal_fn, *dx_journal_prev_fn;
+static int dx_journal_fd = -1;
+
+#define DX_JSON_OVERHEAD 128	// gross assumption about size required for everything else
+
+static int dx_json_entry_size(dx_t *dxp)
+{
+	int n = DX_JSON_OVERHEAD;
+	n += strlen(dxp->ident);
+	if (dxp->notes)
+		n += strlen(dxp->notes);
+	if (dxp->params)
+		n += strlen(dxp->params);
+	return n;
+}
+
+// an entry as it appears in dx.json and the journal
+static int dx_json_entry(char *buf, dx_t *dxp)
+{
+	int n;
+	char *cp = buf;
+
+	n = sprintf(cp, "[%.2f", dxp->freq); cp += n;
+	n = sprintf(cp, ",\"%s\"", modu_s[dxp->flags & DX_MODE]); cp += n;
+	n = sprintf(cp, ",\"%s\",\"%s\"", dxp->ident, dxp->notes? dxp->notes:""); cp += n;
+	n = sprintf(cp, ",%d", dxp->timestamp); cp += n;
+	n = sprintf(cp, ",%d", dxp->tag); cp += n;
+
+	u4_t type = dxp->flags & DX_TYPE;
+	if (type || dxp->low_cut || dxp->high_cut || dxp->offset || (dxp->params && *dxp->params)) {
+		const char *delim = ",{";
+		const char *type_s = "";
+		if (type == DX_WL) type_s = "WL"; else
+		if (type == DX_SB) type_s = "SB"; else
+		if (type == DX_DG) type_s = "DG"; else
+		if (type == DX_SE) type_s = "SE"; else
+		if (type == DX_XX) type_s = "XX"; else
+		if (type == DX_MK) type_s = "MK";
+		if (type) {
+		    n = sprintf(cp, "%s\"%s\":1", delim, type_s); cp += n;
+		    delim = ",";
+		}
+		if (dxp->low_cut) {
+		    n = sprintf(cp, "%s\"lo\":%d", delim, dxp->low_cut); cp += n;
+		    delim = ",";
+		}
+		if (dxp->high_cut) {
+		    n = sprintf(cp, "%s\"hi\":%d", delim, dxp->high_cut); cp += n;
+		    delim = ",";
+		}
+		if (dxp->offset) {
+		    n = sprintf(cp, "%s\"o\":%d", delim, dxp->offset); cp += n;
+		    delim = ",";
+		}
+		if (dxp->params && *dxp->params) {
+		    n = sprintf(cp, "%s\"p\":\"%s\"", delim, dxp->params); cp += n;
+		    //delim = ",";
+		}
+		*cp++ = '}';
+	}
+	*cp++ = ']';
+	*cp = '\0';
+	return cp - buf;
+}
+
+// create JSON string from dx_t struct representation if there have been edits since the last time
+void dx_json_update()
 {
 	int i, n;
 	cfg_t *cfg = &cfg_dx;
 	dx_t *dxp;
 
-	TMEAS(printf("dx_save_as_json: START saving as dx.json, %d entries\n", dx.len);)
+	if (dx.json_up_to_date) return;
+	TMEAS(printf("dx_json_update: START %d entries\n", dx.len);)
 
-	#define DX_JSON_OVERHEAD 128	// gross assumption about size required for everything else
 	n = DX_JSON_OVERHEAD;   // room for "{"dx":[]}" etc.
-	for (i=0, dxp = dx.list; i < dx.len; i++, dxp++) {
-		n += DX_JSON_OVERHEAD;
-		n += strlen(dxp->ident);
-		if (dxp->notes)
-			n += strlen(dxp->notes);
-		if (dxp->params)
-			n += strlen(dxp->params);
-	}
+	for (i=0, dxp = dx.list; i < dx.len; i++, dxp++)
+		n += dx_json_entry_size(dxp);
 
     kiwi_free("dx json buf", cfg->json);
 	cfg->json = (char *) kiwi_malloc("dx json buf", n);
@@ -69,57 +143,74 @@ void dx_save_as_json()
 	n = sprintf(cp, "{\"dx\":["); cp += n;
 
 	for (i=0, dxp = dx.list; i < dx.len; i++, dxp++) {
-	    assert((cp - cfg->json) < cfg->json_buf_size);
-	    
-		n = sprintf(cp, "%s[%.2f", i? ",":"", dxp->freq); cp += n;
-		n = sprintf(cp, ",\"%s\"", modu_s[dxp->flags & DX_MODE]); cp += n;
-		n = sprintf(cp, ",\"%s\",\"%s\"", dxp->ident, dxp->notes? dxp->notes:""); cp += n;
-		n = sprintf(cp, ",%d", dxp->timestamp); cp += n;
-		n = sprintf(cp, ",%d", dxp->tag); cp += n;
-
-		u4_t type = dxp->flags & DX_TYPE;
-		if (type || dxp->low_cut || dxp->high_cut || dxp->offset || (dxp->params && *dxp->params)) {
-			const char *delim = ",{";
-			const char *type_s = "";
-			if (type == DX_WL) type_s = "WL"; else
-			if (type == DX_SB) type_s = "SB"; else
-			if (type == DX_DG) type_s = "DG"; else
-			if (type == DX_SE) type_s = "SE"; else
-			if (type == DX_XX) type_s = "XX"; else
-			if (type == DX_MK) type_s = "MK";
-			if (type) {
-			    n = sprintf(cp, "%s\"%s\":1", delim, type_s); cp += n;
-			    delim = ",";
-			}
-			if (dxp->low_cut) {
-			    n = sprintf(cp, "%s\"lo\":%d", delim, dxp->low_cut); cp += n;
-			    delim = ",";
-			}
-			if (dxp->high_cut) {
-			    n = sprintf(cp, "%s\"hi\":%d", delim, dxp->high_cut); cp += n;
-			    delim = ",";
-			}
-			if (dxp->offset) {
-			    n = sprintf(cp, "%s\"o\":%d", delim, dxp->offset); cp += n;
-			    delim = ",";
-			}
-			if (dxp->params && *dxp->params) {
-			    n = sprintf(cp, "%s\"p\":\"%s\"", delim, dxp->params); cp += n;
-			    //delim = ",";
-			}
-			*cp++ = '}';
-		}
-		*cp++ = ']';
+		if (i) *cp++ = ',';
+		cp += dx_json_entry(cp, dxp);
 		*cp++ = '\n';
-
-		if ((i&31) == 0) NextTask("dx_save_as_json");
+	    assert((cp - cfg->json) < cfg->json_buf_size);
 	}
 	
 	n = sprintf(cp, "]}"); cp += n;
     assert((cp - cfg->json) < cfg->json_buf_size);
-	TMEAS(printf("dx_save_as_json: dx struct -> json string\n");)
-	dxcfg_save_json(cfg->json);
-	TMEAS(printf("dx_save_as_json: DONE\n");)
+
+    // parsed again by dxcfg_update_json() if needed
+    cfg->flags &= ~CFG_PARSE_VALID;
+    cfg->hash_valid = false;
+	dx.json_up_to_date = true;
+	TMEAS(printf("dx_json_update: DONE\n");)
+}
+
+// Write dx.json from a list, one entry at a time instead of from one string of the whole list.
+// The file is replaced only once complete.
+static bool dx_write_json(dx_t *list, int len)
+{
+	int i, n, size = 0;
+	char *buf = NULL, *tmp_fn;
+	dx_t *dxp;
+
+	asprintf(&tmp_fn, "%s.tmp", cfg_dx.filename);
+	FILE *fp = fopen(tmp_fn, "w");
+	if (fp == NULL) {
+		free(tmp_fn);
+		return false;
+	}
+
+	fputs("{\"dx\":[", fp);
+	for (i=0, dxp = list; i < len; i++, dxp++) {
+		if ((n = dx_json_entry_size(dxp)) > size) {
+			size = n;
+			buf = (char *) realloc(buf, size);
+		}
+		dx_json_entry(buf, dxp);
+		fprintf(fp, "%s%s\n", i? ",":"", buf);
+	}
+	fputs("]}\n", fp);
+
+	bool ok = (fflush(fp) == 0 && fsync(fileno(fp)) == 0);
+	ok = (fclose(fp) == 0) && ok;
+	if (ok) ok = (rename(tmp_fn, cfg_dx.filename) == 0);
+	if (!ok) unlink(tmp_fn);
+	free(buf);
+	free(tmp_fn);
+	return ok;
+}
+
+static void dx_journal(char op, dx_t *dxp)
+{
+	if (dx_journal_fd < 0)
+		dx_journal_fd = open(dx_journal_fn, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+	char *s = (char *) malloc(1 + dx_json_entry_size(dxp) + 1);
+	s[0] = op;
+	int n = 1 + dx_json_entry(&s[1], dxp);
+	s[n++] = '\n';
+	if (dx_journal_fd < 0 || write(dx_journal_fd, s, n) != n) {
+		lprintf("DX journal %s: %s, rewriting %s instead\n", dx_journal_fn, strerror(errno), cfg_dx.filename);
+		dx.journal_n = DX_JOURNAL_MAX;
+	}
+	free(s);
+
+	dx.journal_n++;
+	dx.journal_time = timer_sec();
 }
 
 static void dx_mode(dx_t *dxp, const char *s)
@@ -152,7 +243,8 @@ static void dx_flag(dx_t *dxp, const char *flag)
 	lprintf("%.2f \"%s\": unknown dx flag \"%s\"\n", dxp->freq, dxp->ident, flag);
 }
 
-// prepare dx list by conditionally sorting, initializing self indexes and constructing new masked freq list
+// prepare dx list by conditionally sorting, initializing self indexes, constructing new masked freq list
+// and rebuilding the label index
 void dx_prep_list(bool need_sort, dx_t *_dx_list, int _dx_list_len, int _dx_list_len_new)
 {
     int i, j;
@@ -185,21 +277,22 @@ void dx_prep_list(bool need_sort, dx_t *_dx_list, int _dx_list_len, int _dx_list
         //    dxp->freq, dxp->masked_lo, dxp->masked_hi, modu_s[mode], hbw, offset, dxp->low_cut, dxp->high_cut);
     }
     dx.masked_seq++;
+
+    dx_index_build(_dx_list, _dx_list_len_new);
 }
 	
-// create and switch to new dx_t struct from JSON token list representation
-static void dx_reload_json(cfg_t *cfg)
+// new dx_t list from the "dx" array of a JSON token list
+// incomplete: some entries were missing a timestamp or tag and were given one
+static dx_t *dx_parse_json(cfg_t *cfg, int *len, bool *incomplete)
 {
 	const char *s;
 	jsmntok_t *end_tok = &(cfg->tokens[cfg->ntok]);
-	jsmntok_t *jt = dxcfg_lookup_json("dx");
+	jsmntok_t *jt = _cfg_lookup_json(cfg, "dx", CFG_OPT_NONE);
 	assert(jt != NULL);
 	assert(JSMN_IS_ARRAY(jt));
 	int _dx_list_len = jt->size;
 	jt++;
 	
-	lprintf("%d dx entries\n", _dx_list_len);
-	
 	dx_t *_dx_list = (dx_t *) kiwi_malloc("dx_list", (_dx_list_len + DX_HIDDEN_SLOT) * sizeof(dx_t));
 	
 	dx_t *dxp = _dx_list;
@@ -211,46 +304,48 @@ static void dx_reload_json(cfg_t *cfg)
 		jt++;
 		
 		double f;
-		assert(dxcfg_float_json(jt, &f) == true);
+		assert(_cfg_float_json(cfg, jt, &f) == true);
 		dxp->freq = f;
 		jt++;
 		
 		const char *mode;
-		assert(dxcfg_string_json(jt, &mode) == true);
+		assert(_cfg_type_json(cfg, JSMN_STRING, jt, &mode) == true);
 		dx_mode(dxp, mode);
-		dxcfg_string_free(mode);
+		_cfg_free(cfg, mode);
 		jt++;
 		
-		assert(dxcfg_string_json(jt, &s) == true);
+		assert(_cfg_type_json(cfg, JSMN_STRING, jt, &s) == true);
 		kiwi_str_unescape_quotes((char *) s);
         dxp->ident_s = strdup(s);
 		dxp->ident = kiwi_str_encode((char *) s);
-		dxcfg_string_free(s);
+		_cfg_free(cfg, s);
 		jt++;
 		
-		assert(dxcfg_string_json(jt, &s) == true);
+		assert(_cfg_type_json(cfg, JSMN_STRING, jt, &s) == true);
 		kiwi_str_unescape_quotes((char *) s);
         dxp->notes_s = strdup(s);
 		dxp->notes = kiwi_str_encode((char *) s);
-		dxcfg_string_free(s);
+		_cfg_free(cfg, s);
 		if (*dxp->notes == '\0') {
-			dxcfg_string_free(dxp->notes);
+			_cfg_free(cfg, dxp->notes);
 			dxp->notes = NULL;
 		}
 		jt++;
 		
-		if (dxcfg_int_json(jt, &dxp->timestamp)) {
+		if (_cfg_int_json(cfg, jt, &dxp->timestamp)) {
 		    jt++;
 		} else {
 		    //printf("### DX #%d missing timestamp\n", i);
 		    dxp->timestamp = utc_time_since_2018() / 60;
+		    if (incomplete) *incomplete = true;
 		}
 		
-		if (dxcfg_int_json(jt, &dxp->tag)) {
+		if (_cfg_int_json(cfg, jt, &dxp->tag)) {
 		    jt++;
 		} else {
 		    //printf("### DX #%d missing tag\n", i);
 		    dxp->tag = random() % 10000;
+		    if (incomplete) *incomplete = true;
 		}
 		
 		//printf("dx.json %d %.2f 0x%x \"%s\" \"%s\"\n", i, dxp->freq, dxp->flags, dxp->ident, dxp->notes);
@@ -260,11 +355,11 @@ static void dx_reload_json(cfg_t *cfg)
 			while (jt != end_tok && !JSMN_IS_ARRAY(jt)) {
 				assert(JSMN_IS_ID(jt));
 				const char *id;
-				assert(dxcfg_string_json(jt, &id) == true);
+				assert(_cfg_type_json(cfg, JSMN_STRING, jt, &id) == true);
 				jt++;
 				
 				int num;
-				if (dxcfg_int_json(jt, &num) == true) {
+				if (_cfg_int_json(cfg, jt, &num) == true) {
                     if (strcmp(id, "lo") == 0) {
                         dxp->low_cut = num;
                     } else
@@ -281,21 +376,43 @@ static void dx_reload_json(cfg_t *cfg)
                         }
                     }
                 } else
-				if (dxcfg_string_json(jt, &s) == true) {
+				if (_cfg_type_json(cfg, JSMN_STRING, jt, &s) == true) {
                     //printf("dx.json %s=<%s>\n", id, s);
                     if (strcmp(id, "p") == 0) {
                         kiwi_str_unescape_quotes((char *) s);
                         dxp->params = kiwi_str_encode((char *) s);
                     }
-                    dxcfg_string_free(s);
+                    _cfg_free(cfg, s);
 				}
 
-                dxcfg_string_free(id);
+                _cfg_free(cfg, id);
 				jt++;
 			}
 		}
 	}
 	
+	*len = _dx_list_len;
+	return _dx_list;
+}
+
+static void dx_free(dx_t *dxp)
+{
+	// previous allocators better have used malloc(), strdup() et al for these and not kiwi_malloc()
+	free((void *) dxp->ident_s);
+	free((void *) dxp->ident);
+	free((void *) dxp->notes_s);
+	free((void *) dxp->notes);
+	free((void *) dxp->params);
+}
+
+// create and switch to new dx_t struct from JSON token list representation
+static bool dx_reload_json(cfg_t *cfg)
+{
+	int _dx_list_len;
+	bool incomplete = false;
+	dx_t *_dx_list = dx_parse_json(cfg, &_dx_list_len, &incomplete);
+	lprintf("%d dx entries\n", _dx_list_len);
+	
     dx_prep_list(true, _dx_list, _dx_list_len, _dx_list_len);
 
 	// switch to new list
@@ -303,23 +420,289 @@ static void dx_reload_json(cfg_t *cfg)
 	int prev_dx_list_len = dx.len;
 	dx.list = _dx_list;
 	dx.len = _dx_list_len;
-	dx.hidden_used = false;
 	dx.json_up_to_date = true;
 	
 	// release previous
 	if (prev_dx_list) {
 		int i;
-		for (i=0, dxp = prev_dx_list; i < prev_dx_list_len; i++, dxp++) {
-			// previous allocators better have used malloc(), strdup() et al for these and not kiwi_malloc()
-			free((void *) dxp->ident_s);
-			free((void *) dxp->ident);
-			free((void *) dxp->notes_s);
-			free((void *) dxp->notes);
-			free((void *) dxp->params);
-		}
+		for (i=0; i < prev_dx_list_len; i++)
+			dx_free(&prev_dx_list[i]);
 	}
 	
 	kiwi_free("dx_list", prev_dx_list);
+	return incomplete;
+}
+
+// Move dx.list[i] to its place in the list sorted by freq after it has been changed or added at the end.
+// A binary search and one memmove() instead of sorting the whole list again.
+static int dx_list_resort(int i)
+{
+	dx_t e = dx.list[i];
+	int lo, hi, mid, j;
+
+	if (i > 0 && dx.list[i-1].freq > e.freq) {
+		// first of the entries below i with a higher freq
+		for (lo = 0, hi = i-1; lo < hi;) {
+			mid = (lo + hi) / 2;
+			if (dx.list[mid].freq > e.freq) hi = mid; else lo = mid + 1;
+		}
+		j = lo;
+		memmove(&dx.list[j+1], &dx.list[j], (i - j) * sizeof(dx_t));
+	} else
+	if (i < dx.len-1 && dx.list[i+1].freq < e.freq) {
+		// last of the entries above i with a lower freq
+		for (lo = i+1, hi = dx.len-1; lo < hi;) {
+			mid = (lo + hi + 1) / 2;
+			if (dx.list[mid].freq < e.freq) lo = mid; else hi = mid - 1;
+		}
+		j = lo;
+		memmove(&dx.list[i], &dx.list[i+1], (j - i) * sizeof(dx_t));
+	} else {
+		return i;
+	}
+	
+	dx.list[j] = e;
+	return j;
+}
+
+static void dx_list_add(dx_t *dxp)
+{
+	dx.list = (dx_t *) kiwi_realloc("dx_list", dx.list, (dx.len + 1 + DX_HIDDEN_SLOT) * sizeof(dx_t));
+	dx.list[dx.len] = *dxp;
+	dx.len++;
+	memset(&dx.list[dx.len], 0, sizeof(dx_t));
+	dx_list_resort(dx.len-1);
+}
+
+static void dx_list_remove(int i)
+{
+	dx_free(&dx.list[i]);
+	memmove(&dx.list[i], &dx.list[i+1], (dx.len - i - 1) * sizeof(dx_t));
+	dx.len--;
+	memset(&dx.list[dx.len], 0, sizeof(dx_t));
+}
+
+// DX_UPD: modify entry gid, add a new entry (gid == -1) or delete entry gid (upd == NULL).
+// The strings of upd are taken over. The tag of a modified entry is kept.
+void dx_edit(int gid, dx_t *upd)
+{
+	if (gid == -1) {
+		dx_journal('+', upd);
+		dx_list_add(upd);
+	} else {
+		dx_t *dxp = &dx.list[gid];
+		dx_journal('-', dxp);
+		if (upd == NULL) {
+			dx_list_remove(gid);
+		} else {
+			upd->tag = dxp->tag;
+			dx_free(dxp);
+			*dxp = *upd;
+			dx_journal('+', dxp);
+			dx_list_resort(gid);
+		}
+	}
+
+	// list is still sorted
+	dx_prep_list(false, dx.list, dx.len, dx.len);
+	dx.json_up_to_date = false;
+}
+
+static bool dx_journal_append(const char *to_fn, const char *from_fn)
+{
+	char buf[4096];
+	int n, from_fd, to_fd;
+	bool ok;
+
+	if ((from_fd = open(from_fn, O_RDONLY)) < 0) return (errno == ENOENT);
+	ok = ((to_fd = open(to_fn, O_WRONLY | O_APPEND)) >= 0);
+	while (ok && (n = read(from_fd, buf, sizeof(buf))) > 0)
+		ok = (write(to_fd, buf, n) == n);
+	close(from_fd);
+	if (to_fd >= 0) close(to_fd);
+	return ok;
+}
+
+static void dx_compact_child(void *param)
+{
+	// the list as of the fork
+	if (!dx_write_json(dx.list, dx.len)) child_exit(EXIT_FAILURE);
+	unlink(dx_journal_prev_fn);     // its edits are in dx.json now
+}
+
+// rewrite dx.json from the list and remove the journal
+void dx_compact()
+{
+	struct stat st;
+
+	// Edits from here on go to a new journal. The current one is kept as the previous journal until
+	// dx.json has been written. If there is still one from a failed write, append to it instead.
+	if (dx_journal_fd >= 0) {
+		close(dx_journal_fd);
+		dx_journal_fd = -1;
+	}
+	if (stat(dx_journal_prev_fn, &st) == 0) {
+		if (dx_journal_append(dx_journal_prev_fn, dx_journal_fn))
+			unlink(dx_journal_fn);
+		else
+			lprintf("DX journal: appending %s to %s failed\n", dx_journal_fn, dx_journal_prev_fn);
+	} else {
+		rename(dx_journal_fn, dx_journal_prev_fn);
+	}
+
+	int journal_n = dx.journal_n;
+	dx.journal_n = 0;
+	TMEAS(u4_t start = timer_ms();)
+
+    // file writes can sometimes take a long time -- use a child task and wait via NextTask()
+	int status = child_task("kiwi.dx", dx_compact_child, POLL_MSEC(100));
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		lprintf("DX: writing %s failed, %d edits remain in %s\n", cfg_dx.filename, journal_n, dx_journal_prev_fn);
+		dx.journal_n += journal_n;      // try again later
+	}
+	TMEAS(printf("dx_compact: %d edits, %d entries %.3f sec\n", journal_n, dx.len, TIME_DIFF_MS(timer_ms(), start));)
+}
+
+static void dx_compact_task(void *param)
+{
+	while (1) {
+		TaskSleepSec(DX_COMPACT_POLL_SEC);
+		if (dx.journal_n == 0) continue;
+		if (dx.journal_n < DX_JOURNAL_MAX && (timer_sec() - dx.journal_time) < DX_COMPACT_IDLE_SEC) continue;
+		dx_compact();
+	}
+}
+
+static bool dx_str_same(const char *s1, const char *s2)
+{
+	return (strcmp(s1? s1:"", s2? s2:"") == 0);
+}
+
+// same entry as written to the journal: compares what dx.json has with the strings decoded
+static bool dx_same(dx_t *d1, dx_t *d2)
+{
+	char f1[16], f2[16];
+	snprintf(f1, sizeof(f1), "%.2f", d1->freq);
+	snprintf(f2, sizeof(f2), "%.2f", d2->freq);
+	if (strcmp(f1, f2) != 0) return false;
+	if ((d1->flags & (DX_MODE|DX_TYPE)) != (d2->flags & (DX_MODE|DX_TYPE))) return false;
+	if (d1->timestamp != d2->timestamp || d1->tag != d2->tag) return false;
+	if (d1->low_cut != d2->low_cut || d1->high_cut != d2->high_cut || d1->offset != d2->offset) return false;
+	if (!dx_str_same(d1->ident_s, d2->ident_s) || !dx_str_same(d1->notes_s, d2->notes_s)) return false;
+
+	char *p1 = kiwi_str_decode_inplace(d1->params? strdup(d1->params) : NULL);
+	char *p2 = kiwi_str_decode_inplace(d2->params? strdup(d2->params) : NULL);
+	bool same = dx_str_same(p1, p2);
+	free(p1); free(p2);
+	return same;
+}
+
+static int dx_list_find(dx_t *dxp)
+{
+	int lo = 0, hi = dx.len, mid;
+
+	// freq is only compared to 2 decimals
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (dx.list[mid].freq < dxp->freq - 0.01) lo = mid + 1; else hi = mid;
+	}
+	for (; lo < dx.len && dx.list[lo].freq <= dxp->freq + 0.01; lo++) {
+		if (dx_same(&dx.list[lo], dxp)) return lo;
+	}
+	return -1;
+}
+
+// Apply the edits in journals left from before a restart to the list just loaded from dx.json,
+// then write dx.json and remove them. Also rewrites dx.json if it was incomplete
+// so that the entries removed by a later edit are found in it.
+// The edits may already be in dx.json: a stop after dx.json was written (by dx_compact_child() or
+// below) but before the journal was removed. So an added entry that's already there isn't added
+// again, as a removed one that isn't there isn't removed. Replaying twice gives the same list,
+// except that an exact duplicate of an entry added by an edit is lost.
+static void dx_journal_replay(bool incomplete)
+{
+	const char *fn[2] = { dx_journal_prev_fn, dx_journal_fn };     // older edits first
+	char *json, *ops = NULL;
+	int i, f, nops = 0, size = 0, missing = 0, present = 0;
+	size_t json_len, json_size = 4096;
+
+	if (dx_journal_fd >= 0) {
+		close(dx_journal_fd);
+		dx_journal_fd = -1;
+	}
+
+	// a JSON array of the entries and their ops separately
+	json = (char *) malloc(json_size);
+	json_len = sprintf(json, "{\"dx\":[");
+	for (f = 0; f < 2; f++) {
+		FILE *fp = fopen(fn[f], "r");
+		if (fp == NULL) continue;
+		char *line = NULL;
+		size_t line_size = 0;
+		ssize_t n;
+		while ((n = getline(&line, &line_size, fp)) > 0) {
+			// an incomplete last line is an edit interrupted by a crash
+			if ((line[0] != '+' && line[0] != '-') || line[n-1] != '\n') continue;
+			if (nops == size) {
+				size = size? size*2 : 256;
+				ops = (char *) realloc(ops, size);
+			}
+			ops[nops++] = line[0];
+			if (json_len + n + 3 > json_size) {
+				json_size = (json_len + n + 3) * 2;
+				json = (char *) realloc(json, json_size);
+			}
+			if (nops > 1) json[json_len++] = ',';
+			memcpy(&json[json_len], &line[1], n-2);
+			json_len += n-2;
+		}
+		free(line);
+		fclose(fp);
+	}
+	strcpy(&json[json_len], "]}");
+
+	if (nops) {
+		cfg_t cfg;
+		int nent = 0;
+		dx_t *ent = NULL;
+		if (json_init(&cfg, json))
+			ent = dx_parse_json(&cfg, &nent, NULL);
+		if (nent == nops) {
+			for (i = 0; i < nops; i++) {
+				if (ops[i] == '+') {
+					if (dx_list_find(&ent[i]) >= 0) {
+						dx_free(&ent[i]);
+						present++;
+					} else
+						dx_list_add(&ent[i]);
+				} else {
+					int gid = dx_list_find(&ent[i]);
+					if (gid >= 0) dx_list_remove(gid); else missing++;
+					dx_free(&ent[i]);
+				}
+			}
+			dx_prep_list(false, dx.list, dx.len, dx.len);
+			dx.json_up_to_date = false;
+			lprintf("DX journal: replayed %d edits, %d entries to add already present, %d to remove not found\n",
+				nops, present, missing);
+		} else {
+			lprintf("DX journal: can't parse, ignored\n");
+		}
+		kiwi_free("dx_list", ent);
+		json_release(&cfg);
+	}
+	free(json);
+	free(ops);
+
+	if (nops || incomplete) {
+		if (dx_write_json(dx.list, dx.len)) {
+			unlink(dx_journal_prev_fn);
+			unlink(dx_journal_fn);
+			dx.journal_n = 0;
+		} else {
+			lprintf("DX: writing %s failed\n", cfg_dx.filename);
+		}
+	}
 }
 
 // reload requested, at startup or when file edited by hand
@@ -334,6 +717,13 @@ void dx_reload()
 	
 	//dxcfg_walk(NULL, cfg_print_tok, NULL);
 	TMEAS(u4_t split = timer_ms(); printf("DX_RELOAD json file read and json struct %.3f sec\n", TIME_DIFF_MS(split, start));)
-	dx_reload_json(cfg);
+	bool incomplete = dx_reload_json(cfg);
 	TMEAS(u4_t now = timer_ms(); printf("DX_RELOAD DONE json struct -> dx struct %.3f/%.3f sec\n", TIME_DIFF_MS(now, split), TIME_DIFF_MS(now, start));)
+
+	if (dx_journal_fn == NULL) {
+		asprintf(&dx_journal_fn, "%s.journal", cfg->filename);
+		asprintf(&dx_journal_prev_fn, "%s.journal.prev", cfg->filename);
+		CreateTask(dx_compact_task, 0, SERVICES_PRIORITY);
+	}
+	dx_journal_replay(incomplete);
 }
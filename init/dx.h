@@ -21,6 +21,8 @@ Boston, MA  02110-1301, USA.
 
 #include "types.h"
 
+#include <regex.h>
+
 // DX list
 
 #define DX_HIDDEN_SLOT 1
@@ -40,13 +42,26 @@ typedef struct {
 	int masked_lo, masked_hi;   // Hz
 } dx_t;
 
+// list entry in order of displayed frequency (carrier plus offset)
+typedef struct {
+	float freq;             // kHz
+	int idx;                // dx.list[] index
+} dx_key_t;
+
 typedef struct {
 	dx_t *list;
 	int len;                // malloc'd length is always len + DX_HIDDEN_SLOT
-	bool hidden_used;
-	bool json_up_to_date;
+	bool json_up_to_date;   // cfg_dx.json, see dx_json_update()
 	int *masked_idx;
 	int masked_len, masked_seq;
+
+	// index for the label (SET MKR) queries, rebuilt with the list
+	dx_key_t *keys;
+	int keys_len, keys_seq;
+
+	// edits journaled but not yet written to dx.json
+	int journal_n;
+	u4_t journal_time;
 } dxlist_t;
 
 extern dxlist_t dx;
@@ -64,5 +79,29 @@ extern dxlist_t dx;
 #define	DX_FLAG     0xff00
 
 void dx_reload();
-void dx_save_as_json();
+void dx_json_update();
+void dx_edit(int gid, dx_t *upd);
+void dx_compact();
 void dx_prep_list(bool need_sort, dx_t *_dx_list, int _dx_list_len, int _dx_list_len_new);
+
+// DX label filter of a connection (SET DX_FILTER)
+typedef struct {
+	char *ident, *notes;
+	int case_sens, wild, grep;
+	bool has_preg_ident, has_preg_notes;
+	int err_preg_ident, err_preg_notes;
+	regex_t preg_ident, preg_notes;
+
+	// filter result of each dx.keys[] entry, valid while seq == dx.keys_seq
+	u4_t *map;
+	int seq;
+} dx_filter_t;
+
+void dx_index_build(dx_t *_dx_list, int _dx_list_len);
+int dx_index_search(float freq);
+void dx_filter_compile(dx_filter_t *f);
+void dx_filter_free(dx_filter_t *f);
+bool dx_filter_match(dx_filter_t *f, dx_t *dp);
+
+typedef void (*dx_mkr_cb_t)(void *param, dx_t *dp, float freq);
+int dx_mkr(dx_filter_t *f, int type, int dir, float min, float max, int zoom, int width, dx_mkr_cb_t cb, void *param);
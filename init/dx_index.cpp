@@ -0,0 +1,248 @@
+/*
+--------------------------------------------------------------------------------
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+Boston, MA  02110-1301, USA.
+--------------------------------------------------------------------------------
+*/
+
+#include "types.h"
+#include "misc.h"
+#include "dx.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <regex.h>
+#include <fnmatch.h>
+
+// DX label queries (SET MKR)
+//
+// dx.keys[] is the list in order of displayed frequency (carrier plus offset). That is the order
+// the client lays out and steps through the labels, and it makes everything a query tests
+// monotonic in the key index: the upper bound of the visible area and the label x position.
+// So the start is a binary search, the label clutter reduction jumps over the labels too close to the
+// previous one with another binary search instead of visiting each, and the per-connection filter is
+// a bitmap over dx.keys[] computed once per filter or list change instead of a regexec()/fnmatch()/strstr()
+// of every label visited by every query.
+
+// DX_SEARCH_WINDOW: when zoomed far-in need to look at wider window since we don't know PB center here
+#define DX_SEARCH_WINDOW 10.0
+
+#define DX_SPACING_ZOOM_THRESHOLD	5
+#define DX_SPACING_THRESHOLD_PX		10
+
+static int dx_keycomp(const void *elem1, const void *elem2)
+{
+	const dx_key_t *k1 = (const dx_key_t *) elem1, *k2 = (const dx_key_t *) elem2;
+	if (k1->freq < k2->freq) return -1;
+	if (k1->freq > k2->freq) return 1;
+	return k1->idx - k2->idx;
+}
+
+// called by dx_prep_list() after the list is sorted and the dx_t.idx are set
+void dx_index_build(dx_t *_dx_list, int _dx_list_len)
+{
+	int i;
+	dx_t *dxp;
+
+	kiwi_free("dx_keys", dx.keys);
+	dx.keys = (dx_key_t *) kiwi_malloc("dx_keys", MAX(_dx_list_len, 1) * sizeof(dx_key_t));
+	for (i = 0, dxp = _dx_list; i < _dx_list_len; i++, dxp++) {
+		dx.keys[i].freq = dxp->freq + ((float) dxp->offset / 1000.0);		// carrier plus offset
+		dx.keys[i].idx = i;
+	}
+
+	// list is sorted by carrier, so only entries with an offset can be out of order here
+	qsort(dx.keys, _dx_list_len, sizeof(dx_key_t), dx_keycomp);
+	dx.keys_len = _dx_list_len;
+	dx.keys_seq++;
+}
+
+// last entry at or below freq, or the first if none
+int dx_index_search(float freq)
+{
+	int lo = 0, hi = dx.keys_len;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (dx.keys[mid].freq <= freq)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return MAX(lo - 1, 0);
+}
+
+// f->ident, notes, case_sens, wild and grep have just been set
+void dx_filter_compile(dx_filter_t *f)
+{
+	f->err_preg_ident = f->err_preg_notes = 0;
+
+	if (f->grep) {
+		int cflags = f->case_sens? REG_NOSUB : (REG_ICASE|REG_NOSUB);
+		if (f->has_preg_ident) { regfree(&f->preg_ident); f->has_preg_ident = false; }
+		if (f->has_preg_notes) { regfree(&f->preg_notes); f->has_preg_notes = false; }
+		if (f->ident && f->ident[0] != '\0') {
+			f->err_preg_ident = regcomp(&f->preg_ident, f->ident, cflags);
+			f->has_preg_ident = !f->err_preg_ident;
+			if (f->err_preg_ident) printf("regcomp ident %d\n", f->err_preg_ident);
+		}
+		if (f->notes && f->notes[0] != '\0') {
+			f->err_preg_notes = regcomp(&f->preg_notes, f->notes, cflags);
+			f->has_preg_notes = !f->err_preg_notes;
+			if (f->err_preg_notes) printf("regcomp notes %d\n", f->err_preg_notes);
+		}
+	}
+
+	// recomputed by the next query
+	kiwi_free("dx_filter_map", f->map); f->map = NULL;
+}
+
+void dx_filter_free(dx_filter_t *f)
+{
+	free(f->ident); f->ident = NULL;
+	free(f->notes); f->notes = NULL;
+	if (f->has_preg_ident) { regfree(&f->preg_ident); f->has_preg_ident = false; }
+	if (f->has_preg_notes) { regfree(&f->preg_notes); f->has_preg_notes = false; }
+	kiwi_free("dx_filter_map", f->map); f->map = NULL;
+}
+
+bool dx_filter_match(dx_filter_t *f, dx_t *dp)
+{
+	if (!f->ident && !f->notes) return true;
+
+	if (f->grep) {
+		if (f->has_preg_ident && regexec(&f->preg_ident, dp->ident_s, 0, NULL, 0) == REG_NOMATCH) return false;
+		if (f->has_preg_notes && regexec(&f->preg_notes, dp->notes_s, 0, NULL, 0) == REG_NOMATCH) return false;
+	} else
+	if (f->wild) {
+		int fn_flags = f->case_sens? 0 : FNM_CASEFOLD;
+		if (fnmatch(f->ident, dp->ident_s, fn_flags) != 0) return false;
+		if (f->notes && f->notes[0] != '\0' && fnmatch(f->notes, dp->notes_s, fn_flags) != 0) return false;
+	} else {
+		if (f->case_sens) {
+			if (strstr(dp->ident_s, f->ident) == NULL) return false;
+			if (f->notes && strstr(dp->notes_s, f->notes) == NULL) return false;
+		} else {
+			if (strcasestr(dp->ident_s, f->ident) == NULL) return false;
+			if (f->notes && strcasestr(dp->notes_s, f->notes) == NULL) return false;
+		}
+	}
+	return true;
+}
+
+static void dx_filter_map(dx_filter_t *f)
+{
+	if (f->map != NULL && f->seq == dx.keys_seq) return;
+
+	int k, words = (dx.keys_len + 31) / 32;
+	kiwi_free("dx_filter_map", f->map);
+	f->map = (u4_t *) kiwi_malloc("dx_filter_map", MAX(words, 1) * sizeof(u4_t));
+	for (k = 0; k < dx.keys_len; k++) {
+		if (dx_filter_match(f, &dx.list[dx.keys[k].idx]))
+			f->map[k >> 5] |= 1U << (k & 31);
+	}
+	f->seq = dx.keys_seq;
+}
+
+// first entry from k on in direction dir that passes the filter, -1 or dx.keys_len if none
+static int dx_filter_next(dx_filter_t *f, int k, int dir)
+{
+	u4_t w;
+
+	if (dir > 0) {
+		while (k < dx.keys_len) {
+			if ((w = f->map[k >> 5] >> (k & 31)) != 0) return k + __builtin_ctz(w);
+			k = (k | 31) + 1;
+		}
+		return dx.keys_len;
+	}
+
+	while (k >= 0) {
+		if ((w = f->map[k >> 5] << (31 - (k & 31))) != 0) return k - __builtin_clz(w);
+		k = (k & ~31) - 1;
+	}
+	return -1;
+}
+
+static inline int dx_mkr_x(float freq, float min, float bw, int width)
+{
+	return ((freq - min) / bw) * width;
+}
+
+// first entry after k with a label x position of at least x_min
+static int dx_mkr_skip(int k, float min, float bw, int width, int x_min)
+{
+	int lo = k + 1, hi = dx.keys_len;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (dx_mkr_x(dx.keys[mid].freq, min, bw, width) < x_min)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// Called in two different ways:
+// type 4: the labels in the visible area defined by min/max (kHz) for a waterfall width (px) at zoom.
+// type 2: the next label above or below (dir) freq = min when label stepping.
+// The filter applies in both cases. Calls cb for each label and returns how many.
+int dx_mkr(dx_filter_t *f, int type, int dir, float min, float max, int zoom, int width, dx_mkr_cb_t cb, void *param)
+{
+	static bool first = true;
+	int lastx = 0, send = 0;
+	float bw = max - min;
+	bool filter = (f->ident || f->notes);
+	bool spacing = (type == 4 && zoom <= DX_SPACING_ZOOM_THRESHOLD);
+	bool skip = (spacing && bw > 0 && width > 0);
+
+	if (dx.keys_len == 0) return 0;
+	if (filter) dx_filter_map(f);
+
+	int k = dx_index_search(min + ((type == 2 && dir == 1)? DX_SEARCH_WINDOW : -DX_SEARCH_WINDOW));
+
+	while (k >= 0 && k < dx.keys_len) {
+		if (filter) {
+			k = dx_filter_next(f, k, dir);
+			if (k < 0 || k >= dx.keys_len) break;
+		}
+
+		float freq = dx.keys[k].freq;
+		if (type == 4 && freq > max + DX_SEARCH_WINDOW) break;    // get extra one above for label stepping
+
+		// reduce dx label clutter
+		if (spacing) {
+			int x = dx_mkr_x(freq, min, bw, width);
+			if (!first && x - lastx < DX_SPACING_THRESHOLD_PX) {
+				k = skip? dx_mkr_skip(k, min, bw, width, lastx + DX_SPACING_THRESHOLD_PX) : (k + 1);
+				continue;
+			}
+			lastx = x;
+			first = false;
+		}
+
+		dx_t *dp = &dx.list[dx.keys[k].idx];
+		if (type == 4 || freq != min) {
+			cb(param, dp, freq);
+			send++;
+		}
+
+		// return the very first we hit that passed the filtering criteria above
+		if (type == 2 && send) break;
+		k += dir;
+	}
+
+	return send;
+}
@@ -101,6 +101,7 @@ void c2s_sound_init();
 void c2s_sound_setup(void *param);
 void c2s_sound(void *param);
 void c2s_sound_shutdown(void *param);
+void c2s_sound_stats();
 
 void c2s_waterfall_init();
 void c2s_waterfall_compression(int rx_chan, bool compression);
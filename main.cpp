@@ -37,6 +37,7 @@ Boston, MA  02110-1301, USA.
 #include "ext_int.h"
 #include "sanitizer.h"
 #include "shmem.h"
+#include "fft_plan.h"
 
 #include "debug.h"
 
@@ -79,7 +80,7 @@ char *fpga_file;
 int main(int argc, char *argv[])
 {
 	int i;
-	int p_gps=0;
+	int p_gps=0, fftw_rigor=1;
 	bool ext_clk = false;
 	
 	version_maj = VERSION_MAJ;
@@ -154,6 +155,7 @@ int main(int argc, char *argv[])
 		if (strcmp(argv[i], "-eeprom")==0) create_eeprom = true;
 		if (strcmp(argv[i], "-cmap")==0) color_map = 1;
 		if (strcmp(argv[i], "-sim")==0) wf_sim = 1;
+		if (strcmp(argv[i], "-replay")==0) { i++; spi_replay = argv[i]; }
 		if (strcmp(argv[i], "-real")==0) wf_real = 1;
 		if (strcmp(argv[i], "-time")==0) wf_time = 1;
 		if (strcmp(argv[i], "-port")==0) { i++; alt_port = strtol(argv[i], 0, 0); }
@@ -199,6 +201,7 @@ int main(int argc, char *argv[])
 		if (strcmp(argv[i], "-p0")==0) { i++; p0 = strtol(argv[i], 0, 0); }
 		if (strcmp(argv[i], "-p1")==0) { i++; p1 = strtol(argv[i], 0, 0); }
 		if (strcmp(argv[i], "-p2")==0) { i++; p2 = strtol(argv[i], 0, 0); }
+		if (strcmp(argv[i], "-fftw_rigor")==0) { i++; fftw_rigor = strtol(argv[i], 0, 0); }
 
 		i++;
 		while (i<argc && ((argv[i][0] != '+') && (argv[i][0] != '-'))) {
@@ -246,6 +249,10 @@ int main(int argc, char *argv[])
     cfg_reload();
     clock_init();
 
+    // 0 = estimate, 1 = measure, 2 = patient, 3 = exhaustive
+    static const u4_t fftw_rigors[] = { FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT, FFTW_EXHAUSTIVE };
+    fft_plan_init(fftw_rigors[CLAMP(fftw_rigor, 0, ARRAY_LEN(fftw_rigors)-1)], &shmem->fft_plan_shmem);
+
     bool err;
     fw_sel = admcfg_int("firmware_sel", &err, CFG_OPTIONAL);
     if (err) fw_sel = FW_SEL_SDR_RX4_WF4;
@@ -328,11 +335,15 @@ int main(int argc, char *argv[])
     if (p_gps != 0) do_gps = (p_gps == 1)? 1:0;
     
 	if (down) do_sdr = do_gps = 0;
+	if (spi_replay) do_gps = 0;     // no GPS front end to replay
 	need_hardware = (do_gps || do_sdr);
 
 	// called early, in case another server already running so we can detect the busy socket and bail
 	web_server_init(WS_INIT_CREATE);
 
+	if (need_hardware && spi_replay) {
+	    spi_dev_init(spi_clkg, spi_speed);
+	} else
 	if (need_hardware) {
 		peri_init();
 		fpga_init();
@@ -2,6 +2,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "types.h"
 #include "config.h"
@@ -40,33 +41,138 @@
 	static lock_t nbuf_lock;
 	#define NNBUF 1024
 	static nbuf_t nbuf[NNBUF];
+	static nbuf_t *nbuf_free_list;
+	static int nbuf_busy, nbuf_hiwat;
 #endif
 
+// Payload buffers are kept on per-size-class free lists instead of being malloc'd and freed
+// for every packet. Blocks are only ever malloc'd when a class runs dry, so the pool grows to
+// the working set and stays there. Oversize requests are malloc'd/freed individually.
+// The refcnt lets the same payload sit on several connection queues at once.
+// Like nbuf_t there is no lock: the pool must only be used by the tasks (coroutines) of the
+// main thread, never from a MULTI_CORE worker or DRM thread. NBUF_POOL_THREAD_CHECK asserts that.
+
+static pthread_t nbuf_thread;
+#define NBUF_POOL_THREAD_CHECK() assert(pthread_equal(pthread_self(), nbuf_thread))
+
+#define NBUF_BUF_MAGIC	0xbabefeed
+
+typedef struct nbuf_buf_st {
+	u4_t magic;
+	int refcnt;
+	int sclass;
+	struct nbuf_buf_st *next_free;
+} __attribute__((aligned(8))) nbuf_buf_t;
+
+#define NBUF_BUF_HDR(buf)	(((nbuf_buf_t *) (buf)) - 1)
+
+static const int nbuf_sclass_size[] = { 128, 512, 2048, 8192 };
+#define NBUF_NSCLASS ARRAY_LEN(nbuf_sclass_size)
+
+static struct {
+	nbuf_buf_t *free_list;
+	int blocks, busy, hiwat;
+	u4_t allocs;
+} nbuf_pool[NBUF_NSCLASS];
+
+static int nbuf_oversize_busy;
+static u4_t nbuf_oversize_allocs;
+
 void nbuf_init()
 {
+	nbuf_thread = pthread_self();
 #ifdef NBUF_STATIC_ALLOC
 	lock_init(&nbuf_lock);
 	lock_register(&nbuf_lock);
 	memset(nbuf, 0, sizeof(nbuf));
 	int i;
-	for (i=0; i<NNBUF; i++) {
+	nbuf_free_list = NULL;
+	for (i=NNBUF-1; i >= 0; i--) {
 		nbuf_t *nb = &nbuf[i];
 		nb->isFree = TRUE;
+		nb->next_free = nbuf_free_list;
+		nbuf_free_list = nb;
 	}
 #endif
 }
 
 void nbuf_stat()
 {
-//#ifdef NBUF_STATIC_ALLOC
-#if 0
-	int i, busy = 0;
-	for (i=0; i<NNBUF; i++) {
-		nbuf_t *nb = &nbuf[i];
-		if (!nb->isFree) busy++;
-	}
-	printf("NBUF %d/%d busy\n", busy, NNBUF);
+	if (!(print_stats & STATS_TASK)) return;
+
+#ifdef NBUF_STATIC_ALLOC
+	printf("NBUF %d/%d busy, hiwat %d\n", nbuf_busy, NNBUF, nbuf_hiwat);
 #endif
+	for (int i=0; i < NBUF_NSCLASS; i++) {
+		printf("NBUF pool %5d: %3d/%3d busy, hiwat %3d, allocs %d\n", nbuf_sclass_size[i],
+			nbuf_pool[i].busy, nbuf_pool[i].blocks, nbuf_pool[i].hiwat, nbuf_pool[i].allocs);
+		nbuf_pool[i].allocs = 0;
+	}
+	printf("NBUF pool   big: %3d busy, allocs %d\n", nbuf_oversize_busy, nbuf_oversize_allocs);
+	nbuf_oversize_allocs = 0;
+}
+
+char *nbuf_buf_alloc(int size)
+{
+	nbuf_buf_t *bp;
+	int sc;
+	
+	NBUF_POOL_THREAD_CHECK();
+	
+	// +1 so buffers which are strings can be null terminated after the fact
+	for (sc=0; sc < NBUF_NSCLASS && (size+1) > nbuf_sclass_size[sc]; sc++)
+		;
+	
+	if (sc == NBUF_NSCLASS) {
+		bp = (nbuf_buf_t *) kiwi_malloc("nbuf:buf", sizeof(nbuf_buf_t) + size+1);
+		sc = -1;
+		nbuf_oversize_busy++;
+		nbuf_oversize_allocs++;
+	} else {
+		if ((bp = nbuf_pool[sc].free_list) != NULL) {
+			assert(bp->magic == NBUF_BUF_MAGIC && bp->refcnt == 0);
+			nbuf_pool[sc].free_list = bp->next_free;
+		} else {
+			bp = (nbuf_buf_t *) kiwi_malloc("nbuf:pool", sizeof(nbuf_buf_t) + nbuf_sclass_size[sc]);
+			nbuf_pool[sc].blocks++;
+		}
+		nbuf_pool[sc].busy++;
+		if (nbuf_pool[sc].busy > nbuf_pool[sc].hiwat) nbuf_pool[sc].hiwat = nbuf_pool[sc].busy;
+		nbuf_pool[sc].allocs++;
+	}
+	
+	bp->magic = NBUF_BUF_MAGIC;
+	bp->refcnt = 1;
+	bp->sclass = sc;
+	bp->next_free = NULL;
+	return (char *) (bp + 1);
+}
+
+void nbuf_buf_ref(char *buf)
+{
+	nbuf_buf_t *bp = NBUF_BUF_HDR(buf);
+	NBUF_POOL_THREAD_CHECK();
+	assert(bp->magic == NBUF_BUF_MAGIC && bp->refcnt > 0);
+	bp->refcnt++;
+}
+
+void nbuf_buf_unref(char *buf)
+{
+	nbuf_buf_t *bp = NBUF_BUF_HDR(buf);
+	NBUF_POOL_THREAD_CHECK();
+	assert(bp->magic == NBUF_BUF_MAGIC && bp->refcnt > 0);
+	if (--bp->refcnt) return;
+	
+	int sc = bp->sclass;
+	if (sc < 0) {
+		bp->magic = 0;
+		kiwi_free("nbuf:buf", bp);
+		nbuf_oversize_busy--;
+	} else {
+		bp->next_free = nbuf_pool[sc].free_list;
+		nbuf_pool[sc].free_list = bp;
+		nbuf_pool[sc].busy--;
+	}
 }
 
 void ndesc_init(ndesc_t *nd, struct mg_connection *mc)
@@ -90,13 +196,12 @@ static nbuf_t *nbuf_malloc()
 #ifdef NBUF_STATIC_ALLOC
 	// FIXME: don't need a lock here because there is no task preemption to cause contention
 	lock_enter(&nbuf_lock);
-		int i;
-		for (i=0; i<NNBUF; i++) {
-			nb = &nbuf[i];
-			if (nb->isFree)
-				break;
-		}
-		if (i == NNBUF) panic("out of nbufs");
+		nb = nbuf_free_list;
+		if (nb == NULL) panic("out of nbufs");
+		assert(nb->isFree);
+		nbuf_free_list = nb->next_free;
+		nbuf_busy++;
+		if (nbuf_busy > nbuf_hiwat) nbuf_hiwat = nbuf_busy;
 	lock_leave(&nbuf_lock);
 #else
 	nb = (nbuf_t*) kiwi_malloc("nbuf", sizeof(nbuf_t));
@@ -115,6 +220,10 @@ static void nbuf_free(nbuf_t *nb)
 	nb->magic = nb->magic_b = nb->magic_e = 0;
 	nb->isFree = TRUE;
 #ifdef NBUF_STATIC_ALLOC
+	// no nbuf_lock: called from nbuf_enqueue() holding nd->lock and a task can only hold one lock
+	nb->next_free = nbuf_free_list;
+	nbuf_free_list = nb;
+	nbuf_busy--;
 #else
 	kiwi_free("nbuf", nb);
 #endif
@@ -166,7 +275,7 @@ static bool nbuf_enqueue(ndesc_t *nd, nbuf_t *nb)
 			if (nd->dbug) printf("R%d ", dp->id);
 			if (nd->dbug) nbuf_dumpq(nd);
 			assert(dp->buf);
-			kiwi_free("nbuf:buf", dp->buf);
+			nbuf_buf_unref(dp->buf);
 			*q_head = dp->prev;
 			if (*q == dp) {
 				*q = NULL;
@@ -203,26 +312,26 @@ static bool nbuf_enqueue(ndesc_t *nd, nbuf_t *nb)
 	return ovfl;
 }
 
-void nbuf_allocq(ndesc_t *nd, char *s, int sl)
+// queue a reference to a payload from nbuf_buf_alloc()
+void nbuf_allocq_buf(ndesc_t *nd, char *buf, int len)
 {
 	check_ndesc(nd);
 	nbuf_t *nb;
 	bool ovfl;
 	static int id;
 	
-	assert(s != NULL);
-	assert(sl > 0);
+	assert(buf != NULL);
+	assert(len > 0);
 	nb = nbuf_malloc();
 	//assert(nd->mc);
 	nb->mc = nd->mc;
-	// +1 so buffers which are strings can be null terminated after the fact
-	// but don't reflect this extra byte in the nb->len count
-	nb->buf = (char*) kiwi_malloc("nbuf:buf", sl+1);
-    memcpy(nb->buf, s, sl);
-	nb->len = sl;
+	nbuf_buf_ref(buf);
+	nb->buf = buf;
+	nb->len = len;
 	nb->done = FALSE;
 	nb->dequeued = FALSE;
 	nb->ttl = nd->ttl;
+	nb->enq_us = timer_us();
 	if (nd->dbug) nb->id = id++;
 	ovfl = nbuf_enqueue(nd, nb);
 	if (nd->dbug) printf("A%d ", nb->id);
@@ -230,11 +339,23 @@ void nbuf_allocq(ndesc_t *nd, char *s, int sl)
 	
 	check_nbuf(nb);
 	if (ovfl) {
-		kiwi_free("nbuf:buf", nb->buf);
+		nbuf_buf_unref(nb->buf);
 		nbuf_free(nb);
 	}
 }
 
+void nbuf_allocq(ndesc_t *nd, char *s, int sl)
+{
+	assert(s != NULL);
+	assert(sl > 0);
+	// nbuf_buf_alloc() adds +1 so buffers which are strings can be null terminated after the fact
+	// but don't reflect this extra byte in the nb->len count
+	char *buf = nbuf_buf_alloc(sl);
+    memcpy(buf, s, sl);
+	nbuf_allocq_buf(nd, buf, sl);
+	nbuf_buf_unref(buf);
+}
+
 nbuf_t *nbuf_dequeue(ndesc_t *nd)
 {
 	check_ndesc(nd);
@@ -300,7 +421,7 @@ void nbuf_cleanup(ndesc_t *nd)
 			if (dp->buf == 0)
 				lprintf("WARNING: dp->buf == NULL\n");
 			else
-			kiwi_free("nbuf:buf", dp->buf);
+			nbuf_buf_unref(dp->buf);
 
 			*q_head = dp->prev;
 			if (dp == *q) *q = NULL;
@@ -15,8 +15,10 @@ typedef struct nbuf_st {
 	char *buf;
 	u2_t len, ttl, id;
 	bool done, expecting_done, dequeued, isFree;
+	u4_t enq_us;		// timer_us() when queued, for web_server() latency histogram
 	u4_t magic_b;
 	struct nbuf_st *next, *prev;
+	struct nbuf_st *next_free;
 	u4_t magic_e;
 } nbuf_t;
 
@@ -42,6 +44,15 @@ void ndesc_register(ndesc_t *nd);
 void nbuf_init();
 void nbuf_stat();
 void nbuf_allocq(ndesc_t *nd, char *s, int sl);
+
+// Pooled, reference counted payload buffers.
+// A producer can build a packet directly into a payload and queue it on any number of
+// connections with nbuf_allocq_buf() without copying. Release the producer's reference
+// with nbuf_buf_unref() when done. Only for use by tasks of the main thread (no lock).
+char *nbuf_buf_alloc(int size);
+void nbuf_buf_ref(char *buf);
+void nbuf_buf_unref(char *buf);
+void nbuf_allocq_buf(ndesc_t *nd, char *buf, int len);
 nbuf_t *nbuf_dequeue(ndesc_t *nd);
 int nbuf_queued(ndesc_t *nd);
 void nbuf_cleanup(ndesc_t *nd);
@@ -120,25 +120,25 @@ static void get_TZ(void *param)
 		kstr_free(reply);
 		err = false;
 		s = (char *) json_string(&cfg_tz, "status", &err, CFG_OPTIONAL);
-		if (err) goto retry;
+		if (err) goto release_retry;
 		if (strcmp(s, "OK") != 0) {
 			lprintf("TIMEZONE: %s returned status \"%s\"\n", TZ_SERVER, s);
 			err = true;
 		}
 	    json_string_free(&cfg_tz, s);
-		if (err) goto retry;
+		if (err) goto release_retry;
 		
 		#ifdef TIMEZONE_DB_COM
             utc_offset = json_int(&cfg_tz, "gmtOffset", &err, CFG_OPTIONAL);
-            if (err) goto retry;
+            if (err) goto release_retry;
             dst_offset = 0;     // gmtOffset includes dst offset
             tzone_id = (char *) json_string(&cfg_tz, "abbreviation", NULL, CFG_OPTIONAL);
             tzone_name = (char *) json_string(&cfg_tz, "zoneName", NULL, CFG_OPTIONAL);
         #else
             utc_offset = json_int(&cfg_tz, "rawOffset", &err, CFG_OPTIONAL);
-            if (err) goto retry;
+            if (err) goto release_retry;
             dst_offset = json_int(&cfg_tz, "dstOffset", &err, CFG_OPTIONAL);
-            if (err) goto retry;
+            if (err) goto release_retry;
             tzone_id = (char *) json_string(&cfg_tz, "timeZoneId", NULL, CFG_OPTIONAL);
             tzone_name = (char *) json_string(&cfg_tz, "timeZoneName", NULL, CFG_OPTIONAL);
         #endif
@@ -151,6 +151,8 @@ static void get_TZ(void *param)
 		
 	    json_release(&cfg_tz);
 		return;
+release_retry:
+	    json_release(&cfg_tz);
 retry:
 		if (report) lprintf("TIMEZONE: will retry..\n");
 		if (report) report--;
@@ -313,6 +313,7 @@ void schedule_update(int min)
 		
 		if (update) {
 		    printf("TLIMIT-IP 24hr cache cleared\n");
+            json_release(&cfg_ipl);
             json_init(&cfg_ipl, (char *) "{}");     // clear 24hr ip address connect time limit cache
         }
 	}
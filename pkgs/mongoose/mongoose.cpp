@@ -2584,50 +2584,71 @@ static int deliver_websocket_frame(struct connection *conn) {
 
 int mg_websocket_write(struct mg_connection* conn, int opcode,
                        const char *data, size_t data_len) {
-    unsigned char *copy;
-    size_t copy_len = 0;
-    int retval = -1;
+    struct mg_ws_frame frame = { data, data_len };
+    int retval = mg_websocket_write_frames(conn, opcode, &frame, 1);
 
-    if ((copy = (unsigned char *) malloc(data_len + 10)) == NULL) {
-      return -1;
+    // If we send closing frame, schedule a connection to be closed after
+    // data is drained to the client.
+    if (opcode == 0x08) {
+        MG_CONN_2_CONN(conn)->ns_conn->flags |= NSF_FINISHED_SENDING_DATA;
     }
 
-    copy[0] = 0x80 + (opcode & 0x0f);
-
-    // Frame format: http://tools.ietf.org/html/rfc6455#section-5.2
-    if (data_len < 126) {
-      // Inline 7-bit length field
-      copy[1] = data_len;
-      memcpy(copy + 2, data, data_len);
-      copy_len = 2 + data_len;
-    } else if (data_len <= 0xFFFF) {
-      // 16-bit length field
-      copy[1] = 126;
-      * (uint16_t *) (copy + 2) = (uint16_t) htons((uint16_t) data_len);
-      memcpy(copy + 4, data, data_len);
-      copy_len = 4 + data_len;
-    } else {
-      // 64-bit length field
-      copy[1] = 127;
-      * (uint32_t *) (copy + 2) = (uint32_t)
-        htonl((uint32_t) ((uint64_t) data_len >> 32));
-      * (uint32_t *) (copy + 6) = (uint32_t) htonl(data_len & 0xffffffff);
-      memcpy(copy + 10, data, data_len);
-      copy_len = 10 + data_len;
+    return retval;
+}
+
+static size_t websocket_frame_header(unsigned char *hdr, int opcode, size_t data_len) {
+  hdr[0] = 0x80 + (opcode & 0x0f);
+
+  // Frame format: http://tools.ietf.org/html/rfc6455#section-5.2
+  if (data_len < 126) {
+    hdr[1] = data_len;
+    return 2;
+  } else if (data_len <= 0xFFFF) {
+    // hdr is wherever the frame lands in the send iobuf, so no aligned stores
+    uint16_t len16 = htons((uint16_t) data_len);
+    hdr[1] = 126;
+    memcpy(hdr + 2, &len16, sizeof(len16));
+    return 4;
+  } else {
+    uint32_t len32[2];
+    len32[0] = htonl((uint32_t) ((uint64_t) data_len >> 32));
+    len32[1] = htonl(data_len & 0xffffffff);
+    hdr[1] = 127;
+    memcpy(hdr + 2, len32, sizeof(len32));
+    return 10;
+  }
+}
+
+int mg_websocket_write_frames(struct mg_connection* conn, int opcode,
+                              const struct mg_ws_frame *frames, int nframes) {
+    struct iobuf *io = &MG_CONN_2_CONN(conn)->ns_conn->send_iobuf;
+    size_t total = 0;
+    int i;
+
+    for (i = 0; i < nframes; i++) {
+      total += 10 + frames[i].len;    // worst case header
     }
 
-    if (copy_len > 0) {
-      retval = mg_write(conn, copy, copy_len);
+    // grow once for the whole batch
+    if (io->len + (int) total > io->size) {
+      int new_size = (int) ((io->len + total) * IOBUF_RESIZE_MULTIPLIER);
+      char *p = (char *) NS_REALLOC(io->buf, new_size);
+      if (p == NULL) return -1;
+      io->buf = p;
+      io->size = new_size;
     }
-    free(copy);
 
-    // If we send closing frame, schedule a connection to be closed after
-    // data is drained to the client.
-    if (opcode == 0x08) {
-        MG_CONN_2_CONN(conn)->ns_conn->flags |= NSF_FINISHED_SENDING_DATA;
+    total = 0;
+    for (i = 0; i < nframes; i++) {
+      unsigned char *dst = (unsigned char *) io->buf + io->len;
+      size_t hdr_len = websocket_frame_header(dst, opcode, frames[i].len);
+      memcpy(dst + hdr_len, frames[i].data, frames[i].len);
+      io->len += hdr_len + frames[i].len;
+      total += hdr_len + frames[i].len;
     }
+    conn->ws_frames += nframes;
 
-    return retval;
+    return (int) total;
 }
 
 static void send_websocket_handshake_if_requested(struct mg_connection *conn) {
@@ -4880,6 +4901,7 @@ static void mg_ev_handler(struct ns_connection *nc, enum ns_event ev, void *p) {
       break;
 
     case NS_SEND:
+      if (conn != NULL) conn->mg_conn.sock_sends++;
       break;
 
     case NS_CLOSE:
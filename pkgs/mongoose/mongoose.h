@@ -69,6 +69,9 @@ struct mg_connection {
   } cache_info;
 
   void *connection_param;     // Placeholder for connection-specific data
+
+  unsigned ws_frames;         // websocket frames queued for sending
+  unsigned sock_sends;        // send() calls made draining them
 };
 
 struct mg_server; // Opaque structure describing server instance
@@ -110,6 +113,15 @@ void mg_printf_data(struct mg_connection *, const char *format, ...);
 int mg_websocket_write(struct mg_connection *, int opcode,
                        const char *data, size_t data_len);
 
+// Queue several frames with a single resize and copy into the send buffer.
+// They go out together in the next socket write.
+struct mg_ws_frame {
+  const char *data;
+  size_t len;
+};
+int mg_websocket_write_frames(struct mg_connection *, int opcode,
+                              const struct mg_ws_frame *frames, int nframes);
+
 // Deprecated in favor of mg_send_* interface
 int mg_write(struct mg_connection *, const void *buf, int len);
 int mg_printf(struct mg_connection *conn, const char *fmt, ...);
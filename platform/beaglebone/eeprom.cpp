@@ -24,6 +24,7 @@ Boston, MA  02110-1301, USA.
 #include "str.h"
 #include "peri.h"
 #include "spi.h"
+#include "spi_dev.h"
 #include "coroutines.h"
 #include "eeprom.h"
 
@@ -182,6 +183,12 @@ void eeprom_write(next_serno_e type, int serno)
 	const char *fn;
 	FILE *fp;
 	
+	// the write protect is an FPGA ctrl bit, which -replay doesn't have
+	if (spi_replay) {
+		mlprintf("EEPROM write: not with -replay\n");
+		return;
+	}
+
 	eeprom_t *e = &eeprom;
 	memset(e, 0, sizeof(eeprom_t));		// v1.1 fix: zero unused e->io_pins
 
@@ -28,6 +28,7 @@
 #include "coroutines.h"
 #include "debug.h"
 #include "shmem.h"
+#include "timer.h"
 
 #include <stdio.h>
 #include <unistd.h>
@@ -82,11 +83,42 @@ void spi_stats()
         printf("\n");
         spi.xfers = spi.flush = spi.bytes = 0;
     #endif
+
+    // commands per second and the time from request to valid reply, including the wait for the spi_pump()
+    static u4_t last_ms;
+    u4_t now = timer_ms();
+    float secs = (float) (now - last_ms) / 1e3;
+    last_ms = now;
+    bool show = ((print_stats & STATS_TASK) && secs > 0);
+
+    if (show) {
+        u4_t total = 0;
+        for (int i = 0; i < CmdCheckLast; i++) total += spi.cmd_count[i];
+        lprintf("SPI: %.0f cmds/s\n", total / secs);
+    }
+
+    // reset every interval, also when not shown, so turning the stats on gives the rate since the last interval
+    for (int i = 0; i < CmdCheckLast; i++) {
+        u4_t n = spi.cmd_count[i];
+        if (show && n)
+            lprintf("SPI: %-20s %7.1f/s avg %6.0f max %6d us\n", cmds[i], n / secs, (float) spi.cmd_us[i] / n, spi.cmd_max_us[i]);
+        spi.cmd_count[i] = spi.cmd_us[i] = spi.cmd_max_us[i] = 0;
+    }
+}
+
+static void spi_cmd_stat(SPI_CMD cmd, u4_t start_us)
+{
+    if (cmd >= CmdCheckLast) return;    // pseudo
+    u4_t us = timer_us() - start_us;
+    spi.cmd_count[cmd]++;
+    spi.cmd_us[cmd] += us;
+    if (us > spi.cmd_max_us[cmd]) spi.cmd_max_us[cmd] = us;
 }
 
 static int wait_avail(const char *where, SPI_CMD cmd)
 {
     int wait = 0;
+    if (spi_replay) return 0;
     
 	for (int max = 0; !GPIO_READ_BIT(CMD_READY) && max < 1000; max++) {
 	    wait++;
@@ -348,6 +380,7 @@ void spi_stack_check(int wait, SPI_MOSI *tx)
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 void _spi_set(SPI_CMD cmd, uint16_t wparam, uint32_t lparam) {
+    u4_t start_us = timer_us();
     lock_enter(&spi_lock);
         int wait = wait_avail("_spi_set", cmd);
 		SPI_MOSI *tx = &SPI_SHMEM->spi_tx[0];
@@ -358,9 +391,11 @@ void _spi_set(SPI_CMD cmd, uint16_t wparam, uint32_t lparam) {
 		evSpiCmd(EC_EVENT, EV_SPILOOP, -1, "spi_set", "DONE");
     lock_leave(&spi_lock);
     spi_check_wakeup(cmd);		// must be done outside the lock
+    spi_cmd_stat(cmd, start_us);
 }
 
 void spi_set3(SPI_CMD cmd, uint16_t wparam, uint32_t lparam, uint16_t w2param) {
+    u4_t start_us = timer_us();
     lock_enter(&spi_lock);
         int wait = wait_avail("spi_set3", cmd);
 		SPI_MOSI *tx = &SPI_SHMEM->spi_tx[1];
@@ -372,9 +407,11 @@ void spi_set3(SPI_CMD cmd, uint16_t wparam, uint32_t lparam, uint16_t w2param) {
 		evSpiCmd(EC_EVENT, EV_SPILOOP, -1, "spi_set", "DONE");
     lock_leave(&spi_lock);
     spi_check_wakeup(cmd);		// must be done outside the lock
+    spi_cmd_stat(cmd, start_us);
 }
 
 void spi_set_noduplex(SPI_CMD cmd, uint16_t wparam, uint32_t lparam) {
+    u4_t start_us = timer_us();
 	lock_enter(&spi_lock);		// block other threads
         int wait = wait_avail("spi_set_noduplex", cmd);
 		SPI_MOSI *tx = &SPI_SHMEM->spi_tx[2];
@@ -394,9 +431,11 @@ void spi_set_noduplex(SPI_CMD cmd, uint16_t wparam, uint32_t lparam) {
 		evSpiCmd(EC_EVENT, EV_SPILOOP, -1, "spi_setND", "DONE");
     lock_leave(&spi_lock);		// release block
     spi_check_wakeup(cmd);		// must be done outside the lock
+    spi_cmd_stat(cmd, start_us);
 }
 
 void spi_set_buf_noduplex(SPI_CMD cmd, SPI_MOSI *tx, int bytes) {
+    u4_t start_us = timer_us();
 	lock_enter(&spi_lock);		// block other threads
         int wait = wait_avail("spi_set_buf_noduplex", cmd);
 		tx->data.cmd = cmd;
@@ -408,11 +447,13 @@ void spi_set_buf_noduplex(SPI_CMD cmd, SPI_MOSI *tx, int bytes) {
 
     lock_leave(&spi_lock);		// release block
     spi_check_wakeup(cmd);		// must be done outside the lock
+    spi_cmd_stat(cmd, start_us);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 void _spi_get(SPI_CMD cmd, SPI_MISO *rx, int bytes, uint16_t wparam, uint32_t lparam) {
+    u4_t start_us = timer_us();
 	lock_enter(&spi_lock);
         int wait = wait_avail("_spi_get", cmd);
 		SPI_MOSI *tx = &SPI_SHMEM->spi_tx[3];
@@ -443,10 +484,12 @@ void _spi_get(SPI_CMD cmd, SPI_MISO *rx, int bytes, uint16_t wparam, uint32_t lp
     }
 	evSpiCmd(EC_EVENT, EV_SPILOOP, -1, "spi_get", evprintf("BUSY WAIT is DONE %s(%d) %s miso %p",  cmds[cmd], cmd, Task_s(tid), rx));
 	evSpiCmd(EC_EVENT, EV_SPILOOP, -1, "spi_get", "DONE");
+    spi_cmd_stat(cmd, start_us);
 }
 
 // pipelined: don't need to wait for reply to be valid
 void spi_get_pipelined(SPI_CMD cmd, SPI_MISO *rx, int bytes, uint16_t wparam, uint32_t lparam) {
+    u4_t start_us = timer_us();
 	lock_enter(&spi_lock);
         int wait = wait_avail("spi_get_pipelined", cmd);
 		SPI_MOSI *tx = &SPI_SHMEM->spi_tx[4];
@@ -458,10 +501,12 @@ void spi_get_pipelined(SPI_CMD cmd, SPI_MISO *rx, int bytes, uint16_t wparam, ui
     lock_leave(&spi_lock);
     
     spi_check_wakeup(cmd);		// must be done outside the lock
+    spi_cmd_stat(cmd, start_us);
 }
 
 // no duplexing: send a second cmd (flush) to force reply to our original cmd
 void spi_get_noduplex(SPI_CMD cmd, SPI_MISO *rx, int bytes, uint16_t wparam, uint32_t lparam) {
+    u4_t start_us = timer_us();
 	lock_enter(&spi_lock);		// block other threads
         int wait = wait_avail("spi_get_noduplex", cmd);
 		SPI_MOSI *tx = &SPI_SHMEM->spi_tx[5];
@@ -481,10 +526,12 @@ void spi_get_noduplex(SPI_CMD cmd, SPI_MISO *rx, int bytes, uint16_t wparam, uin
 		evSpi(EC_EVENT, EV_SPILOOP, -1, "spi_getND", "DONE");
     lock_leave(&spi_lock);		// release block
     spi_check_wakeup(cmd);		// must be done outside the lock
+    spi_cmd_stat(cmd, start_us);
 }
 
 // spi_get_noduplex() but with 3 uint16_t parameters
 void spi_get3_noduplex(SPI_CMD cmd, SPI_MISO *rx, int bytes, uint16_t wparam, uint16_t w2param, uint16_t w3param) {
+    u4_t start_us = timer_us();
 	lock_enter(&spi_lock);		// block other threads
         int wait = wait_avail("spi_get3_noduplex", cmd);
 		SPI_MOSI *tx = &SPI_SHMEM->spi_tx[6];
@@ -504,4 +551,5 @@ void spi_get3_noduplex(SPI_CMD cmd, SPI_MISO *rx, int bytes, uint16_t wparam, ui
 		evSpi(EC_EVENT, EV_SPILOOP, -1, "spi_getND", "DONE");
     lock_leave(&spi_lock);		// release block
     spi_check_wakeup(cmd);		// must be done outside the lock
+    spi_cmd_stat(cmd, start_us);
 }
@@ -71,6 +71,7 @@ typedef enum { // Embedded CPU commands, order must match 'Commands:' table in .
     CmdPause,
     CmdGetGPSSamples,
     CmdGetChan,
+    CmdGetChans,
     CmdGetClocks,
     CmdGetGlitches,
     CmdIQLogReset,
@@ -130,6 +131,7 @@ static const char *cmds[] = {
     "CmdPause",
     "CmdGetGPSSamples",
     "CmdGetChan",
+    "CmdGetChans",
     "CmdGetClocks",
     "CmdGetGlitches",
     "CmdIQLogReset",
@@ -148,6 +150,9 @@ typedef struct {
     
     #define NRETRY_HIST 8
     u4_t retry_hist[NRETRY_HIST];
+
+    // per command: requests and usec from the request until the reply was valid
+    u4_t cmd_count[CmdCheckLast], cmd_us[CmdCheckLast], cmd_max_us[CmdCheckLast];
 } spi_t;
 
 extern spi_t spi;
@@ -117,6 +117,9 @@ void spi_dev(SPI_SEL sel, SPI_MOSI *mosi, int tx_xfers, SPI_MISO *miso, int rx_x
 {
     assert(init);
 
+    if (spi_replay) {
+        spi_replay_dev(sel, mosi, tx_xfers, miso, rx_xfers);
+    } else
     if (use_async && sel == SPI_HOST) {
         //kiwi_backtrace("spi_dev");
         assert(SPI_SHMEM != NULL);
@@ -189,6 +192,13 @@ static void _spi_dev_init(int spi_clkg, int spi_speed)
 
 void spi_dev_init(int spi_clkg, int spi_speed)
 {
+    if (spi_replay) {
+        spi_replay_init();
+        spi_init();
+        init = true;
+        return;
+    }
+
 #ifdef SPI_SHMEM_DISABLE
 #else
     #ifdef CPU_AM3359
@@ -39,7 +39,7 @@ typedef struct {
 
 typedef struct {
     SPI_MISO dpump_miso;
-    SPI_MISO gps_search_miso, gps_channel_miso[GPS_CHANS], gps_clocks_miso, gps_iqdata_miso, gps_glitches_miso[2];
+    SPI_MISO gps_search_miso, gps_channel_miso[GPS_CHANS], gps_chans_miso, gps_clocks_miso, gps_iqdata_miso, gps_glitches_miso[2];
     SPI_MOSI gps_e1b_code_mosi;
     SPI_MISO wf_miso[MAX_RX_CHANS];
     SPI_MISO misc_miso;
@@ -81,3 +81,11 @@ typedef struct {
 
 void spi_dev_init(int spi_clkg, int spi_speed);
 void spi_dev(SPI_SEL sel, SPI_MOSI *mosi, int tx_xfers, SPI_MISO *miso, int rx_xfers);
+
+// spi_replay.cpp: replayed I/Q instead of the FPGA, see "-replay"
+extern const char *spi_replay;
+void spi_replay_init();
+void spi_replay_dev(SPI_SEL sel, SPI_MOSI *mosi, int tx_xfers, SPI_MISO *miso, int rx_xfers);
+bool spi_replay_snd_intr();
+void spi_replay_idle();
+void spi_replay_stats();
@@ -0,0 +1,253 @@
+/*
+--------------------------------------------------------------------------------
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+Boston, MA  02110-1301, USA.
+--------------------------------------------------------------------------------
+*/
+
+#include "types.h"
+#include "config.h"
+#include "kiwi.h"
+#include "misc.h"
+#include "timer.h"
+#include "spi.h"
+#include "spi_dev.h"
+#include "data_pump.h"
+#include "printf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Replay backend for the SPI layer. Stands in for the FPGA and eCPU so the receive chain
+// (data pump, audio and waterfall tasks, web server) can be run and measured without hardware.
+//
+// kiwi -replay file    file is interleaved 16-bit little-endian I/Q at the audio sample rate, looped
+// kiwi -replay synth   a generated test signal (a few tones plus noise)
+//
+// Every rx channel and waterfall gets the same I/Q regardless of tuning. There is no GPS search:
+// main() turns GPS off since nothing here would give the search a satellite. The GPS channel
+// uploads (CmdGetChan, CmdGetChans) are answered for tools/gps_chan_test, which runs the channel
+// polling against this backend: each GPS_CHAN record has the NAV bit counters running at 50 bps,
+// the rest of its words are (channel << 8) | word offset so the reader can check the layout. CmdGetRX blocks become
+// available at the real-time rate. If the data pump falls more than nrx_bufs blocks behind it
+// resets the stream exactly as it would with the hardware, so dpump.resets counts the drops.
+
+const char *spi_replay;
+
+#define REPLAY_MAX_SAMPS    (16*M)      // I/Q pairs kept in memory
+#define REPLAY_SYNTH_SECS   4
+
+static struct {
+    s2_t *iq;
+    u4_t nsamps, rx_pos, wf_pos;
+
+    u4_t nrx_samps;     // as set by CmdSetRXNsamps, 0 = stopped
+    u64_t start_us;     // when block 0 became available
+    u4_t consumed;      // blocks read by CmdGetRX since start
+    u4_t resets;
+
+    // per stats interval
+    u4_t blocks, late_max_us;
+    u64_t late_sum_us;
+
+    u4_t gps_chan;      // wparam of the last CmdGetChan, answered by the next transfer
+} replay;
+
+static void replay_synth()
+{
+    replay.nsamps = snd_rate * REPLAY_SYNTH_SECS;
+    replay.iq = (s2_t *) kiwi_malloc("replay_synth", replay.nsamps * NIQ * sizeof(s2_t));
+
+    // integer Hz tones so the buffer loops without a phase jump
+    const int tone_hz[] = { 1000, -2500, 440 };
+    const float tone_amp[] = { 4000, 1500, 300 };
+    srandom(1);
+
+    for (u4_t i = 0; i < replay.nsamps; i++) {
+        float re = 0, im = 0;
+        for (int t = 0; t < ARRAY_LEN(tone_hz); t++) {
+            float ph = 2 * K_PI * tone_hz[t] * (float) i / snd_rate;
+            re += tone_amp[t] * cosf(ph);
+            im += tone_amp[t] * sinf(ph);
+        }
+        re += (random() % 201) - 100;
+        im += (random() % 201) - 100;
+        replay.iq[i*2] = (s2_t) re;
+        replay.iq[i*2+1] = (s2_t) im;
+    }
+}
+
+static void replay_file(const char *fn)
+{
+    FILE *fp = fopen(fn, "r");
+    if (fp == NULL) sys_panic("replay fopen");
+    fseek(fp, 0, SEEK_END);
+    long bytes = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    replay.nsamps = MIN(bytes / (NIQ * sizeof(s2_t)), REPLAY_MAX_SAMPS);
+    if (replay.nsamps == 0) panic("replay file empty");
+    replay.iq = (s2_t *) kiwi_malloc("replay_file", replay.nsamps * NIQ * sizeof(s2_t));
+    if (fread(replay.iq, NIQ * sizeof(s2_t), replay.nsamps, fp) != replay.nsamps) sys_panic("replay fread");
+    fclose(fp);
+}
+
+void spi_replay_init()
+{
+    if (strcmp(spi_replay, "synth") == 0)
+        replay_synth();
+    else
+        replay_file(spi_replay);
+
+    lprintf("REPLAY: %s, %.1f sec of I/Q at %d Hz, no FPGA\n",
+        spi_replay, (float) replay.nsamps / snd_rate, snd_rate);
+}
+
+// blocks the FPGA would have written by now
+static u4_t replay_produced()
+{
+    if (replay.nrx_samps == 0) return 0;
+    return (timer_us64() - replay.start_us) * snd_rate / (replay.nrx_samps * 1000000ULL);
+}
+
+// replaces GPIO SND_INTR
+bool spi_replay_snd_intr()
+{
+    return (replay_produced() > replay.consumed);
+}
+
+// called by the scheduler when no task is runnable: sleep until the next block is due (max 1 ms)
+void spi_replay_idle()
+{
+    u4_t sleep_us = 1000;
+    if (replay.nrx_samps) {
+        u64_t due_us = replay.start_us + (u64_t) (replay.consumed + 1) * replay.nrx_samps * 1000000ULL / snd_rate;
+        u64_t now_us = timer_us64();
+        sleep_us = (due_us > now_us)? MIN(due_us - now_us, sleep_us) : 0;
+    }
+    if (sleep_us) kiwi_usleep(sleep_us);
+}
+
+static void replay_get_rx(SPI_MISO *miso)
+{
+    // see rx_data_t and rx_trailer_t in data_pump.cpp
+    rx_iq_t *iqp = (rx_iq_t *) miso->word;
+    for (u4_t j = 0; j < replay.nrx_samps; j++) {
+        s2_t *s = &replay.iq[replay.rx_pos*2];
+        if (++replay.rx_pos == replay.nsamps) replay.rx_pos = 0;
+
+        // 16-bit file samples are the top of the 24-bit hardware samples
+        s4_t i = s[0] << 8, q = s[1] << 8;
+        for (int ch = 0; ch < rx_chans; ch++, iqp++) {
+            iqp->i = i & 0xffff; iqp->i3 = i >> 16;
+            iqp->q = q & 0xffff; iqp->q3 = q >> 16;
+        }
+    }
+
+    u2_t trailer[5];
+    u64_t ticks = (u64_t) replay.consumed * replay.nrx_samps * rx_decim;
+    trailer[0] = ticks & 0xffff;
+    trailer[1] = (ticks >> 16) & 0xffff;
+    trailer[2] = (ticks >> 32) & 0xffff;
+    trailer[3] = replay.consumed;           // write_ctr_stored
+    trailer[4] = replay_produced();         // write_ctr_current
+    memcpy(iqp, trailer, sizeof(trailer));  // rx_iq_t is packed
+
+    u64_t due_us = replay.start_us + (u64_t) (replay.consumed + 1) * replay.nrx_samps * 1000000ULL / snd_rate;
+    u64_t now_us = timer_us64();
+    u4_t late_us = (now_us > due_us)? (now_us - due_us) : 0;
+    replay.late_sum_us += late_us;
+    if (late_us > replay.late_max_us) replay.late_max_us = late_us;
+    replay.blocks++;
+    replay.consumed++;
+}
+
+static void replay_get_wf(SPI_MISO *miso)
+{
+    char *iqp = (char *) miso->word;    // SPI_MISO is packed
+    for (int j = 0; j < NWF_SAMPS; j++) {
+        s2_t *s = &replay.iq[replay.wf_pos*2];
+        if (++replay.wf_pos == replay.nsamps) replay.wf_pos = 0;
+        memcpy(iqp, s, 2 * sizeof(s2_t));
+        iqp += 2 * sizeof(s2_t);
+    }
+}
+
+#ifdef USE_GPS
+// see GPS_CHAN in e_cpu/kiwi.gps.asm
+#define GPS_CHAN_W  (4 + MAX_NAV_BITS/16 + 2*4 + 3*2*2 + 2 + 2 + 3)
+
+static void replay_get_chans(SPI_MISO *miso, int ch, int nchans)
+{
+    u4_t ms = timer_ms();
+    assert(miso->len_bytes >= (int) (sizeof(miso->status) + nchans * GPS_CHAN_W * sizeof(u2_t)));
+
+    for (int i = 0; i < nchans; i++, ch++) {
+        int w = i * GPS_CHAN_W;     // SPI_MISO is packed, so index word[] rather than take a pointer into it
+        miso->word[w + 0] = ms % 20;                                // ch_NAV_MS
+        miso->word[w + 1] = (ms / 20) & (MAX_NAV_BITS-1);           // ch_NAV_BITS
+        for (int j = 2; j < GPS_CHAN_W; j++)
+            miso->word[w + j] = (ch << 8) | j;
+    }
+}
+#endif
+
+// mosi is the new request, miso receives the response to the previous one (see spi_scan())
+void spi_replay_dev(SPI_SEL sel, SPI_MOSI *mosi, int tx_xfers, SPI_MISO *miso, int rx_xfers)
+{
+    if (sel != SPI_HOST) return;
+
+    switch (miso->cmd) {
+        case CmdGetRX: replay_get_rx(miso); break;
+        case CmdGetWFSamples: case CmdGetWFContSamps: replay_get_wf(miso); break;
+        case CmdPing: miso->word[0] = 0xcafe; break;
+    #ifdef USE_GPS
+        case CmdGetChan: replay_get_chans(miso, replay.gps_chan, 1); break;
+        case CmdGetChans: replay_get_chans(miso, 0, GPS_CHANS); break;
+    #endif
+        case CmdPing2: miso->word[0] = 0xbabe; break;
+        default: break;
+    }
+    miso->status = 0;
+
+    if (mosi->data.cmd == CmdSetRXNsamps) {
+        if (replay.nrx_samps && mosi->data.wparam) replay.resets++;
+        replay.nrx_samps = mosi->data.wparam;
+        replay.start_us = timer_us64();
+        replay.consumed = 0;
+    }
+
+    #ifdef USE_GPS
+        if (mosi->data.cmd == CmdGetChan)
+            replay.gps_chan = mosi->data.wparam;
+    #endif
+}
+
+void spi_replay_stats()
+{
+    if (!(print_stats & STATS_TASK)) return;
+    static u4_t last_ms;
+    u4_t now = timer_ms();
+    float secs = (now - last_ms) / 1e3;
+    last_ms = now;
+    if (secs <= 0) return;
+
+    float expected = replay.nrx_samps? (float) snd_rate / replay.nrx_samps : 0;
+    lprintf("REPLAY: %.1f/%.1f blocks/s, late avg %.3f max %.3f msec, %d resets\n",
+        replay.blocks / secs, expected, replay.blocks? (float) replay.late_sum_us / replay.blocks / 1e3 : 0,
+        replay.late_max_us / 1e3, replay.resets);
+    replay.blocks = replay.late_max_us = 0;
+    replay.late_sum_us = 0;
+}
@@ -37,6 +37,7 @@
 //==========================================================================================
 
 #include "agc.h"
+#include "simd.h"
 
 CAgc m_Agc[MAX_RX_CHANS];
 
@@ -124,14 +125,14 @@ void CAgc::SetParameters(bool AgcOn,  bool UseHang, int Threshold, int ManualGai
 		{
 			m_SigDelayBuf[i].re = 0.0;
 			m_SigDelayBuf[i].im = 0.0;
-			m_MagBuf[i] = -16.0;
 		}
 		m_SigDelayPtr = 0;
 		m_HangTimer = 0;
 		m_Peak = -16.0;
 		m_DecayAve = -5.0;
 		m_AttackAve = -5.0;
-		m_MagBufPos = 0;
+		m_MagCount = 0;
+		m_PeakHead = m_PeakTail = 0;
 	}
 
 	//convert m_ThreshGain to linear manual gain value
@@ -161,115 +162,128 @@ void CAgc::SetParameters(bool AgcOn,  bool UseHang, int Threshold, int ManualGai
 	//clamp Delay samples within buffer limit
 	if(m_DelaySamples >= MAX_DELAY_BUF-1)
 		m_DelaySamples = MAX_DELAY_BUF-1;
+	if(m_WindowSamples >= MAX_DELAY_BUF-1)
+		m_WindowSamples = MAX_DELAY_BUF-1;
 
 	//m_Mutex.unlock();
 }
 
 //////////////////////////////////////////////////////////////////////
-// Automatic Gain Control calculator for COMPLEX data
+// Gain for a block of up to AGC_BLOCK input samples, and the delayed
+// input samples it is to be applied to.
+//
+// The log magnitude and the gain curve are computed a block at a time with
+// fast log2/exp2 approximations (simd.cpp). Compared to per-sample log10f/powf
+// the gain differs by less than 1e-5 relative (< 0.0001 dB) apart from the
+// occasional sample where an averager rise/fall comparison tips the other way.
+//
+// The peak of the last m_WindowSamples magnitudes comes from a monotonic
+// deque, amortized O(1) per sample. This gives the same peak as the original
+// circular buffer that was rescanned whenever the outgoing sample was the peak.
 //////////////////////////////////////////////////////////////////////
-void CAgc::ProcessData(int Length, TYPECPX* pInData, TYPECPX* pOutData, bool masked)
+void CAgc::CalcGain(int Length, TYPECPX* pInData, TYPECPX* pDelayed, TYPEREAL* pGain)
 {
-	TYPEREAL gain;
-	TYPEREAL mag;
-	TYPECPX delayedin;
-	//m_Mutex.lock();
-	if (m_AgcOn && !masked)
+	TYPEREAL mag[AGC_BLOCK];
+	TYPEREAL env[AGC_BLOCK];
+
+	//mag is power so 0.5 factor takes square root of power, clamped to -160dBfs
+	simd_log10_mag_cf(Length, (const float*) pInData, 1.0/(MAX_AMPLITUDE*MAX_AMPLITUDE), mag);
+
+	for(int i=0; i<Length; i++)
 	{
-		for(int i=0; i<Length; i++)
+		//Get delayed sample of input signal
+		pDelayed[i] = m_SigDelayBuf[m_SigDelayPtr];
+		//put new input sample into signal delay buffer
+		m_SigDelayBuf[m_SigDelayPtr++] = pInData[i];
+		if( m_SigDelayPtr >= m_DelaySamples)	//deal with delay buffer wrap around
+			m_SigDelayPtr = 0;
+	}
+
+	for(int i=0; i<Length; i++)
+	{
+		//sliding window peak: drop magnitudes that can no longer be the peak from the tail,
+		//add the new one, then drop the head if it has left the window
+		TYPEREAL m = mag[i];
+		while(m_PeakTail != m_PeakHead)
 		{
-			TYPECPX in = pInData[i];	//get latest input sample
-			//Get delayed sample of input signal
-			delayedin = m_SigDelayBuf[m_SigDelayPtr];
-			//put new input sample into signal delay buffer
-			m_SigDelayBuf[m_SigDelayPtr++] = in;
-			if( m_SigDelayPtr >= m_DelaySamples)	//deal with delay buffer wrap around
-				m_SigDelayPtr = 0;
-
-#if 0
-            // don't use this due to observed distortion problems
-			mag = MFABS(in.re);
-			TYPEREAL mim = MFABS(in.im);
-			if(mim>mag)
-				mag = mim;
-			mag = MLOG10( mag + MIN_CONSTANT ) - MLOG10(MAX_AMPLITUDE);		//0==max  -8 is min==-160dB
-#else
-			mag = in.re*in.re+in.im*in.im;
-			//mag is power so 0.5 factor takes square root of power
-			mag = 0.5* MLOG10( mag/(MAX_AMPLITUDE*MAX_AMPLITUDE) + 1e-16);	//clamped to -160dBfs
-#endif
-
-			//create a sliding window of 'm_WindowSamples' magnitudes and output the peak value within the sliding window
-			TYPEREAL tmp = m_MagBuf[m_MagBufPos];	//get oldest mag sample from buffer into tmp
-			m_MagBuf[m_MagBufPos++] = mag;			//put latest mag sample in buffer;
-			if( m_MagBufPos >= m_WindowSamples)		//deal with magnitude buffer wrap around
-				m_MagBufPos = 0;
-			if(mag > m_Peak)
+			int last = (m_PeakTail == 0)? MAX_DELAY_BUF-1 : m_PeakTail-1;
+			if(m_PeakMag[last] > m)
+				break;
+			m_PeakTail = last;
+		}
+		m_PeakMag[m_PeakTail] = m;
+		m_PeakPos[m_PeakTail] = m_MagCount;
+		if(++m_PeakTail == MAX_DELAY_BUF)
+			m_PeakTail = 0;
+		if(m_MagCount - m_PeakPos[m_PeakHead] >= (u4_t) m_WindowSamples)
+		{
+			if(++m_PeakHead == MAX_DELAY_BUF)
+				m_PeakHead = 0;
+		}
+		m_MagCount++;
+		m_Peak = m_PeakMag[m_PeakHead];
+
+		if(m_UseHang)
+		{	//using hang timer mode
+			if(m_Peak>m_AttackAve)	//if power is rising (use m_AttackRiseAlpha time constant)
+				m_AttackAve = (1.0-m_AttackRiseAlpha)*m_AttackAve + m_AttackRiseAlpha*m_Peak;
+			else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
+				m_AttackAve = (1.0-m_AttackFallAlpha)*m_AttackAve + m_AttackFallAlpha*m_Peak;
+
+			if(m_Peak>m_DecayAve)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
 			{
-				m_Peak = mag;	//if new sample is larger than current peak then use it, no need to look at buffer values
+				m_DecayAve = (1.0-m_DecayRiseAlpha)*m_DecayAve + m_DecayRiseAlpha*m_Peak;
+				m_HangTimer = 0;	//reset hang timer
 			}
 			else
-			{
-				if(tmp == m_Peak)		//tmp is oldest sample pulled out of buffer
-				{	//if oldest sample pulled out was last peak then need to find next highest peak in buffer
-					m_Peak = -8.0;		//set to lowest value to find next max peak
-					//search all buffer for maximum value and set as new peak
-					for(int i=0; i<m_WindowSamples; i++)
-					{
-						tmp = m_MagBuf[i];
-						if(tmp > m_Peak)
-							m_Peak = tmp;
-					}
-				}
+			{	//here if decreasing signal
+				if(m_HangTimer<m_HangTime)
+					m_HangTimer++;	//just inc and hold current m_DecayAve
+				else	//else decay with m_DecayFallAlpha which is RELEASE_TIMECONST
+					m_DecayAve = (1.0-m_DecayFallAlpha)*m_DecayAve + m_DecayFallAlpha*m_Peak;
 			}
+		}
+		else
+		{	//using exponential decay mode
+			// perform average of magnitude using 2 averagers each with separate rise and fall time constants
+			if(m_Peak>m_AttackAve)	//if magnitude is rising (use m_AttackRiseAlpha time constant)
+				m_AttackAve = (1.0-m_AttackRiseAlpha)*m_AttackAve + m_AttackRiseAlpha*m_Peak;
+			else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
+				m_AttackAve = (1.0-m_AttackFallAlpha)*m_AttackAve + m_AttackFallAlpha*m_Peak;
+
+			if(m_Peak>m_DecayAve)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
+				m_DecayAve = (1.0-m_DecayRiseAlpha)*m_DecayAve + m_DecayRiseAlpha*(m_Peak);
+			else					//else magnitude is falling (use m_DecayFallAlpha time constant)
+				m_DecayAve = (1.0-m_DecayFallAlpha)*m_DecayAve + m_DecayFallAlpha*(m_Peak);
+		}
+		//use greater magnitude of attack or Decay Averager
+		env[i] = (m_AttackAve>m_DecayAve)? m_AttackAve : m_DecayAve;
+	}
 
+	//calc gain depending on which side of knee the magnitude is on
+	//use fixed gain if below knee, variable gain if above knee
+	simd_agc_gain(Length, env, m_Knee, m_FixedGain, AGC_OUTSCALE, m_GainSlope - 1.0, pGain);
+}
 
-			if(m_UseHang)
-			{	//using hang timer mode
-				if(m_Peak>m_AttackAve)	//if power is rising (use m_AttackRiseAlpha time constant)
-					m_AttackAve = (1.0-m_AttackRiseAlpha)*m_AttackAve + m_AttackRiseAlpha*m_Peak;
-				else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
-					m_AttackAve = (1.0-m_AttackFallAlpha)*m_AttackAve + m_AttackFallAlpha*m_Peak;
-
-				if(m_Peak>m_DecayAve)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
-				{
-					m_DecayAve = (1.0-m_DecayRiseAlpha)*m_DecayAve + m_DecayRiseAlpha*m_Peak;
-					m_HangTimer = 0;	//reset hang timer
-				}
-				else
-				{	//here if decreasing signal
-					if(m_HangTimer<m_HangTime)
-						m_HangTimer++;	//just inc and hold current m_DecayAve
-					else	//else decay with m_DecayFallAlpha which is RELEASE_TIMECONST
-						m_DecayAve = (1.0-m_DecayFallAlpha)*m_DecayAve + m_DecayFallAlpha*m_Peak;
-				}
-			}
-			else
-			{	//using exponential decay mode
-				// perform average of magnitude using 2 averagers each with separate rise and fall time constants
-				if(m_Peak>m_AttackAve)	//if magnitude is rising (use m_AttackRiseAlpha time constant)
-					m_AttackAve = (1.0-m_AttackRiseAlpha)*m_AttackAve + m_AttackRiseAlpha*m_Peak;
-				else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
-					m_AttackAve = (1.0-m_AttackFallAlpha)*m_AttackAve + m_AttackFallAlpha*m_Peak;
-
-				if(m_Peak>m_DecayAve)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
-					m_DecayAve = (1.0-m_DecayRiseAlpha)*m_DecayAve + m_DecayRiseAlpha*(m_Peak);
-				else					//else magnitude is falling (use m_DecayFallAlpha time constant)
-					m_DecayAve = (1.0-m_DecayFallAlpha)*m_DecayAve + m_DecayFallAlpha*(m_Peak);
+//////////////////////////////////////////////////////////////////////
+// Automatic Gain Control calculator for COMPLEX data
+//////////////////////////////////////////////////////////////////////
+void CAgc::ProcessData(int Length, TYPECPX* pInData, TYPECPX* pOutData, bool masked)
+{
+	TYPEREAL gain[AGC_BLOCK];
+	TYPECPX delayedin[AGC_BLOCK];
+	//m_Mutex.lock();
+	if (m_AgcOn && !masked)
+	{
+		for(int b=0; b<Length; b+=AGC_BLOCK)
+		{
+			int n = MIN(Length-b, AGC_BLOCK);
+			CalcGain(n, &pInData[b], delayedin, gain);
+			for(int i=0; i<n; i++)
+			{
+				pOutData[b+i].re = delayedin[i].re * gain[i];
+				pOutData[b+i].im = delayedin[i].im * gain[i];
 			}
-			//use greater magnitude of attack or Decay Averager
-			if(m_AttackAve>m_DecayAve)
-				mag = m_AttackAve;
-			else
-				mag = m_DecayAve;
-
-			//calc gain depending on which side of knee the magnitude is on
-			if(mag<=m_Knee)		//use fixed gain if below knee
-				gain = m_FixedGain;
-			else				//use variable gain if above knee
-				gain = AGC_OUTSCALE * MPOW(10.0, mag*(m_GainSlope - 1.0) );
-			pOutData[i].re = delayedin.re * gain;
-			pOutData[i].im = delayedin.im * gain;
 		}
 	}
 	else
@@ -288,105 +302,17 @@ void CAgc::ProcessData(int Length, TYPECPX* pInData, TYPECPX* pOutData, bool mas
 //////////////////////////////////////////////////////////////////////
 void CAgc::ProcessData(int Length, TYPECPX* pInData, TYPEMONO16* pOutData, bool masked)
 {
-	TYPEREAL gain;
-	TYPEREAL mag;
-	TYPECPX delayedin;
+	TYPEREAL gain[AGC_BLOCK];
+	TYPECPX delayedin[AGC_BLOCK];
 	//m_Mutex.lock();
 	if (m_AgcOn && !masked)
 	{
-		for(int i=0; i<Length; i++)
+		for(int b=0; b<Length; b+=AGC_BLOCK)
 		{
-			TYPECPX in = pInData[i];	//get latest input sample
-			//Get delayed sample of input signal
-			delayedin = m_SigDelayBuf[m_SigDelayPtr];
-			//put new input sample into signal delay buffer
-			m_SigDelayBuf[m_SigDelayPtr++] = in;
-			if( m_SigDelayPtr >= m_DelaySamples)	//deal with delay buffer wrap around
-				m_SigDelayPtr = 0;
-
-#if 0
-            // don't use this due to observed distortion problems
-			mag = MFABS(in.re);
-			TYPEREAL mim = MFABS(in.im);
-			if(mim>mag)
-				mag = mim;
-			mag = MLOG10( mag + MIN_CONSTANT ) - MLOG10(MAX_AMPLITUDE);		//0==max  -8 is min==-160dB
-#else
-			mag = in.re*in.re+in.im*in.im;
-			//mag is power so 0.5 factor takes square root of power
-			mag = 0.5* MLOG10( mag/(MAX_AMPLITUDE*MAX_AMPLITUDE) + 1e-16);	//clamped to -160dBfs
-#endif
-
-			//create a sliding window of 'm_WindowSamples' magnitudes and output the peak value within the sliding window
-			TYPEREAL tmp = m_MagBuf[m_MagBufPos];	//get oldest mag sample from buffer into tmp
-			m_MagBuf[m_MagBufPos++] = mag;			//put latest mag sample in buffer;
-			if( m_MagBufPos >= m_WindowSamples)		//deal with magnitude buffer wrap around
-				m_MagBufPos = 0;
-			if(mag > m_Peak)
-			{
-				m_Peak = mag;	//if new sample is larger than current peak then use it, no need to look at buffer values
-			}
-			else
-			{
-				if(tmp == m_Peak)		//tmp is oldest sample pulled out of buffer
-				{	//if oldest sample pulled out was last peak then need to find next highest peak in buffer
-					m_Peak = -8.0;		//set to lowest value to find next max peak
-					//search all buffer for maximum value and set as new peak
-					for(int i=0; i<m_WindowSamples; i++)
-					{
-						tmp = m_MagBuf[i];
-						if(tmp > m_Peak)
-							m_Peak = tmp;
-					}
-				}
-			}
-
-
-			if(m_UseHang)
-			{	//using hang timer mode
-				if(m_Peak>m_AttackAve)	//if power is rising (use m_AttackRiseAlpha time constant)
-					m_AttackAve = (1.0-m_AttackRiseAlpha)*m_AttackAve + m_AttackRiseAlpha*m_Peak;
-				else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
-					m_AttackAve = (1.0-m_AttackFallAlpha)*m_AttackAve + m_AttackFallAlpha*m_Peak;
-
-				if(m_Peak>m_DecayAve)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
-				{
-					m_DecayAve = (1.0-m_DecayRiseAlpha)*m_DecayAve + m_DecayRiseAlpha*m_Peak;
-					m_HangTimer = 0;	//reset hang timer
-				}
-				else
-				{	//here if decreasing signal
-					if(m_HangTimer<m_HangTime)
-						m_HangTimer++;	//just inc and hold current m_DecayAve
-					else	//else decay with m_DecayFallAlpha which is RELEASE_TIMECONST
-						m_DecayAve = (1.0-m_DecayFallAlpha)*m_DecayAve + m_DecayFallAlpha*m_Peak;
-				}
-			}
-			else
-			{	//using exponential decay mode
-				// perform average of magnitude using 2 averagers each with separate rise and fall time constants
-				if(m_Peak>m_AttackAve)	//if magnitude is rising (use m_AttackRiseAlpha time constant)
-					m_AttackAve = (1.0-m_AttackRiseAlpha)*m_AttackAve + m_AttackRiseAlpha*m_Peak;
-				else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
-					m_AttackAve = (1.0-m_AttackFallAlpha)*m_AttackAve + m_AttackFallAlpha*m_Peak;
-
-				if(m_Peak>m_DecayAve)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
-					m_DecayAve = (1.0-m_DecayRiseAlpha)*m_DecayAve + m_DecayRiseAlpha*(m_Peak);
-				else					//else magnitude is falling (use m_DecayFallAlpha time constant)
-					m_DecayAve = (1.0-m_DecayFallAlpha)*m_DecayAve + m_DecayFallAlpha*(m_Peak);
-			}
-			//use greater magnitude of attack or Decay Averager
-			if(m_AttackAve>m_DecayAve)
-				mag = m_AttackAve;
-			else
-				mag = m_DecayAve;
-
-			//calc gain depending on which side of knee the magnitude is on
-			if(mag<=m_Knee)		//use fixed gain if below knee
-				gain = m_FixedGain;
-			else				//use variable gain if above knee
-				gain = AGC_OUTSCALE * MPOW(10.0, mag*(m_GainSlope - 1.0) );
-			pOutData[i] = (TYPEMONO16) (delayedin.re * gain);
+			int n = MIN(Length-b, AGC_BLOCK);
+			CalcGain(n, &pInData[b], delayedin, gain);
+			for(int i=0; i<n; i++)
+				pOutData[b+i] = (TYPEMONO16) (delayedin[i].re * gain[i]);
 		}
 	}
 	else
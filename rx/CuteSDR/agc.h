@@ -14,6 +14,7 @@
 #include "kiwi.h"
 
 #define MAX_DELAY_BUF 2048
+#define AGC_BLOCK 256		//samples per block of gain calculation
 
 class CAgc
 {
@@ -27,6 +28,8 @@ public:
 	int GetDelaySamples() const { return m_DelaySamples; }
 
  private:
+	void CalcGain(int Length, TYPECPX* pInData, TYPECPX* pDelayed, TYPEREAL* pGain);
+
 	bool m_AgcOn;				//internal copy of AGC settings parameters
 	bool m_UseHang;
 	int m_Threshold;
@@ -52,7 +55,6 @@ public:
 	TYPEREAL m_Peak;
 
 	int m_SigDelayPtr;
-	int m_MagBufPos;
 	int m_DelaySize;
 	int m_DelaySamples;
 	int m_WindowSamples;
@@ -60,7 +62,14 @@ public:
 	int m_HangTimer;
 
 	TYPECPX m_SigDelayBuf[MAX_DELAY_BUF];
-	TYPEREAL m_MagBuf[MAX_DELAY_BUF];
+
+	//sliding window peak: monotonic deque of magnitudes (decreasing from head to tail)
+	//and the sample number of each, so the head is the peak of the last m_WindowSamples
+	u4_t m_MagCount;
+	int m_PeakHead;
+	int m_PeakTail;
+	TYPEREAL m_PeakMag[MAX_DELAY_BUF];
+	u4_t m_PeakPos[MAX_DELAY_BUF];
 };
 
 extern CAgc m_Agc[MAX_RX_CHANS];
@@ -72,9 +72,9 @@ typedef struct
  #define MFFTW_MALLOC fftw_malloc
  #define MFFTW_FREE fftw_free
  #define MFFTW_PLAN fftw_plan
- #define MFFTW_PLAN_DFT_1D fftw_plan_dft_1d
+ #define MFFTW_PLAN_DFT_1D(name, n, in, out, sign, flags) fftw_plan_dft_1d(n, in, out, sign, flags)
  #define MFFTW_DESTROY_PLAN fftw_destroy_plan
- #define MFFTW_EXECUTE fftw_execute
+ #define MFFTW_EXECUTE_DFT fftw_execute_dft
 #else
  #define MSIN(x) sinf(x)
  #define MCOS(x) cosf(x)
@@ -93,10 +93,12 @@ typedef struct
  #define MFFTW_COMPLEX fftwf_complex
  #define MFFTW_MALLOC fftwf_malloc
  #define MFFTW_FREE fftwf_free
- #define MFFTW_PLAN fftwf_plan
- #define MFFTW_PLAN_DFT_1D fftwf_plan_dft_1d
- #define MFFTW_DESTROY_PLAN fftwf_destroy_plan
- #define MFFTW_EXECUTE fftwf_execute
+ // plans shared by all instances, see fft_plan.cpp
+ #include "fft_plan.h"
+ #define MFFTW_PLAN fft_plan_t *
+ #define MFFTW_PLAN_DFT_1D fft_plan_dft_1d
+ #define MFFTW_DESTROY_PLAN(plan)
+ #define MFFTW_EXECUTE_DFT fft_execute_dft
 #endif
 
 #define TYPESTEREO16 tStereo16
@@ -110,9 +110,8 @@ CFastFIR::CFastFIR()
 	}
 #endif
 
-	m_FFT_CoefPlan = MFFTW_PLAN_DFT_1D(CONV_FFT_SIZE, (MFFTW_COMPLEX*) m_pFilterCoef, (MFFTW_COMPLEX*) m_pFilterCoef, FFTW_FORWARD, FFTW_MEASURE);
-	m_FFT_FwdPlan = MFFTW_PLAN_DFT_1D(CONV_FFT_SIZE, (MFFTW_COMPLEX*) m_pFFTBuf, (MFFTW_COMPLEX*) m_pFFTBuf, FFTW_FORWARD, FFTW_MEASURE);
-	m_FFT_RevPlan = MFFTW_PLAN_DFT_1D(CONV_FFT_SIZE, (MFFTW_COMPLEX*) m_pFFTBuf, (MFFTW_COMPLEX*) m_pFFTBuf, FFTW_BACKWARD, FFTW_MEASURE);
+	// m_PassbandFIR[] is constructed before main() runs fft_plan_init(), so no plans here, see MakePlans()
+	m_FFT_CoefPlan = m_FFT_FwdPlan = m_FFT_RevPlan = NULL;
 	
 	m_FLoCut = -1.0;
 	m_FHiCut = 1.0;
@@ -124,6 +123,20 @@ CFastFIR::~CFastFIR()
 {
 }
 
+//////////////////////////////////////////////////////////////////////
+// Make the FFT plans, once fft_plan_init() has loaded the wisdom.
+// c2s_sound_init() calls it for m_PassbandFIR[] before the audio offload
+// processes are forked, so the plans and any new wisdom are the server's.
+// Otherwise the first SetupParameters() or ProcessData() makes them.
+//////////////////////////////////////////////////////////////////////
+void CFastFIR::MakePlans()
+{
+	if (m_FFT_FwdPlan != NULL) return;
+	m_FFT_CoefPlan = MFFTW_PLAN_DFT_1D("FastFIR coef", CONV_FFT_SIZE, (MFFTW_COMPLEX*) m_pFilterCoef, (MFFTW_COMPLEX*) m_pFilterCoef, FFTW_FORWARD, FFTW_MEASURE);
+	m_FFT_FwdPlan = MFFTW_PLAN_DFT_1D("FastFIR fwd", CONV_FFT_SIZE, (MFFTW_COMPLEX*) m_pFFTBuf, (MFFTW_COMPLEX*) m_pFFTBuf, FFTW_FORWARD, FFTW_MEASURE);
+	m_FFT_RevPlan = MFFTW_PLAN_DFT_1D("FastFIR rev", CONV_FFT_SIZE, (MFFTW_COMPLEX*) m_pFFTBuf, (MFFTW_COMPLEX*) m_pFFTBuf, FFTW_BACKWARD, FFTW_MEASURE);
+}
+
 //////////////////////////////////////////////////////////////////////
 //  Call to setup filter parameters
 // SampleRate in Hz
@@ -139,6 +152,7 @@ void CFastFIR::SetupParameters( TYPEREAL FLoCut, TYPEREAL FHiCut,
 								TYPEREAL Offset, TYPEREAL SampleRate)
 {
 int i;
+	MakePlans();
 	if( (FLoCut==m_FLoCut) && (FHiCut==m_FHiCut) &&
 		(Offset==m_Offset) && (SampleRate==m_SampleRate) )
 	{
@@ -192,7 +206,7 @@ int i;
 	}
 
 	//convert FIR coefficients to frequency domain by taking forward FFT
-	MFFTW_EXECUTE(m_FFT_CoefPlan);
+	MFFTW_EXECUTE_DFT(m_FFT_CoefPlan, (MFFTW_COMPLEX*) m_pFilterCoef, (MFFTW_COMPLEX*) m_pFilterCoef);
 
     #define CIC_COMPENSATION
 	#ifdef CIC_COMPENSATION
@@ -225,6 +239,7 @@ int len = InLength;
 int outpos = 0;
 	if( !InLength)	//if nothing to do
 		return 0;
+	MakePlans();
 //StartPerformance();
 	//m_Mutex.lock();
 	while(len--)
@@ -240,7 +255,7 @@ int outpos = 0;
 		if(m_InBufInPos >= CONV_FFT_SIZE)
 		{	//perform FFT -> complexMultiply by FIR coefficients -> inverse FFT on filled FFT input buffer
 			//print_max_min_c("preFFT", m_pFFTBuf, CONV_FFT_SIZE);
-			MFFTW_EXECUTE(m_FFT_FwdPlan);
+			MFFTW_EXECUTE_DFT(m_FFT_FwdPlan, (MFFTW_COMPLEX*) m_pFFTBuf, (MFFTW_COMPLEX*) m_pFFTBuf);
 
 			if (receive_FFT_pre) {
                 //print_max_min_c("postFFT", m_pFFTBuf, CONV_FFT_SIZE);
@@ -264,7 +279,7 @@ int outpos = 0;
 			if (receive_FFT_post)
 				receive_FFT(rx_chan, 0, CONV_FFT_TO_OUTBUF_RATIO, CONV_FFT_SIZE, m_pFFTBuf);
 
-			MFFTW_EXECUTE(m_FFT_RevPlan);
+			MFFTW_EXECUTE_DFT(m_FFT_RevPlan, (MFFTW_COMPLEX*) m_pFFTBuf, (MFFTW_COMPLEX*) m_pFFTBuf);
 			for(j=(CONV_FIR_SIZE-1); j<CONV_FFT_SIZE; j++)
 			{	//copy FFT output into OutBuf minus CONV_FIR_SIZE-1 samples at beginning
 				OutBuf[outpos++] = m_pFFTBuf[j];
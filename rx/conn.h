@@ -27,6 +27,7 @@ Boston, MA  02110-1301, USA.
 #include "non_block.h"      // non_blocking_cmd_t
 #include "update.h"         // update_check_e
 #include "datatypes.h"      // TYPECPX
+#include "dx.h"             // dx_filter_t
 
 #include <sys/types.h>
 #include <regex.h>
@@ -73,18 +74,13 @@ typedef struct conn_st {
 	int last_tune_time, last_log_time;
 	bool tlimit_exempt, tlimit_exempt_by_pwd, tlimit_zombie;
 	float half_bw;
-	TYPECPX last_sample;
 	char *pref_id, *pref;
 	bool is_locked;
 	bool ext_api;
 	
 	// set only in STREAM_WATERFALL
 	bool wf_cmd_recv_ok;
-	char *dx_filter_ident, *dx_filter_notes;
-	bool dx_has_preg_ident, dx_has_preg_notes;
-	int dx_err_preg_ident, dx_err_preg_notes;
-	regex_t dx_preg_ident, dx_preg_notes;
-	int dx_filter_case, dx_filter_wild, dx_filter_grep;
+	dx_filter_t dx_filter;
 	bool isWF_conn;
 
 	// set in STREAM_EXT, STREAM_SOUND
@@ -31,6 +31,7 @@ Boston, MA  02110-1301, USA.
 #include "debug.h"
 #include "shmem.h"
 #include "data_pump.h"
+#include "simd.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -78,7 +79,6 @@ static u4_t last_run_us;
 
 static void snd_service()
 {
-	int j;
 	SPI_MISO *miso = &SPI_SHMEM->dpump_miso;
 	u4_t diff, moved=0;
 
@@ -136,10 +136,14 @@ static void snd_service()
                 ev_dump/1000.0));
         #endif
     
+        // When the sound task has fallen so far behind that the ring is full drop the new block
+        // rather than overwriting the one it might be reading.
         TYPECPX *i_samps[MAX_RX_CHANS];
+        bool ovfl[MAX_RX_CHANS];
         for (int ch=0; ch < rx_chans; ch++) {
             rx_dpump_t *rx = &rx_dpump[ch];
-            i_samps[ch] = rx->in_samps[rx->wr_pos];
+            ovfl[ch] = spsc_full(&rx->in_ring);
+            i_samps[ch] = ovfl[ch]? dpump.ovfl_samps : rx->in_samps[spsc_wr_slot(&rx->in_ring)];
         }
     
         rx_iq_t *iqp = (rx_iq_t*) &rxd->iq_t;
@@ -158,45 +162,35 @@ static void snd_service()
             debug_ticks++;
         #endif
                 
-        for (j=0; j < nrx_samps; j++) {
-    
-            for (int ch=0; ch < rx_chans; ch++) {
-                if (rx_channels[ch].data_enabled) {
-                    s4_t i, q;
-                    i = S24_8_16(iqp->i3, iqp->i);
-                    q = S24_8_16(iqp->q3, iqp->q);
-                    
-                    // NB: I/Q reversed to get correct sideband polarity; fixme: why?
-                    // [probably because mixer NCO polarity is wrong, i.e. cos/sin should really be cos/-sin]
-                    i_samps[ch]->re = q * rescale + DC_offset_I;
-                    i_samps[ch]->im = i * rescale + DC_offset_Q;
-                    i_samps[ch]++;
-                }
-                
-                iqp++;
-            }
-        }
+        // NB: I/Q reversed to get correct sideband polarity; fixme: why?
+        // [probably because mixer NCO polarity is wrong, i.e. cos/sin should really be cos/-sin]
+        float *out[MAX_RX_CHANS];
+        for (int ch=0; ch < rx_chans; ch++)
+            out[ch] = rx_channels[ch].data_enabled? (float *) i_samps[ch] : NULL;
+        simd_iq24_deinterleave(nrx_samps, rx_chans, (const uint8_t *) iqp, rescale, DC_offset_I, DC_offset_Q, out);
     
         for (int ch=0; ch < rx_chans; ch++) {
             if (rx_channels[ch].data_enabled) {
                 rx_dpump_t *rx = &rx_dpump[ch];
+                spsc_t *ring = &rx->in_ring;
+                
+                if (ovfl[ch]) {
+                    ring->overruns++;
+                    #ifdef DATA_PUMP_DEBUG
+                        real_printf("#%d ", ch); fflush(stdout);
+                    #endif
+                    continue;
+                }
 
-                rx->ticks[rx->wr_pos] = S16x4_S64(0, rxt->ticks[2], rxt->ticks[1], rxt->ticks[0]);
+                u4_t slot = spsc_wr_slot(ring);
+                rx->ticks[slot] = S16x4_S64(0, rxt->ticks[2], rxt->ticks[1], rxt->ticks[0]);
     
                 #ifdef SND_SEQ_CHECK
-                    rx->in_seq[rx->wr_pos] = snd_seq;
+                    rx->in_seq[slot] = snd_seq;
                 #endif
                 
-                rx->wr_pos = (rx->wr_pos+1) & (N_DPBUF-1);
-                
-                diff = (rx->wr_pos >= rx->rd_pos)? rx->wr_pos - rx->rd_pos : N_DPBUF - rx->rd_pos + rx->wr_pos;
-                dpump.in_hist[diff]++;
-
-                #ifdef DATA_PUMP_DEBUG
-                    if (rx->wr_pos == rx->rd_pos) {
-                        real_printf("#%d ", ch); fflush(stdout);
-                    }
-                #endif
+                spsc_produce(ring);     // publishes in_samps[slot] and ticks[slot] to the consumer
+                dpump.in_hist[spsc_used(ring)]++;
             }
         }
         
@@ -212,7 +206,14 @@ static void snd_service()
             moved, diff, stored, current, (timer_us() - last_run_us)/1e3));
 
         if (diff > (nrx_bufs-1) || dpump.force_reset) {
-		    if (!dpump.force_reset) dpump.resets++;
+		    if (dpump.force_reset) {
+		        for (int ch=0; ch < rx_chans; ch++) {
+		            rx_dpump_t *rx = &rx_dpump[ch];
+		            rx->in_ring.overruns = rx->in_ring.hiwat = rx->underruns = 0;
+		        }
+		    } else {
+		        dpump.resets++;
+		    }
 		    dpump.force_reset = false;
 		    
 		    // dump on excessive latency between runs
@@ -362,6 +363,12 @@ void data_pump_init()
 	// see rx_dpump_t.in_samps[][]
 	assert (FASTFIR_OUTBUF_SIZE > nrx_samps);
 	
+	// simd_iq24_deinterleave() writes TYPECPX as float pairs
+	assert (sizeof(TYPECPX) == 2 * sizeof(float));
+	
+	for (int ch=0; ch < rx_chans; ch++)
+	    spsc_init(&rx_dpump[ch].in_ring, N_DPBUF);
+
 	// rescale factor from hardware samples to what CuteSDR code is expecting
 	rescale = MPOW(2, -RXOUT_SCALE + CUTESDR_SCALE);
 
@@ -24,6 +24,7 @@ Boston, MA  02110-1301, USA.
 #include "spi.h"
 #include "cuteSDR.h"
 #include "ima_adpcm.h"
+#include "spsc.h"
 
 #include <fftw3.h>
 
@@ -42,17 +43,14 @@ typedef struct {
 
 typedef struct {
 	struct {
-		u4_t wr_pos, rd_pos;
+		spsc_t in_ring;     // data pump -> c2s_sound() handoff of in_samps[], ticks[]
+		u4_t underruns;     // audio underruns reported by the client
 		// array size really nrx_samps but made pow2 FASTFIR_OUTBUF_SIZE for indexing efficiency
 		TYPECPX in_samps[N_DPBUF][FASTFIR_OUTBUF_SIZE];
 		u64_t ticks[N_DPBUF];
 		#ifdef SND_SEQ_CHECK
 		    u4_t in_seq[N_DPBUF];
 		#endif
-		
-		TYPECPX agc_samples[FASTFIR_OUTBUF_SIZE];
-
-		TYPEREAL demod_samples[FASTFIR_OUTBUF_SIZE];
 
 		u4_t real_wr_pos, real_rd_pos;
 		u4_t real_seq, real_seqnum[N_DPBUF];
@@ -104,7 +102,8 @@ typedef struct {
 typedef struct {
     u4_t resets, hist[MAX_NRX_BUFS];
     bool force_reset;
-    u4_t in_hist[N_DPBUF];
+    u4_t in_hist[N_DPBUF+1];
+    TYPECPX ovfl_samps[FASTFIR_OUTBUF_SIZE];     // where a channel's samples go when its ring is full
     int rx_adc_ovfl;
     int audio_dropped;
 } dpump_t;
@@ -1,4 +1,7 @@
 #include "lms.h"
+#include "simd.h"
+
+#include <math.h>
 
 #define DL_LEN_MAX              300     // 25 msec @ 12 kHz
 #define DL_AUTONOTCH_LEN_DEF    48      //  4 msec @ 12 kHz
@@ -10,14 +13,25 @@
 #define DECAY_AUTONOTCH_DEF     0.99915
 #define DECAY_NOISE_DEF         0.98
 
+// block mode per-bin step is limited to LMS_BLOCK_RHO / (block * bin eigenvalue estimate)
+#define LMS_BLOCK_RHO           0.5
+#define LMS_BLOCK_PWR_ALPHA     0.25
+
 CLMS m_LMS_denoise[MAX_RX_CHANS];
 CLMS m_LMS_autonotch[MAX_RX_CHANS];
 
+// plans are per size and shared by all instances (fft_execute_*() on the instance's arrays)
+static fft_plan_t *lms_fwd_plan[LMS_BLOCK_LOG2_MAX + 1], *lms_inv_plan[LMS_BLOCK_LOG2_MAX + 1];
+
 CLMS::CLMS()
 {
+    m_block = m_block_alloc = 0;
+    m_bu = m_bt = m_bd = m_bp = NULL;
+    m_bout = NULL;
+    m_bU = m_bW = m_bT = NULL;
 }
 
-int CLMS::Initialize(lms_e lms_type, TYPEREAL delayLineLen, TYPEREAL beta, TYPEREAL decay)
+int CLMS::Initialize(lms_e lms_type, TYPEREAL delayLineLen, TYPEREAL beta, TYPEREAL decay, int blockLen)
 {
     m_lms_type = lms_type;
     
@@ -44,8 +58,47 @@ int CLMS::Initialize(lms_e lms_type, TYPEREAL delayLineLen, TYPEREAL beta, TYPER
     memset(m_dline, 0, sizeof(m_dline));
     memset(m_lmscoef, 0, sizeof(m_lmscoef));
 
-    printf("LMS %s dlen=%d FIR=%d beta=%.6f decay=%.6f\n", (m_lms_type == LMS_AUTONOTCH_QRM)? "autonotch":"denoise",
-        m_dlen, LMSLEN, m_beta, m_decay);
+    // block mode: round up to a power of 2
+    m_block = 0;
+    if (blockLen > 0) {
+        m_block_log2 = LMS_BLOCK_LOG2_MIN;
+        while ((1 << m_block_log2) < blockLen && m_block_log2 < LMS_BLOCK_LOG2_MAX) m_block_log2++;
+        int L = 1 << m_block_log2, N = 2*L;
+
+        if (L > m_block_alloc) {
+            if (m_block_alloc) {
+                fftwf_free(m_bu); fftwf_free(m_bt); fftwf_free(m_bd); fftwf_free(m_bp); fftwf_free(m_bout);
+                fftwf_free(m_bU); fftwf_free(m_bW); fftwf_free(m_bT);
+            }
+            m_bu = (float *) fftwf_malloc(N * sizeof(float));
+            m_bt = (float *) fftwf_malloc(N * sizeof(float));
+            m_bd = (float *) fftwf_malloc(L * sizeof(float));
+            m_bp = (float *) fftwf_malloc((L+1) * sizeof(float));
+            m_bout = (TYPEMONO16 *) fftwf_malloc(L * sizeof(TYPEMONO16));
+            m_bU = (fftwf_complex *) fftwf_malloc((L+1) * sizeof(fftwf_complex));
+            m_bW = (fftwf_complex *) fftwf_malloc((L+1) * sizeof(fftwf_complex));
+            m_bT = (fftwf_complex *) fftwf_malloc((L+1) * sizeof(fftwf_complex));
+            m_block_alloc = L;
+        }
+
+        // FFTW_ESTIMATE so a SET from the client doesn't stall the audio task measuring
+        // (unless there is wisdom for it, see fft_plan.cpp)
+        if (lms_fwd_plan[m_block_log2] == NULL) {
+            lms_fwd_plan[m_block_log2] = fft_plan_dft_r2c_1d("LMS fwd", N, m_bt, m_bT, FFTW_ESTIMATE);
+            lms_inv_plan[m_block_log2] = fft_plan_dft_c2r_1d("LMS inv", N, m_bT, m_bt, FFTW_ESTIMATE);
+        }
+
+        memset(m_bu, 0, N * sizeof(float));
+        memset(m_bp, 0, (L+1) * sizeof(float));
+        memset(m_bout, 0, L * sizeof(TYPEMONO16));
+        memset(m_bW, 0, (L+1) * sizeof(fftwf_complex));
+        m_block_decay = powf(m_decay, L);
+        m_bpos = 0;
+        m_block = L;
+    }
+
+    printf("LMS %s dlen=%d FIR=%d%s beta=%.6f decay=%.6f\n", (m_lms_type == LMS_AUTONOTCH_QRM)? "autonotch":"denoise",
+        m_dlen, m_block? m_block : LMSLEN, m_block? " (block)" : "", m_beta, m_decay);
     return 0;
 }
 
@@ -58,24 +111,25 @@ int CLMS::Initialize(lms_e lms_type, TYPEREAL delayLineLen, TYPEREAL beta, TYPER
                                   |  |  |  |  |  |  |  |
                                   +--+--+--+--+--+--+--+--> FIR
 
-    We instead use a moving pointer that is modulo a combined delay-line + FIR size buffer.
+    We instead use a moving pointer that is modulo a combined delay-line + FIR size buffer (N).
     So no buffer data has to me moved to implement a shift.
+    Each sample is written at the pointer and again N further on, so the FIR part
+    (the LMSLEN samples after the pointer) is always contiguous and the convolution and
+    coefficient update are straight loops the compiler and NEON can vectorize.
 
-                          new sample ---+
-                                        v
-                  f3_f2_f1_f0_d3_d2_d1_d0_f7_f6_f5_f4
+                          new sample ---+                                   +--- and again
+                                        v                                   v
+                  f3_f2_f1_f0_d3_d2_d1_d0_f7_f6_f5_f4_f3_f2_f1_f0_d3_d2_d1_d0_f7_f6_f5_f4
                   older <---- TIME <--- ^ oldest <---
                                         | pointer increments
-                                          and wraps ->
+                                          and wraps at N ->
 
     I.e. the interpretation of the data in the buffer changes as the pointer is incremented:
     
-                  f3_f2_f1_f0_d3_d2_d1_d0_f7_f6_f5_f4
-                                        ^
-                  f4_f3_f2_f1_f0_d3_d2_d1_d0_f7_f6_f5
-                                           ^
-                  f5_f4_f3_f2_f1_f0_d3_d2_d1_d0_f7_f6   etc.
-                                              ^
+                  f3_f2_f1_f0_d3_d2_d1_d0_f7_f6_f5_f4_f3_f2_f1_f0_...
+                                        ^ f7 ... f0
+                  f4_f3_f2_f1_f0_d3_d2_d1_d0_f7_f6_f5_f4_f3_f2_f1_...
+                                           ^ f7 ... f0   etc.
 */
 
 void CLMS::ProcessFilter(int ilen, TYPEMONO16* ibuf, TYPEMONO16* obuf)
@@ -83,19 +137,36 @@ void CLMS::ProcessFilter(int ilen, TYPEMONO16* ibuf, TYPEMONO16* obuf)
     //printf("LMS run %s dlen=%d beta=%.6f decay=%.6f\n", (m_lms_type == LMS_AUTONOTCH_QRM)? "autonotch":"denoise", \
         m_dlen, m_beta, m_decay);
 
-    int i;
+    if (m_block) {
+        for (int bp = 0; bp < ilen; bp++) {
+            TYPEREAL samp = ((TYPEREAL) ibuf[bp]) / K_AMPMAX;
+            TYPEREAL u = samp;
+            if (m_dlen) {
+                u = m_dline[m_dlp];
+                m_dline[m_dlp] = samp;
+                if (++m_dlp == m_dlen) m_dlp = 0;
+            }
+            m_bd[m_bpos] = samp;
+            m_bu[m_block + m_bpos] = u;
+            obuf[bp] = m_bout[m_bpos];      // one block of latency
+            if (++m_bpos == m_block) {
+                ProcessBlock();
+                m_bpos = 0;
+            }
+        }
+        return;
+    }
+
+    int n = m_dlen + LMSLEN;
     
     for (int bp = 0; bp < ilen; bp++) {
 	    TYPEREAL samp = ((TYPEREAL) ibuf[bp]) / K_AMPMAX;
-	    m_dline[m_dlp] = samp; INC(m_dlp);
+	    m_dline[m_dlp] = m_dline[m_dlp + n] = samp;
+	    if (++m_dlp == n) m_dlp = 0;
+	    TYPEREAL *fir_dline = &m_dline[m_dlp];      // oldest first, lines up with m_lmscoef[0]
 
         // Wiener filter convolution
-        TYPEREAL fir = 0;
-        for (i=0; i < LMSLEN; i++) {
-            fir += m_dline[m_dlp] * m_lmscoef[i];
-            INC(m_dlp);
-        }
-        DEC(m_dlp);     // backup to last
+        TYPEREAL fir = simd_dot_f(LMSLEN, fir_dline, m_lmscoef);
 	
         if (m_lms_type == LMS_DENOISE_QRN) {
             obuf[bp] = (TYPEMONO16) MROUND(fir * 2 * K_AMPMAX);
@@ -108,14 +179,73 @@ void CLMS::ProcessFilter(int ilen, TYPEMONO16* ibuf, TYPEMONO16* obuf)
         }
 
         // Wiener filter adaptation
-        TYPEREAL err2 = err * m_beta;
+        simd_lms_update_f(LMSLEN, fir_dline, err * m_beta, m_decay, m_lmscoef);
+    }
+}
 
-        TYPEREAL new_co;
-        for (i = LMSLEN_M1; i >= 0; i--) {
-            new_co = m_dline[m_dlp] * err2 + m_lmscoef[i] * m_decay;
-            m_lmscoef[i] = new_co;
-            DEC(m_dlp);
-        }
-        INC(m_dlp);
+/*
+
+    Block mode: frequency-domain block LMS (overlap-save, constrained gradient).
+    The filter is m_block taps long and is updated once per m_block samples using
+    five real FFTs of twice the block length, so the cost per sample grows with
+    log(taps) instead of taps. The output is delayed by one block.
+
+    U = FFT([previous block, current block] of delayed input)
+    y = last half of IFFT(U.W)                      filter output for the current block
+    e = d - y
+    G = FFT(first half of IFFT(mu.conj(U).FFT([0, e])), zero padded)
+    W = decay^block.W + G
+
+    The summed block gradient makes the update block times larger than one
+    per-sample step, so where beta would be unstable for a bin's input power the
+    step of that bin is limited (mu = min(beta, rho/(block * power))).
+    Below that limit the adaptation rate matches the time-domain filter with the same beta.
+*/
+
+void CLMS::ProcessBlock()
+{
+    int L = m_block, N = 2*L, nbins = L+1;
+    fft_plan_t *fwd = lms_fwd_plan[m_block_log2], *inv = lms_inv_plan[m_block_log2];
+    float scale = 1.0f / N;
+    int i;
+
+    fft_execute_r2c(fwd, m_bu, m_bU);
+
+    // output
+    simd_multiply_ccc(nbins, m_bU, m_bW, m_bT);
+    fft_execute_c2r(inv, m_bT, m_bt);
+    float *err = m_bt + L;
+    for (i = 0; i < L; i++) {
+        float y = m_bt[L+i] * scale;
+        err[i] = m_bd[i] - y;
+        m_bout[i] = (TYPEMONO16) MROUND(((m_lms_type == LMS_DENOISE_QRN)? (y * 2) : err[i]) * K_AMPMAX);
+    }
+
+    // gradient
+    memset(m_bt, 0, L * sizeof(float));
+    fft_execute_r2c(fwd, m_bt, m_bT);
+    simd_multiply_conjugate_ccc(nbins, m_bU, m_bT, m_bT);
+
+    // |U|^2 is N times the eigenvalue estimate for white input
+    simd_mag2_cf(nbins, m_bU, m_bt);
+    float limit = LMS_BLOCK_RHO * N / L;
+    for (i = 0; i < nbins; i++) {
+        m_bp[i] += LMS_BLOCK_PWR_ALPHA * (m_bt[i] - m_bp[i]);
+        float pwr = MAX(m_bp[i], m_bt[i]);      // don't lag a sudden increase
+        float mu = m_beta;
+        if (mu * pwr > limit) mu = limit / pwr;
+        mu *= scale;
+        m_bT[i][0] *= mu;
+        m_bT[i][1] *= mu;
     }
+    fft_execute_c2r(inv, m_bT, m_bt);
+    memset(m_bt + L, 0, L * sizeof(float));     // constrain to L taps
+    fft_execute_r2c(fwd, m_bt, m_bT);
+
+    for (i = 0; i < nbins; i++) {
+        m_bW[i][0] = m_bW[i][0] * m_block_decay + m_bT[i][0];
+        m_bW[i][1] = m_bW[i][1] * m_block_decay + m_bT[i][1];
+    }
+
+    memcpy(m_bu, m_bu + L, L * sizeof(float));
 }
@@ -3,31 +3,47 @@
 #include "datatypes.h"
 #include "kiwi.h"
 
+#include <fftw3.h>
+
 typedef enum { LMS_DENOISE_QRN, LMS_AUTONOTCH_QRM } lms_e;
 
 #define LMSLEN      121
-#define LMSLEN_M1   (LMSLEN - 1)
 #define MAX_DLEN    (512 - LMSLEN)
 
-#define INC(dlp) dlp = (dlp == (m_dlen + LMSLEN_M1))? 0 : (dlp+1);
-#define DEC(dlp) dlp = (dlp == 0)? (m_dlen + LMSLEN_M1) : (dlp-1);
+// block (frequency-domain) mode: filter length = block length (64 .. 1024), FFT size twice that
+#define LMS_BLOCK_LOG2_MIN  6
+#define LMS_BLOCK_LOG2_MAX  10
 
 class CLMS
 {
 public:
     CLMS();
-    int Initialize(lms_e lms_type, TYPEREAL delayLineLen, TYPEREAL beta, TYPEREAL decay);
+    int Initialize(lms_e lms_type, TYPEREAL delayLineLen, TYPEREAL beta, TYPEREAL decay, int blockLen = 0);
 	void ProcessFilter(int ilen, TYPEMONO16* ibuf, TYPEMONO16* obuf);
 
 private:
+    void ProcessBlock();
+
     lms_e m_lms_type;
     int m_dlen;
     TYPEREAL m_beta;
     TYPEREAL m_decay;
     
-	TYPEREAL m_dline[MAX_DLEN + LMSLEN];
+    // time-domain mode: delay-line + FIR buffer stored twice so the FIR window is contiguous
+	TYPEREAL m_dline[2 * (MAX_DLEN + LMSLEN)];
 	int m_dlp;
 	TYPEREAL m_lmscoef[LMSLEN];
+
+	// block mode, 0 = off (m_dline is then the input delay ring)
+	int m_block, m_block_log2, m_block_alloc;
+	int m_bpos;
+	TYPEREAL m_block_decay;
+	float *m_bu;            // [2*m_block] delayed input: previous block, current block
+	float *m_bt;            // [2*m_block] scratch
+	float *m_bd;            // [m_block] undelayed input
+	float *m_bp;            // [m_block+1] smoothed per-bin input power
+	TYPEMONO16 *m_bout;     // [m_block] output of the previous block
+	fftwf_complex *m_bU, *m_bW, *m_bT;   // [m_block+1] input spectrum, weights, scratch
 };
 
 extern CLMS m_LMS_denoise[MAX_RX_CHANS];
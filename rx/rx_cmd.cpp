@@ -21,6 +21,7 @@ Boston, MA  02110-1301, USA.
 #include "config.h"
 #include "kiwi.h"
 #include "rx.h"
+#include "rx_cmd_key.h"
 #include "clk.h"
 #include "misc.h"
 #include "str.h"
@@ -67,30 +68,15 @@ const int mode_offset[N_MODE] = { 0, 0, 1500, -1500, 0, 0, 0, 0, 0, 1350, -1350
 
 #ifndef CFG_GPS_ONLY
 
-static dx_t *dx_list_first, *dx_list_last;
-
-int bsearch_freqcomp(const void *key, const void *elem)
+static void rx_common_mkr_cb(void *param, dx_t *dp, float freq)
 {
-	dx_t *dx_key = (dx_t *) key, *dx_elem = (dx_t *) elem;
-	float key_freq = dx_key->freq;
-    float elem_freq = dx_elem->freq + ((float) dx_elem->offset / 1000.0);		// carrier plus offset
-    
-    if (key_freq == elem_freq) return 0;
-    if (key_freq < elem_freq) {
-        if (dx_elem == dx_list_first) return 0;     // key < first in array so lower is first
-        return -1;
-    }
-    
-    // implicit key_freq > elem_freq
-    // but because there may never be an exact match must do a range test
-    dx_t *dx_elem2 = dx_elem+1;
-    if (dx_elem2 < dx_list_last) {
-        // there is a following array element to range check with
-        float elem2_freq = dx_elem2->freq + ((float) dx_elem2->offset / 1000.0);		// carrier plus offset
-        if (key_freq < elem2_freq) return 0;    // key was between without exact match
-        return 1;   // key_freq > elem2_freq -> keep looking
-    }
-    return 0;   // key > last in array so lower is last (degenerate case)
+	char **sb = (char **) param;
+
+	// NB: ident, notes and params are already stored URL encoded
+	*sb = kstr_asprintf(*sb, ",{\"g\":%d,\"f\":%.3f,\"lo\":%d,\"hi\":%d,\"o\":%d,\"b\":%d,\"ts\":%d,\"tg\":%d,\"i\":\"%s\"%s%s%s%s%s%s}",
+		dp->idx, freq, dp->low_cut, dp->high_cut, dp->offset, dp->flags, dp->timestamp, dp->tag, dp->ident,
+		dp->notes? ",\"n\":\"":"", dp->notes? dp->notes:"", dp->notes? "\"":"",
+		dp->params? ",\"p\":\"":"", dp->params? dp->params:"", dp->params? "\"":"");
 }
 
 #endif
@@ -118,7 +104,9 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 	NextTask("rx_common_cmd");      // breakup long runs of sequential commands -- sometimes happens at startup
     evLatency(EC_EVENT, EV_RX, 0, "rx_common_cmd", evprintf("%s", cmd));
 	
-	if (strcmp(cmd, "SET keepalive") == 0) {
+	set_key_e key = rx_cmd_key(cmd);
+
+	if (key == CMD_SET_KEEPALIVE) {
 	    conn->keepalive_time = timer_sec();
 
         // for STREAM_EXT send a roundtrip keepalive
@@ -131,7 +119,7 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 	}
 
 	// SECURITY: auth command here is the only one allowed before auth check below (excluding keepalive above)
-	if (kiwi_str_begins_with(cmd, "SET auth")) {
+	if (key == CMD_SET_AUTH) {
 	
 		const char *pwd_s = NULL;
 		int cfg_auto_login;
@@ -544,12 +532,14 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		return true;	// fake that we accepted command so it won't be further processed
 	}
 
+	switch (key) {
+
 
 ////////////////////////////////
 // saved config
 ////////////////////////////////
 
-	if (kiwi_str_begins_with(cmd, "SET save_cfg=")) {
+	case CMD_SET_SAVE_CFG: {
 		if (conn->auth_admin == FALSE) {
 			lprintf("** attempt to save kiwi config with auth_admin == FALSE! IP %s\n", conn->remote_ip);
 			return true;	// fake that we accepted command so it won't be further processed
@@ -567,7 +557,7 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		return true;
 	}
 
-	if (kiwi_str_begins_with(cmd, "SET save_adm=")) {
+	case CMD_SET_SAVE_ADM: {
 		if (conn->type != STREAM_ADMIN) {
 			lprintf("** attempt to save admin config from non-STREAM_ADMIN! IP %s\n", conn->remote_ip);
 			return true;	// fake that we accepted command so it won't be further processed
@@ -597,12 +587,10 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 
 #ifndef CFG_GPS_ONLY
 
-#define DX_SPACING_ZOOM_THRESHOLD	5
-#define DX_SPACING_THRESHOLD_PX		10
 		dx_t *dp, *ldp, *upd;
 
 	// SECURITY: should be okay: checks for conn->auth_admin first
-	if (kiwi_str_begins_with(cmd, "SET DX_UPD")) {
+	case CMD_SET_DX_UPD: {
 		if (conn->auth_admin == false) {
 			cprintf(conn, "DX_UPD NO ADMIN AUTH %s\n", conn->remote_ip);
 			return true;
@@ -610,8 +598,7 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		
 		float freq = 0;
 		int gid = -999;
-		int low_cut, high_cut, mkr_off, flags, new_len;
-		bool need_sort = false;
+		int low_cut, high_cut, mkr_off, flags;
 		flags = 0;
 
 		char *text_m, *notes_m, *params_m;
@@ -636,43 +623,25 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		if (gid != -1 && dx.len == 0) return true;
 		
 		bool err = false;
-		dx_t *dxp;
 		if (gid >= -1 && gid < dx.len) {
 			if (n == 2 && gid != -1 && freq == -1) {
-				// delete entry by forcing to top of list, then decreasing size by one before save
 				cprintf(conn, "DX_UPD %s delete entry #%d\n", conn->remote_ip, gid);
-				dxp = &dx.list[gid];
-				dxp->freq = 999999;
-				new_len = dx.len - 1;
-				need_sort = true;
+				dx_edit(gid, NULL);
 			} else
 			if (n != 2) {
-				if (gid == -1) {
-					// new entry: add to end of list (in hidden slot), then sort will insert it properly
+				if (gid == -1)
 					cprintf(conn, "DX_UPD %s adding new entry\n", conn->remote_ip);
-					assert(dx.hidden_used == false);		// FIXME need better serialization
-					dxp = &dx.list[dx.len];
-					dx.hidden_used = true;
-					dx.len++;
-					new_len = dx.len;
-				    need_sort = true;
-				} else {
-					// modify entry
+				else
 					cprintf(conn, "DX_UPD %s modify entry #%d\n", conn->remote_ip, gid);
-					dxp = &dx.list[gid];
-					new_len = dx.len;
-				    if (dxp->freq != freq) {
-                        need_sort = true;
-                    }
-                    else printf("DX_UPD modify but no freq change, so no sort required %f\n", freq);
 
-				}
-				dxp->freq = freq;
-				dxp->low_cut = low_cut;
-				dxp->high_cut = high_cut;
-				dxp->offset = mkr_off;
-				dxp->flags = flags;
-		        dxp->timestamp = utc_time_since_2018() / 60;
+				dx_t upd;
+				memset(&upd, 0, sizeof(upd));
+				upd.freq = freq;
+				upd.low_cut = low_cut;
+				upd.high_cut = high_cut;
+				upd.offset = mkr_off;
+				upd.flags = flags;
+		        upd.timestamp = utc_time_since_2018() / 60;
 				
 				// remove trailing 'x' transmitted with text, notes and params fields
 				text_m[strlen(text_m)-1] = '\0';
@@ -680,11 +649,14 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 				params_m[strlen(params_m)-1] = '\0';
 				
 				// can't use kiwi_strdup because free() must be used later on
-				free((void *) dxp->ident); dxp->ident = strdup(text_m);
-				free((void *) dxp->ident_s); dxp->ident_s = kiwi_str_decode_inplace(strdup(text_m));
-				free((void *) dxp->notes); dxp->notes = strdup(notes_m);
-				free((void *) dxp->notes_s); dxp->notes_s = kiwi_str_decode_inplace(strdup(notes_m));
-				free((void *) dxp->params); dxp->params = strdup(params_m);
+				upd.ident = strdup(text_m);
+				upd.ident_s = kiwi_str_decode_inplace(strdup(text_m));
+				upd.notes = strdup(notes_m);
+				upd.notes_s = kiwi_str_decode_inplace(strdup(notes_m));
+				upd.params = strdup(params_m);
+				
+				// journals the edit and moves the entry to its place in the sorted list, see init/dx.cpp
+				dx_edit(gid, &upd);
 			} else {
 			    err = true;
 			}
@@ -693,79 +665,32 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 			err = true;
 		}
 		
-        //#define TMEAS(x) x
-        #define TMEAS(x)
-
-		if (!err) {
-            // NB: difference between dx.len and new_len
-            dx_prep_list(need_sort, dx.list, dx.len, new_len);
-            //printf("DX_UPD after qsort dx.len %d new_len %d top elem f=%.2f\n",
-            //	dx.len, new_len, dx.list[dx.len - DX_HIDDEN_SLOT].freq);
-                        
-            dx.len = new_len;
-            TMEAS(u4_t start = timer_ms(); printf("DX_UPD START\n");)
-            dx_save_as_json();		// FIXME need better serialization
-            TMEAS(u4_t split = timer_ms(); printf("DX_UPD struct -> json, file write in %.3f sec\n", TIME_DIFF_MS(split, start));)
-
-            #if 1
-                // NB: Don't need to do the time consuming json re-parse since there are no dxcfg_* write routines that
-                // incrementally alter the json struct. The DX_UPD code modifies the dx struct and then regenerates the entire json string
-                // and writes it to the file. In this way the dx struct is acting as a proxy for the json struct, except at server start-up
-                // when the json struct is walked to construct the initial dx struct.
-                // But do need to grow to include a new hidden slot if it was just used by an add.
-                //dx_reload();
-                if (dx.hidden_used) {
-	                dx.list = (dx_t *) kiwi_realloc("dx_list", dx.list, (dx.len + DX_HIDDEN_SLOT) * sizeof(dx_t));
-	                memset(&dx.list[dx.len], 0, sizeof(dx_t));
-	                dx.hidden_used = false;
-                }
-                
-	            dx.json_up_to_date = false;
-            #else
-                dx_reload();
-            #endif
-
-            TMEAS(u4_t now = timer_ms(); printf("DX_UPD DONE reloaded in %.3f/%.3f sec\n", TIME_DIFF_MS(now, split), TIME_DIFF_MS(now, start));)
+		if (!err)
             send_msg(conn, false, "MSG request_dx_update");	// get client to request updated dx list
-        }
 
         free(text_m); free(notes_m); free(params_m);
 		return true;
 	}
 
-	if (kiwi_str_begins_with(cmd, "SET DX_FILTER")) {
+	case CMD_SET_DX_FILTER: {
 	    char *filter_ident_m, *filter_notes_m;
+	    dx_filter_t *f = &conn->dx_filter;
 		n = sscanf(cmd, "SET DX_FILTER i=%256ms n=%256ms c=%d w=%d g=%d",
-		    &filter_ident_m, &filter_notes_m, &conn->dx_filter_case, &conn->dx_filter_wild, &conn->dx_filter_grep);
+		    &filter_ident_m, &filter_notes_m, &f->case_sens, &f->wild, &f->grep);
 		if (n != 5) return true;
         // remove trailing 'x' appended to text strings
         filter_ident_m[strlen(filter_ident_m)-1] = '\0';
         filter_notes_m[strlen(filter_notes_m)-1] = '\0';
-        free(conn->dx_filter_ident); conn->dx_filter_ident = kiwi_str_decode_inplace(strdup(filter_ident_m));
-        free(conn->dx_filter_notes); conn->dx_filter_notes = kiwi_str_decode_inplace(strdup(filter_notes_m));
+        free(f->ident); f->ident = kiwi_str_decode_inplace(strdup(filter_ident_m));
+        free(f->notes); f->notes = kiwi_str_decode_inplace(strdup(filter_notes_m));
         free(filter_ident_m);
         free(filter_notes_m);
-        conn->dx_err_preg_ident = conn->dx_err_preg_notes = 0;
         
-        // compile regexp
-        if (conn->dx_filter_grep) {
-            int cflags = conn->dx_filter_case? REG_NOSUB : (REG_ICASE|REG_NOSUB);
-            if (conn->dx_has_preg_ident) { regfree(&conn->dx_preg_ident); conn->dx_has_preg_ident = false; }
-            if (conn->dx_has_preg_notes) { regfree(&conn->dx_preg_notes); conn->dx_has_preg_notes = false; }
-            if (conn->dx_filter_ident && conn->dx_filter_ident[0] != '\0') {
-                conn->dx_err_preg_ident = regcomp(&conn->dx_preg_ident, conn->dx_filter_ident, cflags);
-                conn->dx_has_preg_ident = !conn->dx_err_preg_ident;
-                if (conn->dx_err_preg_ident) printf("regcomp ident %d\n", conn->dx_err_preg_ident);
-            }
-            if (conn->dx_filter_notes && conn->dx_filter_notes[0] != '\0') {
-                conn->dx_err_preg_notes = regcomp(&conn->dx_preg_notes, conn->dx_filter_notes, cflags);
-                conn->dx_has_preg_notes = !conn->dx_err_preg_notes;
-                if (conn->dx_err_preg_notes) printf("regcomp notes %d\n", conn->dx_err_preg_notes);
-            }
-        }
+        // compile regexp, invalidate filter map
+        dx_filter_compile(f);
         
         //printf("DX_FILTER setup <%s> <%s> case=%d wild=%d grep=%d\n",
-        //    conn->dx_filter_ident, conn->dx_filter_notes, conn->dx_filter_case, conn->dx_filter_wild, conn->dx_filter_grep);
+        //    f->ident, f->notes, f->case_sens, f->wild, f->grep);
         //show_conn("DX FILTER ", conn);
         send_msg(conn, false, "MSG request_dx_update");	// get client to request updated dx list
 		return true;
@@ -777,21 +702,15 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
     // With 2 params to search for the next label above or below the visible area when label stepping.
     // The search criteria applies in both cases.
     
-	if (kiwi_str_begins_with(cmd, "SET MKR")) {
-		float min, max, bw;
-		int zoom, width, dir = 1;
+	case CMD_SET_MKR: {
+		float min, max = 0;
+		int zoom = 0, width = 0, dir = 1;
 		int type = sscanf(cmd, "SET MKR min=%f max=%f zoom=%d width=%d", &min, &max, &zoom, &width);
 		if (type != 4) {
 		    type = sscanf(cmd, "SET MKR dir=%d freq=%f", &dir, &min);
 		        if (type != 2) return true;
-		} else {
-		    bw = max - min;
 		}
 		
-		static bool first = true;
-		static int dx_lastx;
-		dx_lastx = 0;
-		
 		if (dx.len == 0) {
             send_msg(conn, false, "MSG mkr=[{\"t\":4}]");    // otherwise last marker won't get cleared
 			return true;
@@ -802,98 +721,20 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
         u4_t msec = ts.tv_nsec/1000000;
         // reset appending
 		sb = kstr_asprintf(NULL, "[{\"t\":%d,\"s\":%ld,\"m\":%d,\"f\":%d}",
-		    type, ts.tv_sec, msec, (conn->dx_err_preg_ident? 1:0) + (conn->dx_err_preg_notes? 2:0));   
-		int send = 0;
+		    type, ts.tv_sec, msec, (conn->dx_filter.err_preg_ident? 1:0) + (conn->dx_filter.err_preg_notes? 2:0));   
 		
-		// bsearch the lower bound for speed with large lists
-		dx_t dx_min;
-
-        // DX_SEARCH_WINDOW: when zoomed far-in need to look at wider window since we don't know PB center here
-		#define DX_SEARCH_WINDOW 10.0
-		dx_min.freq = min + ((type == 2 && dir == 1)? DX_SEARCH_WINDOW : -DX_SEARCH_WINDOW);
-		dx_list_first = &dx.list[0];
-		dx_list_last = &dx.list[dx.len - DX_HIDDEN_SLOT];   // NB: addr of LAST in list
-
-		dx_t *dp = (dx_t *) bsearch(&dx_min, dx.list, dx.len, sizeof(dx_t), bsearch_freqcomp);
-		if (dp == NULL) panic("DX bsearch");
-		//printf("DX MKR key=%.2f bsearch=%.2f(%d/%d) min=%.2f max=%.2f\n",
-		//    dx_min.freq, dp->freq + ((float) dp->offset / 1000.0), dp->idx, dx.len, min, max);
-		
-		int dx_filter = 0, fn_flags = 0;
-        if (conn->dx_filter_ident || conn->dx_filter_notes) {
-            dx_filter = 1;
-            fn_flags = conn->dx_filter_case? 0 : FNM_CASEFOLD;
-            //printf("DX FILTERING on <%s> <%s> case=%d wild=%d grep=%d\n",
-            //    conn->dx_filter_ident, conn->dx_filter_notes, conn->dx_filter_case, conn->dx_filter_wild, conn->dx_filter_grep);
-            //show_conn("DX FILTER ", conn);
-        }
-        
-		for (; dp < &dx.list[dx.len] && dp >= dx.list; dp += dir) {
-			float freq = dp->freq + ((float) dp->offset / 1000.0);		// carrier plus offset
-
-			if (type == 4 && freq > max + DX_SEARCH_WINDOW) break;    // get extra one above for label stepping
-			
-			if (dx_filter) {
-			    if (conn->dx_filter_grep) {
-			        if (conn->dx_has_preg_ident) {
-                        if (regexec(&conn->dx_preg_ident, dp->ident_s, 0, NULL, 0) == REG_NOMATCH) continue;
-                    }
-			        if (conn->dx_has_preg_notes) {
-                        if (regexec(&conn->dx_preg_notes, dp->notes_s, 0, NULL, 0) == REG_NOMATCH) continue;
-                    }
-			        //printf("DX FILTER MATCHED-grep %s<%s> %s<%s>\n",
-			        //    conn->dx_has_preg_ident? "*":"", dp->ident_s, conn->dx_has_preg_notes? "*":"", dp->notes_s);
-			    } else
-			    if (conn->dx_filter_wild) {
-                    if (fnmatch(conn->dx_filter_ident, dp->ident_s, fn_flags) != 0) continue;
-                    if (conn->dx_filter_notes && conn->dx_filter_notes[0] != '\0' &&
-                        fnmatch(conn->dx_filter_notes, dp->notes_s, fn_flags) != 0) continue;
-			        //printf("DX FILTER MATCHED-wild <%s> <%s>\n", dp->ident_s, dp->notes_s);
-			    } else {
-                    if (conn->dx_filter_case) {
-                        if (strstr(dp->ident_s, conn->dx_filter_ident) == NULL) continue;
-                        if (conn->dx_filter_notes && strstr(dp->notes_s, conn->dx_filter_notes) == NULL) continue;
-                    } else {
-                        if (strcasestr(dp->ident_s, conn->dx_filter_ident) == NULL) continue;
-                        if (conn->dx_filter_notes && strcasestr(dp->notes_s, conn->dx_filter_notes) == NULL) continue;
-                    }
-			        //printf("DX FILTER MATCHED-no-grep <%s> <%s>\n", dp->ident_s, dp->notes_s);
-                }
-			}
-			
-			// reduce dx label clutter
-			if (type == 4 && zoom <= DX_SPACING_ZOOM_THRESHOLD) {
-				int x = ((dp->freq - min) / bw) * width;
-				int diff = x - dx_lastx;
-				//printf("DX spacing %d %d %d %s\n", dx_lastx, x, diff, dp->ident);
-				if (!first && diff < DX_SPACING_THRESHOLD_PX) continue;
-				dx_lastx = x;
-				first = false;
-			}
-			
-			// NB: ident, notes and params are already stored URL encoded
-			if (type == 4 || dp->freq != min) {
-                sb = kstr_asprintf(sb, ",{\"g\":%d,\"f\":%.3f,\"lo\":%d,\"hi\":%d,\"o\":%d,\"b\":%d,\"ts\":%d,\"tg\":%d,\"i\":\"%s\"%s%s%s%s%s%s}",
-                    dp->idx, freq, dp->low_cut, dp->high_cut, dp->offset, dp->flags, dp->timestamp, dp->tag, dp->ident,
-                    dp->notes? ",\"n\":\"":"", dp->notes? dp->notes:"", dp->notes? "\"":"",
-                    dp->params? ",\"p\":\"":"", dp->params? dp->params:"", dp->params? "\"":"");
-                //printf("DX %d: %.2f(%d)\n", send, freq, dp->idx);
-                send++;
-            }
-			
-			// return the very first we hit that passed the filtering criteria above
-			if (type == 2 && send) break;
-		}
+		// index search, see init/dx_index.cpp
+		dx_mkr(&conn->dx_filter, type, dir, min, max, zoom, width, rx_common_mkr_cb, &sb);
 		
 		sb = kstr_cat(sb, "]");
 		send_msg(conn, false, "MSG mkr=%s", kstr_sp(sb));
 		kstr_free(sb);
-		//printf("DX send=%d\n", send);
 		return true;
 	}
 	
 	// send the whole database as json
-	if (strcmp(cmd, "SET GET_DX_JSON") == 0) {
+	case CMD_SET_GET_DX_JSON: {
+	    dx_json_update();       // regenerate json from the list if there have been edits
 	    dxcfg_update_json();    // update (re-parse) json if necessary
 
         // NB: ident, notes and params are already stored URL encoded
@@ -910,7 +751,7 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 // status and config
 ////////////////////////////////
 
-	if (strcmp(cmd, "SET GET_CONFIG") == 0) {
+	case CMD_SET_GET_CONFIG: {
 		asprintf(&sb, "{\"r\":%d,\"g\":%d,\"s\":%d,\"pu\":\"%s\",\"pe\":%d,\"pv\":\"%s\",\"pi\":%d,\"n\":%d,\"m\":\"%s\",\"v1\":%d,\"v2\":%d}",
 			rx_chans, GPS_CHANS, net.serno, net.ip_pub, net.port_ext, net.ip_pvt, net.port, net.nm_bits, net.mac, version_maj, version_min);
 		send_msg(conn, false, "MSG config_cb=%s", sb);
@@ -918,7 +759,7 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		return true;
 	}
 	
-	if (kiwi_str_begins_with(cmd, "SET STATS_UPD")) {
+	case CMD_SET_STATS_UPD: {
 		int ch;
 		n = sscanf(cmd, "SET STATS_UPD ch=%d", &ch);
 		//printf("STATS_UPD ch=%d\n", ch);
@@ -975,9 +816,20 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
         //printf("status sending wspr_c.rgrid=<%s>\n", wspr_c.rgrid);
         
 		sb = kstr_asprintf(sb, ",\"ad\":%d,\"au\":%d,\"ae\":%d,\"ar\":%d,\"an\":%d,\"an2\":%d,",
-			dpump.audio_dropped, underruns, seq_errors, dpump.resets, nrx_bufs, N_DPBUF);
+			dpump.audio_dropped, underruns, seq_errors, dpump.resets, nrx_bufs, N_DPBUF+1);
 		sb = kstr_cat(sb, kstr_list_int("\"ap\":[", "%u", "],", (int *) dpump.hist, nrx_bufs));
-		sb = kstr_cat(sb, kstr_list_int("\"ai\":[", "%u", "]", (int *) dpump.in_hist, N_DPBUF));
+		sb = kstr_cat(sb, kstr_list_int("\"ai\":[", "%u", "]", (int *) dpump.in_hist, N_DPBUF+1));
+		
+		// per-channel data pump -> sound task ring: overruns, client underruns, high-water mark, current fill
+		if (ch == rx_chans) {
+			sb = kstr_cat(sb, ",\"aq\":[");
+			for (i = 0; i < rx_chans; i++) {
+				rx_dpump_t *rx = &rx_dpump[i];
+				sb = kstr_asprintf(sb, "%s{\"o\":%u,\"u\":%u,\"h\":%u,\"f\":%u}", i? ",":"",
+					rx->in_ring.overruns, rx->underruns, rx->in_ring.hiwat, spsc_used(&rx->in_ring));
+			}
+			sb = kstr_cat(sb, "]");
+		}
 #endif
 
 		char utc_s[32], local_s[32];
@@ -1001,7 +853,7 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 
 #ifndef CFG_GPS_ONLY
 
-	if (strcmp(cmd, "SET GET_USERS") == 0) {
+	case CMD_SET_GET_USERS: {
 		bool include_ip = (conn->type == STREAM_ADMIN);
 		sb = rx_users(include_ip);
 		send_msg(conn, false, "MSG user_cb=%s", kstr_sp(sb));
@@ -1016,7 +868,7 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 // UI
 ////////////////////////////////
 
-	if (kiwi_str_begins_with(cmd, "SET ident_user=")) {
+	case CMD_SET_IDENT_USER: {
         char *ident_user_m = NULL;
 	    sscanf(cmd, "SET ident_user=%256ms", &ident_user_m);
 		bool noname = (ident_user_m == NULL || ident_user_m[0] == '\0');
@@ -1090,8 +942,9 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		return true;
 	}
 
-	n = sscanf(cmd, "SET need_status=%d", &j);
-	if (n == 1) {
+	case CMD_SET_NEED_STATUS: {
+		n = sscanf(cmd, "SET need_status=%d", &j);
+		if (n != 1) break;
 		if (conn->mc == NULL) return true;	// we've seen this
 		char *status = (char*) cfg_string("status_msg", NULL, CFG_REQUIRED);
 		send_msg_encoded(conn, "MSG", "status_msg_html", "\f%s", status);
@@ -1099,9 +952,10 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		return true;
 	}
 	
-	char *geo_m = NULL;
-	n = sscanf(cmd, "SET geo=%127ms", &geo_m);
-	if (n == 1) {
+	case CMD_SET_GEO: {
+		char *geo_m = NULL;
+		n = sscanf(cmd, "SET geo=%127ms", &geo_m);
+		if (n != 1) break;
 		kiwi_str_decode_inplace(geo_m);
 		//cprintf(conn, "ch%d recv geoloc from client: %s\n", conn->rx_channel, geo_m);
 		char *esc = kiwi_str_escape_HTML(geo_m);
@@ -1114,18 +968,20 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		return true;
 	}
 
-	char *geojson_m = NULL;
-	n = sscanf(cmd, "SET geojson=%256ms", &geojson_m);
-	if (n == 1) {
+	case CMD_SET_GEOJSON: {
+		char *geojson_m = NULL;
+		n = sscanf(cmd, "SET geojson=%256ms", &geojson_m);
+		if (n != 1) break;
 		kiwi_str_decode_inplace(geojson_m);
 		//clprintf(conn, "SET geojson<%s>\n", geojson_m);
 		free(geojson_m);
 		return true;
 	}
 	
-	char *browser_m = NULL;
-	n = sscanf(cmd, "SET browser=%256ms", &browser_m);
-	if (n == 1) {
+	case CMD_SET_BROWSER: {
+		char *browser_m = NULL;
+		n = sscanf(cmd, "SET browser=%256ms", &browser_m);
+		if (n != 1) break;
 		kiwi_str_decode_inplace(browser_m);
 		//clprintf(conn, "SET browser=<%s>\n", browser_m);
 		free(browser_m);
@@ -1134,16 +990,17 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 	
 #ifndef CFG_GPS_ONLY
     // used by signal generator etc.
-	int wf_comp;
-	n = sscanf(cmd, "SET wf_comp=%d", &wf_comp);
-	if (n == 1) {
+	case CMD_SET_WF_COMP: {
+		int wf_comp;
+		n = sscanf(cmd, "SET wf_comp=%d", &wf_comp);
+		if (n != 1) break;
 		c2s_waterfall_compression(conn->rx_channel, wf_comp? true:false);
 		//printf("### SET wf_comp=%d\n", wf_comp);
 		return true;
 	}
 #endif
 
-    if (strcmp(cmd, "SET inactivity_ack") == 0) {
+    case CMD_SET_INACTIVITY_ACK: {
         conn->last_tune_time = timer_sec();
         return true;
     }
@@ -1153,7 +1010,7 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 // preferences
 ////////////////////////////////
 
-	if (kiwi_str_begins_with(cmd, "SET pref_export")) {
+	case CMD_SET_PREF_EXPORT: {
 		free(conn->pref_id);
 		free(conn->pref);
 		n = sscanf(cmd, "SET pref_export id=%64ms pref=%4096ms", &conn->pref_id, &conn->pref);
@@ -1177,7 +1034,7 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		return true;
 	}
 	
-	if (kiwi_str_begins_with(cmd, "SET pref_import")) {
+	case CMD_SET_PREF_IMPORT: {
 		free(conn->pref_id);
 		n = sscanf(cmd, "SET pref_import id=%64ms", &conn->pref_id);
 		if (n != 1) {
@@ -1212,9 +1069,10 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
     // DEPRECATED
     // Replaced by "--tlimit-pw" option that specifies an actual time limit exemption password.
     // But silently accept for backward compatibility with old versions of kiwiclient still in use.
-	int inactivity_timeout;
-	n = sscanf(cmd, "SET OVERRIDE inactivity_timeout=%d", &inactivity_timeout);
-	if (n == 1) {
+	case CMD_SET_OVERRIDE: {
+		int inactivity_timeout;
+		n = sscanf(cmd, "SET OVERRIDE inactivity_timeout=%d", &inactivity_timeout);
+		if (n != 1) break;
 		return true;
 	}
 
@@ -1224,34 +1082,38 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 ////////////////////////////////
 
 	// SECURITY: only used during debugging
-	n = sscanf(cmd, "SET nocache=%d", &i);
-	if (n == 1) {
+	case CMD_SET_NOCACHE: {
+		n = sscanf(cmd, "SET nocache=%d", &i);
+		if (n != 1) break;
 		web_nocache = i? true : false;
 		printf("SET nocache=%d\n", web_nocache);
 		return true;
 	}
 
 	// SECURITY: only used during debugging
-	n = sscanf(cmd, "SET ctrace=%d", &i);
-	if (n == 1) {
+	case CMD_SET_CTRACE: {
+		n = sscanf(cmd, "SET ctrace=%d", &i);
+		if (n != 1) break;
 		web_caching_debug = i? true : false;
 		printf("SET ctrace=%d\n", web_caching_debug);
 		return true;
 	}
 
 	// SECURITY: only used during debugging
-	n = sscanf(cmd, "SET debug_v=%d", &i);
-	if (n == 1) {
+	case CMD_SET_DEBUG_V: {
+		n = sscanf(cmd, "SET debug_v=%d", &i);
+		if (n != 1) break;
 		debug_v = i;
 		//printf("SET debug_v=%d\n", debug_v);
 		return true;
 	}
 
 	// SECURITY: only used during debugging
-	sb = (char *) "SET debug_msg=";
-	slen = strlen(sb);
-	n = strncmp(cmd, sb, slen);
-	if (n == 0) {
+	case CMD_SET_DEBUG_MSG: {
+		sb = (char *) "SET debug_msg=";
+		slen = strlen(sb);
+		n = strncmp(cmd, sb, slen);
+		if (n != 0) break;
 		kiwi_str_decode_inplace(cmd);
 		clprintf(conn, "### DEBUG MSG: <%s>\n", &cmd[slen]);
 		return true;
@@ -1262,13 +1124,13 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 // misc
 ////////////////////////////////
 
-	if (strcmp(cmd, "SET is_admin") == 0) {
+	case CMD_SET_IS_ADMIN: {
 	    assert(conn->auth == true);
 		send_msg(conn, false, "MSG is_admin=%d", conn->auth_admin);
 		return true;
 	}
 
-	if (strcmp(cmd, "SET get_authkey") == 0) {
+	case CMD_SET_GET_AUTHKEY: {
 		if (conn->auth_admin == false) {
 			cprintf(conn, "get_authkey NO ADMIN AUTH %s\n", conn->remote_ip);
 			return true;
@@ -1280,9 +1142,10 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		return true;
 	}
 
-    int clk_adj;
-    n = sscanf(cmd, "SET clk_adj=%d", &clk_adj);
-    if (n == 1) {
+    case CMD_SET_CLK_ADJ: {
+        int clk_adj;
+        n = sscanf(cmd, "SET clk_adj=%d", &clk_adj);
+        if (n != 1) break;
 		if (conn->auth_admin == false) {
 			cprintf(conn, "clk_adj NO ADMIN AUTH %s\n", conn->remote_ip);
 			return true;
@@ -1299,6 +1162,17 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 		return true;
     }
 
+	case CMD_SET_X_DEBUG:
+	    cprintf(conn, "x-DEBUG %s \"%s\"\n", conn->remote_ip, &cmd[12]);
+	    return true;
+
+	default:
+		break;
+	}
+	
+	// a stream specific command: leave it to the caller
+	if (key != CMD_SET_NONE) return false;
+
 	if (kiwi_str_begins_with(cmd, "SERVER DE CLIENT")) return true;
 	
 	// we see these sometimes; not part of our protocol
@@ -1314,11 +1188,6 @@ bool rx_common_cmd(const char *stream_name, conn_t *conn, char *cmd)
 	    conn->spurious_timestamps_recvd++;
 	    return true;
 	}
-
-	if (kiwi_str_begins_with(cmd, "SET x-DEBUG")) {
-	    cprintf(conn, "x-DEBUG %s \"%s\"\n", conn->remote_ip, &cmd[12]);
-	    return true;
-	}
 	
 	return false;
 }
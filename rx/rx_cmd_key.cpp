@@ -0,0 +1,173 @@
+/*
+--------------------------------------------------------------------------------
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+Boston, MA  02110-1301, USA.
+--------------------------------------------------------------------------------
+*/
+
+#include "types.h"
+#include "printf.h"
+#include "rx_cmd_key.h"
+
+#include <string.h>
+
+static const struct {
+	set_key_e key;
+	const char *key_s;
+} set_keys[] = {
+	{ CMD_SET_KEEPALIVE,				"keepalive" },
+	{ CMD_SET_AUTH,						"auth" },
+	{ CMD_SET_SAVE_CFG,					"save_cfg" },
+	{ CMD_SET_SAVE_ADM,					"save_adm" },
+	{ CMD_SET_DX_UPD,					"DX_UPD" },
+	{ CMD_SET_DX_FILTER,				"DX_FILTER" },
+	{ CMD_SET_MKR,						"MKR" },
+	{ CMD_SET_GET_DX_JSON,				"GET_DX_JSON" },
+	{ CMD_SET_GET_CONFIG,				"GET_CONFIG" },
+	{ CMD_SET_STATS_UPD,				"STATS_UPD" },
+	{ CMD_SET_GET_USERS,				"GET_USERS" },
+	{ CMD_SET_IDENT_USER,				"ident_user" },
+	{ CMD_SET_NEED_STATUS,				"need_status" },
+	{ CMD_SET_GEO,						"geo" },
+	{ CMD_SET_GEOJSON,					"geojson" },
+	{ CMD_SET_BROWSER,					"browser" },
+	{ CMD_SET_WF_COMP,					"wf_comp" },
+	{ CMD_SET_INACTIVITY_ACK,			"inactivity_ack" },
+	{ CMD_SET_PREF_EXPORT,				"pref_export" },
+	{ CMD_SET_PREF_IMPORT,				"pref_import" },
+	{ CMD_SET_OVERRIDE,					"OVERRIDE" },
+	{ CMD_SET_NOCACHE,					"nocache" },
+	{ CMD_SET_CTRACE,					"ctrace" },
+	{ CMD_SET_DEBUG_V,					"debug_v" },
+	{ CMD_SET_DEBUG_MSG,				"debug_msg" },
+	{ CMD_SET_IS_ADMIN,					"is_admin" },
+	{ CMD_SET_GET_AUTHKEY,				"get_authkey" },
+	{ CMD_SET_CLK_ADJ,					"clk_adj" },
+	{ CMD_SET_X_DEBUG,					"x-DEBUG" },
+
+	{ CMD_SET_DBG_AUDIO_START,			"dbgAudioStart" },
+	{ CMD_SET_MOD,						"mod" },
+	{ CMD_SET_COMPRESSION,				"compression" },
+	{ CMD_SET_RESTART,					"restart" },
+	{ CMD_SET_LITTLE_ENDIAN,			"little-endian" },
+	{ CMD_SET_GEN,						"gen" },
+	{ CMD_SET_GENATTN,					"genattn" },
+	{ CMD_SET_AGC,						"agc" },
+	{ CMD_SET_SQUELCH,					"squelch" },
+	{ CMD_SET_LMS_DENOISE,				"lms_denoise" },
+	{ CMD_SET_LMS_DE_DELAY,				"lms.de_delay" },
+	{ CMD_SET_LMS_DE_BETA,				"lms.de_beta" },
+	{ CMD_SET_LMS_DE_DECAY,				"lms.de_decay" },
+	{ CMD_SET_LMS_DE_BLOCK,				"lms.de_block" },
+	{ CMD_SET_LMS_AUTONOTCH,			"lms_autonotch" },
+	{ CMD_SET_LMS_AN_DELAY,				"lms.an_delay" },
+	{ CMD_SET_LMS_AN_BETA,				"lms.an_beta" },
+	{ CMD_SET_LMS_AN_DECAY,				"lms.an_decay" },
+	{ CMD_SET_LMS_AN_BLOCK,				"lms.an_block" },
+	{ CMD_SET_MUTE,						"mute" },
+	{ CMD_SET_DE_EMP,					"de_emp" },
+	{ CMD_SET_TEST,						"test" },
+	{ CMD_SET_UAR,						"UAR" },
+	{ CMD_SET_AR,						"AR" },
+	{ CMD_SET_UNDERRUN,					"underrun" },
+	{ CMD_SET_SEQ,						"seq" },
+
+	{ CMD_SET_NB,						"nb" },
+
+	{ CMD_SET_ZOOM,						"zoom" },
+	{ CMD_SET_MAXDB,					"maxdb" },
+	{ CMD_SET_BAND,						"band" },
+	{ CMD_SET_SCALE,					"scale" },
+	{ CMD_SET_WF_SPEED,					"wf_speed" },
+	{ CMD_SET_SEND_DB,					"send_dB" },
+
+	{ CMD_SET_EXT_BLUR,					"ext_blur" },
+
+	{ CMD_SET_EXT_SWITCH_TO_CLIENT,		"ext_switch_to_client" },
+	{ CMD_SET_INIT,						"init" },
+	{ CMD_SET_EXT_IS_LOCKED_STATUS,		"ext_is_locked_status" },
+};
+
+// Perfect hash: FNV-1a of the key word, then a seeded multiplicative mix down to RX_CMD_KEY_BITS.
+// The seed is searched for once so that every key lands in its own slot.
+// A lookup is then one hash of the key word, one table read and one compare against that slot's key.
+#define RX_CMD_KEY_BITS		10
+#define RX_CMD_KEY_SLOTS	(1 << RX_CMD_KEY_BITS)
+#define RX_CMD_KEY_SEEDS	(1 << 16)
+
+#define FNV_INIT	2166136261U
+#define FNV_PRIME	16777619U
+
+static u4_t key_seed;
+static u1_t key_slot[RX_CMD_KEY_SLOTS];		// set_key_e, CMD_SET_NONE if empty
+static const char *key_s[N_CMD_SET];
+static u1_t key_len[N_CMD_SET];
+
+#define RX_CMD_KEY_MIX(h, seed)		(((h) ^ (seed)) * 0x9e3779b1U >> (32 - RX_CMD_KEY_BITS))
+
+static u4_t rx_cmd_key_fnv(const char *s, int len)
+{
+	u4_t h = FNV_INIT;
+	while (len--)
+		h = (h ^ (u1_t) *s++) * FNV_PRIME;
+	return h;
+}
+
+void rx_cmd_key_init()
+{
+	int i;
+	u4_t h[N_CMD_SET];
+
+	assert(N_CMD_SET <= 256 && N_CMD_SET <= RX_CMD_KEY_SLOTS/4);
+
+	memset(key_s, 0, sizeof(key_s));
+	for (i = 0; i < ARRAY_LEN(set_keys); i++) {
+		set_key_e k = set_keys[i].key;
+		assert(k > CMD_SET_NONE && k < N_CMD_SET && key_s[k] == NULL);
+		key_s[k] = set_keys[i].key_s;
+		key_len[k] = strlen(key_s[k]);
+	}
+	for (i = CMD_SET_NONE+1; i < N_CMD_SET; i++) {
+		if (key_s[i] == NULL) panic("rx_cmd_key_init: set_key_e missing from set_keys[]");
+		h[i] = rx_cmd_key_fnv(key_s[i], key_len[i]);
+	}
+
+	for (key_seed = 0; key_seed < RX_CMD_KEY_SEEDS; key_seed++) {
+		memset(key_slot, CMD_SET_NONE, sizeof(key_slot));
+		for (i = CMD_SET_NONE+1; i < N_CMD_SET; i++) {
+			u4_t slot = RX_CMD_KEY_MIX(h[i], key_seed);
+			if (key_slot[slot] != CMD_SET_NONE) break;
+			key_slot[slot] = i;
+		}
+		if (i == N_CMD_SET) break;
+	}
+	if (key_seed == RX_CMD_KEY_SEEDS) panic("rx_cmd_key_init: no perfect hash seed");
+}
+
+set_key_e rx_cmd_key(const char *cmd)
+{
+	if (cmd[0] != 'S' || cmd[1] != 'E' || cmd[2] != 'T' || cmd[3] != ' ')
+		return CMD_SET_NONE;
+
+	// hash the key word while finding its end
+	const char *s = &cmd[4];
+	u4_t h = FNV_INIT;
+	int len;
+	for (len = 0; s[len] != '\0' && s[len] != '=' && s[len] != ' '; len++)
+		h = (h ^ (u1_t) s[len]) * FNV_PRIME;
+
+	set_key_e k = (set_key_e) key_slot[RX_CMD_KEY_MIX(h, key_seed)];
+	if (k == CMD_SET_NONE || key_len[k] != len || memcmp(key_s[k], s, len) != 0)
+		return CMD_SET_NONE;
+	return k;
+}
@@ -0,0 +1,64 @@
+/*
+--------------------------------------------------------------------------------
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+Boston, MA  02110-1301, USA.
+--------------------------------------------------------------------------------
+*/
+
+#pragma once
+
+// Keys of the "SET key[=value] ..." websocket commands.
+// rx_cmd_key() maps the key word of a command to one of these with a single perfect hash probe
+// so the command loops can switch() directly to the one sscanf() that parses the rest,
+// instead of trying the sscanf() of every command in turn.
+//
+// The key word is what follows "SET " up to the first '=', ' ' or end of string,
+// e.g. "SET lms.an_decay=0.999" -> "lms.an_decay", "SET AR OK in=12000 out=44100" -> "AR".
+// One table is shared by all streams. A key used by more than one stream (e.g. "nb") has one entry.
+
+typedef enum {
+	CMD_SET_NONE = 0,		// not a "SET" command or an unknown key
+
+	// rx_common_cmd(): all streams
+	CMD_SET_KEEPALIVE, CMD_SET_AUTH, CMD_SET_SAVE_CFG, CMD_SET_SAVE_ADM,
+	CMD_SET_DX_UPD, CMD_SET_DX_FILTER, CMD_SET_MKR, CMD_SET_GET_DX_JSON,
+	CMD_SET_GET_CONFIG, CMD_SET_STATS_UPD, CMD_SET_GET_USERS,
+	CMD_SET_IDENT_USER, CMD_SET_NEED_STATUS, CMD_SET_GEO, CMD_SET_GEOJSON, CMD_SET_BROWSER, CMD_SET_WF_COMP, CMD_SET_INACTIVITY_ACK,
+	CMD_SET_PREF_EXPORT, CMD_SET_PREF_IMPORT, CMD_SET_OVERRIDE,
+	CMD_SET_NOCACHE, CMD_SET_CTRACE, CMD_SET_DEBUG_V, CMD_SET_DEBUG_MSG,
+	CMD_SET_IS_ADMIN, CMD_SET_GET_AUTHKEY, CMD_SET_CLK_ADJ, CMD_SET_X_DEBUG,
+
+	// c2s_sound()
+	CMD_SET_DBG_AUDIO_START, CMD_SET_MOD, CMD_SET_COMPRESSION, CMD_SET_RESTART, CMD_SET_LITTLE_ENDIAN,
+	CMD_SET_GEN, CMD_SET_GENATTN, CMD_SET_AGC, CMD_SET_SQUELCH,
+	CMD_SET_LMS_DENOISE, CMD_SET_LMS_DE_DELAY, CMD_SET_LMS_DE_BETA, CMD_SET_LMS_DE_DECAY, CMD_SET_LMS_DE_BLOCK,
+	CMD_SET_LMS_AUTONOTCH, CMD_SET_LMS_AN_DELAY, CMD_SET_LMS_AN_BETA, CMD_SET_LMS_AN_DECAY, CMD_SET_LMS_AN_BLOCK,
+	CMD_SET_MUTE, CMD_SET_DE_EMP, CMD_SET_TEST, CMD_SET_UAR, CMD_SET_AR, CMD_SET_UNDERRUN, CMD_SET_SEQ,
+
+	// c2s_sound() and c2s_waterfall()
+	CMD_SET_NB,
+
+	// c2s_waterfall()
+	CMD_SET_ZOOM, CMD_SET_MAXDB, CMD_SET_BAND, CMD_SET_SCALE, CMD_SET_WF_SPEED, CMD_SET_SEND_DB,
+
+	// c2s_waterfall() and extint_c2s()
+	CMD_SET_EXT_BLUR,
+
+	// extint_c2s()
+	CMD_SET_EXT_SWITCH_TO_CLIENT, CMD_SET_INIT, CMD_SET_EXT_IS_LOCKED_STATUS,
+
+	N_CMD_SET
+} set_key_e;
+
+void rx_cmd_key_init();
+set_key_e rx_cmd_key(const char *cmd);
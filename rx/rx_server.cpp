@@ -21,6 +21,7 @@ Boston, MA  02110-1301, USA.
 #include "config.h"
 #include "kiwi.h"
 #include "rx.h"
+#include "rx_cmd_key.h"
 #include "clk.h"
 #include "misc.h"
 #include "str.h"
@@ -225,6 +226,8 @@ void rx_server_init()
 		c++;
 	}
 	
+	rx_cmd_key_init();
+
 	    sig_arm(SIG_DEBUG, debug_dump_handler);
 
     //#ifndef DEVSYS
@@ -298,10 +301,7 @@ void rx_server_remove(conn_t *c)
 	free(c->geo);
 	free(c->pref_id);
 	free(c->pref);
-	free(c->dx_filter_ident);
-	free(c->dx_filter_notes);
-    if (c->dx_has_preg_ident) { regfree(&c->dx_preg_ident); c->dx_has_preg_ident = false; }
-    if (c->dx_has_preg_notes) { regfree(&c->dx_preg_notes); c->dx_has_preg_notes = false; }
+	dx_filter_free(&c->dx_filter);
     
     //if (!is_BBAI && c->is_locked) {
     if (c->is_locked) {
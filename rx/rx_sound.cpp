@@ -21,6 +21,7 @@ Boston, MA  02110-1301, USA.
 #include "config.h"
 #include "kiwi.h"
 #include "rx.h"
+#include "rx_cmd_key.h"
 #include "clk.h"
 #include "misc.h"
 #include "str.h"
@@ -82,8 +83,239 @@ gps_timestamp_t gps_ts[MAX_RX_CHANS];
 
 snd_t snd_inst[MAX_RX_CHANS];
 
+#ifdef SND_SHMEM_DISABLE
+    static snd_shmem_t snd_shmem;
+    snd_shmem_t *snd_shmem_p = &snd_shmem;
+#endif
+
+static int snd_workers;     // 0 when the DSP runs on the main core
+
 float g_genfreq, g_genampl, g_mixfreq;
 
+// runs in the audio offload process when MULTI_CORE
+static void snd_dsp_setup(int rx_chan, snd_dsp_t *dsp)
+{
+    u4_t setup = dsp->setup;
+    dsp->setup = 0;
+    
+    if (setup & SND_SETUP_FM_INIT)
+        m_FmDemod[rx_chan].SetSampleRate(rx_chan, dsp->frate);
+    if (setup & SND_SETUP_FM_RESET) {
+        m_FmDemod[rx_chan].Reset();
+        dsp->last_sample.re = dsp->last_sample.im = 0;
+    }
+    if (setup & SND_SETUP_SQUELCH)
+        m_FmDemod[rx_chan].SetSquelch(dsp->squelch, dsp->squelch_max);
+    if (setup & SND_SETUP_AGC)
+        m_Agc[rx_chan].SetParameters(dsp->agc, dsp->hang, dsp->thresh, dsp->manGain, dsp->slope, dsp->decay, dsp->frate);
+    if (setup & SND_SETUP_PASSBAND) {
+        #define CW_OFFSET 0		// fixme: how is cw offset handled exactly?
+        m_PassbandFIR[rx_chan].SetupParameters(dsp->locut, dsp->hicut, CW_OFFSET, dsp->frate);
+        m_AM_FIR[rx_chan].InitLPFilter(0, 1.0, 50.0, dsp->bw, dsp->stop, dsp->frate);
+    }
+    if (setup & SND_SETUP_DE_EMP) {
+        TYPEREAL *c = dsp->de_emp_coef;
+        m_de_emp_Biquad[rx_chan].InitFilterCoef(c[0], c[1], c[2], c[3], c[4], c[5]);
+    }
+    if (setup & SND_SETUP_NB)
+        m_NoiseProc[rx_chan][NB_SND].SetupBlanker("SND", (float) dsp->noise_threshold, (float) dsp->noise_blanker, dsp->frate);
+    if (setup & SND_SETUP_LMS_DE)
+        m_LMS_denoise[rx_chan].Initialize(LMS_DENOISE_QRN, dsp->lms_de_delay, dsp->lms_de_beta, dsp->lms_de_decay, dsp->lms_de_block);
+    if (setup & SND_SETUP_LMS_AN)
+        m_LMS_autonotch[rx_chan].Initialize(LMS_AUTONOTCH_QRM, dsp->lms_an_delay, dsp->lms_an_beta, dsp->lms_an_decay, dsp->lms_an_block);
+}
+
+// S-meter, AGC, demod, de-emp and LMS of a FIR output block
+static void snd_dsp_demod(int rx_chan, snd_dsp_t *dsp, int ns_out)
+{
+    int j;
+    TYPECPX *f_samps = dsp->fir_samps;
+    bool masked = dsp->masked;
+
+    for (j=0; j<ns_out; j++) {
+
+        // S-meter from CuteSDR
+        // FIXME: Why is SND_MAX_VAL less than CUTESDR_MAX_VAL again?
+        // And does this explain the need for SMETER_CALIBRATION?
+        // Can't remember how this evolved..
+        #define SND_MAX_VAL ((float) ((1 << (CUTESDR_SCALE-2)) - 1))
+        #define SND_MAX_PWR (SND_MAX_VAL * SND_MAX_VAL)
+        float re = (float) f_samps[j].re, im = (float) f_samps[j].im;
+        float pwr = re*re + im*im;
+        float pwr_dB = 10.0 * log10f((pwr / SND_MAX_PWR) + 1e-30);
+        dsp->sMeterAvg_dB = (1.0 - dsp->sMeterAlpha)*dsp->sMeterAvg_dB + dsp->sMeterAlpha*pwr_dB;
+        if (j == 0) dsp->smeter_dB[0] = dsp->sMeterAvg_dB;
+        if (j == ns_out/2) dsp->smeter_dB[1] = dsp->sMeterAvg_dB;
+    }
+    
+    TYPEMONO16 *r_samps = dsp->r_samps;
+
+    switch (dsp->mode) {
+    
+    case MODE_AM:
+    case MODE_AMN: {
+        // AM detector from CuteSDR
+        TYPECPX *a_samps = dsp->agc_samples;
+        m_Agc[rx_chan].ProcessData(ns_out, f_samps, a_samps, masked);
+
+        TYPEREAL *d_samps = dsp->demod_samples;
+        double z1 = dsp->z1;
+
+        for (j=0; j<ns_out; j++) {
+            double pwr = a_samps->re*a_samps->re + a_samps->im*a_samps->im;
+            double mag = sqrt(pwr);
+            #define DC_ALPHA 0.99
+            double z0 = mag + (z1 * DC_ALPHA);
+            *d_samps = z0-z1;
+            z1 = z0;
+            d_samps++;
+            a_samps++;
+        }
+        dsp->z1 = z1;
+        
+        // clean up residual noise left by detector
+        // the non-FFT FIR has no pipeline delay issues
+        d_samps = dsp->demod_samples;
+        m_AM_FIR[rx_chan].ProcessFilter(ns_out, d_samps, r_samps);
+        break;
+    }
+    
+    case MODE_NBFM: {
+        TYPEREAL *d_samps = dsp->demod_samples;
+        TYPECPX *a_samps = dsp->agc_samples;
+        m_Agc[rx_chan].ProcessData(ns_out, f_samps, a_samps, masked);
+        
+        // FM demod from CSDR: https://github.com/simonyiszk/csdr
+        // also see: http://www.embedded.com/design/configurable-systems/4212086/DSP-Tricks--Frequency-demodulation-algorithms-
+        #define fmdemod_quadri_K 0.340447550238101026565118445432744920253753662109375
+        float i = a_samps->re, q = a_samps->im;
+        float iL = dsp->last_sample.re, qL = dsp->last_sample.im;
+        *d_samps = SND_MAX_VAL * fmdemod_quadri_K * (i*(q-qL) - q*(i-iL)) / (i*i + q*q);
+        dsp->last_sample = a_samps[ns_out-1];
+        a_samps++; d_samps++;
+        
+        for (j=1; j < ns_out; j++) {
+            i = a_samps->re, q = a_samps->im;
+            iL = a_samps[-1].re, qL = a_samps[-1].im;
+            *d_samps = SND_MAX_VAL * fmdemod_quadri_K * (i*(q-qL) - q*(i-iL)) / (i*i + q*q);
+            a_samps++; d_samps++;
+        }
+        
+        d_samps = dsp->demod_samples;
+
+        // use the noise squelch from CuteSDR
+        dsp->sq_nc_open = m_FmDemod[rx_chan].PerformNoiseSquelch(ns_out, d_samps, r_samps);
+        break;
+    }
+    
+    case MODE_IQ:
+    case MODE_DRM:
+        // NB: f_samps is left un-AGCed for receive_iq()
+        m_Agc[rx_chan].ProcessData(ns_out, f_samps, dsp->iq_samps, masked);
+        break;
+    
+    case MODE_USB:
+    case MODE_USN:
+    case MODE_LSB:
+    case MODE_LSN:
+    case MODE_CW:
+    case MODE_CWN:
+        m_Agc[rx_chan].ProcessData(ns_out, f_samps, r_samps, masked);
+        break;
+
+    default:
+        panic("mode");
+    }
+
+    if (dsp->do_de_emp) {    // AM and NBFM modes
+        m_de_emp_Biquad[rx_chan].ProcessFilter(ns_out, r_samps, r_samps);
+    }
+
+    if (dsp->do_lms) {       // AM and sideband modes
+
+        // noise processors
+        if (dsp->lms_denoise) m_LMS_denoise[rx_chan].ProcessFilter(ns_out, r_samps, r_samps);
+        if (dsp->lms_autonotch) m_LMS_autonotch[rx_chan].ProcessFilter(ns_out, r_samps, r_samps);
+    }
+}
+
+// One input block through the DSP chain. Runs in the audio offload process when MULTI_CORE
+// so must only use the snd_dsp_t in shared memory and the DSP objects.
+void snd_dsp(int rx_chan)
+{
+    snd_dsp_t *dsp = &SND_SHMEM->dsp[rx_chan];
+    u4_t start = timer_us();
+
+    if (dsp->setup) snd_dsp_setup(rx_chan, dsp);
+    
+    if (dsp->stages & SND_DSP_FIR) {
+        int ns_in = dsp->ns_in;
+        TYPECPX *i_samps = dsp->in_samps;
+    
+        if (dsp->noise_blanker) {
+            m_NoiseProc[rx_chan][NB_SND].ProcessBlanker(ns_in, i_samps, i_samps);
+        }
+    
+        dsp->ns_out = m_PassbandFIR[rx_chan].ProcessData(rx_chan, ns_in, i_samps, dsp->fir_samps);
+        dsp->fir_pos = m_PassbandFIR[rx_chan].FirPos();
+        dsp->agc_delay = m_Agc[rx_chan].GetDelaySamples();
+        dsp->sq_nc_open = 0;
+        dsp->blocks++;
+    }
+    
+    if ((dsp->stages & SND_DSP_DEMOD) && dsp->ns_out)
+        snd_dsp_demod(rx_chan, dsp, dsp->ns_out);
+
+    dsp->busy_us += timer_us() - start;
+}
+
+static void snd_dsp_invoke(int rx_chan)
+{
+    #ifdef SND_SHMEM_DISABLE
+        snd_dsp(rx_chan);
+    #else
+        shmem_ipc_invoke(SIG_IPC_SND + (rx_chan % snd_workers), rx_chan);
+    #endif
+}
+
+void c2s_sound_stats()
+{
+    int i;
+    static u4_t last_ms;
+    u4_t now = timer_ms();
+    float interval_us = (float) (now - last_ms) * 1e3;
+    last_ms = now;
+    
+    if ((print_stats & STATS_TASK) && interval_us > 0) {
+        float total = 0;
+        int active = 0;
+        lprintf("SND DSP busy:");
+        for (i = 0; i < rx_chans; i++) {
+            snd_dsp_t *dsp = &SND_SHMEM->dsp[i];
+            if (dsp->blocks == 0) continue;
+            float pct = dsp->busy_us / interval_us * 100;
+            real_printf(" rx%d %.1f%%", i, pct);
+            total += pct;
+            active++;
+        }
+        
+        // Rough capacity estimate: channels that fit in the cores doing the DSP at the current per-channel cost.
+        // Audio drops once the total approaches 100% per core.
+        if (active && total > 0) {
+            real_printf(" | total %.1f%% on %d %s, est max %d chans, dropped %d\n",
+                total, snd_workers? snd_workers : 1, snd_workers? "worker(s)" : "main core",
+                (int) (100.0 * (snd_workers? snd_workers : 1) / (total / active)), dpump.audio_dropped);
+        } else {
+            real_printf(" idle\n");
+        }
+    }
+    
+    for (i = 0; i < rx_chans; i++) {
+        snd_dsp_t *dsp = &SND_SHMEM->dsp[i];
+        dsp->busy_us = dsp->blocks = 0;
+    }
+}
+
 void c2s_sound_init()
 {
 	//evSnd(EC_DUMP, EV_SND, 10000, "rx task", "overrun");
@@ -92,6 +324,20 @@ void c2s_sound_init()
 		spi_set(CmdSetGen, 0, 0);
 		spi_set(CmdSetGenAttn, 0, 0);
 	}
+
+    // in the server process, after fft_plan_init() and before the workers are forked
+    for (int i = 0; i < rx_chans; i++)
+        m_PassbandFIR[i].MakePlans();
+
+#ifdef SND_SHMEM_DISABLE
+#else
+    // one worker per core other than core 0 (the server), each on its own core
+    int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    snd_workers = CLAMP(ncpu - 1, 1, N_SND_WORKERS);
+    for (int i = 0; i < snd_workers; i++)
+        shmem_ipc_setup(stprintf("kiwi.snd-%02d", i), SIG_IPC_SND + i, snd_dsp, 1 + i % MAX(ncpu - 1, 1));
+    printf("SND %d DSP workers\n", snd_workers);
+#endif
 }
 
 #define CMD_FREQ		0x01
@@ -120,6 +366,7 @@ void c2s_sound(void *param)
 	snd_t *snd = &snd_inst[rx_chan];
 	rx_dpump_t *rx = &rx_dpump[rx_chan];
     iq_buf_t *iq = &RX_SHMEM->iq_buf[rx_chan];
+    snd_dsp_t *dsp = &SND_SHMEM->dsp[rx_chan];
 	
 	int j, k, n, len, slen;
 	//static u4_t ncnt[MAX_RX_CHANS];
@@ -128,15 +375,16 @@ void c2s_sound(void *param)
 	double freq=-1, _freq, gen=-1, _gen, locut=0, _locut, hicut=0, _hicut, mix;
 	int mode=-1, _mode, genattn=0, _genattn, mute, test=0, de_emp=0;
 	int noise_blanker=0, noise_threshold=0, nb_click=0, last_noise_pulse=0;
-	int lms_denoise=0, lms_autonotch=0, lms_de_delay=0, lms_an_delay=0;
+	int lms_denoise=0, lms_autonotch=0, lms_de_delay=0, lms_an_delay=0, lms_de_block=0, lms_an_block=0;
 	float lms_de_beta=0, lms_an_beta=0, lms_de_decay=0, lms_an_decay=0;
-	double z1 = 0;
 
 	double frate = ext_update_get_sample_rateHz(rx_chan);      // FIXME: do this in loop to get incremental changes
 	//printf("### frate %f snd_rate %d\n", frate, snd_rate);
 	#define ATTACK_TIMECONST .01	// attack time in seconds
-	float sMeterAlpha = 1.0 - expf(-1.0/((float) frate * ATTACK_TIMECONST));
-	float sMeterAvg_dB = 0;
+	dsp->sMeterAlpha = 1.0 - expf(-1.0/((float) frate * ATTACK_TIMECONST));
+	dsp->sMeterAvg_dB = 0;
+	dsp->z1 = 0;
+	dsp->busy_us = dsp->blocks = 0;
 	int compression = 1;
 	bool little_endian = false;
 	
@@ -149,8 +397,9 @@ void c2s_sound(void *param)
         snd->snd_seq_ck_init = false;
     #endif
     
-	m_FmDemod[rx_chan].SetSampleRate(rx_chan, frate);
-	m_FmDemod[rx_chan].SetSquelch(0, 0);
+	dsp->frate = frate;
+	dsp->squelch = dsp->squelch_max = 0;
+	dsp->setup = SND_SETUP_FM_INIT | SND_SETUP_SQUELCH;
 	
 	// don't start data pump until first connection so GPS search can run at full speed on startup
 	static bool data_pump_started;
@@ -249,14 +498,22 @@ void c2s_sound(void *param)
 				}
 			#endif
 
-			n = sscanf(cmd, "SET dbgAudioStart=%d", &k);
-			if (n == 1) {
+			switch (rx_cmd_key(cmd)) {
+
+			case CMD_SET_DBG_AUDIO_START: {
+				n = sscanf(cmd, "SET dbgAudioStart=%d", &k);
+				if (n != 1) break;
 				continue;
 			}
 
-            char *mode_m = NULL;
-			n = sscanf(cmd, "SET mod=%16ms low_cut=%lf high_cut=%lf freq=%lf", &mode_m, &_locut, &_hicut, &_freq);
-			if (n == 4 && do_sdr) {
+			case CMD_SET_MOD: {
+				char *mode_m = NULL;
+				n = sscanf(cmd, "SET mod=%16ms low_cut=%lf high_cut=%lf freq=%lf", &mode_m, &_locut, &_hicut, &_freq);
+				if (n != 4 || !do_sdr) {
+				    free(mode_m);
+				    break;
+				}
+
 				//cprintf(conn, "SND f=%.3f lo=%.3f hi=%.3f mode=%s\n", _freq, _locut, _hicut, mode_m);
 
 				bool new_freq = false;
@@ -289,7 +546,7 @@ void c2s_sound(void *param)
 		            bool new_IQ_or_DRM = (_mode == MODE_IQ || _mode == MODE_DRM);
 				    if (IQ_or_DRM && !new_IQ_or_DRM && (cmd_recv & CMD_AGC)) {
 					    //cprintf(conn, "SND out IQ mode -> reset AGC, compression\n");
-                        m_Agc[rx_chan].SetParameters(agc, hang, thresh, manGain, slope, decay, frate);
+                        dsp->setup |= SND_SETUP_AGC;
 	                    memset(&rx->adpcm_snd, 0, sizeof(ima_adpcm_state_t));
                     }
 
@@ -301,8 +558,7 @@ void c2s_sound(void *param)
 				}
 
 				if (mode == MODE_NBFM && (new_freq || new_nbfm)) {
-					m_FmDemod[rx_chan].Reset();
-					conn->last_sample.re = conn->last_sample.im = 0;
+					dsp->setup |= SND_SETUP_FM_RESET;
 				}
 			
 				if (hicut != _hicut || locut != _locut) {
@@ -318,15 +574,15 @@ void c2s_sound(void *param)
 					if (bw > frate/2) bw = frate/2;
 					//cprintf(conn, "SND LOcut %.0f HIcut %.0f BW %.0f/%.0f\n", locut, hicut, bw, frate/2);
 					
-					#define CW_OFFSET 0		// fixme: how is cw offset handled exactly?
-					m_PassbandFIR[rx_chan].SetupParameters(locut, hicut, CW_OFFSET, frate);
+					dsp->locut = locut; dsp->hicut = hicut;
 					conn->half_bw = bw;
 					
 					// post AM detector filter
 					// FIXME: not needed if we're doing convolver-based LPF in javascript due to decompression?
 					float stop = bw*1.8;
 					if (stop > frate/2) stop = frate/2;
-					m_AM_FIR[rx_chan].InitLPFilter(0, 1.0, 50.0, bw, stop, frate);
+					dsp->bw = bw; dsp->stop = stop;
+					dsp->setup |= SND_SETUP_PASSBAND;
 					cmd_recv |= CMD_PASSBAND;
 					
 					change_LPF = true;
@@ -360,38 +616,39 @@ void c2s_sound(void *param)
 			    free(mode_m);
 				continue;
 			}
-			free(mode_m);
 			
-			int _comp;
-			n = sscanf(cmd, "SET compression=%d", &_comp);
-			if (n == 1) {
+			case CMD_SET_COMPRESSION: {
+				int _comp;
+				n = sscanf(cmd, "SET compression=%d", &_comp);
+				if (n != 1) break;
 				//printf("compression %d\n", _comp);
 				if (_comp && (compression != _comp)) {      // when enabling compression reset AGC, compression state
 				    if (cmd_recv & CMD_AGC)
-                        m_Agc[rx_chan].SetParameters(agc, hang, thresh, manGain, slope, decay, frate);
+                        dsp->setup |= SND_SETUP_AGC;
                     memset(&rx->adpcm_snd, 0, sizeof(ima_adpcm_state_t));
 				}
                 compression = _comp;
 				continue;
 			}
 
-			if (strcmp(cmd, "SET restart") == 0) {
+			case CMD_SET_RESTART: {
 				cprintf(conn, "SND restart\n");
                 if (cmd_recv & CMD_AGC)
-                    m_Agc[rx_chan].SetParameters(agc, hang, thresh, manGain, slope, decay, frate);
+                    dsp->setup |= SND_SETUP_AGC;
                 memset(&rx->adpcm_snd, 0, sizeof(ima_adpcm_state_t));
                 restart = true;
 				continue;
 			}
 
-			if (strcmp(cmd, "SET little-endian") == 0) {
+			case CMD_SET_LITTLE_ENDIAN: {
 				cprintf(conn, "SND little-endian\n");
 				little_endian = true;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET gen=%lf mix=%lf", &_gen, &mix);
-			if (n == 2) {
+			case CMD_SET_GEN: {
+				n = sscanf(cmd, "SET gen=%lf mix=%lf", &_gen, &mix);
+				if (n != 2) break;
 				//printf("MIX %f %d\n", mix, (int) mix);
 				if (gen != _gen) {
 					gen = _gen;
@@ -409,8 +666,9 @@ void c2s_sound(void *param)
 				continue;
 			}
 
-			n = sscanf(cmd, "SET genattn=%d", &_genattn);
-			if (n == 1) {
+			case CMD_SET_GENATTN: {
+				n = sscanf(cmd, "SET genattn=%d", &_genattn);
+				if (n != 1) break;
 				if (1 || genattn != _genattn) {
 					genattn = _genattn;
 					if (do_sdr) spi_set(CmdSetGenAttn, 0, (u4_t) genattn);
@@ -421,9 +679,10 @@ void c2s_sound(void *param)
 				continue;
 			}
 
-			n = sscanf(cmd, "SET agc=%d hang=%d thresh=%d slope=%d decay=%d manGain=%d",
-				&_agc, &_hang, &_thresh, &_slope, &_decay, &_manGain);
-			if (n == 6) {
+			case CMD_SET_AGC: {
+				n = sscanf(cmd, "SET agc=%d hang=%d thresh=%d slope=%d decay=%d manGain=%d",
+					&_agc, &_hang, &_thresh, &_slope, &_decay, &_manGain);
+				if (n != 6) break;
 				agc = _agc;
 				hang = _hang;
 				thresh = _thresh;
@@ -432,91 +691,121 @@ void c2s_sound(void *param)
 				manGain = _manGain;
 				//printf("AGC %d hang=%d thresh=%d slope=%d decay=%d manGain=%d srate=%.1f\n",
 				//	agc, hang, thresh, slope, decay, manGain, frate);
-				m_Agc[rx_chan].SetParameters(agc, hang, thresh, manGain, slope, decay, frate);
+				dsp->agc = agc; dsp->hang = hang; dsp->thresh = thresh;
+				dsp->manGain = manGain; dsp->slope = slope; dsp->decay = decay;
+				dsp->setup |= SND_SETUP_AGC;
 				cmd_recv |= CMD_AGC;
 				continue;
 			}
 
-			int squelch, squelch_max;
-			n = sscanf(cmd, "SET squelch=%d max=%d", &squelch, &squelch_max);
-			if (n == 2) {
+			case CMD_SET_SQUELCH: {
+				int squelch, squelch_max;
+				n = sscanf(cmd, "SET squelch=%d max=%d", &squelch, &squelch_max);
+				if (n != 2) break;
 			    //cprintf(conn, "SND squelch=%d max=%d\n", squelch, squelch_max);
-				m_FmDemod[rx_chan].SetSquelch(squelch, squelch_max);
+				dsp->squelch = squelch; dsp->squelch_max = squelch_max;
+				dsp->setup |= SND_SETUP_SQUELCH;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET lms_denoise=%d", &lms_denoise);
-			if (n == 1) {
+			case CMD_SET_LMS_DENOISE: {
+				n = sscanf(cmd, "SET lms_denoise=%d", &lms_denoise);
+				if (n != 1) break;
 				//printf("lms_denoise %d\n", lms_denoise);
 			    if (lms_denoise)
-	                m_LMS_denoise[rx_chan].Initialize(LMS_DENOISE_QRN, lms_de_delay, lms_de_beta, lms_de_decay);
+	                dsp->setup |= SND_SETUP_LMS_DE;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET lms.de_delay=%d", &lms_de_delay);
-			if (n == 1) {
+			case CMD_SET_LMS_DE_DELAY: {
+				n = sscanf(cmd, "SET lms.de_delay=%d", &lms_de_delay);
+				if (n != 1) break;
 				//printf("lms_de_delay %d\n", lms_de_delay);
-	            m_LMS_denoise[rx_chan].Initialize(LMS_DENOISE_QRN, lms_de_delay, lms_de_beta, lms_de_decay);
+	            dsp->setup |= SND_SETUP_LMS_DE;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET lms.de_beta=%f", &lms_de_beta);
-			if (n == 1) {
+			case CMD_SET_LMS_DE_BETA: {
+				n = sscanf(cmd, "SET lms.de_beta=%f", &lms_de_beta);
+				if (n != 1) break;
 				//printf("lms_de_beta %.3f\n", lms_de_beta);
-	            m_LMS_denoise[rx_chan].Initialize(LMS_DENOISE_QRN, lms_de_delay, lms_de_beta, lms_de_decay);
+	            dsp->setup |= SND_SETUP_LMS_DE;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET lms.de_decay=%f", &lms_de_decay);
-			if (n == 1) {
+			case CMD_SET_LMS_DE_DECAY: {
+				n = sscanf(cmd, "SET lms.de_decay=%f", &lms_de_decay);
+				if (n != 1) break;
 				//printf("lms_de_decay %.3f\n", lms_de_decay);
-	            m_LMS_denoise[rx_chan].Initialize(LMS_DENOISE_QRN, lms_de_delay, lms_de_beta, lms_de_decay);
+	            dsp->setup |= SND_SETUP_LMS_DE;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET lms_autonotch=%d", &lms_autonotch);
-			if (n == 1) {
+			case CMD_SET_LMS_DE_BLOCK: {
+				n = sscanf(cmd, "SET lms.de_block=%d", &lms_de_block);
+				if (n != 1) break;
+				//printf("lms_de_block %d\n", lms_de_block);
+	            dsp->setup |= SND_SETUP_LMS_DE;
+				continue;
+			}
+
+			case CMD_SET_LMS_AUTONOTCH: {
+				n = sscanf(cmd, "SET lms_autonotch=%d", &lms_autonotch);
+				if (n != 1) break;
 				//printf("lms_autonotch %d\n", lms_autonotch);
 			    if (lms_autonotch)
-	                m_LMS_autonotch[rx_chan].Initialize(LMS_AUTONOTCH_QRM, lms_an_delay, lms_an_beta, lms_an_decay);
+	                dsp->setup |= SND_SETUP_LMS_AN;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET lms.an_delay=%d", &lms_an_delay);
-			if (n == 1) {
+			case CMD_SET_LMS_AN_DELAY: {
+				n = sscanf(cmd, "SET lms.an_delay=%d", &lms_an_delay);
+				if (n != 1) break;
 				//printf("lms_an_delay %d\n", lms_an_delay);
-	            m_LMS_autonotch[rx_chan].Initialize(LMS_AUTONOTCH_QRM, lms_an_delay, lms_an_beta, lms_an_decay);
+	            dsp->setup |= SND_SETUP_LMS_AN;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET lms.an_beta=%f", &lms_an_beta);
-			if (n == 1) {
+			case CMD_SET_LMS_AN_BETA: {
+				n = sscanf(cmd, "SET lms.an_beta=%f", &lms_an_beta);
+				if (n != 1) break;
 				//printf("lms_an_beta %.3f\n", lms_an_beta);
-	            m_LMS_autonotch[rx_chan].Initialize(LMS_AUTONOTCH_QRM, lms_an_delay, lms_an_beta, lms_an_decay);
+	            dsp->setup |= SND_SETUP_LMS_AN;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET lms.an_decay=%f", &lms_an_decay);
-			if (n == 1) {
+			case CMD_SET_LMS_AN_DECAY: {
+				n = sscanf(cmd, "SET lms.an_decay=%f", &lms_an_decay);
+				if (n != 1) break;
 				//printf("lms_an_decay %.3f\n", lms_an_decay);
-	            m_LMS_autonotch[rx_chan].Initialize(LMS_AUTONOTCH_QRM, lms_an_delay, lms_an_beta, lms_an_decay);
+	            dsp->setup |= SND_SETUP_LMS_AN;
+				continue;
+			}
+
+			case CMD_SET_LMS_AN_BLOCK: {
+				n = sscanf(cmd, "SET lms.an_block=%d", &lms_an_block);
+				if (n != 1) break;
+				//printf("lms_an_block %d\n", lms_an_block);
+	            dsp->setup |= SND_SETUP_LMS_AN;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET mute=%d", &mute);
-			if (n == 1) {
+			case CMD_SET_MUTE: {
+				n = sscanf(cmd, "SET mute=%d", &mute);
+				if (n != 1) break;
 				//printf("mute %d\n", mute);
 				// FIXME: stop audio stream to save bandwidth?
 				continue;
 			}
 
             // https://dsp.stackexchange.com/questions/34605/biquad-cookbook-formula-for-broadcast-fm-de-emphasis
-            int _de_emp;
-			n = sscanf(cmd, "SET de_emp=%d", &_de_emp);
-			if (n == 1) {
+			case CMD_SET_DE_EMP: {
+				int _de_emp;
+				n = sscanf(cmd, "SET de_emp=%d", &_de_emp);
+				if (n != 1) break;
 				de_emp = _de_emp;
 				if (de_emp) {
-				    TYPEREAL a0, a1, a2, b0, b1, b2;
+				    TYPEREAL *c = dsp->de_emp_coef;
 				    
 				    // frate 20250 Hz: -20 dB @ 10 kHz
 				    //  This seems to be the natural filter response when Fs = frate.
@@ -528,27 +817,29 @@ void c2s_sound(void *param)
                     double T1 = (de_emp == 1)? 0.000075 : 0.000050;
                     double z1 = -exp(-1.0/(Fs*T1));
                     double p1 = 1.0 + z1;
-                    a0 = 1.0;
-                    a1 = p1;
-                    a2 = 0;
-                    b0 = 2.0;   // remove filter gain
-                    b1 = z1;
-                    b2 = 0;
-					m_de_emp_Biquad[rx_chan].InitFilterCoef(a0, a1, a2, b0, b1, b2);
+                    c[0] = 1.0;     // a0
+                    c[1] = p1;      // a1
+                    c[2] = 0;       // a2
+                    c[3] = 2.0;     // b0: remove filter gain
+                    c[4] = z1;      // b1
+                    c[5] = 0;       // b2
+					dsp->setup |= SND_SETUP_DE_EMP;
 					cprintf(conn, "SND de-emp: %dus frate %.0f\n", (de_emp == 1)? 75:50, frate);
 				}
 				continue;
 			}
 
-			n = sscanf(cmd, "SET test=%d", &test);
-			if (n == 1) {
+			case CMD_SET_TEST: {
+				n = sscanf(cmd, "SET test=%d", &test);
+				if (n != 1) break;
 				//printf("test %d\n", test);
 				continue;
 			}
 
-            int nb, th;
-			n = sscanf(cmd, "SET nb=%d th=%d", &nb, &th);
-			if (n == 2) {
+			case CMD_SET_NB: {
+				int nb, th;
+				n = sscanf(cmd, "SET nb=%d th=%d", &nb, &th);
+				if (n != 2) break;
 			    if (nb < 0) {
 			        nb_click = (nb == -1)? 1:0;
 			        continue;
@@ -557,27 +848,33 @@ void c2s_sound(void *param)
 			    noise_threshold = th;
 
 				if (noise_blanker) {
-                    m_NoiseProc[rx_chan][NB_SND].SetupBlanker("SND", (float) noise_threshold, (float) noise_blanker, frate);
+                    dsp->noise_blanker = noise_blanker;
+                    dsp->noise_threshold = noise_threshold;
+                    dsp->setup |= SND_SETUP_NB;
 				}
 				continue;
 			}
 
-			n = sscanf(cmd, "SET UAR in=%d out=%d", &arate_in, &arate_out);
-			if (n == 2) {
+			case CMD_SET_UAR: {
+				n = sscanf(cmd, "SET UAR in=%d out=%d", &arate_in, &arate_out);
+				if (n != 2) break;
 				//clprintf(conn, "UAR in=%d out=%d\n", arate_in, arate_out);
 				continue;
 			}
 
-			n = sscanf(cmd, "SET AR OK in=%d out=%d", &arate_in, &arate_out);
-			if (n == 2) {
+			case CMD_SET_AR: {
+				n = sscanf(cmd, "SET AR OK in=%d out=%d", &arate_in, &arate_out);
+				if (n != 2) break;
 				//clprintf(conn, "AR OK in=%d out=%d\n", arate_in, arate_out);
 				if (arate_out) cmd_recv |= CMD_AR_OK;
 				continue;
 			}
 
-			n = sscanf(cmd, "SET underrun=%d", &j);
-			if (n == 1) {
+			case CMD_SET_UNDERRUN: {
+				n = sscanf(cmd, "SET underrun=%d", &j);
+				if (n != 1) break;
 				conn->audio_underrun++;
+				rx->underruns++;
 				cprintf(conn, "SND: audio underrun %d %s -------------------------\n",
 					conn->audio_underrun, conn->user);
 				//if (ev_dump) evNT(EC_DUMP, EV_NEXTTASK, ev_dump, "NextTask", evprintf("DUMP IN %.3f SEC",
@@ -586,15 +883,20 @@ void c2s_sound(void *param)
 			}
 
 			#ifdef SND_SEQ_CHECK
+			case CMD_SET_SEQ: {
 				int _seq, _sequence;
 				n = sscanf(cmd, "SET seq=%d sequence=%d", &_seq, &_sequence);
-				if (n == 2) {
-					conn->sequence_errors++;
-					printf("SND%d: audio.js SEQ got %d, expecting %d, %s -------------------------\n",
-						rx_chan, _seq, _sequence, conn->user);
-					continue;
-				}
+				if (n != 2) break;
+				conn->sequence_errors++;
+				printf("SND%d: audio.js SEQ got %d, expecting %d, %s -------------------------\n",
+					rx_chan, _seq, _sequence, conn->user);
+				continue;
+			}
 			#endif
+
+			default:
+				break;
+			}
 			
 			if (conn->mc != NULL) {
 			    cprintf(conn, "SND BAD PARAMS: sl=%d %d|%d|%d [%s] ip=%s ####################################\n",
@@ -687,10 +989,13 @@ void c2s_sound(void *param)
 		bool isNBFM = (mode == MODE_NBFM);
 		bool IQ_or_DRM = (mode == MODE_IQ || mode == MODE_DRM);
 
-		u1_t *bp_real_u1  = snd->out_pkt_real.u1;
-		s2_t *bp_real_s2  = snd->out_pkt_real.s2;
-		u1_t *bp_iq_u1    = snd->out_pkt_iq.u1;
-		s2_t *bp_iq_s2    = snd->out_pkt_iq.s2;
+		// Samples are written straight into a pooled payload which is then queued without a copy
+		// (see nbuf.h). The header is built in snd->out_pkt_* and copied in just before sending.
+		char *pkt = nbuf_buf_alloc(IQ_or_DRM? sizeof(snd_pkt_iq_t) : sizeof(snd_pkt_real_t));
+		u1_t *bp_real_u1  = ((snd_pkt_real_t *) pkt)->u1;
+		s2_t *bp_real_s2  = ((snd_pkt_real_t *) pkt)->s2;
+		u1_t *bp_iq_u1    = ((snd_pkt_iq_t *) pkt)->u1;
+		s2_t *bp_iq_s2    = ((snd_pkt_iq_t *) pkt)->s2;
 		u1_t *flags    = (IQ_or_DRM? &snd->out_pkt_iq.h.flags : &snd->out_pkt_real.h.flags);
 		u1_t *seq      = (IQ_or_DRM? snd->out_pkt_iq.h.seq    : snd->out_pkt_real.h.seq);
 		char *smeter   = (IQ_or_DRM? snd->out_pkt_iq.h.smeter : snd->out_pkt_real.h.smeter);
@@ -715,7 +1020,7 @@ void c2s_sound(void *param)
 		TYPECPX *f_samps;
 
         do {
-			while (rx->wr_pos == rx->rd_pos) {
+			while (spsc_empty(&rx->in_ring)) {
 				evSnd(EC_EVENT, EV_SND, -1, "rx_snd", "sleeping");
 
                 //#define MEAS_SND_LOOP
@@ -745,10 +1050,12 @@ void c2s_sound(void *param)
 			
         	TaskStat2(TSTAT_INCR|TSTAT_ZERO, 0, "aud");
 
-			TYPECPX *i_samps = rx->in_samps[rx->rd_pos];
+			u4_t slot = spsc_rd_slot(&rx->in_ring);
+			TYPECPX *i_samps = dsp->in_samps;
+			memcpy(i_samps, rx->in_samps[slot], sizeof(TYPECPX) * nrx_samps);
 
 			// check 48-bit ticks counter timestamp in audio IQ stream
-			const u64_t ticks   = rx->ticks[rx->rd_pos];
+			const u64_t ticks   = rx->ticks[slot];
 			const u64_t dt      = time_diff48(ticks, clk.ticks);  // time difference to last GPS solution
 #if 0
 			static u64_t last_ticks[MAX_RX_CHANS] = {0};
@@ -771,18 +1078,18 @@ void c2s_sound(void *param)
 			gps_tsp->gpssec = fmod(gps_week_sec + clk.gps_secs + dt/clk.adc_clock_base - gps_delay + gps_delay2, gps_week_sec);
 
 		    #ifdef SND_SEQ_CHECK
-		        if (rx->in_seq[rx->rd_pos] != snd->snd_seq_ck) {
+		        if (rx->in_seq[slot] != snd->snd_seq_ck) {
 		            if (!snd->snd_seq_ck_init) {
 		                snd->snd_seq_ck_init = true;
 		            } else {
-		                real_printf("rx%d: got %d expecting %d\n", rx_chan, rx->in_seq[rx->rd_pos], snd->snd_seq_ck);
+		                real_printf("rx%d: got %d expecting %d\n", rx_chan, rx->in_seq[slot], snd->snd_seq_ck);
 		            }
-		            snd->snd_seq_ck = rx->in_seq[rx->rd_pos];
+		            snd->snd_seq_ck = rx->in_seq[slot];
 		        }
 		        snd->snd_seq_ck++;
 		    #endif
 		    
-			rx->rd_pos = (rx->rd_pos+1) & (N_DPBUF-1);
+			spsc_consume(&rx->in_ring);
 			
 			f_samps = &iq->iq_samples[iq->iq_wr_pos][0];
 			const int ns_in = nrx_samps;
@@ -801,12 +1108,24 @@ void c2s_sound(void *param)
                 }
             }
 
-			if (noise_blanker) {
-                m_NoiseProc[rx_chan][NB_SND].ProcessBlanker(ns_in, i_samps, i_samps);
-            }
-
-			ns_out  = m_PassbandFIR[rx_chan].ProcessData(rx_chan, ns_in, i_samps, f_samps);
-			fir_pos = m_PassbandFIR[rx_chan].FirPos();
+			dsp->ns_in = ns_in;
+			dsp->mode = mode;
+			dsp->masked = masked;
+			dsp->noise_blanker = noise_blanker;
+			dsp->do_de_emp = do_de_emp;
+			dsp->do_lms = do_lms;
+			dsp->lms_denoise = lms_denoise;
+			dsp->lms_autonotch = lms_autonotch;
+			dsp->lms_de_delay = lms_de_delay; dsp->lms_de_beta = lms_de_beta; dsp->lms_de_decay = lms_de_decay;
+			dsp->lms_an_delay = lms_an_delay; dsp->lms_an_beta = lms_an_beta; dsp->lms_an_decay = lms_an_decay;
+			dsp->lms_de_block = lms_de_block; dsp->lms_an_block = lms_an_block;
+
+			// noise blanker, passband FIR, AGC, demod, de-emp and LMS (on another core when MULTI_CORE)
+			// With a receive_iq() only the FIR is done here, the rest after receive_iq() below.
+			dsp->stages = (receive_iq != NULL)? SND_DSP_FIR : (SND_DSP_FIR | SND_DSP_DEMOD);
+			snd_dsp_invoke(rx_chan);
+			ns_out  = dsp->ns_out;
+			fir_pos = dsp->fir_pos;
             // [this diagram was back when the audio buffer was 1/2 its current size and NRX_SAMPS = 84]
             //
 			// FIR has a pipeline delay:
@@ -841,7 +1160,7 @@ void c2s_sound(void *param)
             int sample_filter_delays = norm_nrx_samps - fir_pos;
             //  (2) delay in AGC (if on)
             if (agc)
-                sample_filter_delays -= m_Agc[rx_chan].GetDelaySamples();
+                sample_filter_delays -= dsp->agc_delay;
             gps_tsp->gpssec = fmod(gps_week_sec + gps_tsp->gpssec + rx_decim * sample_filter_delays / clk.adc_clock_base,
                                           gps_week_sec);
     
@@ -855,132 +1174,39 @@ void c2s_sound(void *param)
             snd->out_pkt_iq.h.dummy = 0;
             gps_tsp->last_gpssec = gps_tsp->gpssec;
     
-            // Forward IQ samples if requested.
+            // Forward IQ samples (before AGC) if requested.
             // Remember that receive_iq() is used to pushback test data in some cases, e.g. DRM
-            if (receive_iq != NULL)
-                receive_iq(rx_chan, 0, ns_out, f_samps);
+            // so the rest of the chain must only run after it.
+            if (receive_iq != NULL) {
+                receive_iq(rx_chan, 0, ns_out, dsp->fir_samps);
+                dsp->stages = SND_DSP_DEMOD;
+                snd_dsp_invoke(rx_chan);
+            }
             
             if (receive_iq_tid != (tid_t) NULL)
                 TaskWakeup(receive_iq_tid, TWF_CHECK_WAKING, TO_VOID_PARAM(rx_chan));
     
-            // delay updating iq_wr_pos until after AGC applied below
-            
-            TYPECPX *f_sa = f_samps;
-            for (j=0; j<ns_out; j++) {
-    
-                // S-meter from CuteSDR
-                // FIXME: Why is SND_MAX_VAL less than CUTESDR_MAX_VAL again?
-                // And does this explain the need for SMETER_CALIBRATION?
-                // Can't remember how this evolved..
-                #define SND_MAX_VAL ((float) ((1 << (CUTESDR_SCALE-2)) - 1))
-                #define SND_MAX_PWR (SND_MAX_VAL * SND_MAX_VAL)
-                float re = (float) f_sa->re, im = (float) f_sa->im;
-                float pwr = re*re + im*im;
-                float pwr_dB = 10.0 * log10f((pwr / SND_MAX_PWR) + 1e-30);
-                sMeterAvg_dB = (1.0 - sMeterAlpha)*sMeterAvg_dB + sMeterAlpha*pwr_dB;
-                f_sa++;
-            
-                // forward S-meter samples if requested
-                // S-meter value in audio packet is sent less often than if we send it from here
-                if (receive_S_meter != NULL && (j == 0 || j == ns_out/2))
-                    receive_S_meter(rx_chan, sMeterAvg_dB + S_meter_cal);
+            // IQ and DRM modes have AGC applied by snd_dsp()
+            memcpy(f_samps, IQ_or_DRM? dsp->iq_samps : dsp->fir_samps, sizeof(TYPECPX) * ns_out);
+
+            // forward S-meter samples if requested
+            // S-meter value in audio packet is sent less often than if we send it from here
+            if (receive_S_meter != NULL) {
+                receive_S_meter(rx_chan, dsp->smeter_dB[0] + S_meter_cal);
+                receive_S_meter(rx_chan, dsp->smeter_dB[1] + S_meter_cal);
             }
             
             TYPEMONO16 *r_samps;
             
             if (!IQ_or_DRM) {
                 r_samps = &rx->real_samples[rx->real_wr_pos][0];
+                memcpy(r_samps, dsp->r_samps, sizeof(TYPEMONO16) * ns_out);
                 rx->real_seqnum[rx->real_wr_pos] = rx->real_seq;
                 rx->real_seq++;
             }
             
-            switch (mode) {
-            
-            case MODE_AM:
-            case MODE_AMN: {
-                // AM detector from CuteSDR
-                TYPECPX *a_samps = rx->agc_samples;
-                m_Agc[rx_chan].ProcessData(ns_out, f_samps, a_samps, masked);
-    
-                TYPEREAL *d_samps = rx->demod_samples;
-    
-                for (j=0; j<ns_out; j++) {
-                    double pwr = a_samps->re*a_samps->re + a_samps->im*a_samps->im;
-                    double mag = sqrt(pwr);
-                    #define DC_ALPHA 0.99
-                    double z0 = mag + (z1 * DC_ALPHA);
-                    *d_samps = z0-z1;
-                    z1 = z0;
-                    d_samps++;
-                    a_samps++;
-                }
-                
-                // clean up residual noise left by detector
-                // the non-FFT FIR has no pipeline delay issues
-                d_samps = rx->demod_samples;
-                m_AM_FIR[rx_chan].ProcessFilter(ns_out, d_samps, r_samps);
-                break;
-            }
-            
-            case MODE_NBFM: {
-                TYPEREAL *d_samps = rx->demod_samples;
-                TYPECPX *a_samps = rx->agc_samples;
-                m_Agc[rx_chan].ProcessData(ns_out, f_samps, a_samps, masked);
-                int sq_nc_open;
-                
-                // FM demod from CSDR: https://github.com/simonyiszk/csdr
-                // also see: http://www.embedded.com/design/configurable-systems/4212086/DSP-Tricks--Frequency-demodulation-algorithms-
-                #define fmdemod_quadri_K 0.340447550238101026565118445432744920253753662109375
-                float i = a_samps->re, q = a_samps->im;
-                float iL = conn->last_sample.re, qL = conn->last_sample.im;
-                *d_samps = SND_MAX_VAL * fmdemod_quadri_K * (i*(q-qL) - q*(i-iL)) / (i*i + q*q);
-                conn->last_sample = a_samps[ns_out-1];
-                a_samps++; d_samps++;
-                
-                for (j=1; j < ns_out; j++) {
-                    i = a_samps->re, q = a_samps->im;
-                    iL = a_samps[-1].re, qL = a_samps[-1].im;
-                    *d_samps = SND_MAX_VAL * fmdemod_quadri_K * (i*(q-qL) - q*(i-iL)) / (i*i + q*q);
-                    a_samps++; d_samps++;
-                }
-                
-                d_samps = rx->demod_samples;
-    
-                // use the noise squelch from CuteSDR
-                sq_nc_open = m_FmDemod[rx_chan].PerformNoiseSquelch(ns_out, d_samps, r_samps);
-                
-                if (sq_nc_open != 0) {
-                    send_msg(conn, SM_NO_DEBUG, "MSG squelch=%d", (sq_nc_open == 1)? 1:0);
-                }
-                break;
-            }
-            
-            case MODE_IQ:
-            case MODE_DRM:
-                break;
-            
-            case MODE_USB:
-            case MODE_USN:
-            case MODE_LSB:
-            case MODE_LSN:
-            case MODE_CW:
-            case MODE_CWN:
-                m_Agc[rx_chan].ProcessData(ns_out, f_samps, r_samps, masked);
-                break;
-    
-            default:
-                panic("mode");
-            }
-    
-            if (do_de_emp) {    // AM and NBFM modes
-                m_de_emp_Biquad[rx_chan].ProcessFilter(ns_out, r_samps, r_samps);
-            }
-    
-            if (do_lms) {       // AM and sideband modes
-    
-                // noise processors
-                if (lms_denoise) m_LMS_denoise[rx_chan].ProcessFilter(ns_out, r_samps, r_samps);
-                if (lms_autonotch) m_LMS_autonotch[rx_chan].ProcessFilter(ns_out, r_samps, r_samps);
+            if (dsp->sq_nc_open != 0) {
+                send_msg(conn, SM_NO_DEBUG, "MSG squelch=%d", (dsp->sq_nc_open == 1)? 1:0);
             }
             
             
@@ -993,8 +1219,7 @@ void c2s_sound(void *param)
                 || (mode == MODE_DRM && (drm->monitor || rx_chan >= DRM_MAX_RX))
             #endif
             ){
-                m_Agc[rx_chan].ProcessData(ns_out, f_samps, f_samps, masked);
-                iq->iq_wr_pos = (iq->iq_wr_pos+1) & (N_DPBUF-1);    // after AGC above
+                iq->iq_wr_pos = (iq->iq_wr_pos+1) & (N_DPBUF-1);
 
                 #if 0
                     if (ns_out) for (int i=0; i < ns_out; i++) {
@@ -1064,8 +1289,7 @@ void c2s_sound(void *param)
                 
                 else
                 if (mode == MODE_DRM) {
-                    m_Agc[rx_chan].ProcessData(ns_out, f_samps, f_samps, masked);
-                    iq->iq_wr_pos = (iq->iq_wr_pos+1) & (N_DPBUF-1);    // after AGC above
+                    iq->iq_wr_pos = (iq->iq_wr_pos+1) & (N_DPBUF-1);
 
                     drm_buf_t *drm_buf = &DRM_SHMEM->drm_buf[rx_chan];
                     int pkt_remain = FASTFIR_OUTBUF_SIZE;
@@ -1138,7 +1362,7 @@ void c2s_sound(void *param)
                 
         // send s-meter data with each audio packet
         #define SMETER_BIAS 127.0
-        float sMeter_dBm = sMeterAvg_dB + S_meter_cal;
+        float sMeter_dBm = dsp->sMeterAvg_dB + S_meter_cal;
         if (sMeter_dBm < -127.0) sMeter_dBm = -127.0; else
         if (sMeter_dBm >    3.4) sMeter_dBm =    3.4;
         u2_t sMeter = (u2_t) ((sMeter_dBm + SMETER_BIAS) * 10);
@@ -1184,14 +1408,17 @@ void c2s_sound(void *param)
                 snd->out_pkt_iq.h.gpssec = 0;
                 snd->out_pkt_iq.h.gpsnsec = 0;
             }
+            memcpy(pkt, &snd->out_pkt_iq.h, sizeof(snd->out_pkt_iq.h));
             const int bytes = sizeof(snd->out_pkt_iq.h) + bc;
-            app_to_web(conn, (char*) &snd->out_pkt_iq, bytes);
+            app_to_web_buf(conn, pkt, bytes);
             aud_bytes = sizeof(snd->out_pkt_iq.h.smeter) + bc;
         } else {
+            memcpy(pkt, &snd->out_pkt_real.h, sizeof(snd->out_pkt_real.h));
             const int bytes = sizeof(snd->out_pkt_real.h) + bc;
-            app_to_web(conn, (char*) &snd->out_pkt_real, bytes);
+            app_to_web_buf(conn, pkt, bytes);
             aud_bytes = sizeof(snd->out_pkt_real.h.smeter) + bc;
         }
+        nbuf_buf_unref(pkt);
         audio_bytes[rx_chan] += aud_bytes;
         audio_bytes[rx_chans] += aud_bytes;     // [rx_chans] is the sum of all audio channels
 
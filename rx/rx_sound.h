@@ -67,3 +67,81 @@ typedef struct {
 } snd_t;
 
 extern snd_t snd_inst[MAX_RX_CHANS];
+
+// Per-channel audio DSP chain: noise blanker, passband FIR, AGC, demod, de-emphasis, LMS.
+// With MULTI_CORE it runs in the audio offload process(es) while c2s_sound() keeps doing the I/O.
+// The DSP objects (m_Agc[] etc) only live in the offload process so setup requests
+// are passed as SND_SETUP_* bits with the parameters and applied before the next block.
+
+#define SND_SETUP_FM_INIT   0x0001
+#define SND_SETUP_FM_RESET  0x0002
+#define SND_SETUP_SQUELCH   0x0004
+#define SND_SETUP_AGC       0x0008
+#define SND_SETUP_PASSBAND  0x0010      // includes post AM detector LPF
+#define SND_SETUP_DE_EMP    0x0020
+#define SND_SETUP_NB        0x0040
+#define SND_SETUP_LMS_DE    0x0080
+#define SND_SETUP_LMS_AN    0x0100
+
+// Which part of the chain an invoke runs. c2s_sound() splits a block in two when an extension
+// uses receive_iq(), which sees (and for test data pushback replaces) the FIR output before AGC.
+#define SND_DSP_FIR         0x1     // noise blanker, passband FIR
+#define SND_DSP_DEMOD       0x2     // S-meter, AGC, demod, de-emp, LMS of the FIR output
+
+typedef struct {
+    // written by c2s_sound()
+    u4_t setup, stages;
+    int mode, ns_in;
+    bool masked, do_de_emp, do_lms;
+    int noise_blanker, noise_threshold, lms_denoise, lms_autonotch;
+    double frate;
+    int agc, hang, thresh, manGain, slope, decay;
+    double locut, hicut;
+    float bw, stop;
+    int squelch, squelch_max;
+    TYPEREAL de_emp_coef[6];
+    int lms_de_delay, lms_an_delay;
+    int lms_de_block, lms_an_block;     // block LMS filter length, 0 = time-domain LMSLEN taps
+    float lms_de_beta, lms_an_beta, lms_de_decay, lms_an_decay;
+    TYPECPX in_samps[FASTFIR_OUTBUF_SIZE];
+
+    // private to snd_dsp()
+    double z1;
+    TYPECPX last_sample;
+    float sMeterAlpha;
+    TYPECPX agc_samples[FASTFIR_OUTBUF_SIZE];
+    TYPEREAL demod_samples[FASTFIR_OUTBUF_SIZE];
+
+    // results, valid after snd_dsp() returns
+    int ns_out, fir_pos, agc_delay, sq_nc_open;
+    float sMeterAvg_dB, smeter_dB[2];       // S-meter average at sample 0 and ns_out/2
+    TYPECPX fir_samps[FASTFIR_OUTBUF_SIZE];     // passband FIR output, before AGC
+    TYPECPX iq_samps[FASTFIR_OUTBUF_SIZE];      // IQ/DRM modes: after AGC
+    TYPEMONO16 r_samps[FASTFIR_OUTBUF_SIZE];    // other modes: audio
+
+    u4_t busy_us, blocks;
+} snd_dsp_t;
+
+typedef struct {
+    snd_dsp_t dsp[MAX_RX_CHANS];
+} snd_shmem_t;
+
+// Channels are spread over the worker processes by rx_chan.
+// A worker serves its channels one block at a time.
+// There is one worker per core other than core 0, pinned to it, up to N_SND_WORKERS.
+#define N_SND_WORKERS   4       // max, each takes a real-time signal (SIG_MAX_USED)
+
+#ifdef MULTI_CORE
+    //#define SND_SHMEM_DISABLE
+#else
+    #define SND_SHMEM_DISABLE
+#endif
+
+#ifdef SND_SHMEM_DISABLE
+    extern snd_shmem_t *snd_shmem_p;
+    #define SND_SHMEM snd_shmem_p
+    #define N_SND_IPC 0
+#else
+    #define SND_SHMEM (&shmem->snd_shmem)
+    #define N_SND_IPC N_SND_WORKERS
+#endif
@@ -470,6 +470,15 @@ void webserver_collect_print_stats(int print)
 		if (c == NULL || !c->valid) continue;
         //assert(c->type == STREAM_SOUND || c->type == STREAM_WATERFALL);
 		
+		// websocket frames per send() syscall over the stats interval
+		if (print && c->mc) {
+		    struct mg_connection *mc = c->mc;
+		    if (mc->sock_sends)
+		        cprintf(c, "WS frames %d sends %d = %.1f frames/send\n",
+		            mc->ws_frames, mc->sock_sends, (float) mc->ws_frames / mc->sock_sends);
+		    mc->ws_frames = mc->sock_sends = 0;
+		}
+		
 		u4_t now = timer_sec();
 		if (c->freqHz != c->last_freqHz || c->mode != c->last_mode || c->zoom != c->last_zoom) {
 			if (print) rx_loguser(c, LOG_UPDATE);
@@ -21,6 +21,7 @@ Boston, MA  02110-1301, USA.
 #include "types.h"
 #include "config.h"
 #include "kiwi.h"
+#include "rx_cmd_key.h"
 #include "clk.h"
 #include "misc.h"
 #include "nbuf.h"
@@ -39,6 +40,7 @@ Boston, MA  02110-1301, USA.
 #include "non_block.h"
 #include "rx_waterfall.h"
 #include "shmem.h"
+#include "simd.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -98,7 +100,7 @@ void c2s_waterfall_init()
 	// and cause the data pump to overrun
 	for (i=0; i < MAX_WF_CHANS; i++) {
 	    fft_t *fft = &WF_SHMEM->fft_inst[i];
-		fft->hw_dft_plan = fftwf_plan_dft_1d(WF_C_NSAMPS, fft->hw_c_samps, fft->hw_fft, FFTW_FORWARD, FFTW_MEASURE);
+		fft->hw_dft_plan = fft_plan_dft_1d("WF", WF_C_NSAMPS, fft->hw_c_samps, fft->hw_fft, FFTW_FORWARD, FFTW_MEASURE);
 	}
 
 	float adc_scale_decim = powf(2, -16);		// gives +/- 0.5 float samples
@@ -216,6 +218,8 @@ void c2s_waterfall(void *param)
     wf->mark = timer_ms();
     wf->prev_start = wf->prev_zoom = -1;
     wf->snd = &snd_inst[rx_chan];
+    wf->fft_src = rx_chan;
+    if (rx_chan < MAX_WF_CHANS) WF_SHMEM->fft_inst[rx_chan].cache_valid = false;
 
     wf->check_overlapped_sampling = true;
     int n_chunks = WF_SHMEM->n_chunks;
@@ -278,8 +282,10 @@ void c2s_waterfall(void *param)
 				}
 			#endif
 
-            bool zoom_start_chg = false;
-            if (kiwi_str_begins_with(cmd, "SET zoom=")) {
+			switch (rx_cmd_key(cmd)) {
+
+			case CMD_SET_ZOOM: {
+                bool zoom_start_chg = false;
                 if (sscanf(cmd, "SET zoom=%d start=%f", &_zoom, &_start) == 2) {
                     //cprintf(conn, "WF: zoom=%d/%d start=%.3f(%.1f)\n", _zoom, zoom, _start, _start * HZperStart / kHz);
                     _zoom = CLAMP(_zoom, 0, MAX_ZOOM);
@@ -292,9 +298,8 @@ void c2s_waterfall(void *param)
                     //cprintf(conn, "WF: zoom=%d cf=%.3f start=%.3f halfSpan=%.3f\n", _zoom, cf, _start * HZperStart / kHz, halfSpan_Hz/kHz);
                     zoom_start_chg = true;
                 }
-            }
+                if (!zoom_start_chg) break;
 			
-            if (zoom_start_chg) {
 				if (zoom != _zoom) {
 				    zoom = _zoom;
 				    
@@ -425,8 +430,9 @@ void c2s_waterfall(void *param)
 				continue;
 			}
 			
-			i = sscanf(cmd, "SET maxdb=%d mindb=%d", &wf->maxdb, &wf->mindb);
-			if (i == 2) {
+			case CMD_SET_MAXDB: {
+				i = sscanf(cmd, "SET maxdb=%d mindb=%d", &wf->maxdb, &wf->mindb);
+				if (i != 2) break;
 				#ifdef WF_INFO
 				printf("waterfall: maxdb=%d mindb=%d\n", wf->maxdb, wf->mindb);
 				#endif
@@ -434,8 +440,9 @@ void c2s_waterfall(void *param)
 				continue;
 			}
 
-			i = sscanf(cmd, "SET band=%d", &_wband);
-			if (i == 1) {
+			case CMD_SET_BAND: {
+				i = sscanf(cmd, "SET band=%d", &_wband);
+				if (i != 1) break;
 				//printf("waterfall: band=%d\n", _wband);
 				if (wband != _wband) {
 					wband = _wband;
@@ -444,8 +451,9 @@ void c2s_waterfall(void *param)
 				continue;
 			}
 
-			i = sscanf(cmd, "SET scale=%d", &_scale);
-			if (i == 1) {
+			case CMD_SET_SCALE: {
+				i = sscanf(cmd, "SET scale=%d", &_scale);
+				if (i != 1) break;
 				//printf("waterfall: scale=%d\n", _scale);
 				if (scale != _scale) {
 					scale = _scale;
@@ -454,8 +462,9 @@ void c2s_waterfall(void *param)
 				continue;
 			}
 
-			i = sscanf(cmd, "SET wf_speed=%d", &_speed);
-			if (i == 1) {
+			case CMD_SET_WF_SPEED: {
+				i = sscanf(cmd, "SET wf_speed=%d", &_speed);
+				if (i != 1) break;
 				//printf("W/F wf_speed=%d\n", _speed);
 				if (_speed == -1) _speed = WF_NSPEEDS-1;
 				if (_speed >= 0 && _speed < WF_NSPEEDS)
@@ -465,9 +474,10 @@ void c2s_waterfall(void *param)
 				continue;
 			}
 
-            int nb, th;
-			i = sscanf(cmd, "SET nb=%d th=%d", &nb, &th);
-			if (i == 2) {
+			case CMD_SET_NB: {
+				int nb, th;
+				i = sscanf(cmd, "SET nb=%d th=%d", &nb, &th);
+				if (i != 2) break;
 			    if (nb < 0) {
 			        wf->nb_click = (nb == -1)? 1:0;
 			        continue;
@@ -484,19 +494,25 @@ void c2s_waterfall(void *param)
 				continue;
 			}
 
-			i = sscanf(cmd, "SET send_dB=%d", &wf->send_dB);
-			if (i == 1) {
+			case CMD_SET_SEND_DB: {
+				i = sscanf(cmd, "SET send_dB=%d", &wf->send_dB);
+				if (i != 1) break;
 				//cprintf(conn, "W/F send_dB=%d\n", wf->send_dB);
 				continue;
 			}
 
 			// FIXME: keep these from happening in the first place?
-			int ch;
-			i = sscanf(cmd, "SET ext_blur=%d", &ch);
-			if (i == 1) {
+			case CMD_SET_EXT_BLUR: {
+				int ch;
+				i = sscanf(cmd, "SET ext_blur=%d", &ch);
+				if (i != 1) break;
 				continue;
 			}
 
+			default:
+				break;
+			}
+
 			if (conn->mc != NULL) {
 			    cprintf(conn, "W/F BAD PARAMS: sl=%d %d|%d|%d [%s] ip=%s ####################################\n",
 			        strlen(cmd), cmd[0], cmd[1], cmd[2], cmd, conn->remote_ip);
@@ -509,7 +525,9 @@ void c2s_waterfall(void *param)
 		}
 		
 		if (do_gps && !do_sdr) {
-			wf_pkt_t *out = &wf->out;
+			char *pkt = nbuf_buf_alloc(sizeof(wf_pkt_t));
+			wf_pkt_t *out = (wf_pkt_t *) pkt;
+			memcpy(out, &wf->out, SO_OUT_HDR);
 			int *ns_bin = ClockBins();
 			int max=0;
 			
@@ -522,7 +540,8 @@ void c2s_waterfall(void *param)
 			int delay = 10000 - (timer_ms() - wf->mark);
 			if (delay > 0) TaskSleepReasonMsec("wait frame", delay);
 			wf->mark = timer_ms();
-			app_to_web(conn, (char*) &out, SO_OUT_NOM);
+			app_to_web_buf(conn, pkt, SO_OUT_NOM);
+			nbuf_buf_unref(pkt);
 		}
 		
 		if (!do_sdr) {
@@ -632,6 +651,23 @@ void c2s_waterfall(void *param)
 					}
 				#endif
 				//for (i=0; i<wf->fft_used; i++) printf("%d>%d ", i, wf->fft2wf_map[i]);
+
+				// run-length encode the map so compute_frame() can reduce each plot bin with simd_bin_reduce()
+				wf->n_runs = 0;
+				for (i=0; i<wf->fft_used; i++) {
+					int bin = wf->fft2wf_map[i];
+					if (bin >= WF_WIDTH) {
+						wf->fft_used_limit = i;		// we now know what the limit is
+						break;
+					}
+					if (wf->n_runs == 0 || wf->run_bin[wf->n_runs-1] != bin) {
+						assert(wf->n_runs < ARRAY_LEN(wf->run_bin));
+						wf->run_bin[wf->n_runs] = bin;
+						wf->run_len[wf->n_runs] = 0;
+						wf->n_runs++;
+					}
+					wf->run_len[wf->n_runs-1]++;
+				}
 			} else {
 				// < FFT than plot
 				#ifdef WF_FFT_UNWRAP_NEEDED
@@ -717,6 +753,77 @@ void c2s_waterfall(void *param)
 	}
 }
 
+static void wf_make_key(wf_inst_t *wf, wf_key_t *key)
+{
+    memset(key, 0, sizeof(wf_key_t));
+    key->zoom = wf->zoom;
+    key->start = wf->start;
+    key->speed = wf->speed;
+    key->noise_blanker = wf->noise_blanker;
+    key->noise_threshold = wf->noise_threshold;
+    key->nb_click = wf->nb_click;
+}
+
+// Find another channel currently producing frames with the same key.
+// Only producers (fft_src == own channel) are considered so there is never a chain of followers.
+static int wf_cache_lookup(int rx_chan, wf_key_t *key, int desired)
+{
+    u4_t now = timer_ms();
+    
+    for (int ch = 0; ch < wf_num; ch++) {
+        if (ch == rx_chan) continue;
+        wf_inst_t *wf = &WF_SHMEM->wf_inst[ch];
+        fft_t *fft = &WF_SHMEM->fft_inst[ch];
+        if (wf->conn == NULL || !wf->isWF || wf->fft_src != ch || !fft->cache_valid) continue;
+        if (now - fft->cache_ms > 2*desired + wf->samp_wait_ms) continue;      // producer has stopped or gone away
+        if (memcmp(&fft->cache_key, key, sizeof(wf_key_t)) == 0) return ch;
+    }
+    
+    return -1;
+}
+
+static void compute_frame_out(int rx_chan, wf_pkt_t *out);
+
+static void wf_send_frame(wf_inst_t *wf)
+{
+    int rx_chan = wf->rx_chan;
+    
+    // The frame is built directly in a pooled payload and queued without a copy (see nbuf.h).
+    // Except when compute_frame() runs in the other process, then it comes back through WF_SHMEM.
+    // Frames can't be shared between connections: even a channel using another one's FFT has its
+    // own dB range, compression and audio sequence number.
+    char *pkt = nbuf_buf_alloc(sizeof(wf_pkt_t));
+    wf_pkt_t *out = (wf_pkt_t *) pkt;
+    memcpy(out->id4, wf->out.id4, sizeof(out->id4));
+
+    #ifdef WF_SHMEM_DISABLE
+        compute_frame_out(rx_chan, out);
+    #else
+        #ifdef WF_IPC_SAMPLE_WF
+            compute_frame_out(rx_chan, out);
+        #else
+            shmem_ipc_invoke(SIG_IPC_WF, wf->rx_chan);      // invoke compute_frame()
+            memcpy(out, &wf->out, SO_OUT_HDR + wf->out_bytes);
+        #endif
+    #endif
+    
+    app_to_web_buf(wf->conn, pkt, SO_OUT_HDR + wf->out_bytes);
+    nbuf_buf_unref(pkt);
+    waterfall_bytes[rx_chan] += wf->out_bytes;
+    waterfall_bytes[rx_chans] += wf->out_bytes; // [rx_chans] is the sum of all waterfalls
+    waterfall_frames[rx_chan]++;
+    waterfall_frames[rx_chans]++;       // [rx_chans] is the sum of all waterfalls
+    evWF(EC_EVENT, EV_WF, -1, "WF", "compute_frame: done");
+
+    #if 0
+        static u4_t last_time[MAX_RX_CHANS];
+        u4_t now = timer_ms();
+        printf("WF%d: %d %.3fs seq-%d\n", rx_chan, SO_OUT_HDR + wf->out_bytes,
+            (float) (now - last_time[rx_chan]) / 1e3, out->seq);
+        last_time[rx_chan] = now;
+    #endif
+}
+
 void sample_wf(int rx_chan)
 {
 	wf_inst_t *wf = &WF_SHMEM->wf_inst[rx_chan];
@@ -740,6 +847,37 @@ void sample_wf(int rx_chan)
     assert(wf_fps[wf->speed] != 0);
     int desired = 1000 / wf_fps[wf->speed];
 
+    // If another channel is already producing frames for the same zoom/start/speed just use its FFT
+    // instead of doing our own SPI sampling and FFT. Common with multiple users at z0 on public Kiwis.
+    wf_key_t key;
+    wf_make_key(wf, &key);
+    int src = wf_cache_lookup(rx_chan, &key, desired);
+
+    if (src >= 0) {
+        fft_t *src_fft = &WF_SHMEM->fft_inst[src];
+        
+        if (wf->fft_src == src && wf->fft_src_seq == src_fft->cache_seq) {
+            // already sent the producer's latest frame, wait for its next one
+            int wait = (int) (src_fft->cache_ms + desired - timer_ms());
+            WFSleepReasonMsec("wait shared", CLAMP(wait, 1, desired));
+            return;
+        }
+        
+        wf->fft_src = src;
+        wf->fft_src_seq = src_fft->cache_seq;
+        wf_send_frame(wf);
+        
+        // restart sampling properly if we have to become a producer again
+        wf->check_overlapped_sampling = true;
+        wf->mark = timer_ms();
+        WFNextTask("shared");
+        return;
+    }
+    
+    wf->fft_src = rx_chan;
+    if (fft->cache_valid && memcmp(&fft->cache_key, &key, sizeof(wf_key_t)) != 0)
+        fft->cache_valid = false;   // hw_fft about to be recomputed with different settings
+
     // desired frame rate greater than what full sampling can deliver, so start overlapped sampling
     if (wf->check_overlapped_sampling) {
         wf->check_overlapped_sampling = false;
@@ -854,32 +992,13 @@ void sample_wf(int rx_chan)
     //if (wf->flush_wf_pipe) {
     //	wf->flush_wf_pipe--;
     //} else {
-        void compute_frame(int rx_chan);
-        #ifdef WF_SHMEM_DISABLE
-            compute_frame(rx_chan);
-        #else
-            #ifdef WF_IPC_SAMPLE_WF
-                compute_frame(rx_chan);
-            #else
-                shmem_ipc_invoke(SIG_IPC_WF, wf->rx_chan);      // invoke compute_frame()
-            #endif
-        #endif
-        
-        wf_pkt_t *out = &wf->out;
-        app_to_web(wf->conn, (char*) out, SO_OUT_HDR + wf->out_bytes);
-        waterfall_bytes[rx_chan] += wf->out_bytes;
-        waterfall_bytes[rx_chans] += wf->out_bytes; // [rx_chans] is the sum of all waterfalls
-        waterfall_frames[rx_chan]++;
-        waterfall_frames[rx_chans]++;       // [rx_chans] is the sum of all waterfalls
-        evWF(EC_EVENT, EV_WF, -1, "WF", "compute_frame: done");
-    
-        #if 0
-            static u4_t last_time[MAX_RX_CHANS];
-            u4_t now = timer_ms();
-            printf("WF%d: %d %.3fs seq-%d\n", rx_chan, SO_OUT_HDR + wf->out_bytes,
-                (float) (now - last_time[rx_chan]) / 1e3, wf->out.seq);
-            last_time[rx_chan] = now;
-        #endif
+        wf_send_frame(wf);
+
+        // publish for any channels with the same settings
+        fft->cache_key = key;
+        fft->cache_seq++;
+        fft->cache_ms = timer_ms();
+        fft->cache_valid = true;
     //}
 
     int actual = timer_ms() - wf->mark;
@@ -897,71 +1016,71 @@ void sample_wf(int rx_chan)
     wf->mark = timer_ms();
 }
 
+// shmem_ipc handler, frame is returned in WF_SHMEM
 void compute_frame(int rx_chan)
+{
+	compute_frame_out(rx_chan, &WF_SHMEM->wf_inst[rx_chan].out);
+}
+
+static void compute_frame_out(int rx_chan, wf_pkt_t *out)
 {
 	wf_inst_t *wf = &WF_SHMEM->wf_inst[rx_chan];
 	int i;
-	wf_pkt_t *out = &wf->out;
 	u1_t comp_in_buf[WF_WIDTH];
 	float pwr[MAX_FFT_USED];
-    fft_t *fft = &WF_SHMEM->fft_inst[rx_chan];
+    fft_t *fft = &WF_SHMEM->fft_inst[wf->fft_src];
 		
     //TaskStat2(TSTAT_INCR|TSTAT_ZERO, 0, "frm");
 
-    if (wf->nb_click) {
-        u4_t now = timer_sec();
-        if (now != wf->last_noise_pulse) {
-            wf->last_noise_pulse = now;
-            fft->hw_c_samps[255][I] = 0.49;
+    // hw_fft of another channel (see wf_cache_lookup) is already computed
+    if (wf->fft_src == rx_chan) {
+        if (wf->nb_click) {
+            u4_t now = timer_sec();
+            if (now != wf->last_noise_pulse) {
+                wf->last_noise_pulse = now;
+                fft->hw_c_samps[255][I] = 0.49;
+            }
         }
+    
+        if (wf->noise_blanker) {
+            m_NoiseProc[rx_chan][NB_WF].ProcessBlankerOneShot(WF_C_NSAMPS, (TYPECPX*) fft->hw_c_samps, (TYPECPX*) fft->hw_c_samps);
+        }
+    
+        //NextTask("FFT1");
+        evWF(EC_EVENT, EV_WF, -1, "WF", "compute_frame: FFT start");
+        fft_execute_dft(fft->hw_dft_plan, fft->hw_c_samps, fft->hw_fft);
+        evWF(EC_EVENT, EV_WF, -1, "WF", "compute_frame: FFT done");
+        //NextTask("FFT2");
     }
 
-    if (wf->noise_blanker) {
-        m_NoiseProc[rx_chan][NB_WF].ProcessBlankerOneShot(WF_C_NSAMPS, (TYPECPX*) fft->hw_c_samps, (TYPECPX*) fft->hw_c_samps);
-    }
-
-	//NextTask("FFT1");
-	evWF(EC_EVENT, EV_WF, -1, "WF", "compute_frame: FFT start");
-	fftwf_execute(fft->hw_dft_plan);
-	evWF(EC_EVENT, EV_WF, -1, "WF", "compute_frame: FFT done");
-	//NextTask("FFT2");
-
 	u1_t *bp = (wf->compression)? out->un.buf2 : out->un.buf;
 			
 	if (!wf->fft_used_limit) wf->fft_used_limit = wf->fft_used;
 
-	// zero-out the DC component in bin zero/one (around -90 dBFS)
-	// otherwise when scrolling w/f it will move but then not continue at the new location
-	pwr[0] = 0;
-	pwr[1] = 0;
-	
 	#ifdef SHOW_MAX_MIN_PWR
-	static void *FFT_state;
 	static void *pwr_state;
 	static void *dB_state;
-	static void *buf_state;
 	if (wf->new_map2) {
-		if (FFT_state != NULL) free(FFT_state);
-		FFT_state = NULL;
 		if (pwr_state != NULL) free(pwr_state);
 		pwr_state = NULL;
 		if (dB_state != NULL) free(dB_state);
 		dB_state = NULL;
-		if (buf_state != NULL) free(buf_state);
-		buf_state = NULL;
 		wf->new_map2 = false;
 	}
 	#endif
 	
-	for (i=2; i < wf->fft_used_limit; i++) {
-		float re = fft->hw_fft[i][I], im = fft->hw_fft[i][Q];
-		pwr[i] = re*re + im*im;
+	// pwr = i*i + q*q (see simd.cpp for the NEON versions of these kernels)
+	simd_mag2_cf(wf->fft_used_limit, fft->hw_fft, pwr);
 
-		#ifdef SHOW_MAX_MIN_PWR
-		//print_max_min_stream_f(&FFT_state, "FFT", i, 2, (double) re, (double) im);
-		//print_max_min_stream_f(&pwr_state, "pwr", i, 1, (double) pwr[i]);
-		#endif
-	}
+	// zero-out the DC component in bin zero/one (around -90 dBFS)
+	// otherwise when scrolling w/f it will move but then not continue at the new location
+	pwr[0] = 0;
+	pwr[1] = 0;
+	
+	#ifdef SHOW_MAX_MIN_PWR
+	for (i=2; i < wf->fft_used_limit; i++)
+		print_max_min_stream_f(&pwr_state, P_MAX_MIN_DEMAND, "pwr", i, 1, (double) pwr[i]);
+	#endif
 		
 	// fixme proper power-law scaling..
 	
@@ -980,112 +1099,32 @@ void compute_frame(int rx_chan)
 	// log10(n) = l(n)/l(10)
 	// 10^x = e^(x*ln(10)) = e(x*l(10))
 	
-    #ifdef WF_INFO
-	    float max_dB = wf->maxdb;
-	    float min_dB = wf->mindb;
-	    float range_dB = max_dB - min_dB;
-	    float pix_per_dB = 255.0 / range_dB;
-	#endif
+	// We map 0..-200 dBm to (u1_t) 255..55
+	// If we map it the reverse way, (u1_t) 0..255 => 0..-255 dBm (which is more natural), then the
+	// noise in the bottom bits due to the ADPCM compression will effect the high-order dBm bits
+	// which is bad.
+	// simd_pwr2dB_u8() uses a polynomial log2 approximation good to < 0.0001 dB
 
-	int bin=0, _bin=-1, bin2pwr[WF_WIDTH];
-	float p, dB, pwr_out_sum[WF_WIDTH], pwr_out_peak[WF_WIDTH];
-
-    //#define WF_CMA
-    #ifndef WF_CMA
-	    memset(pwr_out_peak, 0, sizeof(pwr_out_peak));
-	#endif
+	float pwr_out_peak[WF_WIDTH];
 
 	if (wf->fft_used >= wf->plot_width) {
 		// >= FFT than plot
-		
-		int avgs=0;
-		for (i=0; i<wf->fft_used_limit; i++) {
-			p = pwr[i];
-			bin = wf->fft2wf_map[i];
-			if (bin >= WF_WIDTH) {
-				if (wf->new_map) {
-				
-					#ifdef WF_INFO
-					if (!bg) printf(">= FFT: Z%d WF_C_NSAMPS %d i %d fft_used %d plot_width %d pix_per_dB %.3f range %.0f:%.0f\n",
-						wf->zoom, WF_C_NSAMPS, i, wf->fft_used, wf->plot_width, pix_per_dB, max_dB, min_dB);
-					#endif
-					wf->new_map = FALSE;
-				}
-				wf->fft_used_limit = i;		// we now know what the limit is
-				break;
-			}
-			
-			if (bin == _bin) {
-				#ifdef WF_CMA
-					pwr_out_cma[bin] = (pwr_out_cma[bin] * avgs) + p;
-					avgs++;
-					pwr_out_cma[bin] /= avgs;
-				#else
-					if (p > pwr_out_peak[bin]) pwr_out_peak[bin] = p;
-					pwr_out_sum[bin] += p;
-				#endif
-			} else {
-				#ifdef WF_CMA
-					avgs = 1;
-				#endif
-				pwr_out_peak[bin] = p;
-				pwr_out_sum[bin] = p;
-				_bin = bin;
-			}
-		}
-
-		#ifdef SHOW_MAX_MIN_DB
-		float dBs_f[WF_WIDTH];
-		int dBs[WF_WIDTH];
-		#endif
-
-		for (i=0; i<WF_WIDTH; i++) {
-			p = pwr_out_peak[i];
-			//p = pwr_out_sum[i];
-
-			dB = 10.0 * log10f(p * wf->fft_scale[i] + (float) 1e-30) + wf->fft_offset;
-#if 0
-//jks
-if (i == 506) printf("Z%d ", wf->zoom);
-if (i >= 507 && i <= 515) {
-	float peak_dB = 10.0 * log10f(pwr_out_peak[i] * wf->fft_scale[i] + (float) 1e-30) + wf->fft_offset;
-	printf("%d:%.1f|%.1f ", i, dB, peak_dB);
-}
-if (i == 516) printf("\n");
-#endif
-
-			#ifdef SHOW_MAX_MIN_DB
-			dBs_f[i] = dB;
-			#endif
-			#ifdef SHOW_MAX_MIN_PWR
-			print_max_min_stream_f(&dB_state, "dB", i, 1, (double) dB);
-			#endif
-
-			// We map 0..-200 dBm to (u1_t) 255..55
-			// If we map it the reverse way, (u1_t) 0..255 => 0..-255 dBm (which is more natural), then the
-			// noise in the bottom bits due to the ADPCM compression will effect the high-order dBm bits
-			// which is bad.
-			if (dB > 0) dB = 0;
-			if (dB < -200.0) dB = -200.0;
-			dB--;
-			*bp++ = (u1_t) (int) dB;
-
-			#ifdef SHOW_MAX_MIN_DB
-			dBs[i] = *(bp-1);
-			#endif
-			#ifdef SHOW_MAX_MIN_PWR
-			print_max_min_stream_i(&buf_state, "buf", i, 1, (int) *(bp-1));
+		if (wf->new_map) {
+			#ifdef WF_INFO
+			if (!bg) printf(">= FFT: Z%d WF_C_NSAMPS %d fft_used %d/%d plot_width %d runs %d\n",
+				wf->zoom, WF_C_NSAMPS, wf->fft_used_limit, wf->fft_used, wf->plot_width, wf->n_runs);
 			#endif
+			wf->new_map = FALSE;
 		}
 
+		// max of the fft bins collapsed into each plot bin (runs computed with fft2wf_map)
+		memset(pwr_out_peak, 0, sizeof(pwr_out_peak));
+		simd_bin_reduce(wf->n_runs, wf->run_bin, wf->run_len, pwr, pwr_out_peak, NULL);
+		simd_pwr2dB_u8(WF_WIDTH, pwr_out_peak, wf->fft_scale, wf->fft_offset, bp);
+
 		#ifdef SHOW_MAX_MIN_DB
-		//jks
-		printf("Z%d dB_f: ", wf->zoom);
-		for (i=505; i<514; i++) {
-			printf("%d:%.3f ", i, dBs_f[i]);
-		}
-		printf("\n");
-		print_max_min_f("dB_f", dBs_f, WF_WIDTH);
+		int dBs[WF_WIDTH];
+		for (i=0; i<WF_WIDTH; i++) dBs[i] = bp[i];
 		printf("Z%d dB: ", wf->zoom);
 		for (i=505; i<514; i++) {
 			printf("%d:%d ", i, dBs[i]);
@@ -1096,21 +1135,20 @@ if (i == 516) printf("\n");
 	} else {
 		// < FFT than plot
 		if (wf->new_map) {
-			//printf("< FFT: Z%d WF_C_NSAMPS %d fft_used %d plot_width_clamped %d pix_per_dB %.3f range %.0f:%.0f\n",
-			//	wf->zoom, WF_C_NSAMPS, wf->fft_used, wf->plot_width_clamped, pix_per_dB, max_dB, min_dB);
+			//printf("< FFT: Z%d WF_C_NSAMPS %d fft_used %d plot_width_clamped %d\n",
+			//	wf->zoom, WF_C_NSAMPS, wf->fft_used, wf->plot_width_clamped);
 			wf->new_map = FALSE;
 		}
 
-		for (i=0; i<wf->plot_width_clamped; i++) {
-			p = pwr[wf->wf2fft_map[i]];
-			
-			dB = 10.0 * log10f(p * wf->fft_scale[i] + (float) 1e-30) + wf->fft_offset;
-			if (dB > 0) dB = 0;
-			if (dB < -200.0) dB = -200.0;
-			dB--;
-			*bp++ = (u1_t) (int) dB;
-		}
+		for (i=0; i<wf->plot_width_clamped; i++)
+			pwr_out_peak[i] = pwr[wf->wf2fft_map[i]];
+		simd_pwr2dB_u8(wf->plot_width_clamped, pwr_out_peak, wf->fft_scale, wf->fft_offset, bp);
 	}
+
+	#ifdef SHOW_MAX_MIN_PWR
+	for (i=0; i<WF_WIDTH; i++)
+		print_max_min_stream_i(&dB_state, P_MAX_MIN_DEMAND, "buf", i, 1, (int) bp[i]);
+	#endif
 	
 	if (wf->flush_wf_pipe) {
 		out->x_bin_server = (wf->prev_start == -1)? wf->start : wf->prev_start;
@@ -39,6 +39,7 @@ Boston, MA  02110-1301, USA.
 #include "dx.h"
 #include "non_block.h"
 #include "rx_sound.h"
+#include "fft_plan.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -65,10 +66,21 @@ Boston, MA  02110-1301, USA.
 
 #define	WF_WIDTH		1024	// width of waterfall display
 
+// everything that determines the content of a channel's FFT (the window function is common to all)
+struct wf_key_t {
+	int zoom, start, speed;
+	int noise_blanker, noise_threshold, nb_click;
+};
+
 struct fft_t {
-	fftwf_plan hw_dft_plan;
+	fft_plan_t *hw_dft_plan;
 	fftwf_complex hw_c_samps[sizeof(fftwf_complex) * (WF_C_NSAMPS)];
 	fftwf_complex hw_fft[sizeof(fftwf_complex) * (WF_C_NFFT)];
+
+	// frame cache: hw_fft is reused by other channels with identical DDC settings
+	bool cache_valid;
+	wf_key_t cache_key;
+	u4_t cache_seq, cache_ms;
 };
 
 struct wf_pkt_t {
@@ -95,6 +107,8 @@ struct wf_inst_t {
 	float fft_scale[WF_WIDTH], fft_offset;
 	u2_t fft2wf_map[WF_C_NFFT / WF_USING_HALF_FFT];		// map is 1:1 with fft
 	u2_t wf2fft_map[WF_WIDTH];							// map is 1:1 with plot
+	int n_runs;											// fft2wf_map as runs of consecutive fft bins
+	u2_t run_bin[WF_WIDTH+1], run_len[WF_WIDTH+1];		// +1 for the unwrap split
 	int start, prev_start, zoom, prev_zoom;
 	int mark, speed, fft_used_limit;
 	bool new_map, new_map2, compression, isWF, isFFT;
@@ -107,6 +121,8 @@ struct wf_inst_t {
 	int out_bytes;
 	bool check_overlapped_sampling, overlapped_sampling;
 	int samp_wait_ms, chunk_wait_us;
+	int fft_src;				// fft_inst[] used by compute_frame(), != rx_chan when sharing another channel's frame
+	u4_t fft_src_seq;			// cache_seq of the last shared frame sent
 };
 
 struct wf_shmem_t {
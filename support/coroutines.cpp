@@ -31,6 +31,7 @@
 #include "peri.h"
 #include "spi.h"
 #include "shmem.h"
+#include "runq.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -103,7 +104,7 @@ struct TaskQ_t {
 	int p;
 	TaskLL_t tll;
 	TaskLL_t *last_run;
-	int count, runnable;
+	int count;
 };
 
 // just for debugging -- easier to read values in gdb
@@ -214,6 +215,14 @@ static int max_task;
 static TASK Tasks[MAX_TASKS], *cur_task, *last_task_run, *busy_helper_task, *itask;
 static ctx_t ctx[MAX_TASKS]; 
 static TaskQ_t TaskQ[NUM_PRIORITY];
+
+// NextTask() picks from runq and expires deadlines from timers instead of scanning every task.
+// A task's runq bit is set when it's valid and not stopped (see task_runq()).
+// Tasks sleeping on a wakeup_test (set by another process, so no one can call TaskWakeup())
+// are the only ones still polled, via wtest.
+static runq_t runq;
+static theap_t timers;
+static idmap_t wtest;
 static u64_t last_dump;
 static u4_t idle_us;
 static u4_t task_all_hist[N_HIST];
@@ -266,53 +275,46 @@ char *Task_ls(int id)
 }
 
 
-// never got this to work
-// should try explicit run queues
-//#define USE_RUNNABLE
+// keep the runq bit of a task in step with its valid/stopped state
+static void task_runq(TASK *t)
+{
+    if (t->tq == NULL) return;
+    if (t->valid && !t->stopped)
+        runq_set(&runq, t->priority, t->id);
+    else
+        runq_clr(&runq, t->priority, t->id);
+}
 
-#ifdef USE_RUNNABLE
-void runnable(TaskQ_t *tq, int chg)
+// deadline == 0 cancels
+static void task_deadline(TASK *t, s64_t deadline)
 {
-	#ifdef USE_RUNNABLE
-		int t_runnable = tq->runnable;
-		if(!(t_runnable >= 0 && t_runnable <= tq->count && t_runnable <= MAX_TASKS))
-		assert_dump(t_runnable >= 0 && t_runnable <= tq->count && t_runnable <= MAX_TASKS);
-	
-		tq->runnable += chg;
-	
-		int p;
-		for (p = HIGHEST_PRIORITY; p >= LOWEST_PRIORITY; p--) {
-			int ckrun=0;
-			TaskQ_t *head = &TaskQ[p];
-			TaskLL_t *tll = head->tll.next;
-			while (tll) {
-				if (!tll->t->stopped) ckrun++;
-				tll = tll->next;
-			}
-			if (ckrun != head->runnable)
-			assert_dump(ckrun == head->runnable);
-		}
-	
-		t_runnable = tq->runnable;
-		if(!(t_runnable >= 0 && t_runnable <= tq->count && t_runnable <= MAX_TASKS))
-		assert_dump(t_runnable >= 0 && t_runnable <= tq->count && t_runnable <= MAX_TASKS);
-	#endif
+    t->deadline = deadline;
+    if (deadline > 0)
+        theap_set(&timers, t->id, deadline);
+    else
+        theap_del(&timers, t->id);
+}
+
+static void task_wakeup_test(TASK *t, u4_t *wakeup_test)
+{
+    t->wakeup_test = wakeup_test;
+    if (wakeup_test != NULL)
+        idmap_set(&wtest, t->id);
+    else
+        idmap_clr(&wtest, t->id);
 }
-#else
-    #define runnable(tq, chg)
-#endif
 
 #define RUNNABLE_YES(tp) \
     (tp)->stopped = FALSE; \
     run[(tp)->id].r = 1; \
-    runnable((tp)->tq, 1); \
+    task_runq(tp); \
     (tp)->sleeping = FALSE; \
     (tp)->wakeup = TRUE;
 
-#define RUNNABLE_NO(tp, chg) \
+#define RUNNABLE_NO(tp) \
     (tp)->stopped = TRUE; \
     run[(tp)->id].r = 0; \
-    runnable((tp)->tq, chg); \
+    task_runq(tp); \
     (tp)->sleeping = TRUE; \
     (tp)->wakeup = FALSE;
 
@@ -328,15 +330,15 @@ static void TenQ(TASK *t, int priority)
 	head->next = cur;
 	tq->count++;
 
-	if (!t->stopped) runnable(tq, 1);
-
 	t->tq = tq;
+	task_runq(t);
 }
 
 static void TdeQ(TASK *t)
 {
 	TaskQ_t *tq = t->tq;
 	assert(tq == &TaskQ[t->priority]);
+	runq_clr(&runq, t->priority, t->id);
 
 	TaskLL_t *next = t->tll.next, *prev = t->tll.prev;
 	if (next) next->prev = prev;
@@ -350,7 +352,6 @@ static void TdeQ(TASK *t)
 	    //lprintf("### TdeQ: NOT removing %s as last run on TaskQ\n", task_s(t));
 	}
 
-	if (!t->stopped) runnable(tq, -1);
 	tq->count--;
 }
 
@@ -758,6 +759,7 @@ void TaskInit()
     //setpriority(PRIO_PROCESS, getpid(), -20);
 
 	kiwi_server_pid = getpid();
+	assert(MAX_TASKS <= RUNQ_MAX_IDS && NUM_PRIORITY <= RUNQ_MAX_PRIO);
 	printf("TASK MAX_TASKS %d, stack memory %.1f MB, stack size %d k so(u64_t)\n", MAX_TASKS, ((float) sizeof(task_stacks))/M, STACK_SIZE_U64_T/K);
 
 	t = Tasks;
@@ -864,7 +866,9 @@ void TaskPollForInterrupt(ipoll_from_e from)
 		return;
 	}
 
-	if (GPIO_READ_BIT(SND_INTR) && itask->sleeping) {
+	bool intr = spi_replay? spi_replay_snd_intr() : GPIO_READ_BIT(SND_INTR);
+
+	if (intr && itask->sleeping) {
 		evNT(EC_TRIG1, EV_NEXTTASK, -1, "PollIntr", evprintf("CALLED_FROM_%s TO INTERRUPT TASK <===========================",
 			poll_from[from]));
 
@@ -900,6 +904,8 @@ void TaskRemove(int id)
 {
     TASK *t = Tasks + id;
     TdeQ(t);
+    task_deadline(t, 0);
+    task_wakeup_test(t, NULL);
     t->stopped = TRUE;
 	run[t->id].r = 0;
     t->valid = FALSE;
@@ -1091,103 +1097,73 @@ bool TaskIsChild()
             }
         #endif
     
-   		 // search task queues
-		for (p = HIGHEST_PRIORITY; p >= LOWEST_PRIORITY; p--) {
+        // expired deadlines
+        int id;
+        while ((id = theap_expired(&timers, now_us)) >= 0) {
+            TASK *tp = Tasks + id;
+            assert(tp->valid && tp->deadline > 0);
+            evNT(EC_EVENT, EV_NEXTTASK, -1, "NextTask", evprintf("deadline expired %s, Qrunnable %d", task_s(tp), runq_count(&runq, tp->priority)));
+            task_deadline(tp, 0);
+            RUNNABLE_YES(tp);
+            tp->wake_param = TO_VOID_PARAM(tp->last_run_time);      // return how long task ran last time
+        }
+
+        // wakeup tests
+        for (id = idmap_next(&wtest, -1); id >= 0; id = idmap_next(&wtest, id)) {
+            TASK *tp = Tasks + id;
+            if (*tp->wakeup_test != 0) {
+                evNT(EC_EVENT, EV_NEXTTASK, -1, "NextTask", evprintf("wakeup_test completed %s, Qrunnable %d", task_s(tp), runq_count(&runq, tp->priority)));
+                task_wakeup_test(tp, NULL);
+                RUNNABLE_YES(tp);
+                tp->wake_param = TO_VOID_PARAM(tp->last_run_time);
+            }
+        }
+    
+   		 // search the priorities that have runnable tasks, highest first
+		for (p = runq_highest(&runq, NUM_PRIORITY); p >= LOWEST_PRIORITY; p = runq_highest(&runq, p)) {
 			head = &TaskQ[p];
 			assert(p == head->p);
 			
-			#ifdef USE_RUNNABLE
-				int t_runnable = head->runnable;
-				//evNT(EC_EVENT, EV_NEXTTASK, -1, "NextTask", evprintf("looking P%d, count %d, runnable %d",
-				//	p, head->count, t_runnable));
-				if (!(t_runnable >= 0 && t_runnable <= head->count && t_runnable <= MAX_TASKS))
-					assert(t_runnable >= 0 && t_runnable <= head->count && t_runnable <= MAX_TASKS);
-			#else
-				int t_runnable = 0;
-				TaskLL_t *tll;
-				
-                #ifdef LOCK_TEST_HANG
-                    if (lock_test_hang && p == DATAPUMP_PRIORITY) {
-                        printf("LOCK_TEST_HANG ignoring DATAPUMP_PRIORITY\n");
-                        continue;
-                    }
-                #endif
-                
-                #ifdef LOCK_CHECK_HANG
-                    if (lock_panic && head->last_run) lprintf("P%d: last_run %s\n", p, task_s(head->last_run->t));
-                #endif
-					
-				// count the number runnable
-				for (tll = head->tll.next; tll; tll = tll->next) {
-					assert(tll);
-					TASK *tp = tll->t;
-					assert(tp);
-					assert(tp && tp->valid);    // tp check to keep static analyzer quiet
-					
-                    #ifdef LOCK_CHECK_HANG
-				        if (lock_panic) lprintf("P%d: %s %s\n", p, task_s(tp), tp->stopped? "STOP":"RUN");
-                    #endif
-					
-                    bool wake = false;
-                    
-                    if (tp->deadline > 0) {
-                        if (tp->deadline < now_us) {
-                            evNT(EC_EVENT, EV_NEXTTASK, -1, "NextTask", evprintf("deadline expired %s, Qrunnable %d", task_s(tp), tp->tq->runnable));
-                            tp->deadline = 0;
-                            wake = true;
-                        }
-                    } else
-                    if (tp->wakeup_test != NULL) {
-                        if (*tp->wakeup_test != 0) {
-                            evNT(EC_EVENT, EV_NEXTTASK, -1, "NextTask", evprintf("wakeup_test completed %s, Qrunnable %d", task_s(tp), tp->tq->runnable));
-                            tp->wakeup_test = NULL;
-                            wake = true;
-                        }
-                    }
-                    
-                    if (wake) {
-                        RUNNABLE_YES(tp);
-                        tp->wake_param = TO_VOID_PARAM(tp->last_run_time);      // return how long task ran last time
-                    }
-                    
-					if (!tp->stopped)
-						t_runnable++;
-					
-					#ifdef LOCK_CHECK_HANG
-                        if (lock_panic && tp == busy_helper_task)
+            #ifdef LOCK_TEST_HANG
+                if (lock_test_hang && p == DATAPUMP_PRIORITY) {
+                    printf("LOCK_TEST_HANG ignoring DATAPUMP_PRIORITY\n");
+                    continue;
+                }
+            #endif
+            
+			int t_runnable = runq_count(&runq, p);
+			
+            #ifdef LOCK_CHECK_HANG
+                if (lock_panic) {
+                    if (head->last_run) lprintf("P%d: last_run %s\n", p, task_s(head->last_run->t));
+                    for (TaskLL_t *tll = head->tll.next; tll; tll = tll->next) {
+                        TASK *tp = tll->t;
+                        lprintf("P%d: %s %s\n", p, task_s(tp), tp->stopped? "STOP":"RUN");
+                        if (tp == busy_helper_task)
                             lprintf("P%d: busy_helper_task stopped %d lock.wait %d\n", p, tp->stopped, tp->lock.wait);
-                    #endif
-				}
-
-                #ifdef LOCK_CHECK_HANG
-				    if (lock_panic) lprintf("P%d: === runnable %d\n", p, t_runnable);
-				#endif
-			#endif
-
-            //if (p == 2 && t_runnable) real_printf("P2-%d ", t_runnable); fflush(stdout);
+                    }
+                    lprintf("P%d: === runnable %d\n", p, t_runnable);
+                }
+            #endif
 
 			if (p == ct->priority && t_runnable == 1 && no_run_same) {
 				evNT(EC_EVENT, EV_NEXTTASK, -1, "NextTask", evprintf("%s no_run_same TRIGGERED ***", task_s(ct)));
 				no_run_same = false;
-                //if (p == 2) real_printf("NRS?%s ", task_s(ct)); fflush(stdout);
 				continue;
 			}
 			
 			t = NULL;
-			if (t_runnable) {
-				// at this point the p/head queue should have at least one runnable task
-				TaskLL_t *wrap = (head->last_run && head->last_run->next)? head->last_run->next : head->tll.next;
-	            assert(wrap->t->priority == p);
-	            
+			{
 	            // start with the one after the last run (round robin) or, failing that, the first one in the queue
-				TaskLL_t *tll = wrap;
+	            int wrap = idmap_next_wrap(&runq.q[p], head->last_run? head->last_run->t->id : -1);
+	            assert(wrap >= 0);
+				int tid = wrap;
 				
 				int looping = 0;
 				do {
-					assert(tll);
-					t = tll->t;
-					assert(t);
-					assert(t && t->valid);      // t check to keep static analyzer quiet
+					t = Tasks + tid;
+					assert(t->valid);
+					assert(t->priority == p);
 					
 					#ifdef LOCK_CHECK_HANG
 					    if (lock_panic) t->lock_marker = '#';
@@ -1241,12 +1217,11 @@ bool TaskIsChild()
 					}
 					
 					t = NULL;
-					tll = tll->next;
-					if (tll == NULL) tll = head->tll.next;
+					tid = idmap_next_wrap(&runq.q[p], tid);
 					
 					if (++looping == 100)
 					    break;
-				} while (tll != wrap);
+				} while (tid != wrap);
 				
 				if (looping == 100)
 				    panic("NextTask looping");
@@ -1262,8 +1237,8 @@ bool TaskIsChild()
                         break;
                     #endif
 				}
-			} // if (t_runnable)
-		} // for (p = HIGHEST_PRIORITY; p >= LOWEST_PRIORITY; p--)
+			}
+		} // for (p = runq_highest(); p >= LOWEST_PRIORITY; p = runq_highest(p))
 
         #ifdef LOCK_CHECK_HANG
             if (lock_panic) {
@@ -1274,6 +1249,7 @@ bool TaskIsChild()
         #endif
 
 		idle_count++;
+		if (spi_replay && p < LOWEST_PRIORITY) spi_replay_idle();
 		
 		#if 0
             static int is_idle;
@@ -1376,26 +1352,26 @@ static void taskSleepSetup(TASK *t, const char *reason, int usec, u4_t *wakeup_t
 	// usec > 0 is microseconds time in future (added to current time)
 	
 	if (usec > 0) {
-    	t->deadline = timer_us64() + usec;
-        t->wakeup_test = NULL;
+    	task_deadline(t, timer_us64() + usec);
+        task_wakeup_test(t, NULL);
     	sprintf(t->reason, "(%.3f msec) ", (float) usec/1000.0);
-		evNT(EC_EVENT, EV_NEXTTASK, -1, "TaskSleep", evprintf("sleeping usec %d %s Qrunnable %d", usec, task_ls(t), t->tq->runnable));
+		evNT(EC_EVENT, EV_NEXTTASK, -1, "TaskSleep", evprintf("sleeping usec %d %s Qrunnable %d", usec, task_ls(t), runq_count(&runq, t->priority)));
 	} else {
 	    assert(usec == 0);
-        t->wakeup_test = wakeup_test;
-		t->deadline = 0;
+        task_wakeup_test(t, wakeup_test);
+		task_deadline(t, 0);
 		if (wakeup_test != NULL) {
             sprintf(t->reason, "(test %p) ", wakeup_test);
-            evNT(EC_EVENT, EV_NEXTTASK, -1, "TaskSleep", evprintf("sleeping test %p %s Qrunnable %d", wakeup_test, task_ls(t), t->tq->runnable));
+            evNT(EC_EVENT, EV_NEXTTASK, -1, "TaskSleep", evprintf("sleeping test %p %s Qrunnable %d", wakeup_test, task_ls(t), runq_count(&runq, t->priority)));
 		} else {
             strcpy(t->reason, "(evt) ");
-            evNT(EC_EVENT, EV_NEXTTASK, -1, "TaskSleep", evprintf("sleeping event %s Qrunnable %d", task_ls(t), t->tq->runnable));
+            evNT(EC_EVENT, EV_NEXTTASK, -1, "TaskSleep", evprintf("sleeping event %s Qrunnable %d", task_ls(t), runq_count(&runq, t->priority)));
         }
 	}
 	
     kiwi_strncat(t->reason, reason, N_REASON);
 
-	RUNNABLE_NO(t, /* prev_stopped */ t->stopped? 0:-1);
+	RUNNABLE_NO(t);
 }
 
 void *_TaskSleep(const char *reason, int usec, u4_t *wakeup_test)
@@ -1416,11 +1392,13 @@ void *_TaskSleep(const char *reason, int usec, u4_t *wakeup_test)
 		NextTask(t->reason);
 	} while (!t->wakeup);
     
-	evNT(EC_EVENT, EV_NEXTTASK, -1, "TaskSleep", evprintf("woke %s Qrunnable %d", task_ls(t), t->tq->runnable));
+	evNT(EC_EVENT, EV_NEXTTASK, -1, "TaskSleep", evprintf("woke %s Qrunnable %d", task_ls(t), runq_count(&runq, t->priority)));
 
-    t->deadline = 0;
+    task_deadline(t, 0);
+    task_wakeup_test(t, NULL);
     t->stopped = FALSE;
 	run[t->id].r = 1;
+	task_runq(t);
     t->sleeping = FALSE;
 	t->wakeup = FALSE;
 	return t->wake_param;
@@ -1462,7 +1440,7 @@ void TaskWakeup(int id, u4_t flags, void *wake_param)
         return;		// don't interrupt a task sleeping on a time interval
     }
 
-    t->deadline = 0;	// cancel any outstanding deadline
+    task_deadline(t, 0);	// cancel any outstanding deadline
 
 	if (!t->sleeping) {
 		assert(!t->stopped || (t->stopped && t->lock.wait));
@@ -1813,7 +1791,7 @@ void lock_enter(lock_t *lock)
 		ct->lock.wait = lock;
 		ct->stopped = TRUE;
 		run[ct->id].r = 0;
-		runnable(ct->tq, -1);
+		task_runq(ct);
 		
 		// a lock _waiter_ should never be sleeping
 		assert(ct->sleeping == FALSE);
@@ -1956,7 +1934,7 @@ void lock_leave(lock_t *lock)
             assert(tp->sleeping == FALSE);
             
             run[tp->id].r = 1;
-            runnable(tp->tq, 1);
+            task_runq(tp);
             
             if (tp->priority > ct->priority) wake_higher_priority = true;
     
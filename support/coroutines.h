@@ -57,7 +57,7 @@ extern u4_t task_medium_priority;
 #define	NUM_PRIORITY		(HIGHEST_PRIORITY+1)
 
 #define	MISC_TASKS			6					// main, stats, spi, data pump, web server, sdr_hu
-#define GPS_TASKS			(GPS_CHANS + 3)		// chan*n + search + solve + stat
+#define GPS_TASKS			(GPS_CHANS + 4)		// chan*n + upload + search + solve + stat
 #define	SND_TASKS			MAX_RX_CHANS        // SND
 #define	EXT_TASKS			MAX_RX_CHANS        // each extension server-side part runs as a separate task
 #define	EXTRA_TASKS			(MAX_RX_CHANS * 4)  // additional tasks created by extensions etc.
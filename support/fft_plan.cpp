@@ -0,0 +1,372 @@
+/*
+--------------------------------------------------------------------------------
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+Boston, MA  02110-1301, USA.
+--------------------------------------------------------------------------------
+*/
+
+#include "types.h"
+#include "config.h"
+#include "kiwi.h"
+#include "misc.h"
+#include "printf.h"
+#include "str.h"
+#include "timer.h"
+#include "coroutines.h"
+#include "non_block.h"
+#include "fft_plan.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+// The DSP code used to make its own plans, one per instance (waterfall channel, CFastFIR, WSPR channel, SSTV)
+// and mostly FFTW_ESTIMATE. Here a plan is made once per transform: kind, size, howmany, direction, placement and
+// array alignment. Each user executes it on its own arrays with fftwf_execute_dft*().
+//
+// Plans are made with fft_plan_rigor (-fftw_rigor on the command line, FFTW_MEASURE by default) using the wisdom
+// saved in FFT_PLAN_WISDOM, so after the first start planning a transform seen before costs nothing.
+// A user that can't wait for the planner (asks for FFTW_ESTIMATE) gets an FFTW_ESTIMATE plan if there is no wisdom
+// for its transform yet. fft_plan_task() later plans those with fft_plan_rigor in a child process, which saves the
+// wisdom, and replaces them with plans made from it. Offload processes forked before that keep the FFTW_ESTIMATE
+// plan until the next start.
+// A plan an offload process makes without wisdom (e.g. LMS after a client SET) only exists in that process.
+// Its stats entry is marked want_wisdom, and fft_plan_task() plans the transform too so the wisdom is saved
+// for the next start. The offload process keeps its plan.
+// The planner only ever sees arrays of our own, so it doesn't overwrite those of the user.
+
+#define FFT_PLAN_WISDOM         DIR_CFG "/fftwf.wisdom"
+#define FFT_PLAN_POLL_SEC       15
+#define FFT_PLAN_SAMPLE         8       // time one in this many executions, power of 2
+#define FFT_PLAN_ALIGN_SLACK    64      // more than any fftwf_alignment_of()
+
+static u4_t fft_plan_rigor = FFTW_MEASURE;
+static pid_t fft_plan_pid;          // of the server, which saves the wisdom
+static fft_plan_t *fft_plans;
+static bool fft_plan_wisdom_dirty, fft_plan_child_failed;
+
+static fft_plan_shmem_t fft_plan_shmem_local;
+static fft_plan_shmem_t *fft_plan_shmem_p = &fft_plan_shmem_local;
+static fft_plan_stat_t fft_plan_stat_overflow;
+
+static const char *fft_plan_kind_s[] = { "c2c", "r2c", "c2r" };
+
+static const char *fft_plan_rigor_s(u4_t flags)
+{
+	if (flags & FFTW_ESTIMATE) return "estimate";
+	if (flags & FFTW_EXHAUSTIVE) return "exhaustive";
+	if (flags & FFTW_PATIENT) return "patient";
+	return "measure";
+}
+
+// plan p->kind etc. on scratch arrays with the same alignment as the user's
+static fftwf_plan fft_plan_make(fft_plan_t *p, u4_t flags)
+{
+	size_t in_bytes = 0, out_bytes = 0;	// panic() isn't noreturn
+	int nc = p->n/2 + 1;
+
+	switch (p->kind) {
+		case FFT_DFT: in_bytes = out_bytes = p->n * p->howmany * sizeof(fftwf_complex); break;
+		case FFT_R2C: in_bytes = p->n * sizeof(float); out_bytes = nc * sizeof(fftwf_complex); break;
+		case FFT_C2R: in_bytes = nc * sizeof(fftwf_complex); out_bytes = p->n * sizeof(float); break;
+		default: panic("fft_plan_make"); break;
+	}
+	if (p->inplace) in_bytes = out_bytes = MAX(in_bytes, out_bytes);
+
+	u1_t *in_mem = (u1_t *) fftwf_malloc(in_bytes + FFT_PLAN_ALIGN_SLACK);
+	u1_t *out_mem = p->inplace? NULL : (u1_t *) fftwf_malloc(out_bytes + FFT_PLAN_ALIGN_SLACK);
+	assert(in_mem != NULL && (p->inplace || out_mem != NULL));
+	u1_t *in = in_mem + p->align_in;
+	u1_t *out = p->inplace? in : (out_mem + p->align_out);
+	assert(fftwf_alignment_of((float *) in) == p->align_in && fftwf_alignment_of((float *) out) == p->align_out);
+
+	fftwf_plan plan = NULL;
+	switch (p->kind) {
+		case FFT_DFT:
+			plan = fftwf_plan_many_dft(1, &p->n, p->howmany, (fftwf_complex *) in, NULL, 1, p->n,
+				(fftwf_complex *) out, NULL, 1, p->n, p->sign, flags);
+			break;
+		case FFT_R2C: plan = fftwf_plan_dft_r2c_1d(p->n, (float *) in, (fftwf_complex *) out, flags); break;
+		case FFT_C2R: plan = fftwf_plan_dft_c2r_1d(p->n, (fftwf_complex *) in, (float *) out, flags); break;
+	}
+
+	fftwf_free(in_mem);
+	if (out_mem) fftwf_free(out_mem);
+	return plan;
+}
+
+// returns true if there was no wisdom for the transform yet
+static bool fft_plan_plan(fft_plan_t *p, u4_t flags)
+{
+	if (fft_plan_rigor == FFTW_ESTIMATE) {
+		p->flags = FFTW_ESTIMATE;
+		p->plan = fft_plan_make(p, p->flags);
+		if (p->plan == NULL) panic("fft_plan_plan");
+		return false;
+	}
+
+	p->plan = fft_plan_make(p, fft_plan_rigor | FFTW_WISDOM_ONLY);
+	if (p->plan) {
+		p->flags = fft_plan_rigor;
+		return false;
+	}
+
+	if (flags & FFTW_ESTIMATE) {
+		p->flags = FFTW_ESTIMATE;
+		p->want_rigor = true;
+	} else {
+		p->flags = fft_plan_rigor;
+		fft_plan_wisdom_dirty = true;
+	}
+	p->plan = fft_plan_make(p, p->flags);
+	if (p->plan == NULL) panic("fft_plan_plan");
+	return true;
+}
+
+static fft_plan_t *fft_plan_lookup(const char *name, fft_kind_e kind, int n, int howmany, int sign, void *in, void *out, u4_t flags)
+{
+	fft_plan_t *p;
+	int align_in = fftwf_alignment_of((float *) in), align_out = fftwf_alignment_of((float *) out);
+	bool inplace = (in == out);
+
+	for (p = fft_plans; p; p = p->next) {
+		if (p->kind == kind && p->n == n && p->howmany == howmany && p->sign == sign && p->inplace == inplace &&
+			p->align_in == align_in && p->align_out == align_out) {
+			p->stat->users++;
+			return p;
+		}
+	}
+
+	p = (fft_plan_t *) calloc(1, sizeof(fft_plan_t));
+	assert(p != NULL);
+	p->kind = kind;
+	p->n = n;
+	p->howmany = howmany;
+	p->sign = sign;
+	p->inplace = inplace;
+	p->align_in = align_in;
+	p->align_out = align_out;
+	bool no_wisdom = fft_plan_plan(p, flags);
+
+	int i = __sync_fetch_and_add(&fft_plan_shmem_p->n_stats, 1);
+	fft_plan_stat_t *s = (i < N_FFT_PLAN_STATS)? &fft_plan_shmem_p->stats[i] : &fft_plan_stat_overflow;
+	kiwi_strncpy(s->name, name, N_FFT_PLAN_NAME);
+	s->kind = kind;
+	s->n = n;
+	s->howmany = howmany;
+	s->sign = sign;
+	s->inplace = inplace;
+	s->align_in = align_in;
+	s->align_out = align_out;
+	s->flags = p->flags;
+	s->users = 1;
+	s->want_wisdom = (no_wisdom && getpid() != fft_plan_pid);
+	p->stat = s;
+
+	p->next = fft_plans;
+	fft_plans = p;
+	return p;
+}
+
+fft_plan_t *fft_plan_dft_1d(const char *name, int n, fftwf_complex *in, fftwf_complex *out, int sign, u4_t flags)
+{
+	return fft_plan_lookup(name, FFT_DFT, n, 1, sign, in, out, flags);
+}
+
+// howmany contiguous transforms of n
+fft_plan_t *fft_plan_many_dft(const char *name, int n, int howmany, fftwf_complex *in, fftwf_complex *out, int sign, u4_t flags)
+{
+	return fft_plan_lookup(name, FFT_DFT, n, howmany, sign, in, out, flags);
+}
+
+fft_plan_t *fft_plan_dft_r2c_1d(const char *name, int n, float *in, fftwf_complex *out, u4_t flags)
+{
+	return fft_plan_lookup(name, FFT_R2C, n, 1, FFTW_FORWARD, in, out, flags);
+}
+
+fft_plan_t *fft_plan_dft_c2r_1d(const char *name, int n, fftwf_complex *in, float *out, u4_t flags)
+{
+	return fft_plan_lookup(name, FFT_C2R, n, 1, FFTW_BACKWARD, in, out, flags);
+}
+
+static inline u64_t fft_plan_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Counts aren't atomic between the processes sharing a plan's stats, so they may very occasionally lose one.
+#define FFT_EXECUTE(p, in, out, execute) \
+	fft_plan_stat_t *s = (p)->stat; \
+	assert(fftwf_alignment_of((float *) (in)) == (p)->align_in && ((void *) (in) == (void *) (out)) == (p)->inplace); \
+	if ((s->execs++ & (FFT_PLAN_SAMPLE-1)) == 0) { \
+		u64_t t0 = fft_plan_ns(); \
+		execute((p)->plan, in, out); \
+		s->ns += fft_plan_ns() - t0; \
+		s->timed++; \
+	} else { \
+		execute((p)->plan, in, out); \
+	}
+
+void fft_execute_dft(fft_plan_t *p, fftwf_complex *in, fftwf_complex *out)
+{
+	FFT_EXECUTE(p, in, out, fftwf_execute_dft);
+}
+
+void fft_execute_r2c(fft_plan_t *p, float *in, fftwf_complex *out)
+{
+	FFT_EXECUTE(p, in, out, fftwf_execute_dft_r2c);
+}
+
+void fft_execute_c2r(fft_plan_t *p, fftwf_complex *in, float *out)
+{
+	FFT_EXECUTE(p, in, out, fftwf_execute_dft_c2r);
+}
+
+static bool fft_plan_wisdom_save()
+{
+	bool ok = fftwf_export_wisdom_to_filename(FFT_PLAN_WISDOM ".tmp") &&
+		rename(FFT_PLAN_WISDOM ".tmp", FFT_PLAN_WISDOM) == 0;
+	if (!ok) lprintf("FFT: saving wisdom to %s failed\n", FFT_PLAN_WISDOM);
+	return ok;
+}
+
+static void fft_plan_child(void *param)
+{
+	int i;
+	fft_plan_t *p;
+	fftwf_plan plan;
+
+	for (p = fft_plans; p; p = p->next) {
+		if (!p->want_rigor) continue;
+		plan = fft_plan_make(p, fft_plan_rigor);
+		if (plan) fftwf_destroy_plan(plan);
+	}
+
+	// transforms planned in the offload processes
+	int n_stats = MIN(fft_plan_shmem_p->n_stats, N_FFT_PLAN_STATS);
+	for (i = 0; i < n_stats; i++) {
+		fft_plan_stat_t *s = &fft_plan_shmem_p->stats[i];
+		if (!s->want_wisdom) continue;
+		fft_plan_t t;
+		memset(&t, 0, sizeof(t));
+		t.kind = s->kind;
+		t.n = s->n;
+		t.howmany = s->howmany;
+		t.sign = s->sign;
+		t.inplace = s->inplace;
+		t.align_in = s->align_in;
+		t.align_out = s->align_out;
+		plan = fft_plan_make(&t, fft_plan_rigor);
+		if (plan) fftwf_destroy_plan(plan);
+	}
+
+	if (!fft_plan_wisdom_save()) child_exit(EXIT_FAILURE);
+}
+
+// save new wisdom and replace the FFTW_ESTIMATE plans
+void fft_plan_wisdom_update()
+{
+	int i;
+	fft_plan_t *p;
+	int want = 0, replanned = 0;
+	u4_t others = 0;	// stats entries marked want_wisdom by the offload processes
+
+	if (fft_plan_wisdom_dirty) {
+		fft_plan_wisdom_dirty = false;
+		fft_plan_wisdom_save();
+	}
+
+	for (p = fft_plans; p; p = p->next)
+		if (p->want_rigor) want++;
+	int n_stats = MIN(fft_plan_shmem_p->n_stats, N_FFT_PLAN_STATS);
+	for (i = 0; i < n_stats; i++)
+		if (fft_plan_shmem_p->stats[i].want_wisdom) others |= 1U << i;
+	if ((want == 0 && others == 0) || fft_plan_child_failed) return;
+
+	// planning with fft_plan_rigor can take seconds -- use a child task and wait via NextTask()
+	u4_t start = timer_ms();
+	int status = child_task("kiwi.fft", fft_plan_child, POLL_MSEC(250));
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !fftwf_import_wisdom_from_filename(FFT_PLAN_WISDOM)) {
+		lprintf("FFT: planning %d transforms with %s failed\n", want + __builtin_popcount(others), fft_plan_rigor_s(fft_plan_rigor));
+		fft_plan_child_failed = true;
+		return;
+	}
+
+	for (i = 0; i < n_stats; i++)
+		if (others & (1U << i)) fft_plan_shmem_p->stats[i].want_wisdom = false;
+	if (others)
+		lprintf("FFT: wisdom saved for %d transforms planned by offload processes\n", __builtin_popcount(others));
+	if (want == 0) return;
+
+	for (p = fft_plans; p; p = p->next) {
+		if (!p->want_rigor) continue;
+		fftwf_plan plan = fft_plan_make(p, fft_plan_rigor | FFTW_WISDOM_ONLY);
+		if (plan == NULL) continue;     // asked for while the child was planning, next time
+		fftwf_destroy_plan(p->plan);
+		p->plan = plan;
+		p->flags = p->stat->flags = fft_plan_rigor;
+		p->want_rigor = false;
+		replanned++;
+	}
+	lprintf("FFT: %d of %d transforms replanned with %s in %.3f sec\n",
+		replanned, want, fft_plan_rigor_s(fft_plan_rigor), TIME_DIFF_MS(timer_ms(), start));
+}
+
+static void fft_plan_task(void *param)
+{
+	while (1) {
+		TaskSleepSec(FFT_PLAN_POLL_SEC);
+		fft_plan_wisdom_update();
+	}
+}
+
+void fft_plan_init(u4_t rigor, fft_plan_shmem_t *shmem_stats)
+{
+	fft_plan_rigor = rigor;
+	fft_plan_pid = getpid();
+	if (shmem_stats) fft_plan_shmem_p = shmem_stats;
+	bool wisdom = (rigor != FFTW_ESTIMATE && fftwf_import_wisdom_from_filename(FFT_PLAN_WISDOM));
+	lprintf("FFT: planner %s, %s\n", fft_plan_rigor_s(rigor), wisdom? "wisdom loaded from " FFT_PLAN_WISDOM : "no wisdom");
+	CreateTask(fft_plan_task, 0, SERVICES_PRIORITY);
+}
+
+void fft_plan_stats()
+{
+	int i;
+	static u4_t last_ms;
+	u4_t now = timer_ms();
+	float interval_s = (float) (now - last_ms) / 1e3;
+	last_ms = now;
+
+	if (!(print_stats & STATS_TASK) || interval_s <= 0) return;
+	int n_stats = MIN(fft_plan_shmem_p->n_stats, N_FFT_PLAN_STATS);
+
+	for (i = 0; i < n_stats; i++) {
+		fft_plan_stat_t *s = &fft_plan_shmem_p->stats[i];
+		u4_t execs = s->execs - s->execs_last, timed = s->timed - s->timed_last;
+		float avg_us = timed? (float) (s->ns - s->ns_last) / timed / 1e3 : 0;
+		s->execs_last = s->execs;
+		s->timed_last = s->timed;
+		s->ns_last = s->ns;
+		if (execs == 0) continue;
+		lprintf("FFT %-*s %s %5d", N_FFT_PLAN_NAME, s->name, fft_plan_kind_s[s->kind], s->n);
+		if (s->howmany > 1) real_printf(" x%d", s->howmany);
+		real_printf(" %s users %d: %.0f/s %.1f us %.1f%%\n", fft_plan_rigor_s(s->flags), s->users,
+			execs / interval_s, avg_us, execs * avg_us / (interval_s * 1e4));
+	}
+}
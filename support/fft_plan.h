@@ -0,0 +1,80 @@
+/*
+--------------------------------------------------------------------------------
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+Boston, MA  02110-1301, USA.
+--------------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "types.h"
+
+#include <fftw3.h>
+
+// Registry of the single precision FFTW plans of all the DSP code, see fft_plan.cpp.
+// A plan is shared by every user asking for the same transform and is executed
+// on the user's own arrays, so use fft_execute_*() instead of fftwf_execute().
+
+typedef enum { FFT_DFT, FFT_R2C, FFT_C2R } fft_kind_e;
+
+// execution time per plan, in shmem so the offload processes add to it too
+#define N_FFT_PLAN_STATS    32
+#define N_FFT_PLAN_NAME     16
+
+typedef struct {
+    char name[N_FFT_PLAN_NAME];     // of the first user
+    fft_kind_e kind;
+    int n, howmany, sign, users;
+    bool inplace;
+    int align_in, align_out;
+    u4_t flags;                     // planner rigor of the plan in use
+    bool want_wisdom;               // planned in another process without wisdom, the server should plan it
+    u4_t execs, execs_last;
+    u4_t timed, timed_last;         // executions timed, one in FFT_PLAN_SAMPLE
+    u64_t ns, ns_last;
+} fft_plan_stat_t;
+
+typedef struct {
+    int n_stats;
+    fft_plan_stat_t stats[N_FFT_PLAN_STATS];
+} fft_plan_shmem_t;
+
+typedef struct fft_plan_s {
+    fft_kind_e kind;
+    int n, howmany, sign;
+    bool inplace;
+    int align_in, align_out;        // fftwf_alignment_of() of the arrays, same for every user
+    fftwf_plan plan;
+    u4_t flags;
+    bool want_rigor;                // planned with less than fft_plan_rigor, replan from wisdom when there is some
+    fft_plan_stat_t *stat;
+    struct fft_plan_s *next;
+} fft_plan_t;
+
+// rigor: FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT or FFTW_EXHAUSTIVE
+// Make no plans before this, i.e. not from the constructor of a global object.
+void fft_plan_init(u4_t rigor, fft_plan_shmem_t *shmem_stats = NULL);
+
+// flags: FFTW_ESTIMATE if the caller can't wait for the planner (e.g. runs from a client SET)
+fft_plan_t *fft_plan_dft_1d(const char *name, int n, fftwf_complex *in, fftwf_complex *out, int sign, u4_t flags);
+fft_plan_t *fft_plan_many_dft(const char *name, int n, int howmany, fftwf_complex *in, fftwf_complex *out, int sign, u4_t flags);
+fft_plan_t *fft_plan_dft_r2c_1d(const char *name, int n, float *in, fftwf_complex *out, u4_t flags);
+fft_plan_t *fft_plan_dft_c2r_1d(const char *name, int n, fftwf_complex *in, float *out, u4_t flags);
+
+// the arrays must have the same alignment and placement (in-place or not) as those the plan was asked for with
+void fft_execute_dft(fft_plan_t *p, fftwf_complex *in, fftwf_complex *out);
+void fft_execute_r2c(fft_plan_t *p, float *in, fftwf_complex *out);
+void fft_execute_c2r(fft_plan_t *p, fftwf_complex *in, float *out);
+
+void fft_plan_wisdom_update();
+void fft_plan_stats();
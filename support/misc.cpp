@@ -30,6 +30,7 @@ Boston, MA  02110-1301, USA.
 #include "net.h"
 #include "debug.h"
 #include "shmem.h"
+#include "timer.h"
 
 #include <sys/file.h>
 #include <fcntl.h>
@@ -56,68 +57,175 @@ Boston, MA  02110-1301, USA.
  #define kmprintf(x)
 #endif
 
-#define NMT 1024
-struct mtrace_t {
-	int i;
-	const char *from;
+// Allocation tracker, cheap enough to leave on in production.
+// Live allocations are in an open-addressed hash table keyed by pointer (linear probing,
+// backward shift deletion so no tombstones), grown by doubling instead of an overflow panic.
+// Each points to the aggregate of its allocation site, the "from" string. Sites are found by
+// a second table keyed by the string pointer. Identical strings at different places in the
+// code are the same site.
+
+#define MT_NSITE		1024				// sites beyond this go to the last one, "(other)"
+#define MT_NSITE_HASH	(MT_NSITE * 2)
+#define MT_INIT_BITS	12
+
+typedef struct {
 	char *ptr;
-	int size;
-} mtrace[NMT];
+	u4_t size;
+	u2_t site;
+} mt_ent_t;
+
+typedef struct {
+	const char *from;
+	u4_t nlive, live, peak;
+	u4_t allocs, allocs_last;
+} mt_site_t;
+
+typedef struct {
+	const char *from;
+	u2_t site;
+} mt_site_hash_t;
+
+static mt_ent_t *mt_tab;
+static int mt_bits, mt_mask, nmt;
+static u4_t mt_live, mt_peak;
 
-static int nmt;
+static mt_site_t mt_site[MT_NSITE];
+static mt_site_hash_t mt_site_hash[MT_NSITE_HASH];
+static int mt_nsite, mt_nsite_hash;
+static u4_t mt_dump_ms;
 
-static int mt_enter(const char *from, void *ptr, int size)
+static inline u4_t mt_hash(const void *p, int bits)
 {
-	int i;
-	mtrace_t *mt;
+	return ((u4_t) (uintptr_t) p * 0x9e3779b1U) >> (32 - bits);
+}
+
+static int mt_site_lookup(const char *from)
+{
+	int i, h = mt_hash(from, 11) & (MT_NSITE_HASH-1);
+	
+	while (mt_site_hash[h].from != NULL) {
+		if (mt_site_hash[h].from == from) return mt_site_hash[h].site;
+		h = (h+1) & (MT_NSITE_HASH-1);
+	}
+	
+	// first time this string pointer is seen
+	for (i = 0; i < mt_nsite; i++)
+		if (strcmp(mt_site[i].from, from) == 0) break;
+	if (i == mt_nsite) {
+		if (mt_nsite < MT_NSITE-1) {
+			mt_nsite++;
+			mt_site[i].from = from;
+		} else {
+			i = MT_NSITE-1;
+			if (mt_nsite == MT_NSITE-1) {
+				mt_nsite++;
+				mt_site[i].from = "(other)";
+			}
+		}
+	}
+	
+	if (mt_nsite_hash < MT_NSITE_HASH/2) {		// keep the probe runs short
+		mt_nsite_hash++;
+		mt_site_hash[h].from = from;
+		mt_site_hash[h].site = i;
+	}
+	return i;
+}
+
+static void mt_insert(mt_ent_t *tab, int mask, int bits, char *ptr, u4_t size, u2_t site)
+{
+	int h = mt_hash(ptr, bits) & mask;
+	while (tab[h].ptr != NULL) h = (h+1) & mask;
+	tab[h].ptr = ptr;
+	tab[h].size = size;
+	tab[h].site = site;
+}
+
+static void mt_grow()
+{
+	int i, bits = mt_tab? (mt_bits + 1) : MT_INIT_BITS;
+	int mask = (1 << bits) - 1;
+	mt_ent_t *tab = (mt_ent_t *) calloc(mask+1, sizeof(mt_ent_t));
+	if (tab == NULL) panic("mt_grow");
+	
+	if (mt_tab) {
+		for (i = 0; i <= mt_mask; i++) {
+			mt_ent_t *e = &mt_tab[i];
+			if (e->ptr) mt_insert(tab, mask, bits, e->ptr, e->size, e->site);
+		}
+		free(mt_tab);
+	}
+	
+	mt_tab = tab;
+	mt_bits = bits;
+	mt_mask = mask;
+}
+
+static void mt_enter(const char *from, void *ptr, int size)
+{
+	int h;
 	
 	#ifdef USE_VALGRIND
-	    return 0;
+	    return;
 	#endif
 	
-	for (i=0; i<NMT; i++) {
-		mt = &mtrace[i];
-		if (mt->ptr == ptr) {
-			kmprintf(("  mt_enter \"%s\" #%d (\"%s\") %d %p\n", from, i, mt->from, size, ptr));
+	if (nmt >= (mt_mask+1)/2) mt_grow();
+	
+	for (h = mt_hash(ptr, mt_bits) & mt_mask; mt_tab[h].ptr != NULL; h = (h+1) & mt_mask) {
+		if (mt_tab[h].ptr == ptr) {
+			kmprintf(("  mt_enter \"%s\" (\"%s\") %d %p\n", from, mt_site[mt_tab[h].site].from, size, ptr));
 			panic("mt_enter dup");
 		}
-		if (mt->ptr == NULL) {
-			mt->i = i;
-			mt->from = from;
-			mt->ptr = (char*) ptr;
-			mt->size = size;
-			break;
-		}
 	}
 	
-	if (i == NMT) panic("mt_enter overflow");
+	int si = mt_site_lookup(from);
+	mt_ent_t *e = &mt_tab[h];
+	e->ptr = (char*) ptr;
+	e->size = size;
+	e->site = si;
 	nmt++;
-	return i+1;
+	
+	mt_site_t *s = &mt_site[si];
+	s->nlive++;
+	s->allocs++;
+	s->live += size;
+	if (s->live > s->peak) s->peak = s->live;
+	mt_live += size;
+	if (mt_live > mt_peak) mt_peak = mt_live;
 }
 
 static void mt_remove(const char *from, void *ptr)
 {
-	int i;
-	mtrace_t *mt;
+	int h, j;
 	
 	#ifdef USE_VALGRIND
 	    return;
 	#endif
 	
-	for (i=0; i<NMT; i++) {
-		mt = &mtrace[i];
-		if (mt->ptr == (char*) ptr) {
-			mt->ptr = NULL;
-			break;
-		}
-	}
+	for (h = mt_tab? (mt_hash(ptr, mt_bits) & mt_mask) : 0; mt_tab && mt_tab[h].ptr != NULL; h = (h+1) & mt_mask)
+		if (mt_tab[h].ptr == (char*) ptr) break;
 	
-	kmprintf(("  mt_remove \"%s\" #%d %p\n", from, i+1, ptr));
-	if (i == NMT) {
+	kmprintf(("  mt_remove \"%s\" %p\n", from, ptr));
+	if (mt_tab == NULL || mt_tab[h].ptr == NULL) {
 		printf("mt_remove \"%s\"\n", from);
 		panic("mt_remove not found");
 	}
+	
+	mt_site_t *s = &mt_site[mt_tab[h].site];
+	s->nlive--;
+	s->live -= mt_tab[h].size;
+	mt_live -= mt_tab[h].size;
 	nmt--;
+
+	// backward shift: move up later entries of the probe run that may not be left behind the hole
+	for (j = (h+1) & mt_mask; mt_tab[j].ptr != NULL; j = (j+1) & mt_mask) {
+		int home = mt_hash(mt_tab[j].ptr, mt_bits) & mt_mask;
+		if (((j - home) & mt_mask) >= ((j - h) & mt_mask)) {
+			mt_tab[h] = mt_tab[j];
+			h = j;
+		}
+	}
+	mt_tab[h].ptr = NULL;
 }
 
 #define	MALLOC_MAX	PHOTO_UPLOAD_MAX_SIZE
@@ -128,12 +236,8 @@ void *kiwi_malloc(const char *from, size_t size)
 	kmprintf(("kiwi_malloc-1 \"%s\" %d\n", from, size));
 	void *ptr = malloc(size);
 	memset(ptr, 0, size);
-    #ifdef MALLOC_DEBUG_PRF
-        int i = mt_enter(from, ptr, size);
-    #else
-        mt_enter(from, ptr, size);
-    #endif
-	kmprintf(("kiwi_malloc-2 \"%s\" #%d %d %p\n", from, i, size, ptr));
+	mt_enter(from, ptr, size);
+	kmprintf(("kiwi_malloc-2 \"%s\" %d %p\n", from, size, ptr));
 	return ptr;
 }
 
@@ -141,14 +245,10 @@ void *kiwi_realloc(const char *from, void *ptr, size_t size)
 {
 	//if (size > MALLOC_MAX) panic("malloc > MALLOC_MAX");
 	kmprintf(("kiwi_realloc-1 \"%s\" %d %p\n", from, size, ptr));
-	mt_remove(from, ptr);
+	if (ptr != NULL) mt_remove(from, ptr);
 	ptr = realloc(ptr, size);
-    #ifdef MALLOC_DEBUG_PRF
-        int i = mt_enter(from, ptr, size);
-    #else
-        mt_enter(from, ptr, size);
-    #endif
-	kmprintf(("kiwi_realloc-2 \"%s\" #%d %d %p\n", from, i, size, ptr));
+	mt_enter(from, ptr, size);
+	kmprintf(("kiwi_realloc-2 \"%s\" %d %p\n", from, size, ptr));
 	return ptr;
 }
 
@@ -157,12 +257,8 @@ char *kiwi_strdup(const char *from, const char *s)
 	int sl = strlen(s)+1;
 	if (sl == 0 || sl > 1024) panic("strdup size");
 	char *ptr = strdup(s);
-    #ifdef MALLOC_DEBUG_PRF
-        int i = mt_enter(from, (void*) ptr, sl);
-    #else
-        mt_enter(from, (void*) ptr, sl);
-    #endif
-	kmprintf(("kiwi_strdup \"%s\" #%d %d %p %p\n", from, i, sl, s, ptr));
+	mt_enter(from, (void*) ptr, sl);
+	kmprintf(("kiwi_strdup \"%s\" %d %p %p\n", from, sl, s, ptr));
 	return ptr;
 }
 
@@ -179,6 +275,37 @@ int kiwi_malloc_stat()
 	return nmt;
 }
 
+static int mt_live_cmp(const void *elem1, const void *elem2)
+{
+	const mt_site_t *s1 = &mt_site[*(const u2_t *) elem1], *s2 = &mt_site[*(const u2_t *) elem2];
+	if (s1->live != s2->live) return (s1->live < s2->live)? 1 : -1;
+	return (s1->peak < s2->peak)? 1 : ((s1->peak > s2->peak)? -1 : 0);
+}
+
+// top allocation sites by live bytes, alloc rate since the last dump
+void kiwi_malloc_dump(int ntop)
+{
+	int i;
+	static u2_t order[MT_NSITE];
+	u4_t now = timer_ms();
+	float secs = mt_dump_ms? (now - mt_dump_ms) / 1e3 : 0;
+	
+	for (i = 0; i < mt_nsite; i++) order[i] = i;
+	qsort(order, mt_nsite, sizeof(u2_t), mt_live_cmp);
+	
+	lprintf("MALLOC %d live %.1f kB, peak %.1f kB, %d sites, table %d/%d\n",
+		nmt, mt_live / 1024.0, mt_peak / 1024.0, mt_nsite, nmt, mt_tab? (mt_mask+1) : 0);
+	lprintf("MALLOC   live kB  nlive   peak kB  allocs/s     allocs  from\n");
+	for (i = 0; i < mt_nsite && i < ntop; i++) {
+		mt_site_t *s = &mt_site[order[i]];
+		lprintf("MALLOC %9.1f %6d %9.1f %9.1f %10u  %s\n", s->live / 1024.0, s->nlive, s->peak / 1024.0,
+			secs? (s->allocs - s->allocs_last) / secs : 0, s->allocs, s->from);
+	}
+	
+	for (i = 0; i < mt_nsite; i++) mt_site[i].allocs_last = mt_site[i].allocs;
+	mt_dump_ms = now;
+}
+
 #endif
 
 void kiwi_str_redup(char **ptr, const char *from, const char *s)
@@ -188,16 +315,11 @@ void kiwi_str_redup(char **ptr, const char *from, const char *s)
 	if (*ptr) kiwi_free(from, (void*) *ptr);
 	*ptr = strdup(s);
 #ifdef MALLOC_DEBUG
-    #ifdef MALLOC_DEBUG_PRF
-        int i = mt_enter(from, (void*) *ptr, sl);
-    #else
-        mt_enter(from, (void*) *ptr, sl);
-    #endif
-	kmprintf(("kiwi_str_redup \"%s\" #%d %d %p %p\n", from, i, sl, s, *ptr));
+	mt_enter(from, (void*) *ptr, sl);
+	kmprintf(("kiwi_str_redup \"%s\" %d %p %p\n", from, sl, s, *ptr));
 #endif
 }
 
-
 // used by qsort
 // NB: assumes first element in struct is float sort field
 int qsort_floatcomp(const void *elem1, const void *elem2)
@@ -34,6 +34,7 @@ Boston, MA  02110-1301, USA.
 	char *kiwi_strdup(const char *from, const char *s);
 	void kiwi_str_redup(char **ptr, const char *from, const char *s);
 	int kiwi_malloc_stat();
+	void kiwi_malloc_dump(int ntop);
 #else
 	#define kiwi_malloc(from, size) malloc(size)
 	#define kiwi_realloc(from, ptr, size) realloc(ptr, size)
@@ -41,6 +42,7 @@ Boston, MA  02110-1301, USA.
 	#define kiwi_strdup(from, s) strdup(s)
 	void kiwi_str_redup(char **ptr, const char *from, const char *s);
 	#define kiwi_malloc_stat() 0
+	#define kiwi_malloc_dump(ntop)
 #endif
 
 u2_t ctrl_get();
@@ -0,0 +1,210 @@
+/*
+--------------------------------------------------------------------------------
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+Boston, MA  02110-1301, USA.
+--------------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "types.h"
+#include "kiwi_assert.h"
+
+#include <string.h>
+
+// Scheduler queues indexed by task id, so picking the next task doesn't look at every task.
+// The bitmaps cost the same whatever the task count, the timer heap O(log n) in the number
+// of sleeping tasks. tools/sched_bench compares this with the old scan.
+//
+// idmap_t  bitmap of ids, iterated with find-first-set, with a summary bit per word so an
+//          empty or sparse map isn't walked a word at a time
+// runq_t   one idmap per priority plus a bitmap of the priorities that have a runnable id
+// theap_t  binary min-heap of (deadline, id) with a per-id position so an entry can be
+//          moved or removed in O(log n) when a sleep is cancelled
+
+#define RUNQ_MAX_IDS    256
+#define RUNQ_WORDS      (RUNQ_MAX_IDS / 32)    // <= 32 for idmap_t.any
+#define RUNQ_MAX_PRIO   32
+
+typedef struct {
+    u4_t any;           // bit i set when w[i] is not zero
+    u4_t w[RUNQ_WORDS];
+} idmap_t;
+
+static inline void idmap_set(idmap_t *m, int id)
+{
+    m->w[id >> 5] |= 1U << (id & 31);
+    m->any |= 1U << (id >> 5);
+}
+
+static inline void idmap_clr(idmap_t *m, int id)
+{
+    u4_t w = m->w[id >> 5] &= ~(1U << (id & 31));
+    if (w == 0) m->any &= ~(1U << (id >> 5));
+}
+
+static inline bool idmap_isset(idmap_t *m, int id)
+{
+    return (m->w[id >> 5] & (1U << (id & 31))) != 0;
+}
+
+static inline bool idmap_empty(idmap_t *m)
+{
+    return m->any == 0;
+}
+
+static inline int idmap_count(idmap_t *m)
+{
+    int n = 0;
+    for (int i = 0; i < RUNQ_WORDS; i++)
+        n += __builtin_popcount(m->w[i]);
+    return n;
+}
+
+// first id > after (after = -1 to start at the beginning), -1 if none
+static inline int idmap_next(idmap_t *m, int after)
+{
+    int id = after + 1;
+    if (id >= RUNQ_MAX_IDS) return -1;
+    int i = id >> 5;
+    u4_t w = m->w[i] & (~0U << (id & 31));
+    if (w) return (i << 5) + __builtin_ctz(w);
+    u4_t a = m->any & (~1U << i);
+    if (a == 0) return -1;
+    i = __builtin_ctz(a);
+    return (i << 5) + __builtin_ctz(m->w[i]);
+}
+
+// as above but wraps around, so returns after itself if it's the only one set
+static inline int idmap_next_wrap(idmap_t *m, int after)
+{
+    int id = idmap_next(m, after);
+    return (id >= 0)? id : idmap_next(m, -1);
+}
+
+
+typedef struct {
+    u4_t prio_map;      // bit p set when q[p] is not empty
+    idmap_t q[RUNQ_MAX_PRIO];
+} runq_t;
+
+static inline void runq_init(runq_t *rq)
+{
+    memset(rq, 0, sizeof(*rq));
+}
+
+static inline void runq_set(runq_t *rq, int p, int id)
+{
+    idmap_set(&rq->q[p], id);
+    rq->prio_map |= 1U << p;
+}
+
+static inline void runq_clr(runq_t *rq, int p, int id)
+{
+    idmap_clr(&rq->q[p], id);
+    if (idmap_empty(&rq->q[p])) rq->prio_map &= ~(1U << p);
+}
+
+// highest priority < below with a runnable id, -1 if none
+static inline int runq_highest(runq_t *rq, int below)
+{
+    u4_t m = rq->prio_map & ((below >= 32)? ~0U : ((1U << below) - 1));
+    return m? (31 - __builtin_clz(m)) : -1;
+}
+
+static inline int runq_count(runq_t *rq, int p)
+{
+    return idmap_count(&rq->q[p]);
+}
+
+
+typedef struct {
+    int n;
+    struct {
+        u64_t key;
+        int id;
+    } e[RUNQ_MAX_IDS];
+    u2_t pos[RUNQ_MAX_IDS];     // 1 + index into e[], 0 = not in heap
+} theap_t;
+
+static inline void theap_init(theap_t *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+static inline void _theap_place(theap_t *h, int i, u64_t key, int id)
+{
+    h->e[i].key = key;
+    h->e[i].id = id;
+    h->pos[id] = i + 1;
+}
+
+static inline void _theap_up(theap_t *h, int i)
+{
+    u64_t key = h->e[i].key;
+    int id = h->e[i].id;
+    while (i > 0) {
+        int parent = (i-1) / 2;
+        if (h->e[parent].key <= key) break;
+        _theap_place(h, i, h->e[parent].key, h->e[parent].id);
+        i = parent;
+    }
+    _theap_place(h, i, key, id);
+}
+
+static inline void _theap_down(theap_t *h, int i)
+{
+    u64_t key = h->e[i].key;
+    int id = h->e[i].id;
+    while (true) {
+        int c = 2*i + 1;
+        if (c >= h->n) break;
+        if (c+1 < h->n && h->e[c+1].key < h->e[c].key) c++;
+        if (key <= h->e[c].key) break;
+        _theap_place(h, i, h->e[c].key, h->e[c].id);
+        i = c;
+    }
+    _theap_place(h, i, key, id);
+}
+
+static inline bool theap_has(theap_t *h, int id)
+{
+    return h->pos[id] != 0;
+}
+
+static inline void theap_del(theap_t *h, int id)
+{
+    if (!h->pos[id]) return;
+    int i = h->pos[id] - 1;
+    h->pos[id] = 0;
+    if (--h->n == i) return;
+    _theap_place(h, i, h->e[h->n].key, h->e[h->n].id);
+    _theap_down(h, i);
+    _theap_up(h, i);
+}
+
+// insert, or move if already present
+static inline void theap_set(theap_t *h, int id, u64_t key)
+{
+    assert(id >= 0 && id < RUNQ_MAX_IDS);
+    theap_del(h, id);
+    _theap_place(h, h->n, key, id);
+    h->n++;
+    _theap_up(h, h->n - 1);
+}
+
+// id of the earliest entry if its key is <= now, otherwise -1
+static inline int theap_expired(theap_t *h, u64_t now)
+{
+    return (h->n && h->e[0].key <= now)? h->e[0].id : -1;
+}
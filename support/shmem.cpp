@@ -43,7 +43,7 @@ void shmem_init()
     shmem->log_save.endp = (char *) shmem_end;
 
     // printf_init() hasn't been called yet
-    real_printf("SHMEM=%.3f MB: ipc=%.3f spi=%.3f rx=%.3f wf=%.3f wspr=%.3f drm=%.3f\n",
+    real_printf("SHMEM=%.3f MB: ipc=%.3f spi=%.3f rx=%.3f wf=%.3f wspr=%.3f drm=%.3f snd=%.3f gps=%.3f\n",
         (float) size/M,
         
         (float) sizeof(shmem->ipc)/M,
@@ -73,9 +73,21 @@ void shmem_init()
         #endif
 
         #ifdef DRM_SHMEM_DISABLE
+            0.,
+        #else
+            (float) sizeof(shmem->drm_shmem)/M,
+        #endif
+
+        #ifdef SND_SHMEM_DISABLE
+            0.,
+        #else
+            (float) sizeof(shmem->snd_shmem)/M,
+        #endif
+
+        #ifdef GPS_SHMEM_DISABLE
             0.
         #else
-            (float) sizeof(shmem->drm_shmem)/M
+            (float) sizeof(shmem->gps_acq)/M
         #endif
     );
 
@@ -114,7 +126,7 @@ static void shmem_child_task(void *param)
 {
     shmem_ipc_t *ipc = (shmem_ipc_t *) FROM_VOID_PARAM(param);
     //real_printf("CHILD shmem_child_task RUNNING parent_pid=%d\n", ipc->parent_pid);
-    set_cpu_affinity(1);
+    set_cpu_affinity(ipc->cpu);
     sig_arm(ipc->child_sig, shmem_child_sig_handler);
     
     // see: www.gnu.org/software/libc/manual/html_node/Sigsuspend.html
@@ -219,7 +231,7 @@ int shmem_ipc_poll(int signal, int poll_msec, int which)
     return done;
 }
 
-void shmem_ipc_setup(const char *pname, int signal, funcPI_t func)
+void shmem_ipc_setup(const char *pname, int signal, funcPI_t func, int cpu)
 {
     assert(!TaskIsChild());
     shmem_ipc_t *ipc = &shmem->ipc[SIG2IPC(signal)];
@@ -228,6 +240,7 @@ void shmem_ipc_setup(const char *pname, int signal, funcPI_t func)
     ipc->tid = TaskID();
     ipc->func = func;
     ipc->child_sig = signal;
+    ipc->cpu = cpu;
     ipc->parent_pid = getpid();
     ipc->child_pid = child_task(ipc->pname, shmem_child_task, NO_WAIT, TO_VOID_PARAM(ipc));
     //real_printf("PARENT shmem_ipc_setup child_pid=%d\n", ipc->child_pid);
@@ -29,6 +29,8 @@ Boston, MA  02110-1301, USA.
 #include "net.h"
 #include "rx_waterfall.h"
 #include "wspr.h"
+#include "gps.h"
+#include "fft_plan.h"
 
 #ifdef DRM
  #include "DRM.h"
@@ -73,8 +75,11 @@ extern log_save_t *log_save_p;
 #define SIG_IPC_WF      (SIG_IPC_SPI + 1)
 #define SIG_IPC_WSPR    (SIG_IPC_WF + 1)
 #define SIG_IPC_DRM     (SIG_IPC_WSPR + MAX_RX_CHANS)
-#define SIG_BACKTRACE   (SIG_IPC_DRM + DRM_MAX_RX)
-#define SIG_MAX_USED    (1 + 1 + MAX_RX_CHANS + DRM_MAX_RX + 1)      // done this way because SIGRTMIN is not a constant
+#define SIG_IPC_SND     (SIG_IPC_DRM + DRM_MAX_RX)
+#define SIG_IPC_GPS     (SIG_IPC_SND + N_SND_IPC)
+#define SIG_BACKTRACE   (SIG_IPC_GPS + 1)
+#define SIG_WSPR_POOL   (SIG_BACKTRACE + 1)     // wakes the WSPR decode workers
+#define SIG_MAX_USED    (1 + 1 + MAX_RX_CHANS + DRM_MAX_RX + N_SND_IPC + 1 + 1 + 1)      // done this way because SIGRTMIN is not a constant
 
 #define SIG2IPC(sig)    ((sig) - SIG_IPC_MIN)
 
@@ -85,6 +90,7 @@ typedef struct {
     funcPI_t func;
     int child_sig, child_signalled;
     int parent_pid, child_pid;
+    int cpu;                    // core the child is pinned to
     int which_hiwat;
     #define N_SHMEM_WHICH 32
     u4_t request[N_SHMEM_WHICH], done[N_SHMEM_WHICH];
@@ -130,6 +136,21 @@ typedef struct {
         drm_shmem_t drm_shmem;
     #endif
 
+    #ifdef SND_SHMEM_DISABLE
+    #else
+        // shared with audio DSP offload processes
+        snd_shmem_t snd_shmem;
+    #endif
+
+    #ifdef GPS_SHMEM_DISABLE
+    #else
+        // shared with GPS acquisition offload process
+        gps_acq_t gps_acq;
+    #endif
+
+    // FFT plan execution times from all processes
+    fft_plan_shmem_t fft_plan_shmem;
+
     log_save_t log_save;    // must be last because of var length
 } shmem_t;
 
@@ -139,4 +160,4 @@ void shmem_init();
 void sig_arm(int signal, funcPI_t handler, int flags=0);
 void shmem_ipc_invoke(int signal, int which=0, int wait=1);
 int shmem_ipc_poll(int signal, int poll_msec, int which=0);
-void shmem_ipc_setup(const char *pname, int signal, funcPI_t func);
+void shmem_ipc_setup(const char *pname, int signal, funcPI_t func, int cpu=1);
@@ -138,3 +138,424 @@ void simd_bit2float(int len, const int8_t* cv, float* fv)
         *fv++ = float(2*(*cv>0) - 1);
     }
 }
+
+// p = re*re + im*im
+void simd_mag2_cf(int len, const fftwf_complex* a, float* p)
+{
+    const float* pa = (const float*) a;
+
+    int counter=0;
+#ifdef __ARM_NEON
+    float32x4x2_t u;
+    float32x4_t w;
+    for (counter=0; counter<len/4; ++counter) {
+        __builtin_prefetch(pa+64);
+        u = vld2q_f32(pa);                          // [re, im]
+        w = vmulq_f32(u.val[0], u.val[0]);          // w  = re*re
+        w = vmlaq_f32(w, u.val[1], u.val[1]);       // w += im*im
+        vst1q_f32(p, w);
+        pa+=8, p+=4;
+    }
+    counter *= 4;
+#endif
+    for (; counter<len; ++counter, pa+=2)
+        *p++ = pa[0]*pa[0] + pa[1]*pa[1];
+}
+
+// peak[bin] = max(p[run]), sum[bin] = sum(p[run])
+void simd_bin_reduce(int nruns,
+                     const uint16_t* run_bin,
+                     const uint16_t* run_len,
+                     const float* p,
+                     float* peak,
+                     float* sum)
+{
+    for (int k=0; k<nruns; ++k) {
+        int n = run_len[k], i = 0;
+        float mx = p[0], sm = 0;
+#ifdef __ARM_NEON
+        if (n >= 4) {
+            float32x4_t vmx = vld1q_f32(p), vsm = vdupq_n_f32(0);
+            for (; i <= n-4; i+=4) {
+                float32x4_t v = vld1q_f32(p+i);
+                vmx = vmaxq_f32(vmx, v);
+                vsm = vaddq_f32(vsm, v);
+            }
+            float32x2_t m2 = vpmax_f32(vget_low_f32(vmx), vget_high_f32(vmx));
+            float32x2_t s2 = vpadd_f32(vget_low_f32(vsm), vget_high_f32(vsm));
+            m2 = vpmax_f32(m2, m2);
+            s2 = vpadd_f32(s2, s2);
+            mx = vget_lane_f32(m2, 0);
+            sm = vget_lane_f32(s2, 0);
+        }
+#endif
+        for (; i<n; ++i) {
+            if (p[i] > mx) mx = p[i];
+            sm += p[i];
+        }
+        peak[run_bin[k]] = mx;
+        if (sum) sum[run_bin[k]] = sm;
+        p += n;
+    }
+}
+
+// log2(x) for x > 0 normal: exponent plus a degree-5 least-squares polynomial of the mantissa
+// max error 2.8e-5 (i.e. < 0.0001 dB after scaling to 10*log10)
+#define LOG2_C1  1.4418255f
+#define LOG2_C2 -0.708678912f
+#define LOG2_C3  0.415411186f
+#define LOG2_C4 -0.194408323f
+#define LOG2_C5  0.0458789501f
+#define DB_PER_LOG2 3.01029996f     // 10*log10(2)
+
+static inline float fast_log2f(float x)
+{
+    union { float f; int32_t i; } u = { x };
+    float e = (float) ((u.i >> 23) - 127);
+    u.i = (u.i & 0x007fffff) | 0x3f800000;
+    float m = u.f - 1.0f;
+    float poly = LOG2_C5;
+    poly = LOG2_C4 + poly*m;
+    poly = LOG2_C3 + poly*m;
+    poly = LOG2_C2 + poly*m;
+    poly = LOG2_C1 + poly*m;
+    return e + poly*m;
+}
+
+// u = uint8_t(int(clamp(10*log10(p*scale + 1e-30) + offset, -200, 0) - 1))
+// i.e. 0..-200 dBm maps to 255..55
+void simd_pwr2dB_u8(int len,
+                    const float* p,
+                    const float* scale,
+                    float offset,
+                    uint8_t* u)
+{
+    int counter=0;
+#ifdef __ARM_NEON
+    const float32x4_t tiny      = vdupq_n_f32(1e-30f);
+    const float32x4_t one       = vdupq_n_f32(1.0f);
+    const float32x4_t db_per_l2 = vdupq_n_f32(DB_PER_LOG2);
+    const float32x4_t voffset   = vdupq_n_f32(offset - 1.0f);    // includes the "dB--"
+    const float32x4_t vmax      = vdupq_n_f32(-1.0f);
+    const float32x4_t vmin      = vdupq_n_f32(-201.0f);
+    const int32x4_t   mant_mask = vdupq_n_s32(0x007fffff);
+    const int32x4_t   exp_one   = vdupq_n_s32(0x3f800000);
+    const int32x4_t   exp_bias  = vdupq_n_s32(127);
+
+    for (counter=0; counter<len/8; ++counter) {
+        __builtin_prefetch(p+64);
+        __builtin_prefetch(scale+64);
+        int32x4_t d[2];
+        for (int h=0; h<2; ++h) {
+            float32x4_t x = vmlaq_f32(tiny, vld1q_f32(p), vld1q_f32(scale));     // x = p*scale + 1e-30
+            int32x4_t xi = vreinterpretq_s32_f32(x);
+            float32x4_t e = vcvtq_f32_s32(vsubq_s32(vshrq_n_s32(xi, 23), exp_bias));
+            float32x4_t m = vsubq_f32(vreinterpretq_f32_s32(vorrq_s32(vandq_s32(xi, mant_mask), exp_one)), one);
+            float32x4_t poly = vdupq_n_f32(LOG2_C5);
+            poly = vmlaq_f32(vdupq_n_f32(LOG2_C4), poly, m);
+            poly = vmlaq_f32(vdupq_n_f32(LOG2_C3), poly, m);
+            poly = vmlaq_f32(vdupq_n_f32(LOG2_C2), poly, m);
+            poly = vmlaq_f32(vdupq_n_f32(LOG2_C1), poly, m);
+            float32x4_t l2 = vmlaq_f32(e, poly, m);
+            float32x4_t dB = vmlaq_f32(voffset, l2, db_per_l2);
+            dB = vminq_f32(vmaxq_f32(dB, vmin), vmax);
+            d[h] = vcvtq_s32_f32(dB);       // truncates toward zero like (int)
+            p+=4, scale+=4;
+        }
+        int16x8_t d16 = vcombine_s16(vmovn_s32(d[0]), vmovn_s32(d[1]));
+        vst1_u8(u, vmovn_u16(vreinterpretq_u16_s16(d16)));
+        u+=8;
+    }
+    counter *= 8;
+#endif
+    for (; counter<len; ++counter) {
+        float dB = DB_PER_LOG2 * fast_log2f((*p++) * (*scale++) + 1e-30f) + offset;
+        if (dB > 0) dB = 0;
+        if (dB < -200.0f) dB = -200.0f;
+        dB--;
+        *u++ = (uint8_t) (int) dB;
+    }
+}
+
+// out[ch][2*j] = q*scale + dc_re, out[ch][2*j+1] = i*scale + dc_im
+void simd_iq24_deinterleave(int nsamps,
+                            int nchans,
+                            const uint8_t* iq,
+                            float scale,
+                            float dc_re,
+                            float dc_im,
+                            float** out)
+{
+    float* po[nchans];
+    for (int ch=0; ch<nchans; ++ch)
+        po[ch] = out[ch];
+
+    int counter=0, ch=0;
+#ifdef __ARM_NEON
+    // Convert 8 consecutive entries per iteration regardless of channel, then distribute.
+    // The SPI buffer is one contiguous run of entries so this is a single pass for all channels.
+    const int n = nsamps*nchans;
+    const uint16_t* p16 = (const uint16_t*) iq;
+    const float32x4_t vdc_re = vdupq_n_f32(dc_re), vdc_im = vdupq_n_f32(dc_im);
+    float stage[16] __attribute__((aligned(16)));
+    for (counter=0; counter<n/8; ++counter) {
+        __builtin_prefetch(p16+96);
+        uint16x8x3_t u = vld3q_u16(p16);                    // [i lo16, q lo16, q3 | i3<<8]
+        int16x8_t hi = vreinterpretq_s16_u16(u.val[2]);
+        int16x8_t i3 = vshrq_n_s16(hi, 8);                  // sign extended i[23:16]
+        int16x8_t q3 = vshrq_n_s16(vshlq_n_s16(hi, 8), 8);  // sign extended q[23:16]
+        for (int h=0; h<2; ++h) {
+            int16x4_t i3h = h? vget_high_s16(i3) : vget_low_s16(i3);
+            int16x4_t q3h = h? vget_high_s16(q3) : vget_low_s16(q3);
+            uint16x4_t ilo = h? vget_high_u16(u.val[0]) : vget_low_u16(u.val[0]);
+            uint16x4_t qlo = h? vget_high_u16(u.val[1]) : vget_low_u16(u.val[1]);
+            int32x4_t vi = vorrq_s32(vshll_n_s16(i3h, 16), vreinterpretq_s32_u32(vmovl_u16(ilo)));
+            int32x4_t vq = vorrq_s32(vshll_n_s16(q3h, 16), vreinterpretq_s32_u32(vmovl_u16(qlo)));
+            float32x4x2_t w;
+            w.val[0] = vmlaq_n_f32(vdc_re, vcvtq_f32_s32(vq), scale);
+            w.val[1] = vmlaq_n_f32(vdc_im, vcvtq_f32_s32(vi), scale);
+            vst2q_f32(stage + 8*h, w);
+        }
+        for (int e=0; e<8; ++e) {
+            if (po[ch]) {
+                po[ch][0] = stage[2*e];
+                po[ch][1] = stage[2*e+1];
+                po[ch] += 2;
+            }
+            if (++ch == nchans) ch = 0;
+        }
+        p16 += 24;
+    }
+    counter *= 8;
+    iq = (const uint8_t*) p16;
+    for (; counter<n; ++counter, iq+=6) {
+        if (po[ch]) {
+            int32_t i = (int32_t) (((uint32_t) (int8_t) iq[5] << 16) | iq[0] | (iq[1] << 8));
+            int32_t q = (int32_t) (((uint32_t) (int8_t) iq[4] << 16) | iq[2] | (iq[3] << 8));
+            po[ch][0] = q * scale + dc_re;
+            po[ch][1] = i * scale + dc_im;
+            po[ch] += 2;
+        }
+        if (++ch == nchans) ch = 0;
+    }
+#else
+    // channel at a time so there is no per-sample enable test
+    for (ch=0; ch<nchans; ++ch) {
+        float* o = po[ch];
+        if (o == NULL) continue;
+        const uint8_t* p = iq + 6*ch;
+        for (counter=0; counter<nsamps; ++counter, p+=6*nchans, o+=2) {
+            int32_t i = (int32_t) (((uint32_t) (int8_t) p[5] << 16) | p[0] | (p[1] << 8));
+            int32_t q = (int32_t) (((uint32_t) (int8_t) p[4] << 16) | p[2] | (p[3] << 8));
+            o[0] = q * scale + dc_re;
+            o[1] = i * scale + dc_im;
+        }
+    }
+#endif
+}
+
+// 2^x for -126 <= x < 128: 2^floor(x) from the exponent bits times a degree-5 polynomial
+// of the fraction, max relative error 2e-7
+#define EXP2_C1 0.693151591f
+#define EXP2_C2 0.240164346f
+#define EXP2_C3 0.0557938212f
+#define EXP2_C4 0.00903105317f
+#define EXP2_C5 0.00185880865f
+#define LOG2_10 3.32192809f
+
+static inline float fast_exp2f(float x)
+{
+    if (x < -126.0f) x = -126.0f;
+    float fl = (float) (int32_t) x;
+    if (fl > x) fl -= 1.0f;
+    float f = x - fl;
+    float poly = EXP2_C5;
+    poly = EXP2_C4 + poly*f;
+    poly = EXP2_C3 + poly*f;
+    poly = EXP2_C2 + poly*f;
+    poly = EXP2_C1 + poly*f;
+    union { float f; int32_t i; } u;
+    u.i = ((int32_t) fl + 127) << 23;
+    return u.f * (1.0f + poly*f);
+}
+
+// m = 0.5*log10((re*re + im*im)*scale + 1e-16)
+void simd_log10_mag_cf(int len,
+                       const float* iq,
+                       float scale,
+                       float* m)
+{
+    const float half_log10_2 = 0.150514998f;    // 0.5*log10(2)
+    int counter=0;
+#ifdef __ARM_NEON
+    const float32x4_t tiny      = vdupq_n_f32(1e-16f);
+    const float32x4_t one       = vdupq_n_f32(1.0f);
+    const int32x4_t   mant_mask = vdupq_n_s32(0x007fffff);
+    const int32x4_t   exp_one   = vdupq_n_s32(0x3f800000);
+    const int32x4_t   exp_bias  = vdupq_n_s32(127);
+
+    for (counter=0; counter<len/4; ++counter) {
+        __builtin_prefetch(iq+64);
+        float32x4x2_t v = vld2q_f32(iq);
+        float32x4_t p = vmlaq_f32(vmulq_f32(v.val[0], v.val[0]), v.val[1], v.val[1]);
+        float32x4_t x = vmlaq_n_f32(tiny, p, scale);
+        int32x4_t xi = vreinterpretq_s32_f32(x);
+        float32x4_t e = vcvtq_f32_s32(vsubq_s32(vshrq_n_s32(xi, 23), exp_bias));
+        float32x4_t mt = vsubq_f32(vreinterpretq_f32_s32(vorrq_s32(vandq_s32(xi, mant_mask), exp_one)), one);
+        float32x4_t poly = vdupq_n_f32(LOG2_C5);
+        poly = vmlaq_f32(vdupq_n_f32(LOG2_C4), poly, mt);
+        poly = vmlaq_f32(vdupq_n_f32(LOG2_C3), poly, mt);
+        poly = vmlaq_f32(vdupq_n_f32(LOG2_C2), poly, mt);
+        poly = vmlaq_f32(vdupq_n_f32(LOG2_C1), poly, mt);
+        vst1q_f32(m, vmulq_n_f32(vmlaq_f32(e, poly, mt), half_log10_2));
+        iq+=8, m+=4;
+    }
+    counter *= 4;
+#endif
+    for (; counter<len; ++counter, iq+=2) {
+        float p = iq[0]*iq[0] + iq[1]*iq[1];
+        *m++ = half_log10_2 * fast_log2f(p*scale + 1e-16f);
+    }
+}
+
+// g = (m <= knee)? fixed : outscale * 10^(m*slope)
+void simd_agc_gain(int len,
+                   const float* m,
+                   float knee,
+                   float fixed,
+                   float outscale,
+                   float slope,
+                   float* g)
+{
+    const float k = slope * LOG2_10;
+    int counter=0;
+#ifdef __ARM_NEON
+    const float32x4_t vknee  = vdupq_n_f32(knee);
+    const float32x4_t vfixed = vdupq_n_f32(fixed);
+    const float32x4_t vmin   = vdupq_n_f32(-126.0f);
+    const float32x4_t one    = vdupq_n_f32(1.0f);
+    const int32x4_t   bias   = vdupq_n_s32(127);
+
+    for (counter=0; counter<len/4; ++counter) {
+        float32x4_t vm = vld1q_f32(m);
+        float32x4_t x = vmaxq_f32(vmulq_n_f32(vm, k), vmin);
+        float32x4_t fl = vcvtq_f32_s32(vcvtq_s32_f32(x));                 // truncate ...
+        fl = vsubq_f32(fl, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(fl, x), vreinterpretq_u32_f32(one))));    // ... to floor
+        float32x4_t f = vsubq_f32(x, fl);
+        float32x4_t poly = vdupq_n_f32(EXP2_C5);
+        poly = vmlaq_f32(vdupq_n_f32(EXP2_C4), poly, f);
+        poly = vmlaq_f32(vdupq_n_f32(EXP2_C3), poly, f);
+        poly = vmlaq_f32(vdupq_n_f32(EXP2_C2), poly, f);
+        poly = vmlaq_f32(vdupq_n_f32(EXP2_C1), poly, f);
+        poly = vmlaq_f32(one, poly, f);
+        float32x4_t p2 = vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(fl), bias), 23));
+        float32x4_t gv = vmulq_n_f32(vmulq_f32(poly, p2), outscale);
+        vst1q_f32(g, vbslq_f32(vcleq_f32(vm, vknee), vfixed, gv));
+        m+=4, g+=4;
+    }
+    counter *= 4;
+#endif
+    for (; counter<len; ++counter, ++m)
+        *g++ = (*m <= knee)? fixed : outscale * fast_exp2f(*m * k);
+}
+
+// sum(a*b)
+float simd_dot_f(int len,
+                 const float* a,
+                 const float* b)
+{
+    float sum = 0;
+    int counter=0;
+#ifdef __ARM_NEON
+    float32x4_t acc0 = vdupq_n_f32(0), acc1 = vdupq_n_f32(0);
+    for (counter=0; counter<len/8; ++counter) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a),   vld1q_f32(b));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a+4), vld1q_f32(b+4));
+        a+=8, b+=8;
+    }
+    counter *= 8;
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float32x2_t s2 = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    sum = vget_lane_f32(vpadd_f32(s2, s2), 0);
+#else
+    // independent partial sums, the loop-carried add is what limits the scalar version
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (counter=0; counter<len/4; ++counter) {
+        s0 += a[0]*b[0]; s1 += a[1]*b[1]; s2 += a[2]*b[2]; s3 += a[3]*b[3];
+        a+=4, b+=4;
+    }
+    counter *= 4;
+    sum = (s0 + s1) + (s2 + s3);
+#endif
+    for (; counter<len; ++counter)
+        sum += *a++ * *b++;
+    return sum;
+}
+
+// coef = x*err + coef*decay
+void simd_lms_update_f(int len,
+                       const float* x,
+                       float err,
+                       float decay,
+                       float* coef)
+{
+    int counter=0;
+#ifdef __ARM_NEON
+    for (counter=0; counter<len/4; ++counter) {
+        vst1q_f32(coef, vmlaq_n_f32(vmulq_n_f32(vld1q_f32(coef), decay), vld1q_f32(x), err));
+        x+=4, coef+=4;
+    }
+    counter *= 4;
+#endif
+    for (; counter<len; ++counter, ++coef)
+        *coef = *x++ * err + *coef * decay;
+}
+
+// i[t] = sum(id*c[t] + qd*s[t]), q[t] = sum(qd*c[t] - id*s[t])
+void simd_tone4_corr_f(int len,
+                       const float* id,
+                       const float* qd,
+                       const float* c,
+                       const float* s,
+                       int stride,
+                       float* i,
+                       float* q)
+{
+    int t, counter=0;
+    for (t=0; t<4; ++t)
+        i[t] = q[t] = 0;
+#ifdef __ARM_NEON
+    float32x4_t ai[4], aq[4];
+    for (t=0; t<4; ++t)
+        ai[t] = aq[t] = vdupq_n_f32(0);
+    for (counter=0; counter<len/4; ++counter) {
+        const int j = counter*4;
+        const float32x4_t vi = vld1q_f32(id+j);
+        const float32x4_t vq = vld1q_f32(qd+j);
+        for (t=0; t<4; ++t) {
+            const float32x4_t vc = vld1q_f32(c + t*stride + j);
+            const float32x4_t vs = vld1q_f32(s + t*stride + j);
+            ai[t] = vmlaq_f32(vmlaq_f32(ai[t], vi, vc), vq, vs);
+            aq[t] = vmlsq_f32(vmlaq_f32(aq[t], vq, vc), vi, vs);
+        }
+    }
+    counter *= 4;
+    for (t=0; t<4; ++t) {
+        float32x2_t si = vadd_f32(vget_low_f32(ai[t]), vget_high_f32(ai[t]));
+        float32x2_t sq = vadd_f32(vget_low_f32(aq[t]), vget_high_f32(aq[t]));
+        i[t] = vget_lane_f32(vpadd_f32(si, si), 0);
+        q[t] = vget_lane_f32(vpadd_f32(sq, sq), 0);
+    }
+#endif
+    for (t=0; t<4; ++t) {
+        const float* ct = c + t*stride;
+        const float* st = s + t*stride;
+        float si = 0, sq = 0;
+        for (int j=counter; j<len; ++j) {
+            si += id[j]*ct[j] + qd[j]*st[j];
+            sq += qd[j]*ct[j] - id[j]*st[j];
+        }
+        i[t] += si;
+        q[t] += sq;
+    }
+}
@@ -24,4 +24,67 @@ extern void simd_multiply_cfc(int len,
 // fv = float(2*(cv>0)-1)
 extern void simd_bit2float(int len, const int8_t* cv, float* fv);
 
+// p = re*re + im*im
+extern void simd_mag2_cf(int len,
+                         const fftwf_complex* a,
+                         float* p);
+// peak[run_bin[k]] = max(p[run k]), sum[run_bin[k]] = sum(p[run k])
+// runs are consecutive in p, sum may be NULL
+extern void simd_bin_reduce(int nruns,
+                            const uint16_t* run_bin,
+                            const uint16_t* run_len,
+                            const float* p,
+                            float* peak,
+                            float* sum);
+// u = uint8_t(int(clamp(10*log10(p*scale + 1e-30) + offset, -200, 0) - 1))
+extern void simd_pwr2dB_u8(int len,
+                           const float* p,
+                           const float* scale,
+                           float offset,
+                           uint8_t* u);
+// deinterleave nsamps x nchans of packed 24-bit IQ (6 bytes each: i[15:0], q[15:0], q[23:16], i[23:16])
+// out[ch][2*j] = q*scale + dc_re, out[ch][2*j+1] = i*scale + dc_im (NB: I/Q swapped)
+// channels with out[ch] == NULL are skipped
+extern void simd_iq24_deinterleave(int nsamps,
+                                   int nchans,
+                                   const uint8_t* iq,
+                                   float scale,
+                                   float dc_re,
+                                   float dc_im,
+                                   float** out);
+
+// m = 0.5*log10((re*re + im*im)*scale + 1e-16), iq interleaved re/im
+extern void simd_log10_mag_cf(int len,
+                              const float* iq,
+                              float scale,
+                              float* m);
+// g = (m <= knee)? fixed : outscale * 10^(m*slope)
+extern void simd_agc_gain(int len,
+                          const float* m,
+                          float knee,
+                          float fixed,
+                          float outscale,
+                          float slope,
+                          float* g);
+// sum(a*b)
+extern float simd_dot_f(int len,
+                        const float* a,
+                        const float* b);
+// coef = x*err + coef*decay
+extern void simd_lms_update_f(int len,
+                              const float* x,
+                              float err,
+                              float decay,
+                              float* coef);
+// correlation with 4 tones, c and s hold 4 rows of stride floats, t = 0..3:
+// i[t] = sum(id*c[t] + qd*s[t]), q[t] = sum(qd*c[t] - id*s[t])
+extern void simd_tone4_corr_f(int len,
+                              const float* id,
+                              const float* qd,
+                              const float* c,
+                              const float* s,
+                              int stride,
+                              float* i,
+                              float* q);
+
 #endif // SUPPORT_SIMD_H
@@ -0,0 +1,95 @@
+/*
+--------------------------------------------------------------------------------
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Library General Public
+License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+You should have received a copy of the GNU Library General Public
+License along with this library; if not, write to the
+Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+Boston, MA  02110-1301, USA.
+--------------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "types.h"
+#include "kiwi_assert.h"
+
+#include <string.h>
+
+// Lock-free single-producer/single-consumer ring of a power-of-2 number of slots.
+// Only the indices live here, the slot arrays belong to the user.
+//
+// wr and rd are free running and each is written by only one side. The release store
+// that publishes an index pairs with the acquire load on the other side, so slot contents
+// are visible before the index that hands them over. This holds even if the producer and
+// consumer are in different threads or processes (ring in shmem), not just coroutines.
+//
+// producer:  if (spsc_full(r)) drop; else { fill slot spsc_wr_slot(r); spsc_produce(r); }
+// consumer:  while (!spsc_empty(r)) { use slot spsc_rd_slot(r); spsc_consume(r); }
+
+typedef struct {
+    u4_t wr, rd;
+    u4_t size;
+
+    // telemetry, written by the producer
+    u4_t overruns;      // times the producer found the ring full and had to drop
+    u4_t hiwat;         // most slots ever in use, the reader may take and reset it atomically
+} spsc_t;
+
+static inline void spsc_init(spsc_t *r, u4_t size)
+{
+    assert(size != 0 && (size & (size-1)) == 0);
+    memset(r, 0, sizeof(*r));
+    r->size = size;
+}
+
+// slots in use, valid from either side
+static inline u4_t spsc_used(spsc_t *r)
+{
+    return __atomic_load_n(&r->wr, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->rd, __ATOMIC_ACQUIRE);
+}
+
+// producer side
+
+static inline bool spsc_full(spsc_t *r)
+{
+    return (r->wr - __atomic_load_n(&r->rd, __ATOMIC_ACQUIRE)) >= r->size;
+}
+
+static inline u4_t spsc_wr_slot(spsc_t *r)
+{
+    return r->wr & (r->size-1);
+}
+
+static inline void spsc_produce(spsc_t *r)
+{
+    u4_t wr = r->wr + 1;
+    __atomic_store_n(&r->wr, wr, __ATOMIC_RELEASE);
+    u4_t used = wr - __atomic_load_n(&r->rd, __ATOMIC_ACQUIRE);
+    u4_t hiwat = __atomic_load_n(&r->hiwat, __ATOMIC_RELAXED);
+    while (used > hiwat && !__atomic_compare_exchange_n(&r->hiwat, &hiwat, used, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// consumer side
+
+static inline bool spsc_empty(spsc_t *r)
+{
+    return __atomic_load_n(&r->wr, __ATOMIC_ACQUIRE) == r->rd;
+}
+
+static inline u4_t spsc_rd_slot(spsc_t *r)
+{
+    return r->rd & (r->size-1);
+}
+
+static inline void spsc_consume(spsc_t *r)
+{
+    __atomic_store_n(&r->rd, r->rd + 1, __ATOMIC_RELEASE);
+}
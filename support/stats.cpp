@@ -27,6 +27,8 @@ Boston, MA  02110-1301, USA.
 #include "debug.h"
 #include "printf.h"
 #include "non_block.h"
+#include "spi_dev.h"
+#include "fft_plan.h"
 
 void stat_task(void *param)
 {
@@ -39,6 +41,10 @@ void stat_task(void *param)
 			if (do_sdr) {
 				webserver_collect_print_stats(print_stats & STATS_TASK);
 				if (!do_gps) nbuf_stat();
+				web_server_stats();
+				c2s_sound_stats();
+				fft_plan_stats();
+				if (spi_replay) spi_replay_stats();
 			}
 
             cull_zombies();
@@ -0,0 +1,194 @@
+// Benchmark and check of CAgc::ProcessData(): the original per-sample version
+// (log10f/powf per sample, peak buffer rescanned when the peak leaves the window)
+// versus the block version with the monotonic deque peak and fast log2/exp2.
+// Test signals at 12 kHz: a carrier with 20 dB fading plus noise bursts, and a carrier
+// whose level keeps falling (sawtooth), which makes the original rescan its window on
+// nearly every sample. Both TYPECPX and TYPEMONO16 outputs, with and without hang.
+//
+// make UTIL=agc_bench run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../types.h"
+#include "agc.h"
+
+#define SRATE		12000
+#define NSAMPS		(SRATE * 10)
+#define BLOCK		512			// samples per ProcessData() call, like the audio task
+#define NPASS		20			// timing passes over the samples, last one is compared
+
+// the original algorithm
+struct agc_ref {
+	bool UseHang;
+	float Knee, GainSlope, FixedGain, Peak, DecayAve, AttackAve;
+	float AttackRiseAlpha, AttackFallAlpha, DecayRiseAlpha, DecayFallAlpha;
+	int SigDelayPtr, MagBufPos, DelaySamples, WindowSamples, HangTime, HangTimer;
+	TYPECPX SigDelayBuf[MAX_DELAY_BUF];
+	float MagBuf[MAX_DELAY_BUF];
+
+	void init(bool hang, int thresh, int slope, int decay)
+	{
+		memset(this, 0, sizeof(*this));
+		UseHang = hang;
+		for (int i=0; i < MAX_DELAY_BUF; i++) MagBuf[i] = -16.0;
+		Peak = -16.0; DecayAve = -5.0; AttackAve = -5.0;
+		Knee = thresh/20.0;
+		GainSlope = slope/100.0;
+		FixedGain = 0.7 * powf(10.0, Knee*(GainSlope - 1.0));
+		AttackRiseAlpha = 1.0 - expf(-1.0/(SRATE*.002));
+		AttackFallAlpha = 1.0 - expf(-1.0/(SRATE*.005));
+		DecayRiseAlpha = 1.0 - expf(-1.0/(SRATE*decay*.001*.3));
+		HangTime = (int) (SRATE*decay*.001);
+		DecayFallAlpha = hang? 1.0 - expf(-1.0/(SRATE*.05)) : 1.0 - expf(-1.0/(SRATE*decay*.001));
+		DelaySamples = (int) (SRATE*.015);
+		WindowSamples = (int) (SRATE*.018);
+	}
+
+	float gain(TYPECPX in, TYPECPX *delayedin)
+	{
+		*delayedin = SigDelayBuf[SigDelayPtr];
+		SigDelayBuf[SigDelayPtr++] = in;
+		if (SigDelayPtr >= DelaySamples) SigDelayPtr = 0;
+		float mag = 0.5 * log10f((in.re*in.re + in.im*in.im)/(32767.0*32767.0) + 1e-16);
+		float tmp = MagBuf[MagBufPos];
+		MagBuf[MagBufPos++] = mag;
+		if (MagBufPos >= WindowSamples) MagBufPos = 0;
+		if (mag > Peak) {
+			Peak = mag;
+		} else
+		if (tmp == Peak) {
+			Peak = -8.0;
+			for (int i=0; i < WindowSamples; i++)
+				if (MagBuf[i] > Peak) Peak = MagBuf[i];
+		}
+		AttackAve = (Peak > AttackAve)? (1.0-AttackRiseAlpha)*AttackAve + AttackRiseAlpha*Peak :
+			(1.0-AttackFallAlpha)*AttackAve + AttackFallAlpha*Peak;
+		if (Peak > DecayAve) {
+			DecayAve = (1.0-DecayRiseAlpha)*DecayAve + DecayRiseAlpha*Peak;
+			HangTimer = 0;
+		} else {
+			if (UseHang && HangTimer < HangTime)
+				HangTimer++;
+			else
+				DecayAve = (1.0-DecayFallAlpha)*DecayAve + DecayFallAlpha*Peak;
+		}
+		mag = (AttackAve > DecayAve)? AttackAve : DecayAve;
+		return (mag <= Knee)? FixedGain : 0.7 * powf(10.0, mag*(GainSlope - 1.0));
+	}
+};
+
+static TYPECPX in[NSAMPS], out_ref[NSAMPS], out_new[NSAMPS];
+static TYPEMONO16 out16_ref[NSAMPS], out16_new[NSAMPS];
+static agc_ref ref;
+CAgc agc;
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec);
+}
+
+static void ref_cpx()
+{
+	TYPECPX d;
+	for (int i=0; i < NSAMPS; i++) {
+		float g = ref.gain(in[i], &d);
+		out_ref[i].re = d.re * g;
+		out_ref[i].im = d.im * g;
+	}
+}
+
+static void ref_mono16()
+{
+	TYPECPX d;
+	for (int i=0; i < NSAMPS; i++) {
+		float g = ref.gain(in[i], &d);
+		out16_ref[i] = (TYPEMONO16) (d.re * g);
+	}
+}
+
+static void gen(int sig)
+{
+	srandom(1);
+	for (int i=0; i < NSAMPS; i++) {
+		float t = (float) i / SRATE, a;
+		if (sig == 0) {
+			a = 3000 * powf(10, -1 + sinf(2*M_PI*0.3*t));		// 20 dB fade
+			if ((i / 3000) % 7 == 3) a += 20000;					// bursts
+		} else {
+			a = 30000 * powf(10, -2 * fmodf(t, 1.0));			// falls 40 dB each second
+		}
+		float ph = 2*M_PI*1000*t;
+		in[i].re = a * cosf(ph) + (random() % 201) - 100;
+		in[i].im = a * sinf(ph) + (random() % 201) - 100;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct rusage start, finish;
+	static const char *sig_s[] = { "fading", "falling" };
+
+	for (int sig=0; sig <= 1; sig++)
+	for (int hang=0; hang <= 1; hang++) {
+		gen(sig);
+
+		// CPX
+		ref.init(hang, -100, 6, 1000);
+		getrusage(RUSAGE_SELF, &start);
+		for (int p=0; p < NPASS; p++) ref_cpx();
+		getrusage(RUSAGE_SELF, &finish);
+		double t_ref = cpu_secs(&start, &finish);
+
+		agc = CAgc();
+		agc.SetParameters(true, hang, -100, 50, 6, 1000, SRATE);
+		getrusage(RUSAGE_SELF, &start);
+		for (int p=0; p < NPASS; p++)
+			for (int i=0; i < NSAMPS; i += BLOCK)
+				agc.ProcessData(MIN(BLOCK, NSAMPS-i), &in[i], &out_new[i], false);
+		getrusage(RUSAGE_SELF, &finish);
+		double t_new = cpu_secs(&start, &finish);
+
+		double max_rel = 0;
+		int over = 0;
+		for (int i=0; i < NSAMPS; i++) {
+			float m = hypotf(out_ref[i].re, out_ref[i].im);
+			if (m < 1) continue;
+			double rel = hypotf(out_new[i].re - out_ref[i].re, out_new[i].im - out_ref[i].im) / m;
+			if (rel > 1e-4) over++;
+			if (rel > max_rel) max_rel = rel;
+		}
+		printf("%-7s CPX    hang=%d: orig %.1f ns/samp, new %.1f ns/samp, %.2fx, max rel diff %.2e, %d samples > 1e-4\n",
+			sig_s[sig], hang, t_ref / NSAMPS / NPASS * 1e9, t_new / NSAMPS / NPASS * 1e9, t_ref / t_new, max_rel, over);
+
+		// MONO16
+		ref.init(hang, -100, 6, 1000);
+		getrusage(RUSAGE_SELF, &start);
+		for (int p=0; p < NPASS; p++) ref_mono16();
+		getrusage(RUSAGE_SELF, &finish);
+		t_ref = cpu_secs(&start, &finish);
+
+		agc = CAgc();
+		agc.SetParameters(true, hang, -100, 50, 6, 1000, SRATE);
+		getrusage(RUSAGE_SELF, &start);
+		for (int p=0; p < NPASS; p++)
+			for (int i=0; i < NSAMPS; i += BLOCK)
+				agc.ProcessData(MIN(BLOCK, NSAMPS-i), &in[i], &out16_new[i], false);
+		getrusage(RUSAGE_SELF, &finish);
+		t_new = cpu_secs(&start, &finish);
+
+		int max_diff = 0;
+		for (int i=0; i < NSAMPS; i++) {
+			int d = abs(out16_new[i] - out16_ref[i]);
+			if (d > max_diff) max_diff = d;
+		}
+		printf("%-7s MONO16 hang=%d: orig %.1f ns/samp, new %.1f ns/samp, %.2fx, max diff %d LSB\n",
+			sig_s[sig], hang, t_ref / NSAMPS / NPASS * 1e9, t_new / NSAMPS / NPASS * 1e9, t_ref / t_new, max_diff);
+	}
+	return 0;
+}
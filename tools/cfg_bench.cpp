@@ -0,0 +1,320 @@
+// Benchmark and check of configuration lookups: the original linear scan of every jsmn token
+// (and _cfg_walk() for "id1.id2") versus the hash index in init/cfg.cpp, plus the typed value
+// cache of the cfg_int()/cfg_bool()/cfg_float() getters.
+// Uses the distribution kiwi.json, admin.json and dx.json, plus generated files the size of the
+// kiwi.json/admin.json of a receiver that has been running a while (hundreds of ids, some objects)
+// and of a large dx.json. Every id in them, every id1.id2 pair and some missing ids are looked up
+// with both versions and the resulting tokens must be identical. JSON nested too deep to be indexed
+// must give the same results from the linear scan lookups fall back to.
+//
+// make UTIL=cfg_bench run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../types.h"
+#include "config.h"
+#include "kiwi.h"
+#include "misc.h"
+#include "str.h"
+#include "cfg.h"
+
+#define NLOOKUP		2000000
+#define DEEP_LEVELS	40		// more than the hash index tracks (CFG_HASH_DEPTH)
+
+// the original lookup
+static jsmntok_t *ref_lookup_id(cfg_t *cfg, const char *id)
+{
+	int idlen = strlen(id);
+	for (jsmntok_t *jt = cfg->tokens; jt != &cfg->tokens[cfg->ntok]; jt++) {
+		int n = jt->end - jt->start;
+		if (JSMN_IS_ID(jt) && n == idlen && strncmp(id, &cfg->json[jt->start], n) == 0)
+			return jt+1;
+	}
+	return NULL;
+}
+
+static bool ref_lookup_cb(cfg_t *cfg, void *param, jsmntok_t *jt, int seq, int hit, int lvl, int rem, void **rval)
+{
+	char *id2 = (char *) param;
+	if (!JSMN_IS_ID(jt)) return false;
+	int n = jt->end - jt->start;
+	if (n != (int) strlen(id2) || strncmp(&cfg->json[jt->start], id2, n) != 0) return false;
+	if (rval) *rval = jt+1;
+	return true;
+}
+
+static jsmntok_t *ref_lookup(cfg_t *cfg, const char *id)
+{
+	const char *dot = strchr(id, '.');
+	if (dot && !strchr(dot+1, '.')) {
+		char id1[256];
+		snprintf(id1, sizeof(id1), "%.*s", (int) (dot - id), id);
+		jsmntok_t *jt = (jsmntok_t *) _cfg_walk(cfg, id1, ref_lookup_cb, (void *) (dot+1));
+		if (jt == NULL && ref_lookup_id(cfg, id1) != NULL) return CFG_LOOKUP_LVL1;
+		return jt;
+	}
+	return ref_lookup_id(cfg, id);
+}
+
+#define NIDS	4096
+static char *ids[NIDS];
+static int nids;
+
+static void add_id(const char *fmt, ...)
+{
+	if (nids == NIDS) return;
+	va_list ap;
+	va_start(ap, fmt);
+	vasprintf(&ids[nids], fmt, ap);
+	va_end(ap);
+
+	// repeated ids (e.g. every dx.json entry has the same few) give nothing more to check or time
+	for (int i=0; i < nids; i++)
+		if (strcmp(ids[i], ids[nids]) == 0) { free(ids[nids]); return; }
+	nids++;
+}
+
+// every id, and id1.id2 for ids directly inside the object of id1
+static bool collect_cb(cfg_t *cfg, void *param, jsmntok_t *jt, int seq, int hit, int lvl, int rem, void **rval)
+{
+	static char id1[256];
+	if (seq < 0 || !JSMN_IS_ID(jt)) return false;
+	int n = jt->end - jt->start;
+	char *s = &cfg->json[jt->start];
+	if (lvl == 1) snprintf(id1, sizeof(id1), "%.*s", n, s);
+	add_id("%.*s", n, s);
+	if (lvl == 2) add_id("%s.%.*s", id1, n, s);
+	return false;
+}
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec);
+}
+
+static char *load(const char *fn)
+{
+	FILE *fp = fopen(fn, "r");
+	if (fp == NULL) { printf("can't open %s\n", fn); return NULL; }
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	char *buf = (char *) malloc(size + 1);
+	buf[fread(buf, 1, size, fp)] = '\0';
+	fclose(fp);
+	return buf;
+}
+
+// generated JSON
+static char *gbuf;
+static int glen, gsize;
+
+static void gen(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	int n = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (glen + n + 1 > gsize) {
+		gsize = (glen + n + 1) * 2;
+		gbuf = (char *) realloc(gbuf, gsize);
+	}
+	va_start(ap, fmt);
+	vsnprintf(gbuf + glen, n + 1, fmt, ap);
+	va_end(ap);
+	glen += n;
+}
+
+static const char *gen_start()
+{
+	glen = 0;
+	gen("");
+	return gbuf;
+}
+
+// nval top level ids of mixed types, nobj objects of nsub ids each
+static char *gen_cfg(int nval, int nobj, int nsub)
+{
+	gen_start();
+	gen("{");
+	for (int i=0; i < nval; i++) {
+		switch (i % 4) {
+			case 0: gen("\"param_%d\":%d,", i, i * 7); break;
+			case 1: gen("\"flag_%d\":%s,", i, (i & 2)? "true" : "false"); break;
+			case 2: gen("\"freq_%d\":%d.%03d,", i, i, i % 1000); break;
+			case 3: gen("\"name_%d\":\"value%%20of%%20%d\",", i, i); break;
+		}
+	}
+	for (int i=0; i < nobj; i++) {
+		gen("\"ext_%d\":{", i);
+		for (int j=0; j < nsub; j++)
+			gen("\"%s_%d\":%d%s", (j & 1)? "enable" : "param", j, j, (j == nsub-1)? "" : ",");
+		gen("},");
+	}
+	gen("\"last\":0}");
+	return strdup(gbuf);
+}
+
+// dx.json with n entries like the distribution one
+static char *gen_dx(int n)
+{
+	static const char *mode[] = { "AM", "CW", "CWN", "USB", "LSB" };
+	gen_start();
+	gen("{\"dx\":[");
+	for (int i=0; i < n; i++)
+		gen("%s[%d.%02d,\"%s\",\"Station%%20%d\",\"notes%%20%d\",{\"WL\":%d}]\n",
+			i? "," : "", 10 + i, i % 100, mode[i % 5], i, i, i % 3);
+	gen("]}");
+	return strdup(gbuf);
+}
+
+// nested deeper than the hash index tracks, so lookups scan
+static char *gen_deep(int depth)
+{
+	gen_start();
+	gen("{\"top\":1,");
+	for (int i=0; i < depth; i++) gen("\"lvl_%d\":{\"val_%d\":%d,", i, i, i);
+	gen("\"bottom\":true");
+	for (int i=0; i < depth; i++) gen("},\"after_%d\":%d", depth-1-i, i);
+	gen("}");
+	return strdup(gbuf);
+}
+
+// ids of gen_deep(): _cfg_walk() can't be used to collect them or for ref_lookup() as it doesn't nest that deep
+static int check_deep(cfg_t *cfg, int depth)
+{
+	int bad = 0;
+	char id[64];
+
+	for (int i=0; i < depth; i++) {
+		const char *fmt[] = { "lvl_%d", "val_%d", "after_%d" };
+		for (int k=0; k < 3; k++) {
+			snprintf(id, sizeof(id), fmt[k], i);
+			jsmntok_t *jt_ref = ref_lookup_id(cfg, id);
+			if (jt_ref == NULL || jt_ref != _cfg_lookup_json(cfg, id, CFG_OPT_NONE)) bad++;
+		}
+
+		// id1.id2 is the value of id2 directly inside id1 (val_i, and lvl_i+1 except at the bottom)
+		snprintf(id, sizeof(id), "val_%d", i);
+		jsmntok_t *jt_ref = ref_lookup_id(cfg, id);
+		snprintf(id, sizeof(id), "lvl_%d.val_%d", i, i);
+		if (jt_ref != _cfg_lookup_json(cfg, id, CFG_OPT_NONE)) bad++;
+		snprintf(id, sizeof(id), "lvl_%d.val_%d", i, i+1);
+		if (_cfg_lookup_json(cfg, id, CFG_OPT_NONE) != CFG_LOOKUP_LVL1) bad++;
+		snprintf(id, sizeof(id), "lvl_%d.after_%d", i, i);
+		if (_cfg_lookup_json(cfg, id, CFG_OPT_NONE) != CFG_LOOKUP_LVL1) bad++;
+		if (i+1 < depth) {
+			snprintf(id, sizeof(id), "lvl_%d", i+1);
+			jt_ref = ref_lookup_id(cfg, id);
+			snprintf(id, sizeof(id), "lvl_%d.lvl_%d", i, i+1);
+			if (jt_ref != _cfg_lookup_json(cfg, id, CFG_OPT_NONE)) bad++;
+		}
+	}
+	if (_cfg_lookup_json(cfg, "bottom", CFG_OPT_NONE) != ref_lookup_id(cfg, "bottom")) bad++;
+	if (_cfg_lookup_json(cfg, "top.bottom", CFG_OPT_NONE) != CFG_LOOKUP_LVL1) bad++;
+	if (_cfg_lookup_json(cfg, "no_such_id", CFG_OPT_NONE) != NULL) bad++;
+
+	// the typed getters, twice for what would come from the value cache of an indexed cfg
+	bool err;
+	for (int pass = 0; pass < 2; pass++) {
+		for (int i=0; i < depth; i++) {
+			snprintf(id, sizeof(id), "val_%d", i);
+			if (json_int(cfg, id, &err, CFG_OPTIONAL) != i || err) bad++;
+			if (json_float(cfg, id, &err, CFG_OPTIONAL) != i || err) bad++;
+			snprintf(id, sizeof(id), "lvl_%d.val_%d", i, i);
+			if (json_int(cfg, id, &err, CFG_OPTIONAL) != i || err) bad++;
+		}
+		if (json_bool(cfg, "bottom", &err, CFG_OPTIONAL) != true || err) bad++;
+		json_int(cfg, "no_such_id", &err, CFG_OPTIONAL);
+		if (!err) bad++;
+	}
+	json_set_int(cfg, "val_5", 55);
+	if (json_int(cfg, "val_5", &err, CFG_OPTIONAL) != 55 || err) bad++;
+	
+	printf("deep JSON (%d levels): %d tokens, %s, %d mismatches\n",
+		depth, cfg->ntok, cfg->hash_scan? "not indexed" : "INDEXED", bad);
+	return bad + (cfg->hash_scan? 0:1);
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *fn[] = {
+		"../unix_env/kiwi.config/dist.kiwi.json", "../unix_env/kiwi.config/dist.admin.json",
+		"../unix_env/kiwi.config/dist.dx.json",
+		"generated kiwi.json", "generated admin.json", "generated dx.json"
+	};
+	struct rusage start, finish;
+	int errs = 0;
+
+	for (int f=0; f < (int) ARRAY_LEN(fn); f++) {
+		static cfg_t cfg;
+		char *buf;
+		switch (f) {
+			case 3: buf = gen_cfg(600, 12, 20); break;
+			case 4: buf = gen_cfg(200, 2, 10); break;
+			case 5: buf = gen_dx(10000); break;
+			default: buf = load(fn[f]); break;
+		}
+		if (buf == NULL || !json_init(&cfg, buf)) return -1;
+		free(buf);
+		nids = 0;
+		_cfg_walk(&cfg, NULL, collect_cb, NULL);
+		int nfound = nids;
+		add_id("no_such_id");
+		add_id("no_such.id");
+		add_id("%s.no_such_id", ids[0]);
+		add_id("1.2.3.4");
+
+		int bad = 0;
+		for (int i=0; i < nids; i++) {
+			jsmntok_t *jt_ref = ref_lookup(&cfg, ids[i]);
+			jsmntok_t *jt_new = _cfg_lookup_json(&cfg, ids[i], CFG_OPT_NONE);
+			if (jt_ref != jt_new) {
+				printf("MISMATCH %s: ref %p new %p\n", ids[i], jt_ref, jt_new);
+				bad++;
+			}
+		}
+
+		// the linear scan is slow on the big files, fewer of them
+		int nref = MAX(NLOOKUP/100 * 50 / MAX(cfg.ntok, 50), 100);
+		getrusage(RUSAGE_SELF, &start);
+		for (int i=0; i < nref; i++) ref_lookup(&cfg, ids[i % nids]);
+		getrusage(RUSAGE_SELF, &finish);
+		double t_ref = cpu_secs(&start, &finish) / nref * 1e9;
+
+		getrusage(RUSAGE_SELF, &start);
+		for (int i=0; i < NLOOKUP; i++) _cfg_lookup_json(&cfg, ids[i % nids], CFG_OPT_NONE);
+		getrusage(RUSAGE_SELF, &finish);
+		double t_new = cpu_secs(&start, &finish) / NLOOKUP * 1e9;
+
+		// getters: the value is parsed once then comes from the cache
+		bool err;
+		getrusage(RUSAGE_SELF, &start);
+		for (int i=0; i < NLOOKUP; i++) json_int(&cfg, ids[i % nfound], &err, CFG_OPTIONAL);
+		getrusage(RUSAGE_SELF, &finish);
+		double t_int = cpu_secs(&start, &finish) / NLOOKUP * 1e9;
+
+		printf("%s: %d tokens, %d ids (%d missing), %d mismatches\n", fn[f], cfg.ntok, nids, nids - nfound, bad);
+		printf("    lookup: linear %.1f ns, hash %.1f ns, %.0fx; json_int() %.1f ns\n",
+			t_ref, t_new, t_ref / t_new, t_int);
+
+		errs += bad;
+		for (int i=0; i < nids; i++) free(ids[i]);
+		json_release(&cfg);
+	}
+	
+	static cfg_t cfg;
+	char *buf = gen_deep(DEEP_LEVELS);
+	if (!json_init(&cfg, buf)) return -1;
+	free(buf);
+	errs += check_deep(&cfg, DEEP_LEVELS);
+	json_release(&cfg);
+
+	return errs? 1 : 0;
+}
@@ -0,0 +1,232 @@
+// Benchmark and check of websocket command dispatch for the SND stream: the original chain of
+// strcmp()/kiwi_str_begins_with()/sscanf() tests, in the order of rx_common_cmd() then c2s_sound(),
+// versus looking up the key word with rx_cmd_key() and running only the one matching parse.
+// Both versions must select the same command (or none) for every command of the mix.
+//
+// make UTIL=cmd_bench run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../types.h"
+#include "rx_cmd_key.h"
+
+#define NLOOP		20000
+
+typedef enum { STRCMP, BEGINS, SSCANF } how_e;
+
+// the tests in the order the original code made them
+static const struct {
+	set_key_e key;
+	how_e how;
+	int n;
+	const char *fmt;
+} chain[] = {
+	// rx_common_cmd() (after "SET auth" only once authenticated)
+	{ CMD_SET_KEEPALIVE,		STRCMP, 0, "SET keepalive" },
+	{ CMD_SET_AUTH,				BEGINS, 0, "SET auth" },
+	{ CMD_SET_SAVE_CFG,			BEGINS, 0, "SET save_cfg=" },
+	{ CMD_SET_SAVE_ADM,			BEGINS, 0, "SET save_adm=" },
+	{ CMD_SET_DX_UPD,			BEGINS, 0, "SET DX_UPD" },
+	{ CMD_SET_DX_FILTER,		BEGINS, 0, "SET DX_FILTER" },
+	{ CMD_SET_MKR,				BEGINS, 0, "SET MKR" },
+	{ CMD_SET_GET_DX_JSON,		STRCMP, 0, "SET GET_DX_JSON" },
+	{ CMD_SET_GET_CONFIG,		STRCMP, 0, "SET GET_CONFIG" },
+	{ CMD_SET_STATS_UPD,		BEGINS, 0, "SET STATS_UPD" },
+	{ CMD_SET_GET_USERS,		STRCMP, 0, "SET GET_USERS" },
+	{ CMD_SET_IDENT_USER,		BEGINS, 0, "SET ident_user=" },
+	{ CMD_SET_NEED_STATUS,		SSCANF, 1, "SET need_status=%d" },
+	{ CMD_SET_GEO,				SSCANF, 1, "SET geo=%127ms" },
+	{ CMD_SET_GEOJSON,			SSCANF, 1, "SET geojson=%256ms" },
+	{ CMD_SET_BROWSER,			SSCANF, 1, "SET browser=%256ms" },
+	{ CMD_SET_WF_COMP,			SSCANF, 1, "SET wf_comp=%d" },
+	{ CMD_SET_INACTIVITY_ACK,	STRCMP, 0, "SET inactivity_ack" },
+	{ CMD_SET_PREF_EXPORT,		BEGINS, 0, "SET pref_export" },
+	{ CMD_SET_PREF_IMPORT,		BEGINS, 0, "SET pref_import" },
+	{ CMD_SET_OVERRIDE,			SSCANF, 1, "SET OVERRIDE inactivity_timeout=%d" },
+	{ CMD_SET_NOCACHE,			SSCANF, 1, "SET nocache=%d" },
+	{ CMD_SET_CTRACE,			SSCANF, 1, "SET ctrace=%d" },
+	{ CMD_SET_DEBUG_V,			SSCANF, 1, "SET debug_v=%d" },
+	{ CMD_SET_DEBUG_MSG,		BEGINS, 0, "SET debug_msg=" },
+	{ CMD_SET_IS_ADMIN,			STRCMP, 0, "SET is_admin" },
+	{ CMD_SET_GET_AUTHKEY,		STRCMP, 0, "SET get_authkey" },
+	{ CMD_SET_CLK_ADJ,			SSCANF, 1, "SET clk_adj=%d" },
+	{ CMD_SET_X_DEBUG,			BEGINS, 0, "SET x-DEBUG" },
+
+	// c2s_sound()
+	{ CMD_SET_DBG_AUDIO_START,	SSCANF, 1, "SET dbgAudioStart=%d" },
+	{ CMD_SET_MOD,				SSCANF, 4, "SET mod=%16ms low_cut=%lf high_cut=%lf freq=%lf" },
+	{ CMD_SET_COMPRESSION,		SSCANF, 1, "SET compression=%d" },
+	{ CMD_SET_RESTART,			STRCMP, 0, "SET restart" },
+	{ CMD_SET_LITTLE_ENDIAN,	STRCMP, 0, "SET little-endian" },
+	{ CMD_SET_GEN,				SSCANF, 2, "SET gen=%lf mix=%lf" },
+	{ CMD_SET_GENATTN,			SSCANF, 1, "SET genattn=%d" },
+	{ CMD_SET_AGC,				SSCANF, 6, "SET agc=%d hang=%d thresh=%d slope=%d decay=%d manGain=%d" },
+	{ CMD_SET_SQUELCH,			SSCANF, 2, "SET squelch=%d max=%d" },
+	{ CMD_SET_LMS_DENOISE,		SSCANF, 1, "SET lms_denoise=%d" },
+	{ CMD_SET_LMS_DE_DELAY,		SSCANF, 1, "SET lms.de_delay=%d" },
+	{ CMD_SET_LMS_DE_BETA,		SSCANF, 1, "SET lms.de_beta=%f" },
+	{ CMD_SET_LMS_DE_DECAY,		SSCANF, 1, "SET lms.de_decay=%f" },
+	{ CMD_SET_LMS_DE_BLOCK,		SSCANF, 1, "SET lms.de_block=%d" },
+	{ CMD_SET_LMS_AUTONOTCH,	SSCANF, 1, "SET lms_autonotch=%d" },
+	{ CMD_SET_LMS_AN_DELAY,		SSCANF, 1, "SET lms.an_delay=%d" },
+	{ CMD_SET_LMS_AN_BETA,		SSCANF, 1, "SET lms.an_beta=%f" },
+	{ CMD_SET_LMS_AN_DECAY,		SSCANF, 1, "SET lms.an_decay=%f" },
+	{ CMD_SET_LMS_AN_BLOCK,		SSCANF, 1, "SET lms.an_block=%d" },
+	{ CMD_SET_MUTE,				SSCANF, 1, "SET mute=%d" },
+	{ CMD_SET_DE_EMP,			SSCANF, 1, "SET de_emp=%d" },
+	{ CMD_SET_TEST,				SSCANF, 1, "SET test=%d" },
+	{ CMD_SET_NB,				SSCANF, 2, "SET nb=%d th=%d" },
+	{ CMD_SET_UAR,				SSCANF, 2, "SET UAR in=%d out=%d" },
+	{ CMD_SET_AR,				SSCANF, 2, "SET AR OK in=%d out=%d" },
+	{ CMD_SET_UNDERRUN,			SSCANF, 1, "SET underrun=%d" },
+};
+
+#define N_COMMON	29		// entries of chain[] from rx_common_cmd()
+
+static const char *mix[] = {
+	"SET keepalive",
+	"SET mod=usb low_cut=300 high_cut=2700 freq=7020.000",
+	"SET agc=1 hang=0 thresh=-100 slope=6 decay=1000 manGain=50",
+	"SET squelch=0 max=0",
+	"SET compression=1",
+	"SET lms.an_decay=0.99915",
+	"SET nb=0 th=50",
+	"SET de_emp=0",
+	"SET AR OK in=12000 out=44100",
+	"SET underrun=1",
+	"SET STATS_UPD ch=0",
+	"SET geo=Somewhere",
+	"SET ident_user=kiwi",
+	"SET little-endian",
+	"SET no_such_cmd=1",
+};
+
+typedef union { int i; float f; double d; char *s; } arg_t;
+
+static bool begins_with(const char *s, const char *cs)
+{
+	return (strncmp(s, cs, strlen(cs)) == 0);
+}
+
+static bool has_ms(const char *fmt)
+{
+	const char *s = strchr(fmt, '%');
+	if (s == NULL) return false;
+	for (s++; *s >= '0' && *s <= '9'; s++)
+		;
+	return (s[0] == 'm' && s[1] == 's');
+}
+
+static bool test(const char *cmd, int c)
+{
+	arg_t a[8];
+	memset(a, 0, sizeof(a));
+	switch (chain[c].how) {
+	case STRCMP: return (strcmp(cmd, chain[c].fmt) == 0);
+	case BEGINS: return begins_with(cmd, chain[c].fmt);
+	case SSCANF: {
+		int n = sscanf(cmd, chain[c].fmt, &a[0], &a[1], &a[2], &a[3], &a[4], &a[5], &a[6], &a[7]);
+		if (has_ms(chain[c].fmt)) free(a[0].s);		// %ms is always the first conversion
+		return (n == chain[c].n);
+	}
+	}
+	return false;
+}
+
+// what rx_common_cmd() checks after the command switch for anything not a "SET" command
+static bool tail(const char *cmd)
+{
+	int y, n, d, h, m, s;
+	if (begins_with(cmd, "SERVER DE CLIENT")) return true;
+	if (strcmp(cmd, "PING") == 0) return true;
+	if (strlen(cmd) == 2 && cmd[0] == 3) return true;
+	if (sscanf(cmd, "%d/%d/%d %d:%d:%d", &y, &n, &d, &h, &m, &s) == 6) return true;
+	return false;
+}
+
+// original: returns chain[] index or -1
+static int dispatch_ref(const char *cmd)
+{
+	int c;
+	for (c = 0; c < N_COMMON - 1; c++)
+		if (test(cmd, c)) return c;
+	if (tail(cmd)) return -1;
+	if (test(cmd, N_COMMON - 1)) return N_COMMON - 1;		// x-DEBUG came after the tail checks
+	for (c = N_COMMON; c < ARRAY_LEN(chain); c++)
+		if (test(cmd, c)) return c;
+	return -1;
+}
+
+static int chain_idx[N_CMD_SET];
+
+static int dispatch_new(const char *cmd)
+{
+	// rx_common_cmd()
+	set_key_e key = rx_cmd_key(cmd);
+	int c = chain_idx[key];
+	if (c >= 0 && c < N_COMMON && test(cmd, c)) return c;
+	if (key == CMD_SET_NONE && tail(cmd)) return -1;
+
+	// c2s_sound()
+	key = rx_cmd_key(cmd);
+	c = chain_idx[key];
+	if (c >= N_COMMON && test(cmd, c)) return c;
+	return -1;
+}
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec);
+}
+
+static double time_one(int (*dispatch)(const char *), const char *cmd, int nloop)
+{
+	struct rusage start, finish;
+	getrusage(RUSAGE_SELF, &start);
+	for (int i=0; i < nloop; i++) dispatch(cmd);
+	getrusage(RUSAGE_SELF, &finish);
+	return cpu_secs(&start, &finish) / nloop * 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	int i, bad = 0;
+	struct rusage start, finish;
+
+	rx_cmd_key_init();
+	for (i=0; i < N_CMD_SET; i++) chain_idx[i] = -1;
+	for (i=0; i < ARRAY_LEN(chain); i++) chain_idx[chain[i].key] = i;
+
+	for (i=0; i < ARRAY_LEN(mix); i++) {
+		int r = dispatch_ref(mix[i]), n = dispatch_new(mix[i]);
+		if (r != n) {
+			printf("MISMATCH <%s>: ref %d new %d\n", mix[i], r, n);
+			bad++;
+		}
+	}
+	printf("%d commands, %d mismatches\n\n", ARRAY_LEN(mix), bad);
+
+	printf("%-60s %9s %9s\n", "ns/cmd", "orig", "new");
+	for (i=0; i < ARRAY_LEN(mix); i++) {
+		double t_ref = time_one(dispatch_ref, mix[i], NLOOP), t_new = time_one(dispatch_new, mix[i], NLOOP);
+		printf("%-60s %9.0f %9.0f %5.1fx\n", mix[i], t_ref, t_new, t_ref / t_new);
+	}
+
+	double t[2];
+	for (int v=0; v < 2; v++) {
+		getrusage(RUSAGE_SELF, &start);
+		for (int l=0; l < NLOOP; l++)
+			for (i=0; i < ARRAY_LEN(mix); i++)
+				(v? dispatch_new : dispatch_ref)(mix[i]);
+		getrusage(RUSAGE_SELF, &finish);
+		t[v] = cpu_secs(&start, &finish);
+	}
+	double n = (double) NLOOP * ARRAY_LEN(mix);
+	printf("\nmix: orig %.0f cmds/sec, new %.0f cmds/sec, %.1fx\n", n / t[0], n / t[1], t[0] / t[1]);
+	return 0;
+}
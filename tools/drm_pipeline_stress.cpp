@@ -0,0 +1,198 @@
+// Stress test of the DRM receiver stage control (extensions/DRM/dream/DRMPipeline.cpp) without a receiver.
+// A front end (the main thread), equalizer and decoder thread pass numbered blocks through the two queues
+// like CDRMReceiver::process_pipelined() does, with a little busy work per block for each stage.
+// All stages also ask for exclusive sections: nested ones, ones from inside their Enter()/Leave() bracket
+// like the FAC/SDC users do, and epoch bumps like InitsForWaveMode() which must drop the blocks in flight.
+// While a section is held no other stage may be inside its bracket, and no stage may start on a block
+// while a section is held. Every block that isn't dropped must reach the decoder in order, exactly once.
+// Halfway through, once the queues have drained, the pipeline is stopped and started again.
+// Prints the stage report (CDRMPipeline::Report()) once per second, then the counts.
+//
+// make UTIL=drm_pipeline_stress run
+// make UTIL=drm_pipeline_stress ARGS="-n 500000" run    (blocks)
+
+#include "GlobalDefinitions.h"
+#include "DRMPipeline.h"
+#include "timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <atomic>
+
+#define SYMBOL_LEN		16
+#define CELLS_LEN		64
+#define NEST_EVERY		1000	// front end: nested exclusive section
+#define EPOCH_EVERY		5000	// front end: new epoch, the blocks in flight are dropped
+#define EXCL_EVERY		3000	// front end: exclusive section outside its bracket
+#define DEC_EXCL_PCT	5		// decoder: exclusive section from inside its bracket
+
+static CDRMPipeline Pipeline;
+static std::atomic<int> inside, exclusive;
+static std::atomic<int> errors, ndropped;
+static int nsections;
+
+// stage work on a block, must never overlap an exclusive section
+static void work(int loops)
+{
+	if (exclusive) errors++;
+	inside++;
+	for (volatile int i = 0; i < loops; i++)
+		;
+	inside--;
+}
+
+static void section()
+{
+	Pipeline.ExclusiveBegin();
+	exclusive++;
+	if (inside) errors++;
+	for (volatile int i = 0; i < 5000; i++)
+		;
+	if (inside) errors++;
+	nsections++;
+	exclusive--;
+	Pipeline.ExclusiveEnd();
+}
+
+static void *equalize(void *param)
+{
+	CSingleBuffer<_COMPLEX> symbol;
+	CCyclicBuffer<CEquSig> cells;
+	cells.Init(CELLS_LEN);
+
+	while (1) {
+		CPipeSymbol *s = Pipeline.SymbolQueue.WaitFilled();
+		if (!s) return NULL;
+		CPipeCells *c = Pipeline.CellQueue.WaitFree();
+		if (!c) return NULL;
+
+		Pipeline.Enter();
+		bool ok = (s->iEpoch == Pipeline.GetEpoch());
+		if (ok) s->Symbol.Put(symbol);
+		Pipeline.SymbolQueue.Consume();
+		if (ok) {
+			uint32_t start = timer_us();
+			work(1500);
+			CVectorEx<_COMPLEX> *in = symbol.Get(symbol.GetFillLevel());
+			(*cells.QueryWriteBuffer())[0] = CEquSig((*in)[0], 1);
+			cells.Put(1);
+			c->MSC.Get(cells);
+			c->FAC.Get(cells);
+			c->SDC.Get(cells);
+			c->iEpoch = Pipeline.GetEpoch();
+			Pipeline.StageDone(PS_EQUALIZE, timer_us() - start);
+		} else {
+			Pipeline.Dropped(PS_EQUALIZE);
+			ndropped++;
+		}
+		Pipeline.Leave();
+
+		if (ok) Pipeline.CellQueue.Produce(); else Pipeline.CellQueue.Release();
+	}
+}
+
+static std::atomic<int> ndecoded;
+static int last_block, order_errs;
+
+static void *decode(void *param)
+{
+	CCyclicBuffer<CEquSig> msc;
+
+	while (1) {
+		CPipeCells *c = Pipeline.CellQueue.WaitFilled();
+		if (!c) return NULL;
+
+		Pipeline.Enter();
+		bool ok = (c->iEpoch == Pipeline.GetEpoch());
+		if (ok) c->MSC.Put(msc);
+		Pipeline.CellQueue.Consume();
+		if (ok) {
+			uint32_t start = timer_us();
+			work(2500);
+			int n = msc.GetFillLevel();
+			CVectorEx<CEquSig> *v = msc.Get(n);
+			for (int i = 0; i < n; i++) {
+				int block = (int) (*v)[i].cSig.real();
+				if (block <= last_block) order_errs++;
+				last_block = block;
+				ndecoded++;
+			}
+			if (rand() % 100 < DEC_EXCL_PCT) section();		// e.g. services from the FAC
+			Pipeline.StageDone(PS_DECODE, timer_us() - start);
+		} else {
+			Pipeline.Dropped(PS_DECODE);
+			ndropped++;
+		}
+		Pipeline.Leave();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int nblocks = 200000, nepochs = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i+1 < argc) nblocks = atoi(argv[++i]);
+	}
+
+	CSingleBuffer<_COMPLEX> symbol;
+	symbol.Init(SYMBOL_LEN);
+	Pipeline.Start(equalize, decode, NULL);
+	uint32_t start = timer_us();
+
+	for (int k = 1; k <= nblocks; k++) {
+		CPipeSymbol *s = Pipeline.SymbolQueue.WaitFree();
+		Pipeline.Enter();
+		uint32_t t = timer_us();
+		work(1000);
+		(*symbol.QueryWriteBuffer())[0] = _COMPLEX(k, 0);
+		symbol.Put(SYMBOL_LEN);
+		s->Symbol.Get(symbol);
+		s->iEpoch = Pipeline.GetEpoch();
+
+		if (k % NEST_EVERY == 0) {		// e.g. SetInStartMode() from within InitsForWaveMode()
+			Pipeline.ExclusiveBegin();
+			section();
+			Pipeline.ExclusiveEnd();
+		}
+		if (k % EPOCH_EVERY == 0) {
+			Pipeline.ExclusiveBegin();
+			Pipeline.NewEpoch();
+			Pipeline.ExclusiveEnd();
+			nepochs++;
+		}
+		Pipeline.StageDone(PS_FRONT_END, timer_us() - t);
+		Pipeline.Leave();
+		Pipeline.SymbolQueue.Produce();
+
+		if (k % EXCL_EVERY == 0) section();		// e.g. a ConsoleIO request
+		Pipeline.Report();
+
+		if (k == nblocks/2) {		// the queues must work again after a restart
+			while (ndecoded + ndropped < k)
+				usleep(1000);
+			Pipeline.Stop();
+			Pipeline.Start(equalize, decode, NULL);
+		}
+	}
+
+	// every block is either decoded or dropped, a lost one shows up as a timeout
+	for (int i = 0; i < 500 && ndecoded + ndropped < nblocks; i++)
+		usleep(10000);
+	double secs = (timer_us() - start) / 1e6;
+	Pipeline.Stop();
+
+	printf("\n%d blocks in %.1f sec, %d decoded, %d dropped by %d epochs, %d exclusive sections\n",
+		nblocks, secs, (int) ndecoded, (int) ndropped, nepochs, nsections);
+	printf("%d exclusion violations, %d out of order, %d lost\n",
+		(int) errors, order_errs, nblocks - ndecoded - ndropped);
+
+	// only the blocks in flight (both queues and a block in each stage) are dropped by a new epoch
+	bool bad = errors || order_errs || ndecoded + ndropped != nblocks ||
+		ndropped > nepochs * (2 * DRM_PIPE_DEPTH + 2);
+	printf("%s\n", bad? "FAILED" : "ok");
+	return bad? 1 : 0;
+}
@@ -0,0 +1,221 @@
+// Benchmark and check of the Viterbi decoder of the DRM MLC (extensions/DRM/dream/MLC/ViterbiDecoder.cpp)
+// on synthetic soft metrics: random bits encoded with CConvEncoder like the two levels of a 16-QAM MSC
+// frame, noise added, and the distances towards 0 and 1 as the demapper would give them.
+// Prints the decode throughput in bits/sec and compares every decoded bit and the returned metric with
+// the plain c++ trellis in this file. That is what the c++ version of CViterbiDecoder::Decode() does,
+// so on ARM this checks the NEON trellis (USE_NEON) and on x86 the c++ one.
+// The noise is integer and the metrics are multiples of 1/1024, so the input is the same everywhere.
+// The checksum at the end covers all decoded bits and metrics and must be the same on x86 and ARM.
+//
+// make UTIL=drm_viterbi_bench run
+// make UTIL=drm_viterbi_bench ARGS="-n 2000 -f 50 -e 12" run    (cells per frame, frames, noise)
+
+#include "GlobalDefinitions.h"
+#include "MLC/ViterbiDecoder.h"
+#include "MLC/ConvEncoder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define NLEVELS		2		// 16-QAM SM
+#define PROT_LEVEL	1		// iCodRateCombMSC16SM[] row
+#define NPASS		3		// timing passes over the frames, last one is compared
+
+// BUTTERFLY() calls of ViterbiDecoder.cpp: states 2j and 2j+1 from j and j+32
+static const struct { int met0, met1; } bfly[MC_NUM_STATES / 2] = {
+	{ 0,15}, { 6, 9}, {11, 4}, {13, 2}, {11, 4}, {13, 2}, { 0,15}, { 6, 9},
+	{ 4,11}, { 2,13}, {15, 0}, { 9, 6}, {15, 0}, { 9, 6}, { 4,11}, { 2,13},
+	{ 9, 6}, {15, 0}, { 2,13}, { 4,11}, { 2,13}, { 4,11}, { 9, 6}, {15, 0},
+	{13, 2}, {11, 4}, { 6, 9}, { 0,15}, { 6, 9}, { 0,15}, {13, 2}, {11, 4},
+};
+
+struct level_t {
+	int nin, nin_mem;
+	CVector<int> punc;
+	CConvEncoder enc;
+	CViterbiDecoder vit;
+};
+
+static level_t lev[NLEVELS];
+static CMatrix<_BINARY> ref_dec;
+
+// the c++ trellis with the same additions in the same order
+static _REAL ref_decode(level_t *l, CVector<CDistance> &d, CVector<_DECISION> &out)
+{
+	float m1[MC_NUM_STATES], m2[MC_NUM_STATES], *cur = m1, *old = m2;
+	_REAL met[16];
+	int i, j, pos = 0;
+
+	old[0] = 0;
+	for (j = 1; j < MC_NUM_STATES; j++) old[j] = 1e10;
+
+	#define T(p, b) ((b)? d[p].rTow1 : d[p].rTow0)
+
+	for (i = 0; i < l->nin_mem; i++) {
+		int p0 = pos, p1 = pos+1, p2 = pos+2, p3 = pos+3;
+		for (int k = 0; k < 16; k++) {
+			int b0 = k & 1, b1 = (k >> 1) & 1, b2 = (k >> 2) & 1, b3 = (k >> 3) & 1;
+			switch (l->punc[i]) {
+				case PP_TYPE_0001: met[k] = T(p0, b0); break;
+				case PP_TYPE_0101: met[k] = T(p1, b2) + T(p0, b0); break;
+				case PP_TYPE_0011: met[k] = T(p1, b1) + T(p0, b0); break;
+				case PP_TYPE_0111: met[k] = T(p2, b2) + (T(p1, b1) + T(p0, b0)); break;
+				default:           met[k] = (T(p3, b3) + T(p2, b2)) + (T(p1, b1) + T(p0, b0)); break;
+			}
+		}
+		switch (l->punc[i]) {
+			case PP_TYPE_0001: pos += 1; break;
+			case PP_TYPE_0101: case PP_TYPE_0011: pos += 2; break;
+			case PP_TYPE_0111: pos += 3; break;
+			default: pos += 4; break;
+		}
+
+		for (j = 0; j < MC_NUM_STATES / 2; j++) {
+			float a = old[j] + met[bfly[j].met0], b = old[j + MC_NUM_STATES/2] + met[bfly[j].met1];
+			if (a < b) { cur[2*j] = a; ref_dec[i][2*j] = 0; } else { cur[2*j] = b; ref_dec[i][2*j] = 1; }
+			a = old[j] + met[bfly[j].met1]; b = old[j + MC_NUM_STATES/2] + met[bfly[j].met0];
+			if (a < b) { cur[2*j+1] = a; ref_dec[i][2*j+1] = 0; } else { cur[2*j+1] = b; ref_dec[i][2*j+1] = 1; }
+		}
+		float *t = cur; cur = old; old = t;
+	}
+	#undef T
+
+	int state = 0;
+	for (i = 0; i < l->nin; i++) {
+		int bit = ref_dec[l->nin_mem - i - 1][state];
+		state = (state >> 1) | (bit << 5);
+		out[l->nin - i - 1] = bit;
+	}
+	return old[0] / pos;
+}
+
+static uint32_t rnd_state = 1;
+
+static int rnd(int n)		// xorshift32, 0 .. n-1
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+static uint32_t fnv(uint32_t h, const void *p, int n)
+{
+	for (int i = 0; i < n; i++) { h ^= ((const uint8_t *) p)[i]; h *= 16777619; }
+	return h;
+}
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, f, k, ncells = 5000, nframes = 40, noise = 10;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i+1 < argc) ncells = atoi(argv[++i]);
+		if (strcmp(argv[i], "-f") == 0 && i+1 < argc) nframes = atoi(argv[++i]);
+		if (strcmp(argv[i], "-e") == 0 && i+1 < argc) noise = atoi(argv[++i]);
+	}
+
+	#if defined(USE_NEON)
+		const char *trellis = "NEON";
+	#elif defined(USE_SIMD)
+		const char *trellis = "x86 fixed-point";
+	#else
+		const char *trellis = "c++";
+	#endif
+	printf("%d frames of %d cells, noise %d/16, trellis %s\n", nframes, ncells, noise, trellis);
+
+	// like CMLC::CalculateParam() for the MSC with N1 = 0: M_p,2 = RX_p * floor((2 * N_2 - 12) / RY_p)
+	int nbits_total = 0, nenc = 2 * ncells, nin_max = 0;
+	for (k = 0; k < NLEVELS; k++) {
+		level_t *l = &lev[k];
+		int rate = iCodRateCombMSC16SM[PROT_LEVEL][k];
+		l->nin = iPuncturingPatterns[rate][0] * ((2 * ncells - 12) / iPuncturingPatterns[rate][1]);
+		l->nin_mem = l->nin + MC_CONSTRAINT_LENGTH - 1;
+		l->enc.Init(CS_2_SM, CT_MSC, 0, ncells, 0, l->nin, 0, rate, k);
+		l->vit.Init(CS_2_SM, CT_MSC, 0, ncells, 0, l->nin, 0, rate, k);
+		l->punc = l->enc.GenPuncPatTable(CS_2_SM, CT_MSC, 0, ncells, 0, l->nin, 0, rate, k);
+		nbits_total += l->nin;
+		if (l->nin_mem > nin_max) nin_max = l->nin_mem;
+	}
+	ref_dec.Init(nin_max, MC_NUM_STATES);
+
+	// frames of encoded random bits as distances
+	CVector<CDistance> *dist = new CVector<CDistance>[nframes * NLEVELS];
+	CVector<_DECISION> *tx = new CVector<_DECISION>[nframes * NLEVELS];
+	CVector<_DECISION> enc_out(nenc);
+	for (f = 0; f < nframes * NLEVELS; f++) {
+		level_t *l = &lev[f % NLEVELS];
+		tx[f].Init(l->nin);
+		for (i = 0; i < l->nin; i++) tx[f][i] = rnd(2);
+		int n = l->enc.Encode(tx[f], enc_out);
+		dist[f].Init(n);
+		for (i = 0; i < n; i++) {
+			int y = (enc_out[i]? 16 : -16) + rnd(2*noise+1) + rnd(2*noise+1) - 2*noise;
+			dist[f][i].rTow0 = (_REAL) ((y + 16) * (y + 16)) / 1024;
+			dist[f][i].rTow1 = (_REAL) ((y - 16) * (y - 16)) / 1024;
+		}
+	}
+
+	// Decode() scales the distances in place for the fixed-point trellis, so work on copies
+	CVector<CDistance> *work = new CVector<CDistance>[nframes * NLEVELS];
+	CVector<_DECISION> *out = new CVector<_DECISION>[nframes * NLEVELS], *out_ref = new CVector<_DECISION>[nframes * NLEVELS];
+	_REAL *metric = new _REAL[nframes * NLEVELS], *metric_ref = new _REAL[nframes * NLEVELS];
+	for (f = 0; f < nframes * NLEVELS; f++) {
+		work[f].Init(dist[f].Size());
+		out[f].Init(lev[f % NLEVELS].nin);
+		out_ref[f].Init(lev[f % NLEVELS].nin);
+	}
+
+	struct rusage start, finish;
+	double t_vit = 0, t_ref = 0;
+	for (int p = 0; p < NPASS; p++) {
+		for (f = 0; f < nframes * NLEVELS; f++)
+			for (i = 0; i < dist[f].Size(); i++) work[f][i] = dist[f][i];
+		getrusage(RUSAGE_SELF, &start);
+		for (f = 0; f < nframes * NLEVELS; f++)
+			metric[f] = lev[f % NLEVELS].vit.Decode(work[f], out[f]);
+		getrusage(RUSAGE_SELF, &finish);
+		t_vit += cpu_secs(&start, &finish);
+
+		getrusage(RUSAGE_SELF, &start);
+		for (f = 0; f < nframes * NLEVELS; f++)
+			metric_ref[f] = ref_decode(&lev[f % NLEVELS], dist[f], out_ref[f]);
+		getrusage(RUSAGE_SELF, &finish);
+		t_ref += cpu_secs(&start, &finish);
+	}
+
+	int bit_diff = 0, metric_diff = 0, errs = 0;
+	uint32_t sum = 2166136261U;
+	for (f = 0; f < nframes * NLEVELS; f++) {
+		for (i = 0; i < out[f].Size(); i++) {
+			if (out[f][i] != out_ref[f][i]) bit_diff++;
+			if (out[f][i] != tx[f][i]) errs++;
+			_BINARY b = out[f][i];
+			sum = fnv(sum, &b, 1);
+		}
+		if (memcmp(&metric[f], &metric_ref[f], sizeof(_REAL)) != 0) metric_diff++;
+		sum = fnv(sum, &metric[f], sizeof(_REAL));
+	}
+
+	double nbits = (double) nbits_total * nframes * NPASS;
+	printf("decoder   %.2f Mbits/sec\n", nbits / t_vit / 1e6);
+	printf("reference %.2f Mbits/sec, %.2fx\n", nbits / t_ref / 1e6, t_ref / t_vit);
+	printf("BER %.2e, %d bits and %d metrics differ from the reference, checksum %08x\n",
+		(double) errs / (nbits_total * nframes), bit_diff, metric_diff, sum);
+
+	#ifdef USE_SIMD
+		// the fixed-point trellis decides differently near ties and returns no metric
+		return 0;
+	#else
+		return (bit_diff || metric_diff)? 1 : 0;
+	#endif
+}
@@ -0,0 +1,313 @@
+// Benchmark and check of the DX label queries (SET MKR): the original bsearch() of dx.list and
+// walk applying the connection filter to every label visited, versus the index in init/dx_index.cpp
+// (dx.keys[] binary searches plus the per-connection filter bitmap).
+// A synthetic list of NDX labels spread over 0-30 MHz is queried at every zoom level across the band,
+// plus label steps, with no filter and with each kind of filter. Without offsets the labels
+// returned by both must be identical. With offsets the index returns them in displayed frequency order
+// so only the number of differing queries is shown.
+//
+// make UTIL=dx_bench run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../types.h"
+#include "dx.h"
+
+#include <regex.h>
+#include <fnmatch.h>
+
+#define NDX			50000
+#define MAX_KHZ		30000.0
+#define WIDTH		1024
+#define NZOOM		15
+#define NQUERY		4000
+#define NPASS_REF	1
+#define NPASS		5
+
+dxlist_t dx;
+
+// the original
+#define DX_SPACING_ZOOM_THRESHOLD	5
+#define DX_SPACING_THRESHOLD_PX		10
+#define DX_SEARCH_WINDOW 10.0
+
+static dx_t *dx_list_first, *dx_list_last;
+
+static int bsearch_freqcomp(const void *key, const void *elem)
+{
+	dx_t *dx_key = (dx_t *) key, *dx_elem = (dx_t *) elem;
+	float key_freq = dx_key->freq;
+	float elem_freq = dx_elem->freq + ((float) dx_elem->offset / 1000.0);
+
+	if (key_freq == elem_freq) return 0;
+	if (key_freq < elem_freq) {
+		if (dx_elem == dx_list_first) return 0;
+		return -1;
+	}
+	dx_t *dx_elem2 = dx_elem+1;
+	if (dx_elem2 < dx_list_last) {
+		float elem2_freq = dx_elem2->freq + ((float) dx_elem2->offset / 1000.0);
+		if (key_freq < elem2_freq) return 0;
+		return 1;
+	}
+	return 0;
+}
+
+static int ref_mkr(dx_filter_t *f, int type, int dir, float min, float max, int zoom, int width, dx_mkr_cb_t cb, void *param)
+{
+	static bool first = true;
+	int dx_lastx = 0, send = 0;
+	float bw = max - min;
+	dx_t dx_min;
+
+	dx_min.freq = min + ((type == 2 && dir == 1)? DX_SEARCH_WINDOW : -DX_SEARCH_WINDOW);
+	dx_list_first = &dx.list[0];
+	dx_list_last = &dx.list[dx.len - DX_HIDDEN_SLOT];
+	dx_t *dp = (dx_t *) bsearch(&dx_min, dx.list, dx.len, sizeof(dx_t), bsearch_freqcomp);
+
+	int dx_filter = 0, fn_flags = 0;
+	if (f->ident || f->notes) {
+		dx_filter = 1;
+		fn_flags = f->case_sens? 0 : FNM_CASEFOLD;
+	}
+
+	for (; dp < &dx.list[dx.len] && dp >= dx.list; dp += dir) {
+		float freq = dp->freq + ((float) dp->offset / 1000.0);
+		if (type == 4 && freq > max + DX_SEARCH_WINDOW) break;
+
+		if (dx_filter) {
+			if (f->grep) {
+				if (f->has_preg_ident) {
+					if (regexec(&f->preg_ident, dp->ident_s, 0, NULL, 0) == REG_NOMATCH) continue;
+				}
+				if (f->has_preg_notes) {
+					if (regexec(&f->preg_notes, dp->notes_s, 0, NULL, 0) == REG_NOMATCH) continue;
+				}
+			} else
+			if (f->wild) {
+				if (fnmatch(f->ident, dp->ident_s, fn_flags) != 0) continue;
+				if (f->notes && f->notes[0] != '\0' && fnmatch(f->notes, dp->notes_s, fn_flags) != 0) continue;
+			} else {
+				if (f->case_sens) {
+					if (strstr(dp->ident_s, f->ident) == NULL) continue;
+					if (f->notes && strstr(dp->notes_s, f->notes) == NULL) continue;
+				} else {
+					if (strcasestr(dp->ident_s, f->ident) == NULL) continue;
+					if (f->notes && strcasestr(dp->notes_s, f->notes) == NULL) continue;
+				}
+			}
+		}
+
+		if (type == 4 && zoom <= DX_SPACING_ZOOM_THRESHOLD) {
+			int x = ((dp->freq - min) / bw) * width;
+			int diff = x - dx_lastx;
+			if (!first && diff < DX_SPACING_THRESHOLD_PX) continue;
+			dx_lastx = x;
+			first = false;
+		}
+
+		if (type == 4 || dp->freq != min) {
+			cb(param, dp, freq);
+			send++;
+		}
+		if (type == 2 && send) break;
+	}
+	return send;
+}
+
+// labels returned by one query
+typedef struct {
+	int n;
+	int idx[NDX];
+	float freq[NDX];
+} result_t;
+
+static result_t res_ref, res_new;
+
+static void result_cb(void *param, dx_t *dp, float freq)
+{
+	result_t *r = (result_t *) param;
+	r->idx[r->n] = dp->idx;
+	r->freq[r->n] = freq;
+	r->n++;
+}
+
+static void count_cb(void *param, dx_t *dp, float freq)
+{
+	(*(int *) param)++;
+}
+
+typedef struct {
+	int type, dir, zoom;
+	float min, max;
+} query_t;
+
+static query_t queries[NQUERY];
+
+static const char *words[] = { "radio", "Beacon", "VOLMET", "NDB", "time", "China", "BBC", "Radio", "DGPS", "utility",
+	"Europe", "marine", "navy", "Weather", "fax", "NAVTEX", "numbers", "ham", "CW", "RTTY" };
+
+static char *mkstr(const char *prefix, int i)
+{
+	char *s;
+	asprintf(&s, "%s %s %d", prefix, words[random() % ARRAY_LEN(words)], i);
+	return s;
+}
+
+// like qsort_floatcomp() used by dx_prep_list()
+static int freqcomp(const void *elem1, const void *elem2)
+{
+	float f1 = *(const float *) elem1, f2 = *(const float *) elem2;
+	return (f1 < f2)? -1 : ((f1 > f2)? 1 : 0);
+}
+
+static void gen_list(bool offsets)
+{
+	int i;
+	srandom(1);
+	dx.len = NDX;
+	dx.list = (dx_t *) calloc(NDX + DX_HIDDEN_SLOT, sizeof(dx_t));
+	for (i = 0; i < NDX; i++) {
+		dx_t *dp = &dx.list[i];
+		dp->freq = (float) (random() % (int) (MAX_KHZ * 100)) / 100;
+		dp->ident = dp->ident_s = mkstr(words[random() % ARRAY_LEN(words)], i);
+		dp->notes = dp->notes_s = mkstr("", i);
+		dp->offset = (offsets && (random() % 10) == 0)? (random() % 2001) - 1000 : 0;
+	}
+	qsort(dx.list, NDX, sizeof(dx_t), freqcomp);
+	for (i = 0; i < NDX; i++) dx.list[i].idx = i;
+	dx_index_build(dx.list, NDX);
+}
+
+static void gen_queries()
+{
+	srandom(2);
+	for (int i = 0; i < NQUERY; i++) {
+		query_t *q = &queries[i];
+		if ((i % 8) == 7) {
+			q->type = 2;
+			q->dir = (random() & 1)? 1 : -1;
+			q->min = (float) (random() % (int) (MAX_KHZ * 1000)) / 1000;
+			q->max = q->zoom = 0;
+		} else {
+			q->type = 4;
+			q->dir = 1;
+			q->zoom = i % NZOOM;
+			float span = MAX_KHZ / (1 << q->zoom);
+			q->min = (MAX_KHZ - span) * (random() % 10001) / 10000;
+			q->max = q->min + span;
+		}
+	}
+}
+
+static void set_filter(dx_filter_t *f, const char *ident, const char *notes, int case_sens, int wild, int grep)
+{
+	dx_filter_free(f);
+	if (ident) f->ident = strdup(ident);
+	if (notes) f->notes = strdup(notes);
+	f->case_sens = case_sens; f->wild = wild; f->grep = grep;
+	dx_filter_compile(f);
+}
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec);
+}
+
+typedef int (*mkr_t)(dx_filter_t *f, int type, int dir, float min, float max, int zoom, int width, dx_mkr_cb_t cb, void *param);
+
+// queries/sec
+static double timed(mkr_t mkr, dx_filter_t *f, int npass)
+{
+	struct rusage start, finish;
+	int n = 0;
+	getrusage(RUSAGE_SELF, &start);
+	for (int p = 0; p < npass; p++) {
+		for (int i = 0; i < NQUERY; i++) {
+			query_t *q = &queries[i];
+			mkr(f, q->type, q->dir, q->min, q->max, q->zoom, WIDTH, count_cb, &n);
+		}
+	}
+	getrusage(RUSAGE_SELF, &finish);
+	return NQUERY * npass / cpu_secs(&start, &finish);
+}
+
+static int check(dx_filter_t *f)
+{
+	int bad = 0;
+	for (int i = 0; i < NQUERY; i++) {
+		query_t *q = &queries[i];
+		res_ref.n = res_new.n = 0;
+		ref_mkr(f, q->type, q->dir, q->min, q->max, q->zoom, WIDTH, result_cb, &res_ref);
+		dx_mkr(f, q->type, q->dir, q->min, q->max, q->zoom, WIDTH, result_cb, &res_new);
+		if (res_ref.n != res_new.n ||
+			memcmp(res_ref.idx, res_new.idx, res_ref.n * sizeof(int)) != 0 ||
+			memcmp(res_ref.freq, res_new.freq, res_ref.n * sizeof(float)) != 0)
+			bad++;
+	}
+	return bad;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name, *ident, *notes;
+		int case_sens, wild, grep;
+	} filters[] = {
+		{ "none",		NULL, NULL, 0, 0, 0 },
+		{ "empty",		"", "", 0, 0, 0 },
+		{ "substring",	"radio", "", 0, 0, 0 },
+		{ "wild",		"*NDB*", "", 1, 1, 0 },
+		{ "grep",		"^(Radio|BBC) .*(time|utility)", "", 1, 0, 1 },
+	};
+	dx_filter_t f;
+	memset(&f, 0, sizeof(f));
+
+	gen_queries();
+
+	// both let the very first label of the first spaced query through, get that out of the way
+	int n = 0;
+	gen_list(false);
+	ref_mkr(&f, 4, 1, 0, MAX_KHZ, 0, WIDTH, count_cb, &n);
+	dx_mkr(&f, 4, 1, 0, MAX_KHZ, 0, WIDTH, count_cb, &n);
+	free(dx.list);
+
+	for (int offsets = 0; offsets <= 1; offsets++) {
+		gen_list(offsets);
+		printf("%d labels, %s, %d queries (7/8 visible area at zoom 0-%d, 1/8 label step)\n",
+			NDX, offsets? "10% with offsets" : "no offsets", NQUERY, NZOOM-1);
+
+		for (int i = 0; i < (int) ARRAY_LEN(filters); i++) {
+			set_filter(&f, filters[i].ident, filters[i].notes, filters[i].case_sens, filters[i].wild, filters[i].grep);
+
+			// first query after a filter change computes the filter map
+			struct rusage start, finish;
+			int n = 0;
+			getrusage(RUSAGE_SELF, &start);
+			dx_mkr(&f, 4, 1, 0, MAX_KHZ, 0, WIDTH, count_cb, &n);
+			getrusage(RUSAGE_SELF, &finish);
+			double t_map = cpu_secs(&start, &finish) * 1e3;
+
+			int bad = check(&f);
+			double q_ref = timed(ref_mkr, &f, NPASS_REF);
+			double q_new = timed(dx_mkr, &f, NPASS);
+			printf("    filter %-9s queries/sec: orig %8.0f, index %9.0f, %6.1fx  map %.2f ms  %d %s\n",
+				filters[i].name, q_ref, q_new, q_new / q_ref, t_map, bad, offsets? "queries differ" : "mismatches");
+		}
+		printf("\n");
+
+		for (int i = 0; i < NDX; i++) {
+			free((void *) dx.list[i].ident);
+			free((void *) dx.list[i].notes);
+		}
+		free(dx.list);
+	}
+
+	dx_filter_free(&f);
+	return 0;
+}
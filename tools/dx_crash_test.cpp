@@ -0,0 +1,197 @@
+// Check of the DX journal replay after a crash between writing dx.json and removing the journal,
+// when dx.json already has the journal's edits. The crash is an unlink() that exits instead of
+// removing the journal: in dx_compact_child() right after the rename of dx.json.tmp, and in
+// dx_journal_replay() at startup right after its dx_write_json(). After each, dx_reload() must
+// give the list as edited, with no entry added twice and no extra entry removed.
+// NEDIT random modifies, adds and deletes on a list of NDX entries.
+//
+// make UTIL=dx_crash_test run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "../types.h"
+#include "config.h"
+#include "kiwi.h"
+#include "misc.h"
+#include "str.h"
+#include "cfg.h"
+#include "dx.h"
+
+#define NDX			2000
+#define NEDIT		500
+#define DX_FN		"/tmp/dx_crash_test.dx.json"
+#define CRASH_EXIT	99
+
+// the crash: unlink() of this file exits the process instead, as if it had stopped there
+static const char *crash_fn;
+
+extern "C" int unlink(const char *path) __THROW
+{
+	if (crash_fn && strcmp(path, crash_fn) == 0) _exit(CRASH_EXIT);
+	return unlinkat(AT_FDCWD, path, 0);
+}
+
+static const char *words[] = { "radio", "Beacon", "VOLMET", "NDB", "time", "China", "BBC", "DGPS", "utility", "Europe" };
+
+static void gen_file()
+{
+	srandom(1);
+	FILE *fp = fopen(DX_FN, "w");
+	fprintf(fp, "{\"dx\":[");
+	for (int i = 0; i < NDX; i++) {
+		fprintf(fp, "%s[%.2f,\"%s\",\"%s%%20%d\",\"%s\",%d,%d", i? ",":"", (float) (random() % 3000000) / 100,
+			modu_s[random() % N_MODE], words[random() % ARRAY_LEN(words)], i, words[random() % ARRAY_LEN(words)],
+			(int) (random() % 100000), (int) (random() % 10000));
+		if ((i % 10) == 0) fprintf(fp, ",{\"WL\":1,\"o\":%d}", (int) (random() % 1000));
+		fprintf(fp, "]\n");
+	}
+	fprintf(fp, "]}\n");
+	fclose(fp);
+	unlink(DX_FN ".journal");
+	unlink(DX_FN ".journal.prev");
+}
+
+static void restart()
+{
+	memset(&cfg_dx, 0, sizeof(cfg_dx));
+	dx_reload();
+}
+
+// one edit of DX_UPD: the entry to change and what to
+typedef struct {
+	int gid;        // -1 add
+	bool del;
+	float freq;
+	int flags, offset;
+	char ident[32];
+} edit_t;
+
+static edit_t edits[NEDIT];
+
+static void gen_edits(int seed)
+{
+	srandom(seed);
+	int len = dx.len;
+	for (int i = 0; i < NEDIT; i++) {
+		edit_t *e = &edits[i];
+		int r = random() % 10;
+		e->gid = (r < 2)? -1 : (random() % len);
+		e->del = (r >= 2 && r < 4);
+		e->freq = (r < 8)? (float) (random() % 3000000) / 100 : -1;		// -1: same freq
+		e->flags = random() % N_MODE;
+		e->offset = (r & 1)? random() % 1000 : 0;
+		snprintf(e->ident, sizeof(e->ident), "edit%%20%d", i);
+		if (e->gid == -1) len++;
+		if (e->del) len--;
+	}
+}
+
+static void make_upd(dx_t *upd, edit_t *e, dx_t *old)
+{
+	memset(upd, 0, sizeof(*upd));
+	upd->freq = (e->freq == -1)? old->freq : e->freq;
+	upd->flags = e->flags;
+	upd->offset = e->offset;
+	upd->timestamp = 1234;
+	upd->ident = strdup(e->ident);
+	upd->ident_s = kiwi_str_decode_inplace(strdup(e->ident));
+	upd->notes = strdup("");
+	upd->notes_s = strdup("");
+	upd->params = strdup("");
+}
+
+static void new_edit(edit_t *e)
+{
+	if (e->del) {
+		dx_edit(e->gid, NULL);
+	} else {
+		dx_t upd;
+		make_upd(&upd, e, (e->gid == -1)? NULL : &dx.list[e->gid]);
+		dx_edit(e->gid, &upd);
+	}
+}
+
+static int linecomp(const void *elem1, const void *elem2)
+{
+	return strcmp(*(char * const *) elem1, *(char * const *) elem2);
+}
+
+// the list as dx.json lines, sorted so entries of the same freq compare in any order
+static char **snapshot(int *n)
+{
+	dx_json_update();
+	char *json = strdup(cfg_dx.json);
+	char **lines = (char **) malloc((dx.len + 1) * sizeof(char *));
+	int i = 0;
+	for (char *s = strtok(json, "\n"); s; s = strtok(NULL, "\n"))
+		lines[i++] = strdup(s + ((*s == ',' || *s == '{')? ((*s == ',')? 1 : 7) : 0));
+	free(json);
+	if (i) lines[i-1][strlen(lines[i-1]) - 2] = '\0';	// "]}"
+	qsort(lines, i, sizeof(char *), linecomp);
+	*n = i;
+	return lines;
+}
+
+static int compare(char **l1, int n1, char **l2, int n2)
+{
+	int bad = abs(n1 - n2);
+	for (int i = 0; i < MIN(n1, n2); i++)
+		if (strcmp(l1[i], l2[i]) != 0) bad++;
+	return bad;
+}
+
+static void edit(int seed)
+{
+	gen_edits(seed);
+	for (int i = 0; i < NEDIT; i++) new_edit(&edits[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	int n1, n2, status;
+	char **l1, **l2;
+
+	gen_file();
+	restart();
+
+	// crash in the compaction child, after dx.json is written and before the journal is removed
+	edit(2);
+	l1 = snapshot(&n1);
+	crash_fn = DX_FN ".journal.prev";
+	dx_compact();
+	crash_fn = NULL;
+	bool left = (access(DX_FN ".journal.prev", F_OK) == 0 && access(DX_FN ".tmp", F_OK) != 0);
+	restart();
+	l2 = snapshot(&n2);
+	int bad_compact = compare(l1, n1, l2, n2);
+	printf("crash after dx.json written by compaction: %d entries, %d after restart, %d differences%s\n",
+		n1, n2, bad_compact, left? "" : " (JOURNAL NOT LEFT, NO CRASH?)");
+
+	// crash at startup, after the replay has written dx.json and before the journal is removed
+	edit(3);
+	l1 = snapshot(&n1);
+	pid_t pid = fork();
+	if (pid == 0) {
+		crash_fn = DX_FN ".journal.prev";
+		restart();
+		_exit(0);
+	}
+	waitpid(pid, &status, 0);
+	bool crashed = (WIFEXITED(status) && WEXITSTATUS(status) == CRASH_EXIT);
+	restart();
+	l2 = snapshot(&n2);
+	int bad_replay = compare(l1, n1, l2, n2);
+	printf("crash after dx.json written by replay:     %d entries, %d after restart, %d differences%s\n",
+		n1, n2, bad_replay, crashed? "" : " (NO CRASH?)");
+
+	bool journal_gone = (access(DX_FN ".journal", F_OK) != 0 && access(DX_FN ".journal.prev", F_OK) != 0);
+	bool ok = (bad_compact == 0 && bad_replay == 0 && left && crashed && journal_gone);
+	printf("%s\n", ok? "ok" : "FAIL");
+	unlink(DX_FN);
+	return ok? 0 : 1;
+}
@@ -0,0 +1,254 @@
+// Benchmark and check of DX list edits (SET DX_UPD): the original qsort() of the list and rewrite
+// of the whole dx.json per edit versus dx_edit() in init/dx.cpp, which moves the entry to its
+// sorted place and appends to the journal. Compaction into dx.json is timed separately.
+// NEDIT random modifies, adds and deletes on a list of NDX entries.
+// Checks that the list after the edits is what dx_reload() gives after a restart,
+// both from the journal and after a compaction.
+//
+// make UTIL=dx_edit_bench run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../types.h"
+#include "config.h"
+#include "kiwi.h"
+#include "misc.h"
+#include "str.h"
+#include "cfg.h"
+#include "dx.h"
+
+#define NDX			20000
+#define NEDIT		1000
+#define DX_FN		"/tmp/dx_edit_bench.dx.json"
+
+static const char *words[] = { "radio", "Beacon", "VOLMET", "NDB", "time", "China", "BBC", "DGPS", "utility", "Europe" };
+
+static void gen_file()
+{
+	srandom(1);
+	FILE *fp = fopen(DX_FN, "w");
+	fprintf(fp, "{\"dx\":[");
+	for (int i = 0; i < NDX; i++) {
+		fprintf(fp, "%s[%.2f,\"%s\",\"%s%%20%d\",\"%s\",%d,%d", i? ",":"", (float) (random() % 3000000) / 100,
+			modu_s[random() % N_MODE], words[random() % ARRAY_LEN(words)], i, words[random() % ARRAY_LEN(words)],
+			(int) (random() % 100000), (int) (random() % 10000));
+		if ((i % 10) == 0) fprintf(fp, ",{\"WL\":1,\"o\":%d}", (int) (random() % 1000));
+		fprintf(fp, "]\n");
+	}
+	fprintf(fp, "]}\n");
+	fclose(fp);
+	unlink(DX_FN ".journal");
+	unlink(DX_FN ".journal.prev");
+}
+
+static void restart()
+{
+	memset(&cfg_dx, 0, sizeof(cfg_dx));
+	dx_reload();
+}
+
+// one edit of DX_UPD: the entry to change and what to
+typedef struct {
+	int gid;        // -1 add
+	bool del;
+	float freq;
+	int flags, offset;
+	char ident[32];
+} edit_t;
+
+static edit_t edits[NEDIT];
+
+static void gen_edits(int seed)
+{
+	srandom(seed);
+	int len = NDX;
+	for (int i = 0; i < NEDIT; i++) {
+		edit_t *e = &edits[i];
+		int r = random() % 10;
+		e->gid = (r < 2)? -1 : (random() % len);
+		e->del = (r >= 2 && r < 4);
+		e->freq = (r < 8)? (float) (random() % 3000000) / 100 : -1;		// -1: same freq
+		e->flags = random() % N_MODE;
+		e->offset = (r & 1)? random() % 1000 : 0;
+		snprintf(e->ident, sizeof(e->ident), "edit%%20%d", i);
+		if (e->gid == -1) len++;
+		if (e->del) len--;
+	}
+}
+
+static void make_upd(dx_t *upd, edit_t *e, dx_t *old)
+{
+	memset(upd, 0, sizeof(*upd));
+	upd->freq = (e->freq == -1)? old->freq : e->freq;
+	upd->flags = e->flags;
+	upd->offset = e->offset;
+	upd->timestamp = 1234;
+	upd->ident = strdup(e->ident);
+	upd->ident_s = kiwi_str_decode_inplace(strdup(e->ident));
+	upd->notes = strdup("");
+	upd->notes_s = strdup("");
+	upd->params = strdup("");
+}
+
+// the original: edit in place, qsort(), whole list to a JSON string, write whole file
+static void ref_save()
+{
+	int i, n = 128;
+	dx_t *dxp;
+	for (i=0, dxp = dx.list; i < dx.len; i++, dxp++)
+		n += 128 + strlen(dxp->ident) + (dxp->notes? strlen(dxp->notes) : 0) + (dxp->params? strlen(dxp->params) : 0);
+	char *json = (char *) malloc(n), *cp = json;
+	cp += sprintf(cp, "{\"dx\":[");
+	for (i=0, dxp = dx.list; i < dx.len; i++, dxp++) {
+		cp += sprintf(cp, "%s[%.2f", i? ",":"", dxp->freq);
+		cp += sprintf(cp, ",\"%s\"", modu_s[dxp->flags & DX_MODE]);
+		cp += sprintf(cp, ",\"%s\",\"%s\"", dxp->ident, dxp->notes? dxp->notes:"");
+		cp += sprintf(cp, ",%d", dxp->timestamp);
+		cp += sprintf(cp, ",%d", dxp->tag);
+		if (dxp->offset) cp += sprintf(cp, ",{\"o\":%d}", dxp->offset);
+		*cp++ = ']';
+		*cp++ = '\n';
+	}
+	cp += sprintf(cp, "]}");
+	FILE *fp = fopen(DX_FN ".ref", "w");
+	fprintf(fp, "%s\n", json);
+	fclose(fp);
+	free(json);
+}
+
+static void ref_edit(edit_t *e)
+{
+	dx_t *dxp;
+	int new_len;
+	if (e->del) {
+		dxp = &dx.list[e->gid];
+		dxp->freq = 999999;
+		new_len = dx.len - 1;
+	} else {
+		dx_t upd;
+		if (e->gid == -1) {
+			dxp = &dx.list[dx.len];
+			dx.len++;
+		} else {
+			dxp = &dx.list[e->gid];
+		}
+		new_len = dx.len;
+		make_upd(&upd, e, dxp);
+		*dxp = upd;
+	}
+	dx_prep_list(true, dx.list, dx.len, new_len);
+	dx.len = new_len;
+	ref_save();
+	if (e->gid == -1) {
+		dx.list = (dx_t *) realloc(dx.list, (dx.len + DX_HIDDEN_SLOT) * sizeof(dx_t));
+		memset(&dx.list[dx.len], 0, sizeof(dx_t));
+	}
+}
+
+static void new_edit(edit_t *e)
+{
+	if (e->del) {
+		dx_edit(e->gid, NULL);
+	} else {
+		dx_t upd;
+		make_upd(&upd, e, (e->gid == -1)? NULL : &dx.list[e->gid]);
+		dx_edit(e->gid, &upd);
+	}
+}
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec + finish->ru_stime.tv_sec - start->ru_stime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec + finish->ru_stime.tv_usec - start->ru_stime.tv_usec);
+}
+
+static int linecomp(const void *elem1, const void *elem2)
+{
+	return strcmp(*(char * const *) elem1, *(char * const *) elem2);
+}
+
+// the list as dx.json lines, sorted so entries of the same freq compare in any order
+static char **snapshot(int *n)
+{
+	dx_json_update();
+	char *json = strdup(cfg_dx.json);
+	char **lines = (char **) malloc((dx.len + 1) * sizeof(char *));
+	int i = 0;
+	for (char *s = strtok(json, "\n"); s; s = strtok(NULL, "\n"))
+		lines[i++] = strdup(s + ((*s == ',' || *s == '{')? ((*s == ',')? 1 : 7) : 0));
+	free(json);
+	if (i) lines[i-1][strlen(lines[i-1]) - 2] = '\0';	// "]}"
+	qsort(lines, i, sizeof(char *), linecomp);
+	*n = i;
+	return lines;
+}
+
+static int compare(char **l1, int n1, char **l2, int n2)
+{
+	int bad = abs(n1 - n2);
+	for (int i = 0; i < MIN(n1, n2); i++)
+		if (strcmp(l1[i], l2[i]) != 0) bad++;
+	return bad;
+}
+
+int main(int argc, char *argv[])
+{
+	struct rusage start, finish;
+	int i, n1, n2;
+	char **l1, **l2;
+
+	gen_file();
+	restart();
+	gen_edits(2);
+
+	// with the whole file written each time the edits are few
+	#define NREF (NEDIT/10)
+	getrusage(RUSAGE_SELF, &start);
+	for (i = 0; i < NREF; i++) ref_edit(&edits[i]);
+	getrusage(RUSAGE_SELF, &finish);
+	double t_ref = cpu_secs(&start, &finish) / NREF * 1e6;
+	unlink(DX_FN ".ref");
+
+	gen_file();
+	restart();
+	getrusage(RUSAGE_SELF, &start);
+	for (i = 0; i < NEDIT; i++) new_edit(&edits[i]);
+	getrusage(RUSAGE_SELF, &finish);
+	double t_new = cpu_secs(&start, &finish) / NEDIT * 1e6;
+	int journal_n = dx.journal_n;
+
+	// restart with the journal
+	l1 = snapshot(&n1);
+	restart();
+	l2 = snapshot(&n2);
+	int bad_journal = compare(l1, n1, l2, n2);
+
+	// more edits, compact, restart with the compacted file
+	gen_edits(3);
+	for (i = 0; i < NEDIT; i++) new_edit(&edits[i]);
+	l1 = snapshot(&n1);
+	struct timeval tv0, tv1;
+	gettimeofday(&tv0, NULL);
+	dx_compact();
+	gettimeofday(&tv1, NULL);
+	double t_compact = (tv1.tv_sec - tv0.tv_sec) * 1e3 + (tv1.tv_usec - tv0.tv_usec) / 1e3;
+	bool journal_gone = (access(DX_FN ".journal", F_OK) != 0 && access(DX_FN ".journal.prev", F_OK) != 0);
+	restart();
+	l2 = snapshot(&n2);
+	int bad_compact = compare(l1, n1, l2, n2);
+
+	printf("%d entries, %d edits (%d journaled)\n", NDX, NEDIT, journal_n);
+	printf("per edit: sort + rewrite %.0f us, sorted move + journal %.1f us, %.0fx\n", t_ref, t_new, t_ref / t_new);
+	printf("1000 edits: %.2f sec vs %.3f sec\n", t_ref * 1000 / 1e6, t_new * 1000 / 1e6);
+	printf("compaction (fork, stream %d entries): %.1f ms wall\n", dx.len, t_compact);
+	printf("restart: %d differences replaying the journal, %d after compaction%s\n", bad_journal, bad_compact,
+		journal_gone? "" : ", JOURNAL NOT REMOVED");
+
+	unlink(DX_FN);
+	return 0;
+}
@@ -0,0 +1,202 @@
+// Benchmark of the FFTW plans made through support/fft_plan.cpp, for the transforms the DSP code uses:
+// execution time of FFTW_ESTIMATE plans (what most of it made before) versus FFTW_MEASURE and FFTW_PATIENT,
+// and the planning time of those. Then the registry: planning all of them at startup with and without the
+// saved wisdom, one plan for many users, and an FFTW_ESTIMATE user replanned in the background.
+// Run on the target, the numbers depend on the CPU.
+//
+// make UTIL=fft_bench run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "../types.h"
+#include "kiwi.h"
+#include "fft_plan.h"
+
+#define NEXEC_MIN	50
+#define EXEC_NS		200000000ULL	// time each plan for at least this long
+#define WISDOM_FN	"/tmp/fftwf.wisdom"
+
+static u64_t ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+typedef struct {
+	const char *name;
+	fft_kind_e kind;
+	int n, howmany;
+	bool inplace;
+} xform_t;
+
+static const xform_t xforms[] = {
+	{ "WF",				FFT_DFT, 4096,  1, false },
+	{ "FastFIR",		FFT_DFT, 1024,  1, true },
+	{ "GPS fwd",		FFT_DFT, 16384, 1, true },
+	{ "GPS rev",		FFT_DFT, 16384, 8, true },
+	{ "WSPR",			FFT_DFT, 512,   1, false },
+	{ "SSTV",			FFT_R2C, 1024,  1, false },
+	{ "SSTV",			FFT_R2C, 2048,  1, false },
+	{ "LMS fwd",		FFT_R2C, 256,   1, false },
+	{ "LMS inv",		FFT_C2R, 256,   1, false },
+	{ "LMS fwd",		FFT_R2C, 2048,  1, false },
+	{ "LMS inv",		FFT_C2R, 2048,  1, false },
+};
+
+#define NXFORM ARRAY_LEN(xforms)
+
+static float *in[NXFORM], *out[NXFORM];
+
+static void alloc_arrays()
+{
+	for (int i = 0; i < NXFORM; i++) {
+		const xform_t *x = &xforms[i];
+		size_t n = (x->n + 2) * x->howmany;
+		in[i] = (float *) fftwf_malloc(n * sizeof(fftwf_complex));
+		out[i] = x->inplace? in[i] : (float *) fftwf_malloc(n * sizeof(fftwf_complex));
+		for (size_t j = 0; j < n * 2; j++) in[i][j] = (float) (random() % 2001 - 1000) / 1000;
+	}
+}
+
+static fft_plan_t *plan_xform(int i, u4_t flags)
+{
+	const xform_t *x = &xforms[i];
+	switch (x->kind) {
+		case FFT_DFT: return fft_plan_many_dft(x->name, x->n, x->howmany, (fftwf_complex *) in[i], (fftwf_complex *) out[i], FFTW_FORWARD, flags);
+		case FFT_R2C: return fft_plan_dft_r2c_1d(x->name, x->n, in[i], (fftwf_complex *) out[i], flags);
+		case FFT_C2R: return fft_plan_dft_c2r_1d(x->name, x->n, (fftwf_complex *) in[i], out[i], flags);
+	}
+	return NULL;
+}
+
+static void exec_xform(int i, fft_plan_t *p)
+{
+	switch (xforms[i].kind) {
+		case FFT_DFT: fft_execute_dft(p, (fftwf_complex *) in[i], (fftwf_complex *) out[i]); break;
+		case FFT_R2C: fft_execute_r2c(p, in[i], (fftwf_complex *) out[i]); break;
+		case FFT_C2R: fft_execute_c2r(p, (fftwf_complex *) in[i], out[i]); break;
+	}
+}
+
+// a plain FFTW plan of transform i
+static fftwf_plan fftw_xform(int i, u4_t flags)
+{
+	const xform_t *x = &xforms[i];
+	int n = x->n;
+	switch (x->kind) {
+		case FFT_DFT: return fftwf_plan_many_dft(1, &n, x->howmany, (fftwf_complex *) in[i], NULL, 1, n,
+			(fftwf_complex *) out[i], NULL, 1, n, FFTW_FORWARD, flags);
+		case FFT_R2C: return fftwf_plan_dft_r2c_1d(n, in[i], (fftwf_complex *) out[i], flags);
+		case FFT_C2R: return fftwf_plan_dft_c2r_1d(n, (fftwf_complex *) in[i], out[i], flags);
+	}
+	return NULL;
+}
+
+// usec per execution
+static double time_fftw(int i, fftwf_plan plan)
+{
+	int n = 0;
+	u64_t start = ns(), t;
+	do {
+		switch (xforms[i].kind) {
+			case FFT_DFT: fftwf_execute_dft(plan, (fftwf_complex *) in[i], (fftwf_complex *) out[i]); break;
+			case FFT_R2C: fftwf_execute_dft_r2c(plan, in[i], (fftwf_complex *) out[i]); break;
+			case FFT_C2R: fftwf_execute_dft_c2r(plan, (fftwf_complex *) in[i], out[i]); break;
+		}
+		n++;
+	} while ((t = ns() - start) < EXEC_NS || n < NEXEC_MIN);
+	return (double) t / n / 1e3;
+}
+
+// all transforms through the registry as a freshly started server would, msec
+static double startup(u4_t flags)
+{
+	int status;
+	int fd[2];
+	double ms = 0;
+
+	pipe(fd);
+	pid_t pid = fork();
+	if (pid == 0) {
+		u64_t start = ns();
+		fft_plan_init(FFTW_MEASURE);
+		for (int i = 0; i < NXFORM; i++) plan_xform(i, flags);
+		ms = (ns() - start) / 1e6;
+		fft_plan_wisdom_update();
+		write(fd[1], &ms, sizeof(ms));
+		_exit(0);
+	}
+	read(fd[0], &ms, sizeof(ms));
+	waitpid(pid, &status, 0);
+	close(fd[0]); close(fd[1]);
+	return ms;
+}
+
+int main(int argc, char *argv[])
+{
+	int i, r;
+	static const u4_t rigor[] = { FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT };
+	static const char *rigor_s[] = { "estimate", "measure", "patient" };
+
+	print_stats = STATS_TASK;		// for fft_plan_stats()
+	srandom(1);
+	alloc_arrays();
+
+	printf("execution usec (planning msec), speedup over estimate:\n");
+	for (i = 0; i < NXFORM; i++) {
+		const xform_t *x = &xforms[i];
+		double t_est = 0;
+		printf("%-8s %s %5d", x->name, (x->kind == FFT_DFT)? "c2c" : ((x->kind == FFT_R2C)? "r2c" : "c2r"), x->n);
+		printf(x->howmany > 1? " x%-2d" : "    ", x->howmany);
+		for (r = 0; r < ARRAY_LEN(rigor); r++) {
+			u64_t start = ns();
+			fftwf_plan plan = fftw_xform(i, rigor[r]);
+			double t_plan = (ns() - start) / 1e6;
+			double t = time_fftw(i, plan);
+			if (r == 0) t_est = t;
+			printf("  %s %8.1f (%7.1f) %4.2fx", rigor_s[r], t, t_plan, t_est / t);
+			fftwf_destroy_plan(plan);
+		}
+		printf("\n");
+	}
+	fftwf_forget_wisdom();
+
+	// registry, in child processes so each starts without the wisdom of the last
+	unlink(WISDOM_FN);
+	double t_none = startup(FFTW_MEASURE);
+	double t_wisdom = startup(FFTW_MEASURE);
+	printf("\nstartup planning all with measure: no wisdom %.1f ms, with wisdom %.1f ms\n", t_none, t_wisdom);
+
+	// registry in this process: FFTW_ESTIMATE users with no wisdom, many users of one transform
+	unlink(WISDOM_FN);
+	fft_plan_init(FFTW_MEASURE);
+	fft_plan_t *p[NXFORM];
+	for (i = 0; i < NXFORM; i++) p[i] = plan_xform(i, FFTW_ESTIMATE);
+	int shared = 0;
+	for (int user = 0; user < 16; user++)
+		for (i = 0; i < NXFORM; i++) shared += (plan_xform(i, FFTW_ESTIMATE) == p[i]);
+	printf("%d of %d requests for existing transforms shared a plan\n", shared, 16 * NXFORM);
+
+	fftwf_plan before[NXFORM];
+	for (i = 0; i < NXFORM; i++) before[i] = p[i]->plan;
+	fft_plan_wisdom_update();
+	int replanned = 0;
+	for (i = 0; i < NXFORM; i++) replanned += (p[i]->plan != before[i] && p[i]->flags == FFTW_MEASURE);
+	printf("%d of %d estimate plans replaced by measure plans from the wisdom of a child process\n", replanned, NXFORM);
+
+	// per-plan stats as printed by the server
+	fft_plan_stats();
+	for (i = 0; i < NXFORM; i++)
+		for (int j = 0; j < 200; j++) exec_xform(i, p[i]);
+	sleep(1);
+	fft_plan_stats();
+
+	unlink(WISDOM_FN);
+	return 0;
+}
@@ -0,0 +1,259 @@
+// Check of the GPS channel polling, ChanUploadTask() and CHANNEL::WaitUpload() in gps/channel.cpp,
+// run through spi.cpp against the replay backend's CmdGetChan/CmdGetChans (platform/beaglebone/spi_replay.cpp).
+// A small cooperative scheduler stands in for support/coroutines.cpp, spi_pump() is its busy helper.
+// All GPS_CHANS channels poll the way Tracking() does, for NSECS in each of three phases:
+//   single     each channel sends its own CmdGetChan every poll, as before CmdGetChans
+//   batched    channels wait in WaitUpload(), ChanUploadTask() sends one CmdGetChans per poll
+//   stalled    ChanUploadTask() isn't run, so WaitUpload() times out and falls back to CmdGetChan
+// Every record a channel gets must be its own: the replay tags each word of a GPS_CHAN record with
+// its channel and offset, so a GPS_CHAN stride other than sizeof(UPLOAD) shows up as a mismatch.
+// spi_stats() is printed for each phase.
+//
+// make UTIL=gps_chan_test run
+
+#include "channel.cpp"
+#include "spi_dev.h"
+#include "peri.h"
+#include "timer.h"
+
+#include <ucontext.h>
+#include <unistd.h>
+
+#define NSECS		5
+#define NTASKS		(GPS_CHANS + 4)
+#define STACK_B		(64*1024)
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// scheduler
+
+typedef struct {
+	ucontext_t ctx;
+	funcP_t entry;
+	void *param;
+	u4_t flags;
+	bool sleeping, stalled;
+	u64_t deadline;     // 0 = until TaskWakeup()
+	void *wake_param;
+} task_t;
+
+static task_t tasks[NTASKS];
+static int ntasks, cur;
+static ucontext_t sched_ctx;
+
+static void task_start(int id)
+{
+	tasks[id].entry(tasks[id].param);
+}
+
+int _CreateTask(funcP_t entry, const char *name, void *param, int priority, u4_t flags, int f_arg)
+{
+	assert(ntasks < NTASKS);
+	int id = ntasks++;
+	task_t *t = &tasks[id];
+	t->entry = entry;
+	t->param = param;
+	t->flags = flags;
+	getcontext(&t->ctx);
+	t->ctx.uc_stack.ss_sp = malloc(STACK_B);
+	t->ctx.uc_stack.ss_size = STACK_B;
+	t->ctx.uc_link = NULL;
+	makecontext(&t->ctx, (void (*)()) task_start, 1, id);
+	return id;
+}
+
+u4_t TaskID() { return cur; }
+
+void *_TaskSleep(const char *reason, int usec, u4_t *wakeup_test)
+{
+	task_t *t = &tasks[cur];
+	t->sleeping = true;
+	t->deadline = usec? (timer_us64() + usec) : 0;
+	t->wake_param = NULL;
+	swapcontext(&t->ctx, &sched_ctx);
+	return t->wake_param;
+}
+
+void TaskWakeup(int id, u4_t flags, void *wake_param)
+{
+	tasks[id].sleeping = false;
+	tasks[id].wake_param = wake_param;
+}
+
+static void next_task(u4_t param)
+{
+	// like _NextTask(): a task waiting for its SPI reply gets the busy helper (spi_pump) run
+	if (param == NT_BUSY_WAIT) {
+		for (int i = 0; i < ntasks; i++)
+			if (tasks[i].flags & CTF_BUSY_HELPER) tasks[i].sleeping = false;
+	}
+	swapcontext(&tasks[cur].ctx, &sched_ctx);
+}
+
+#ifdef DEBUG
+ void _NextTask(const char *s, u4_t param, u_int64_t pc) { next_task(param); }
+#else
+ void _NextTask(u4_t param) { next_task(param); }
+#endif
+
+static void run(int secs)
+{
+	u64_t end = timer_us64() + SEC_TO_USEC(secs);
+
+	for (u64_t now = timer_us64(); now < end; now = timer_us64()) {
+		u64_t next = end;
+		for (int i = 0; i < ntasks; i++) {
+			task_t *t = &tasks[i];
+			if (t->stalled) continue;
+			if (t->sleeping && t->deadline && now >= t->deadline) t->sleeping = false;
+			if (t->sleeping) {
+				if (t->deadline && t->deadline < next) next = t->deadline;
+				continue;
+			}
+			cur = i;
+			swapcontext(&sched_ctx, &t->ctx);
+			next = now;
+		}
+		if (next > now) kiwi_usleep(next - now);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// the rest of the server that channel.cpp and spi.cpp use
+
+#ifdef SPI_SHMEM_DISABLE
+	static spi_shmem_t spi_shmem;
+	spi_shmem_t *spi_shmem_p = &spi_shmem;
+#endif
+
+void spi_dev(SPI_SEL sel, SPI_MOSI *mosi, int tx_xfers, SPI_MISO *miso, int rx_xfers)
+{
+	spi_replay_dev(sel, mosi, tx_xfers, miso, rx_xfers);
+}
+
+#undef lock_t   // rtklib.h, included by channel.cpp, has its own
+
+void _lock_init(lock_t *lock, const char *name) {}
+void lock_register(lock_t *lock) {}
+void lock_enter(lock_t *lock) {}    // tasks only switch in NextTask() and TaskSleep()
+void lock_leave(lock_t *lock) {}
+u4_t task_medium_priority;
+int TaskStat(u4_t s1_func, int s1_val, const char *s1_units, u4_t s2_func, int s2_val, const char *s2_units) { return 0; }
+void TaskPollForInterrupt(ipoll_from_e from) {}
+
+u64_t timer_us64()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+void kiwi_usleep(u4_t usec) { usleep(usec); }
+void spin_us(u4_t usec) {}
+
+volatile u4_t *gpio_m[1];
+gpio_t CMD_READY;
+int spi_delay, ecpu_cmds, ecpu_tcmds, rx_chans, rx_decim, snd_rate;
+int gps_chans = GPS_CHANS, gps_debug, gps_lo_gain, gps_cg_gain;
+
+gps_t gps;
+SATELLITE Sats[1];
+EPHEM Ephemeris[MAX_SATS];
+u1_t E1B_code1[NUM_E1B_SATS][E1B_CODELEN];
+void EPHEM::Init(int sat) {}
+void EPHEM::Subframe(char *buf) {}
+void SearchEnable(int sat) {}
+void GPSstat(STAT st, double d, int i, int j, int k, int l, double d2) {}
+unsigned bin(char *s, int n) { return 0; }
+void *create_viterbi27(int len) { return NULL; }
+void set_viterbi27_polynomial(int polys[2]) {}
+void delete_viterbi27(void *vp) {}
+int decode_e1b(sdrnav_t *nav, int *error) { return 0; }
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+enum { SINGLE, BATCHED, STALLED };
+static const char *phase_s[] = { "single", "batched", "stalled" };
+static int phase;
+static u4_t polls[GPS_CHANS], bad[GPS_CHANS];
+
+static void chan_task(void *param)
+{
+	int ch = (int) FROM_VOID_PARAM(param);
+	CHANNEL *c = &Chans[ch];
+	c->ch = ch;
+	c->id = TaskID();
+	c->miso = &SPI_SHMEM->gps_channel_miso[ch];
+
+	for (;;) {
+		if (phase == SINGLE) {
+			TaskSleepUsec(POLLING_US);
+			if (phase != SINGLE) continue;
+			c->UploadEmbeddedState();
+		} else {
+			c->WaitUpload();
+		}
+
+		u2_t *w = (u2_t *) &c->ul;
+		for (int j = 2; j < (int) (sizeof(UPLOAD) / sizeof(u2_t)); j++) {
+			if (w[j] != ((ch << 8) | j)) {
+				if (!bad[ch]) printf("ch%d: word %d is 0x%04x, expected 0x%04x\n", ch, j, w[j], (ch << 8) | j);
+				bad[ch]++;
+				break;
+			}
+		}
+		polls[ch]++;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int ch, fail = 0;
+
+	spi_replay = "synth";
+	spi_init();
+	for (ch = 0; ch < GPS_CHANS; ch++)
+		CreateTask(chan_task, TO_VOID_PARAM(ch), GPS_PRIORITY);
+	int upload_id = CreateTask(ChanUploadTask, 0, GPS_PRIORITY);
+	printf("%d channels, UPLOAD %d bytes, %d sec per phase\n", GPS_CHANS, (int) sizeof(UPLOAD), NSECS);
+
+	for (phase = SINGLE; phase <= STALLED; phase++) {
+		tasks[upload_id].stalled = (phase == STALLED);
+		memset(polls, 0, sizeof(polls));
+		print_stats = 0;
+		spi_stats();    // resets the counts
+
+		run(NSECS);
+
+		u4_t single = spi.cmd_count[CmdGetChan], batched = spi.cmd_count[CmdGetChans];
+		u4_t min_polls = polls[0];
+		for (ch = 1; ch < GPS_CHANS; ch++) min_polls = MIN(min_polls, polls[ch]);
+		printf("\n%s: CmdGetChan %.1f/s, CmdGetChans %.1f/s, polls per channel %.1f/s min\n", phase_s[phase],
+			(float) single / NSECS, (float) batched / NSECS, (float) min_polls / NSECS);
+		print_stats = STATS_TASK;
+		spi_stats();
+
+		// allow a poll lost at each end of the phase
+		int per_chan = (phase == STALLED)? (SEC_TO_USEC(NSECS) / UPLOAD_TIMEOUT_US) : (NSECS * POLLING_PS);
+		if (min_polls < per_chan - 2) {
+			printf("FAIL: a channel got %d polls, expected %d\n", min_polls, per_chan);
+			fail = 1;
+		}
+		if (phase == BATCHED && (single != 0 || batched < (u4_t) (NSECS * POLLING_PS - 2))) {
+			printf("FAIL: expected only CmdGetChans\n");
+			fail = 1;
+		}
+		if (phase == STALLED && (batched != 0 || single < (u4_t) (GPS_CHANS * (per_chan - 2)))) {
+			printf("FAIL: expected the CmdGetChan fallback of every channel\n");
+			fail = 1;
+		}
+	}
+
+	for (ch = 0; ch < GPS_CHANS; ch++) {
+		if (bad[ch]) {
+			printf("FAIL: ch%d got %d records that weren't its own\n", ch, bad[ch]);
+			fail = 1;
+		}
+	}
+
+	printf("%s\n", fail? "FAIL" : "ok");
+	return fail;
+}
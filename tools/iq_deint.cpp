@@ -0,0 +1,115 @@
+// Benchmark of the data pump snd_service() IQ deinterleave:
+// the original per-sample/per-channel S24_8_16() loop versus simd_iq24_deinterleave().
+// Synthetic SPI buffers, 680 IQ entries per transfer split over 3..14 channels,
+// with one channel disabled to exercise the skip path.
+//
+// make UTIL=iq_deint run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../types.h"
+#include "simd.h"
+
+#define NENTRIES	680		// (NRX_SPI - NRX_OVHD) / NRX_IQW
+#define MAX_CHANS	16
+#define NXFERS		200000
+
+typedef struct {
+	u2_t i, q;
+	u1_t q3, i3;	// NB: endian swap
+} __attribute__((packed)) rx_iq_t;
+
+typedef struct {
+	float re, im;
+} cpx_t;
+
+static rx_iq_t iq_buf[NENTRIES];
+static cpx_t out_scalar[MAX_CHANS][NENTRIES], out_simd[MAX_CHANS][NENTRIES];
+static bool enabled[MAX_CHANS];
+
+static const float rescale = 1.0 / (1 << 10), dc_i = 0.25, dc_q = -0.5;
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec);
+}
+
+// the loop snd_service() used before the simd kernel
+static void deint_scalar(int nsamps, int nchans)
+{
+	int j;
+	cpx_t *i_samps[MAX_CHANS];
+	for (int ch=0; ch < nchans; ch++)
+		i_samps[ch] = out_scalar[ch];
+	rx_iq_t *iqp = iq_buf;
+
+	for (j=0; j < nsamps; j++) {
+		for (int ch=0; ch < nchans; ch++) {
+			if (enabled[ch]) {
+				s4_t i, q;
+				i = S24_8_16(iqp->i3, iqp->i);
+				q = S24_8_16(iqp->q3, iqp->q);
+				i_samps[ch]->re = q * rescale + dc_i;
+				i_samps[ch]->im = i * rescale + dc_q;
+				i_samps[ch]++;
+			}
+			iqp++;
+		}
+	}
+}
+
+static void deint_simd(int nsamps, int nchans)
+{
+	float *out[MAX_CHANS];
+	for (int ch=0; ch < nchans; ch++)
+		out[ch] = enabled[ch]? (float *) out_simd[ch] : NULL;
+	simd_iq24_deinterleave(nsamps, nchans, (const uint8_t *) iq_buf, rescale, dc_i, dc_q, out);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, x, ch;
+	struct rusage start, finish;
+	static const int chans[] = { 3, 4, 8, 14 };
+
+	srandom(1);
+	for (i=0; i < NENTRIES; i++) {
+		iq_buf[i].i = random(); iq_buf[i].q = random();
+		iq_buf[i].i3 = random(); iq_buf[i].q3 = random();
+	}
+
+	for (int c=0; c < (int) ARRAY_LEN(chans); c++) {
+		int nchans = chans[c], nsamps = NENTRIES / nchans, diffs = 0;
+		for (ch=0; ch < nchans; ch++)
+			enabled[ch] = (ch != 1);
+
+		memset(out_scalar, 0, sizeof(out_scalar));
+		memset(out_simd, 0, sizeof(out_simd));
+		deint_scalar(nsamps, nchans);
+		deint_simd(nsamps, nchans);
+		for (ch=0; ch < nchans; ch++)
+			for (i=0; i < nsamps; i++)
+				if (out_scalar[ch][i].re != out_simd[ch][i].re || out_scalar[ch][i].im != out_simd[ch][i].im)
+					diffs++;
+
+		getrusage(RUSAGE_SELF, &start);
+		for (x=0; x < NXFERS; x++) deint_scalar(nsamps, nchans);
+		getrusage(RUSAGE_SELF, &finish);
+		double t_scalar = cpu_secs(&start, &finish);
+
+		getrusage(RUSAGE_SELF, &start);
+		for (x=0; x < NXFERS; x++) deint_simd(nsamps, nchans);
+		getrusage(RUSAGE_SELF, &finish);
+		double t_simd = cpu_secs(&start, &finish);
+
+		double samps = (double) NXFERS * nsamps * nchans;
+		printf("%2d chans: %d differing, scalar %.1f Msamps/sec, simd %.1f Msamps/sec, speedup %.2fx\n",
+			nchans, diffs, samps / t_scalar / 1e6, samps / t_simd / 1e6, t_scalar / t_simd);
+	}
+	return 0;
+}
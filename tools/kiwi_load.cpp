@@ -0,0 +1,313 @@
+// Headless load generator: opens N audio (SND) and optionally waterfall (W/F) websocket
+// connections to a Kiwi server and reports per-stream packet rate, audio sequence drops and
+// packet arrival gaps. Run against "kiwi -replay synth +stats" to measure per-channel CPU,
+// latency and drops without FPGA hardware (add +sdr on a DEVSYS build, which defaults to -sdr).
+//
+// make UTIL=kiwi_load ARGS="-n 4 -wf -t 60" run
+//
+// -h host -p port    server, default localhost:8073
+// -n N               number of SND connections (receiver channels)
+// -wf                also open a W/F connection per channel
+// -iq                IQ mode instead of AM
+// -f kHz             frequency, incremented 1 kHz per channel
+// -t secs            run time, 0 = forever
+// -r secs            report interval
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "../types.h"
+
+#define MAX_STREAMS     64
+#define RBUF_SIZE       (256*1024)
+
+typedef struct {
+    int fd, ch;
+    bool wf, open;
+    u1_t *rbuf;
+    int rlen;
+
+    u4_t pkts, bytes, msgs, drops;
+    u4_t seq, last_us, max_gap_us;
+    u64_t sum_gap_us;
+    bool have_seq;
+    u4_t t_pkts, t_drops, t_max_gap_us;     // totals over the run
+} stream_t;
+
+static stream_t streams[MAX_STREAMS];
+static int nstreams;
+
+static u64_t timer_us()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (u64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void ws_send(stream_t *s, const char *fmt, ...)
+{
+    char msg[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    if (len < 0 || len >= (int) sizeof(msg)) {
+        printf("%s%d: message too long\n", s->wf? "W/F":"SND", s->ch);
+        exit(-1);
+    }
+
+    // client frames must be masked, payloads >= 126 bytes have a 16-bit extended length
+    u1_t frame[sizeof(msg) + 8];
+    u1_t mask[4] = { (u1_t) random(), (u1_t) random(), (u1_t) random(), (u1_t) random() };
+    int hl = 2;
+    frame[0] = 0x81;    // FIN, text
+    if (len < 126) {
+        frame[1] = 0x80 | len;
+    } else {
+        frame[1] = 0x80 | 126;
+        frame[hl++] = len >> 8;
+        frame[hl++] = len & 0xff;
+    }
+    memcpy(&frame[hl], mask, 4);
+    hl += 4;
+    for (int i=0; i < len; i++)
+        frame[hl+i] = msg[i] ^ mask[i&3];
+    if (write(s->fd, frame, hl + len) != hl + len) {
+        printf("%s%d: write failed\n", s->wf? "W/F":"SND", s->ch);
+        exit(-1);
+    }
+}
+
+static int ws_open(const char *host, int port, const char *path)
+{
+    struct addrinfo hints, *res;
+    char port_s[16];
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    sprintf(port_s, "%d", port);
+    if (getaddrinfo(host, port_s, &hints, &res) != 0) { printf("can't resolve %s\n", host); exit(-1); }
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) < 0) { perror("connect"); exit(-1); }
+    freeaddrinfo(res);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    char req[512];
+    int n = snprintf(req, sizeof(req),
+        "GET %s HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n",
+        path, host, port);
+    if (write(fd, req, n) != n) { perror("write"); exit(-1); }
+
+    // response header, byte at a time so no frame data is consumed
+    char hdr[1024];
+    int hlen = 0;
+    while (hlen < (int) sizeof(hdr) - 1) {
+        if (read(fd, &hdr[hlen], 1) != 1) { printf("%s: no handshake reply\n", path); exit(-1); }
+        hlen++;
+        if (hlen >= 4 && memcmp(&hdr[hlen-4], "\r\n\r\n", 4) == 0) break;
+    }
+    hdr[hlen] = 0;
+    if (strstr(hdr, " 101 ") == NULL) { printf("%s: handshake failed:\n%s", path, hdr); exit(-1); }
+    return fd;
+}
+
+static void stream_open(stream_t *s, const char *host, int port, long long ts, int ch, bool wf, bool iq, double freq)
+{
+    char path[64];
+    sprintf(path, "/kiwi/%lld/%s", ts, wf? "W/F" : "SND");
+    s->fd = ws_open(host, port, path);
+    s->ch = ch;
+    s->wf = wf;
+    s->rbuf = (u1_t *) malloc(RBUF_SIZE);
+    s->open = true;
+
+    ws_send(s, "SET auth t=kiwi p=#");
+    if (wf) {
+        ws_send(s, "SET zoom=0 start=0");
+        ws_send(s, "SET maxdb=-10 mindb=-110");
+        ws_send(s, "SET wf_speed=4");
+        ws_send(s, "SET wf_comp=0");
+    } else {
+        ws_send(s, "SET mod=%s low_cut=%d high_cut=%d freq=%.3f", iq? "iq":"am", iq? -5000:-4900, iq? 5000:4900, freq);
+        ws_send(s, "SET compression=0");
+        ws_send(s, "SET agc=1 hang=0 thresh=-100 slope=6 decay=1000 manGain=50");
+        ws_send(s, "SET squelch=0 max=0");
+        ws_send(s, "SET AR OK in=12000 out=44100");
+    }
+    ws_send(s, "SET ident_user=kiwi_load");
+}
+
+static void frame_rx(stream_t *s, u1_t *p, int len)
+{
+    u4_t now = timer_us();
+
+    if (len >= 3 && memcmp(p, "MSG", 3) == 0) {
+        s->msgs++;
+        if (len > 4 && (memmem(p, len, "too_busy", 8) || memmem(p, len, "badp=1", 6) || memmem(p, len, "down=1", 6)))
+            printf("%s%d: %.*s\n", s->wf? "W/F":"SND", s->ch, len, p);
+        return;
+    }
+
+    // SND: id[3] flags seq[4], W/F: id4[4] x_bin_server flags_x_zoom_server seq
+    // The W/F seq is the audio seq when the frame was made (for A/V sync), not a frame count,
+    // so it skips whenever the frame rate is below the audio packet rate. Only SND seq gaps are drops.
+    int seq_off = s->wf? 12 : 4;
+    if (len < seq_off + 4) return;
+    u4_t seq = p[seq_off] | (p[seq_off+1] << 8) | (p[seq_off+2] << 16) | (p[seq_off+3] << 24);
+    if (!s->wf && s->have_seq && seq != s->seq + 1) s->drops++;
+    s->seq = seq;
+
+    if (s->have_seq) {
+        u4_t gap = now - s->last_us;
+        s->sum_gap_us += gap;
+        if (gap > s->max_gap_us) s->max_gap_us = gap;
+    }
+    s->have_seq = true;
+    s->last_us = now;
+    s->pkts++;
+    s->bytes += len;
+}
+
+static void stream_rx(stream_t *s)
+{
+    int n = read(s->fd, s->rbuf + s->rlen, RBUF_SIZE - s->rlen);
+    if (n <= 0) {
+        printf("%s%d: connection closed\n", s->wf? "W/F":"SND", s->ch);
+        close(s->fd);
+        s->open = false;
+        return;
+    }
+    s->rlen += n;
+
+    // server frames are not masked
+    u1_t *p = s->rbuf;
+    while (s->rlen >= 2) {
+        int op = p[0] & 0xf, hlen = 2;
+        u4_t len = p[1] & 0x7f;
+        if (len == 126) {
+            if (s->rlen < 4) break;
+            len = (p[2] << 8) | p[3];
+            hlen = 4;
+        } else
+        if (len == 127) {
+            if (s->rlen < 10) break;
+            len = (p[6] << 24) | (p[7] << 16) | (p[8] << 8) | p[9];
+            hlen = 10;
+        }
+        if (len > RBUF_SIZE - 16) { printf("frame too big %d\n", len); exit(-1); }
+        if (s->rlen < (int) (hlen + len)) break;
+
+        if (op == 1 || op == 2) frame_rx(s, p + hlen, len);
+        if (op == 8) { s->rlen = 0; close(s->fd); s->open = false; return; }
+        p += hlen + len;
+        s->rlen -= hlen + len;
+    }
+    if (s->rlen) memmove(s->rbuf, p, s->rlen);
+}
+
+static void report(float secs, bool final)
+{
+    u4_t pkts = 0, snd_pkts = 0, drops = 0, max_gap = 0;
+    bool show = final || secs >= 1;     // a tail under a second at the end only goes into the totals
+    if (show) printf("%s%.0f sec:\n", final? "TOTAL ":"", secs);
+    for (int i=0; i < nstreams; i++) {
+        stream_t *s = &streams[i];
+        u4_t n = final? s->t_pkts : s->pkts, d = final? s->t_drops : s->drops;
+        u4_t mg = final? s->t_max_gap_us : s->max_gap_us;
+        if (!final) {
+            if (show) {
+                printf("  %s%-2d %s %6.1f pkt/s %7.1f kB/s, ", s->wf? "W/F":"SND", s->ch, s->open? "  ":"X ",
+                    n / secs, s->bytes / secs / 1e3);
+                if (s->wf) printf("         "); else printf("%d drops, ", d);
+                printf("gap avg %.1f max %.1f msec\n", s->pkts > 1? s->sum_gap_us / 1e3 / (s->pkts - 1) : 0, mg / 1e3);
+            }
+            s->t_pkts += s->pkts; s->t_drops += s->drops;
+            if (s->max_gap_us > s->t_max_gap_us) s->t_max_gap_us = s->max_gap_us;
+            s->pkts = s->bytes = s->drops = s->max_gap_us = 0;
+            s->sum_gap_us = 0;
+        }
+        if (!s->wf) { snd_pkts += n; drops += d; }
+        pkts += n;
+        if (mg > max_gap) max_gap = mg;
+    }
+    if (show) printf("  all    %6.1f pkt/s, %d SND drops (%.3f%%), max gap %.1f msec\n",
+        pkts / secs, drops, snd_pkts? 100.0 * drops / (snd_pkts + drops) : 0, max_gap / 1e3);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *host = "localhost";
+    int port = 8073, nsnd = 1, run_secs = 0, report_secs = 10;
+    bool wf = false, iq = false;
+    double freq = 10000;
+
+    for (int i=1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 && i+1 < argc) host = argv[++i]; else
+        if (strcmp(argv[i], "-p") == 0 && i+1 < argc) port = atoi(argv[++i]); else
+        if (strcmp(argv[i], "-n") == 0 && i+1 < argc) nsnd = atoi(argv[++i]); else
+        if (strcmp(argv[i], "-t") == 0 && i+1 < argc) run_secs = atoi(argv[++i]); else
+        if (strcmp(argv[i], "-r") == 0 && i+1 < argc) report_secs = atoi(argv[++i]); else
+        if (strcmp(argv[i], "-f") == 0 && i+1 < argc) freq = atof(argv[++i]); else
+        if (strcmp(argv[i], "-wf") == 0) wf = true; else
+        if (strcmp(argv[i], "-iq") == 0) iq = true; else
+            { printf("unknown arg %s\n", argv[i]); return -1; }
+    }
+    if (nsnd * (wf? 2:1) > MAX_STREAMS) { printf("too many streams\n"); return -1; }
+
+    // SND and W/F of a channel share the timestamp in the url so the server pairs them
+    long long ts = (long long) time(NULL) * 1000;
+    srandom(ts);
+    for (int ch=0; ch < nsnd; ch++) {
+        stream_open(&streams[nstreams++], host, port, ts + ch, ch, false, iq, freq + ch);
+        if (wf) stream_open(&streams[nstreams++], host, port, ts + ch, ch, true, iq, freq + ch);
+    }
+    printf("%d SND%s connections to %s:%d\n", nsnd, wf? " + W/F":"", host, port);
+
+    struct pollfd pfd[MAX_STREAMS];
+    u64_t start = timer_us(), last_report = start, last_keepalive = start;
+
+    while (run_secs == 0 || (timer_us() - start) < (u64_t) run_secs * 1000000) {
+        int nopen = 0;
+        for (int i=0; i < nstreams; i++) {
+            pfd[i].fd = streams[i].open? streams[i].fd : -1;
+            pfd[i].events = POLLIN;
+            if (streams[i].open) nopen++;
+        }
+        if (nopen == 0) break;
+
+        if (poll(pfd, nstreams, 100) < 0 && errno != EINTR) { perror("poll"); return -1; }
+        for (int i=0; i < nstreams; i++)
+            if (pfd[i].revents & (POLLIN | POLLHUP | POLLERR)) stream_rx(&streams[i]);
+
+        u64_t now = timer_us();
+        if (now - last_keepalive >= 5000000) {
+            for (int i=0; i < nstreams; i++)
+                if (streams[i].open) ws_send(&streams[i], "SET keepalive");
+            last_keepalive = now;
+        }
+        if (now - last_report >= (u64_t) report_secs * 1000000) {
+            report((now - last_report) / 1e6, false);
+            last_report = now;
+        }
+    }
+
+    u64_t now = timer_us();
+    report((now - last_report) / 1e6, false);
+    report((now - start) / 1e6, true);
+    return 0;
+}
@@ -0,0 +1,183 @@
+// Benchmark and check of CLMS::ProcessFilter(): the original per-sample version
+// (modulo indexed delay line, INC/DEC per tap) versus the linear double-length delay line
+// with the vectorized dot product and coefficient update, and the frequency-domain block mode.
+// Test signal at 12 kHz: two carriers (1000, 1730 Hz) in white noise.
+// The time-domain output must match the original to within rounding. The block mode adapts
+// differently so its tone/noise figures over the last half of the signal are shown instead.
+// Channels per core is for both denoise and autonotch enabled.
+//
+// make UTIL=lms_bench run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../types.h"
+#include "lms.h"
+
+#define SRATE		12000
+#define NSAMPS		(SRATE * 10)
+#define BLOCK		512			// samples per ProcessFilter() call, like the audio task
+#define NPASS		5			// timing passes, each from a fresh Initialize()
+
+static const float tone_hz[] = { 1000, 1730 };
+
+// the original algorithm
+#define INC(dlp) dlp = (dlp == (dlen + LMSLEN - 1))? 0 : (dlp+1);
+#define DEC(dlp) dlp = (dlp == 0)? (dlen + LMSLEN - 1) : (dlp-1);
+
+struct lms_ref {
+	bool notch;
+	int dlen, dlp;
+	float beta, decay;
+	float dline[MAX_DLEN + LMSLEN];
+	float coef[LMSLEN];
+
+	void init(bool an, int delay, float b, float d)
+	{
+		memset(this, 0, sizeof(*this));
+		notch = an; dlen = delay; beta = b; decay = d;
+	}
+
+	void process(int ilen, TYPEMONO16 *ibuf, TYPEMONO16 *obuf)
+	{
+		int i;
+		for (int bp = 0; bp < ilen; bp++) {
+			float samp = ((float) ibuf[bp]) / K_AMPMAX;
+			dline[dlp] = samp; INC(dlp);
+			float fir = 0;
+			for (i=0; i < LMSLEN; i++) {
+				fir += dline[dlp] * coef[i];
+				INC(dlp);
+			}
+			DEC(dlp);
+			if (!notch) obuf[bp] = (TYPEMONO16) MROUND(fir * 2 * K_AMPMAX);
+			float err = samp - fir;
+			if (notch) obuf[bp] = (TYPEMONO16) MROUND(err * K_AMPMAX);
+			float err2 = err * beta;
+			for (i = LMSLEN - 1; i >= 0; i--) {
+				coef[i] = dline[dlp] * err2 + coef[i] * decay;
+				DEC(dlp);
+			}
+			INC(dlp);
+		}
+	}
+};
+
+static TYPEMONO16 in[NSAMPS], out_ref[NSAMPS], out_new[NSAMPS];
+static lms_ref ref;
+static CLMS lms;
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec);
+}
+
+static void gen()
+{
+	srandom(1);
+	for (int i=0; i < NSAMPS; i++) {
+		float t = (float) i / SRATE, s = 0;
+		for (int k=0; k < (int) ARRAY_LEN(tone_hz); k++)
+			s += 3000 * sinf(2*M_PI*tone_hz[k]*t);
+		s += ((random() % 20001) - 10000) * 0.3;
+		in[i] = (TYPEMONO16) s;
+	}
+}
+
+// over the last half: power at the tone frequencies and the rest, in dB re full scale
+static void tone_noise(TYPEMONO16 *x, float *tone_dB, float *rest_dB)
+{
+	int n0 = NSAMPS/2, n = NSAMPS - n0;
+	double total = 0, tone = 0;
+	for (int i = n0; i < NSAMPS; i++) total += (double) x[i] * x[i];
+	total /= n;
+	for (int k=0; k < (int) ARRAY_LEN(tone_hz); k++) {
+		double re = 0, im = 0;
+		for (int i = n0; i < NSAMPS; i++) {
+			double ph = 2*M_PI*tone_hz[k]*i / SRATE;
+			re += x[i] * cos(ph);
+			im += x[i] * sin(ph);
+		}
+		tone += 2 * (re*re + im*im) / ((double) n*n);
+	}
+	*tone_dB = 10 * log10(tone / (K_AMPMAX*K_AMPMAX) + 1e-20);
+	*rest_dB = 10 * log10(MAX(total - tone, 0) / (K_AMPMAX*K_AMPMAX) + 1e-20);
+}
+
+static double run_new(lms_e type, int delay, float beta, float decay, int block)
+{
+	struct rusage start, finish;
+	double t = 0;
+	for (int p=0; p < NPASS; p++) {
+		lms.Initialize(type, delay, beta, decay, block);
+		getrusage(RUSAGE_SELF, &start);
+		for (int i=0; i < NSAMPS; i += BLOCK)
+			lms.ProcessFilter(MIN(BLOCK, NSAMPS-i), &in[i], &out_new[i]);
+		getrusage(RUSAGE_SELF, &finish);
+		t += cpu_secs(&start, &finish);
+	}
+	return t / NSAMPS / NPASS * 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	struct rusage start, finish;
+	static const char *type_s[] = { "denoise", "autonotch" };
+	static const int delay[] = { 1, 48 };
+	static const float beta[] = { 0.05, 0.125 }, decay[] = { 0.98, 0.99915 };		// LMS_filter.js defaults
+	static const int blocks[] = { 128, 256, 512, 1024 };
+	double ns_ref[2], ns_new[2], ns_block[2][ARRAY_LEN(blocks)];
+	float tone_dB, rest_dB;
+
+	gen();
+	tone_noise(in, &tone_dB, &rest_dB);
+	printf("input: tones %.1f dB, noise %.1f dB\n\n", tone_dB, rest_dB);
+
+	for (int an=0; an <= 1; an++) {
+		lms_e type = an? LMS_AUTONOTCH_QRM : LMS_DENOISE_QRN;
+
+		double t = 0;
+		for (int p=0; p < NPASS; p++) {
+			ref.init(an, delay[an], beta[an], decay[an]);
+			getrusage(RUSAGE_SELF, &start);
+			for (int i=0; i < NSAMPS; i += BLOCK)
+				ref.process(MIN(BLOCK, NSAMPS-i), &in[i], &out_ref[i]);
+			getrusage(RUSAGE_SELF, &finish);
+			t += cpu_secs(&start, &finish);
+		}
+		ns_ref[an] = t / NSAMPS / NPASS * 1e9;
+
+		ns_new[an] = run_new(type, delay[an], beta[an], decay[an], 0);
+		int max_diff = 0;
+		for (int i=0; i < NSAMPS; i++) {
+			int d = abs(out_new[i] - out_ref[i]);
+			if (d > max_diff) max_diff = d;
+		}
+		tone_noise(out_ref, &tone_dB, &rest_dB);
+		printf("%-9s orig       %6.1f ns/samp                  tones %6.1f dB, noise %6.1f dB\n",
+			type_s[an], ns_ref[an], tone_dB, rest_dB);
+		printf("%-9s new        %6.1f ns/samp  %5.2fx  max diff %d LSB\n",
+			type_s[an], ns_new[an], ns_ref[an] / ns_new[an], max_diff);
+
+		for (int b=0; b < (int) ARRAY_LEN(blocks); b++) {
+			ns_block[an][b] = run_new(type, delay[an], beta[an], decay[an], blocks[b]);
+			tone_noise(out_new, &tone_dB, &rest_dB);
+			printf("%-9s block %4d %6.1f ns/samp  %5.2fx                tones %6.1f dB, noise %6.1f dB\n",
+				type_s[an], blocks[b], ns_block[an][b], ns_ref[an] / ns_block[an][b], tone_dB, rest_dB);
+		}
+		printf("\n");
+	}
+
+	printf("channels/core with denoise + autonotch at %d Hz:\n", SRATE);
+	printf("orig %.0f, new %.0f", 1e9 / SRATE / (ns_ref[0] + ns_ref[1]), 1e9 / SRATE / (ns_new[0] + ns_new[1]));
+	for (int b=0; b < (int) ARRAY_LEN(blocks); b++)
+		printf(", block %d %.0f", blocks[b], 1e9 / SRATE / (ns_block[0][b] + ns_block[1][b]));
+	printf("\n");
+	return 0;
+}
@@ -0,0 +1,222 @@
+// Benchmark of the NAV preamble search of CHANNEL::Tracking() (gps/channel.cpp) on synthetic bitstreams.
+// Each stream is random data with the L1 subframe (or E1B page pair) preamble at the subframe boundaries,
+// upright or inverted, joined at a random bit position, and arrives 16 bits at a time at the rate of a poll.
+// The search as it was (memcmp of the preamble at the start of the char buffer, memmove of the whole
+// buffer by one bit on a miss) runs against nav_sync_t (gps/nav_sync.h) which skips to the next candidate
+// in one go. A candidate that is not on a real boundary is rejected with one bit dropped, one on a boundary
+// is taken as a subframe, like ParityCheck() would. Both must see the same candidates at the same stream
+// positions, so the time to sync is the same and only the CPU time differs.
+//
+// make UTIL=nav_sync_bench run
+// make UTIL=nav_sync_bench ARGS="-n 500 -s 20" run    (streams, subframes per stream)
+
+#include "types.h"
+#include "nav_sync.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define MAX_NAV_BITS	128		// kiwi.gen.h
+#define NPASS			5		// timing passes
+
+#define L1_PRELEN		8
+#define L1_PREAMBLE		0x8b
+#define E1B_PRELEN		10
+#define E1B_PREAMBLE	0x160
+#define E1B_TSYM_PP		250
+
+static const char L1preambleUpright [] = {1,0,0,0,1,0,1,1};
+static const char L1preambleInverse [] = {0,1,1,1,0,1,0,0};
+static const char E1BpreambleUpright [] = {0,1,0,1,1,0,0,0,0,0};
+static const char E1BpreambleInverse [] = {1,0,1,0,0,1,1,1,1,1};
+
+struct sig_t {
+	const char *name;
+	int bps, subframe_bits, prelen, pair;
+	u4_t preamble;
+	const char *up, *inv;
+};
+
+static const sig_t sigs[2] = {
+	{ "L1 ", 50,  300, L1_PRELEN,  0,           L1_PREAMBLE,  L1preambleUpright,  L1preambleInverse },
+	{ "E1B", 250, 500, E1B_PRELEN, E1B_TSYM_PP, E1B_PREAMBLE, E1BpreambleUpright, E1BpreambleInverse },
+};
+
+struct result_t {
+	int ncand, nsync;
+	int first_sync;		// stream bit position of the first subframe taken
+	u4_t sum;			// over the stream positions of all candidates
+};
+
+static u4_t rnd_state = 1;
+
+static u4_t rnd()		// xorshift32
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+static void candidate(result_t *r, const sig_t *s, int pos, int phase, int *nbits)
+{
+	r->ncand++;
+	r->sum = (r->sum ^ pos) * 16777619;
+	if ((pos - phase) % s->subframe_bits == 0) {
+		if (r->nsync++ == 0) r->first_sync = pos;
+		*nbits = s->subframe_bits;
+	} else {
+		*nbits = 1;
+	}
+}
+
+// as in CHANNEL::Tracking() and CHANNEL::ParityCheck() before
+static void search_memmove(const sig_t *s, const u2_t *words, int nwords, int phase, result_t *r)
+{
+	char buf[1024];
+	int holding = 0, dropped = 0, poll = 0, w = 0;
+
+	while (w < nwords) {
+		poll += s->bps;
+		for (; poll >= 4*16 && w < nwords; poll -= 4*16, w++) {
+			int word = words[w];
+			for (int i = 0; i < 16; i++) {
+				word <<= 1;
+				buf[holding++] = (word >> 16) & 1;
+			}
+		}
+
+		while (holding >= s->subframe_bits) {
+			int nbits;
+			if ((memcmp(buf, s->up, s->prelen) == 0 && (!s->pair || memcmp(buf + s->pair, s->up, s->prelen) == 0)) ||
+			    (memcmp(buf, s->inv, s->prelen) == 0 && (!s->pair || memcmp(buf + s->pair, s->inv, s->prelen) == 0)))
+				candidate(r, s, dropped, phase, &nbits);
+			else
+				nbits = 1;
+			memmove(buf, buf + nbits, holding -= nbits);
+			dropped += nbits;
+		}
+	}
+}
+
+// as in CHANNEL::Tracking() now
+static void search_packed(const sig_t *s, const u2_t *words, int nwords, int phase, result_t *r)
+{
+	char buf[1024];
+	nav_sync_t ns;
+	int holding = 0, dropped = 0, poll = 0, w = 0;
+
+	ns.reset();
+	while (w < nwords) {
+		poll += s->bps;
+		for (; poll >= 4*16 && w < nwords; poll -= 4*16, w++) {
+			int word = words[w];
+			ns.put16(word);
+			for (int i = 0; i < 16; i++) {
+				word <<= 1;
+				buf[holding++] = (word >> 16) & 1;
+			}
+		}
+
+		while (holding >= s->subframe_bits) {
+			int noffsets = holding - s->subframe_bits + 1, nbits;
+			int k = ns.find(noffsets, s->preamble, s->prelen, s->pair, NULL);
+			if (k < 0) k = noffsets;
+			if (k) {
+				memmove(buf, buf + k, holding -= k);
+				ns.drop(k);
+				dropped += k;
+				continue;
+			}
+			candidate(r, s, dropped, phase, &nbits);
+			memmove(buf, buf + nbits, holding -= nbits);
+			ns.drop(nbits);
+			dropped += nbits;
+		}
+	}
+}
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, j, n, nstreams = 200, nsub = 12, errs = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i+1 < argc) nstreams = atoi(argv[++i]);
+		if (strcmp(argv[i], "-s") == 0 && i+1 < argc) nsub = atoi(argv[++i]);
+	}
+
+	for (int g = 0; g < 2; g++) {
+		const sig_t *s = &sigs[g];
+		int nwords = (nsub * s->subframe_bits + 15) / 16;
+		u2_t *words = (u2_t *) malloc(nstreams * nwords * sizeof(u2_t));
+		int *phase = (int *) malloc(nstreams * sizeof(int));
+		result_t *r_old = (result_t *) calloc(nstreams, sizeof(result_t));
+		result_t *r_new = (result_t *) calloc(nstreams, sizeof(result_t));
+		char *bits = (char *) malloc(nwords * 16 + s->subframe_bits);
+
+		for (n = 0; n < nstreams; n++) {
+			int inv = rnd() & 1;
+			phase[n] = rnd() % s->subframe_bits;
+			for (i = 0; i < nwords * 16; i++) bits[i] = rnd() & 1;
+			for (i = phase[n]; i < nwords * 16; i += s->subframe_bits)
+				for (j = 0; j < s->prelen; j++) {
+					bits[i+j] = (inv? s->inv : s->up)[j];
+					if (s->pair) bits[i+s->pair+j] = bits[i+j];
+				}
+			for (i = 0; i < nwords; i++) {
+				u2_t w = 0;
+				for (j = 0; j < 16; j++) w = (w << 1) | bits[i*16 + j];
+				words[n*nwords + i] = w;
+			}
+		}
+
+		struct rusage start, finish;
+		double t_old = 0, t_new = 0;
+		for (int p = 0; p < NPASS; p++) {
+			memset(r_old, 0, nstreams * sizeof(result_t));
+			memset(r_new, 0, nstreams * sizeof(result_t));
+			getrusage(RUSAGE_SELF, &start);
+			for (n = 0; n < nstreams; n++)
+				search_memmove(s, &words[n*nwords], nwords, phase[n], &r_old[n]);
+			getrusage(RUSAGE_SELF, &finish);
+			t_old += cpu_secs(&start, &finish);
+
+			getrusage(RUSAGE_SELF, &start);
+			for (n = 0; n < nstreams; n++)
+				search_packed(s, &words[n*nwords], nwords, phase[n], &r_new[n]);
+			getrusage(RUSAGE_SELF, &finish);
+			t_new += cpu_secs(&start, &finish);
+		}
+
+		int diff = 0, nsync = 0, ncand = 0;
+		double sync_bits = 0;
+		for (n = 0; n < nstreams; n++) {
+			if (r_old[n].ncand != r_new[n].ncand || r_old[n].nsync != r_new[n].nsync ||
+			    r_old[n].first_sync != r_new[n].first_sync || r_old[n].sum != r_new[n].sum) diff++;
+			nsync += r_new[n].nsync;
+			ncand += r_new[n].ncand;
+			sync_bits += r_new[n].first_sync + s->subframe_bits;
+		}
+		errs += diff;
+
+		double nbits = (double) nstreams * nwords * 16 * NPASS;
+		printf("%s %d streams of %d bits: first sync after %.1f sec avg, %d subframes, %d false preambles\n",
+			s->name, nstreams, nwords * 16, sync_bits / nstreams / s->bps, nsync, ncand - nsync);
+		printf("    memmove search %6.1f nsec/bit\n", t_old / nbits * 1e9);
+		printf("    packed search  %6.1f nsec/bit, %.1fx, %d streams differ\n",
+			t_new / nbits * 1e9, t_old / t_new, diff);
+
+		free(words); free(phase); free(r_old); free(r_new); free(bits);
+	}
+
+	return errs? 1 : 0;
+}
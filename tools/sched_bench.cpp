@@ -0,0 +1,202 @@
+// Benchmark of the coroutine scheduler's next-task selection:
+// the original walk of every task on every priority queue (checking deadlines and
+// wakeup tests as it goes) versus the runq bitmaps and timer heap in support/runq.h.
+// Tasks are spread over the 8 priorities, each runs then sleeps for a random time,
+// mostly on a deadline, some until an explicit wakeup. Only selection is timed,
+// not the context switch itself.
+// A running server has about 30 tasks when idle (main, stats, spi, data pump, web server,
+// services, 12 GPS channels + 3, admin, dx) plus 2-3 per connected channel (SND, WF, EXT),
+// so 30-60 are the counts that matter. Built -O3 like support/ in the server.
+//
+// make UTIL=sched_bench run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../types.h"
+#include "runq.h"
+
+#define NPRIO		8
+#define NSWITCH		2000000
+#define USEC_PER_SWITCH	50
+
+typedef struct {
+	int id, prio;
+	bool stopped;
+	u64_t deadline;
+	u4_t *wakeup_test;
+} task_t;
+
+static task_t tasks[RUNQ_MAX_IDS];
+static int ntasks;
+static u4_t wu_done[RUNQ_MAX_IDS];	// like shmem ipc->done[], set by another process
+static u64_t now;		// simulated time, usec
+
+// original: per priority linked list, here an array in the same order
+static int prio_list[NPRIO][RUNQ_MAX_IDS], prio_count[NPRIO], last_run[NPRIO];
+
+static runq_t runq;
+static theap_t timers;
+
+// random numbers are precomputed so random() isn't part of the timing
+#define NRAND		(64*1024)
+static u4_t rand_tab[NRAND], rand_idx;
+
+static u4_t rnd()
+{
+	return rand_tab[rand_idx++ & (NRAND-1)];
+}
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec);
+}
+
+static void setup(int n)
+{
+	ntasks = n;
+	now = 0;
+	memset(prio_count, 0, sizeof(prio_count));
+	runq_init(&runq);
+	theap_init(&timers);
+	srandom(1);
+	for (int i=0; i < NRAND; i++) rand_tab[i] = random();
+	rand_idx = 0;
+
+	for (int i=0; i < n; i++) {
+		task_t *t = &tasks[i];
+		t->id = i;
+		t->prio = i % NPRIO;
+		t->stopped = false;
+		t->deadline = 0;
+		t->wakeup_test = NULL;
+		prio_list[t->prio][prio_count[t->prio]++] = i;
+		runq_set(&runq, t->prio, i);
+	}
+	for (int p=0; p < NPRIO; p++) last_run[p] = -1;
+}
+
+// After running: sleep on a deadline or, 1 in 8, on a wakeup test.
+// Sleep time scales with the task count so a few tasks are runnable at any time
+// and both versions do the same (non-idle) work per switch whatever the count.
+static u64_t sleep_time()
+{
+	return 1 + rnd() % (ntasks * 2 * USEC_PER_SWITCH);
+}
+
+static void sleep_old(task_t *t)
+{
+	t->stopped = true;
+	if ((rnd() & 7) == 0) {
+		wu_done[t->id] = 0;
+		t->wakeup_test = &wu_done[t->id];
+	} else
+		t->deadline = now + sleep_time();
+}
+
+static idmap_t waiters;
+
+static void sleep_new(task_t *t)
+{
+	t->stopped = true;
+	runq_clr(&runq, t->prio, t->id);
+	if ((rnd() & 7) == 0) {
+		wu_done[t->id] = 0;
+		t->wakeup_test = &wu_done[t->id];
+		idmap_set(&waiters, t->id);
+	} else
+		theap_set(&timers, t->id, now + sleep_time());
+}
+
+static int next_old()
+{
+	for (int p = NPRIO-1; p >= 0; p--) {
+		int runnable = 0;
+		for (int i=0; i < prio_count[p]; i++) {
+			task_t *t = &tasks[prio_list[p][i]];
+			if (t->deadline > 0) {
+				if (t->deadline <= now) { t->deadline = 0; t->stopped = false; }
+			} else
+			if (t->wakeup_test != NULL) {
+				if (*t->wakeup_test != 0) { t->wakeup_test = NULL; t->stopped = false; }
+			}
+			if (!t->stopped) runnable++;
+		}
+		if (!runnable) continue;
+		int start = last_run[p] + 1, n = prio_count[p];
+		for (int i=0; i < n; i++) {
+			int idx = (start + i) % n;
+			if (!tasks[prio_list[p][idx]].stopped) {
+				last_run[p] = idx;
+				return prio_list[p][idx];
+			}
+		}
+	}
+	return -1;
+}
+
+static int next_new()
+{
+	int id;
+	while ((id = theap_expired(&timers, now)) >= 0) {
+		theap_del(&timers, id);
+		tasks[id].stopped = false;
+		runq_set(&runq, tasks[id].prio, id);
+	}
+	
+	// only the tasks waiting on a test are polled
+	for (id = idmap_next(&waiters, -1); id >= 0; id = idmap_next(&waiters, id)) {
+		task_t *t = &tasks[id];
+		if (*t->wakeup_test == 0) continue;
+		t->wakeup_test = NULL;
+		t->stopped = false;
+		idmap_clr(&waiters, id);
+		runq_set(&runq, t->prio, id);
+	}
+	int p = runq_highest(&runq, NPRIO);
+	if (p < 0) return -1;
+	id = idmap_next_wrap(&runq.q[p], last_run[p]);
+	last_run[p] = id;
+	return id;
+}
+
+static double run(int n, bool use_new, u4_t *idle)
+{
+	struct rusage start, finish;
+	setup(n);
+	memset(&waiters, 0, sizeof(waiters));
+	*idle = 0;
+	getrusage(RUSAGE_SELF, &start);
+
+	for (int x=0; x < NSWITCH; x++) {
+		now += USEC_PER_SWITCH;
+		if ((x & 63) == 0)
+			for (int i=0; i < n; i++) wu_done[i] = 1;
+		int id = use_new? next_new() : next_old();
+		if (id < 0) { (*idle)++; continue; }
+		if (use_new) sleep_new(&tasks[id]); else sleep_old(&tasks[id]);
+	}
+
+	getrusage(RUSAGE_SELF, &finish);
+	return cpu_secs(&start, &finish) / NSWITCH * 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	static const int ntask[] = { 20, 30, 40, 50, 60, 100, 150, 200 };
+
+	printf("tasks   old ns/switch   new ns/switch   idle%%\n");
+	for (int i=0; i < (int) ARRAY_LEN(ntask); i++) {
+		u4_t idle_old, idle_new;
+		double t_old = run(ntask[i], false, &idle_old);
+		double t_new = run(ntask[i], true, &idle_new);
+		printf("%5d   %13.1f   %13.1f   %4.1f %4.1f\n", ntask[i], t_old, t_new,
+			100.0 * idle_old / NSWITCH, 100.0 * idle_new / NSWITCH);
+	}
+	return 0;
+}
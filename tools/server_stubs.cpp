@@ -0,0 +1,129 @@
+// Stand-ins for what the server sources linked into the tools use from the rest of the server:
+// logging, panic, kiwi_malloc, tasks, timers, child processes, string encoding and the mode tables.
+// Linked through MORE in the Makefile. Stand-ins that only make sense for one tool stay in that tool.
+
+#include "types.h"
+#include "config.h"
+#include "kiwi.h"
+#include "misc.h"
+#include "str.h"
+#include "printf.h"
+#include "coroutines.h"
+#include "timer.h"
+#include "eeprom.h"
+#include "non_block.h"
+#include "mongoose.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+int print_stats;
+
+const char *modu_s[N_MODE] = { "AM", "AMN", "USB", "LSB", "CW", "CWN", "NBFM", "IQ", "DRM", "USN", "LSN" };
+const int mode_hbw[N_MODE] = { 9800/2, 5000/2, 2400/2, 2400/2, 400/2, 60/2, 12000/2, 10000/2, 10000/2, 2100/2, 2100/2 };
+const int mode_offset[N_MODE] = { 0, 0, 1500, -1500, 0, 0, 0, 0, 0, 1350, -1350 };
+
+// zeroed like the real one
+void *kiwi_malloc(const char *from, size_t size) { return calloc(1, size); }
+void *kiwi_realloc(const char *from, void *ptr, size_t size) { return realloc(ptr, size); }
+void kiwi_free(const char *from, void *ptr) { free(ptr); }
+
+void lprintf(const char *fmt, ...) { va_list ap; va_start(ap, fmt); vprintf(fmt, ap); va_end(ap); }
+void real_printf(const char *fmt, ...) { va_list ap; va_start(ap, fmt); vprintf(fmt, ap); va_end(ap); }
+void alt_printf(const char *fmt, ...) { va_list ap; va_start(ap, fmt); vprintf(fmt, ap); va_end(ap); }
+
+// _exit() since it can be called from a child process or a thread
+void _panic(const char *str, bool core, const char *file, int line)
+{
+	printf("PANIC: %s %s:%d\n", str, file, line);
+	fflush(stdout);
+	_exit(-1);
+}
+void _sys_panic(const char *str, const char *file, int line) { _panic(str, false, file, line); }
+
+// weak: a tool that runs tasks (gps_chan_test) brings its own scheduler
+#ifdef DEBUG
+ __attribute__((weak)) void _NextTask(const char *s, u4_t param, u_int64_t pc) {}
+#else
+ __attribute__((weak)) void _NextTask(u4_t param) {}
+#endif
+__attribute__((weak)) int _CreateTask(funcP_t entry, const char *name, void *param, int priority, u4_t flags, int f_arg) { return 0; }
+__attribute__((weak)) void *_TaskSleep(const char *reason, int usec, u4_t *wakeup_test) { return NULL; }
+
+u4_t timer_sec() { return time(NULL); }
+u4_t timer_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+u4_t timer_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+int utc_time_since_2018() { return 0; }
+
+// like support/non_block.cpp: NO_WAIT returns the pid, otherwise waits and returns the status
+void child_exit(int rv) { _exit(rv); }
+int child_task(const char *pname, funcP_t func, int poll_msec, void *param)
+{
+	int status;
+	pid_t pid = fork();
+	if (pid == 0) { func(param); child_exit(EXIT_SUCCESS); }
+	if (poll_msec == NO_WAIT) return pid;
+	waitpid(pid, &status, 0);
+	return status;
+}
+
+int qsort_floatcomp(const void *elem1, const void *elem2)
+{
+	float f1 = *(const float *) elem1, f2 = *(const float *) elem2;
+	return (f1 < f2)? -1 : ((f1 > f2)? 1 : 0);
+}
+
+int eeprom_check() { return 0; }
+void cfg_adm_transition() {}
+
+char *kiwi_overlap_strcpy(char *dst, const char *src) { return (char *) memmove(dst, src, strlen(src) + 1); }
+char *kiwi_strncpy(char *dst, const char *src, size_t n) { strncpy(dst, src, n); dst[n-1] = '\0'; return dst; }
+
+// only ' ' needs encoding in the strings the tools use
+void mg_url_encode(const char *src, char *dst, size_t dst_len)
+{
+	for (; *src && dst_len > 3; src++) {
+		if (*src == ' ') { strcpy(dst, "%20"); dst += 3; dst_len -= 3; } else { *dst++ = *src; dst_len--; }
+	}
+	*dst = '\0';
+}
+int mg_url_decode(const char *src, int src_len, char *dst, int dst_len, int is_form_url_encoded)
+{
+	int i, j;
+	for (i = j = 0; i < src_len && j < dst_len - 1; i++, j++) {
+		if (src[i] == '%' && i + 2 < src_len + 1 && strncmp(&src[i], "%20", 3) == 0) { dst[j] = ' '; i += 2; } else dst[j] = src[i];
+	}
+	dst[j] = '\0';
+	return j;
+}
+char *kiwi_str_encode(char *src)
+{
+	if (src == NULL) src = (char *) "";
+	size_t slen = strlen(src) * 3 + 1;
+	char *dst = (char *) malloc(slen);
+	mg_url_encode(src, dst, slen);
+	return dst;
+}
+char *kiwi_str_decode_inplace(char *src)
+{
+	if (src == NULL) return NULL;
+	int slen = strlen(src);
+	mg_url_decode(src, slen, src, slen + 1, 0);
+	return src;
+}
+void kiwi_str_unescape_quotes(char *str) {}
@@ -0,0 +1,200 @@
+// Benchmark of the audio DSP capacity: how many receiver channels the SND workers keep up with
+// before a block misses its deadline, i.e. before audio drops.
+// Each channel runs the passband FIR (CFastFIR) and AGC (CAgc) on one FASTFIR_OUTBUF_SIZE block
+// per block period at the audio rate, like snd_dsp() in the kiwi.snd-NN processes.
+// Workers are pinned one per core from core 1 and channels spread by rx_chan % workers, like
+// c2s_sound_init(). "0 workers" is everything in one process (no MULTI_CORE).
+// For each worker count the channel count is raised until a block is late.
+//
+// make UTIL=snd_bench run
+// make UTIL=snd_bench ARGS="-r 20250 -t 10" run    (audio rate, secs per channel count)
+
+#include "types.h"
+#include "kiwi.h"
+#include "datatypes.h"
+#include "cuteSDR.h"
+#include "fastfir.h"
+#include "agc.h"
+#include "ext_int.h"
+#include "fft_plan.h"
+#include "rx_sound.h"
+#include "misc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <math.h>
+#include <sys/wait.h>
+
+#define NCH_MAX		1024
+#define WARMUP		8			// blocks not checked while the workers start up
+
+// stand-ins for what the DSP uses from the rest of the server, see also server_stubs.cpp
+ext_users_t ext_users[MAX_RX_CHANS];
+int snd_rate;
+
+static int ncpu, srate, nblk_run;
+static double period_us;
+static TYPECPX in_samps[FASTFIR_OUTBUF_SIZE];
+
+static u64_t now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void pin(int cpu)
+{
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(cpu % ncpu, &cpu_set);
+	sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+}
+
+typedef struct {
+	CFastFIR *fir;
+	CAgc agc;
+	TYPECPX f_samps[FASTFIR_OUTBUF_SIZE];
+	TYPEMONO16 a_samps[FASTFIR_OUTBUF_SIZE];
+} chan_t;
+
+// the channels rx_chan % nw == w, -1 for all of them
+static chan_t *chans_setup(int nch, int nw, int w)
+{
+	chan_t *chans = new chan_t[nch];
+	for (int ch = 0; ch < nch; ch++) {
+		if (w >= 0 && ch % nw != w) { chans[ch].fir = NULL; continue; }
+		chans[ch].fir = new CFastFIR();
+		chans[ch].fir->SetupParameters(300, 2700, 0, srate);		// USB
+		chans[ch].agc.SetParameters(true, false, -100, 50, 6, 1000, srate);
+	}
+	return chans;
+}
+
+static void chans_block(chan_t *chans, int nch)
+{
+	for (int ch = 0; ch < nch; ch++) {
+		chan_t *c = &chans[ch];
+		if (c->fir == NULL) continue;
+		int ns_out = c->fir->ProcessData(ch % MAX_RX_CHANS, FASTFIR_OUTBUF_SIZE, in_samps, c->f_samps);
+		if (ns_out) c->agc.ProcessData(ns_out, c->f_samps, c->a_samps, false);
+	}
+}
+
+// a block is dropped when its DSP isn't done by the time the next block is due
+static bool run(int nch, int nw, double *busy_pct, double *worst_ms)
+{
+	int w, go[N_SND_WORKERS][2], done[N_SND_WORKERS][2];
+	pid_t pid[N_SND_WORKERS];
+	chan_t *chans = NULL;
+	char c = 0;
+
+	if (nw == 0) {
+		chans = chans_setup(nch, 1, -1);
+	} else {
+		for (w = 0; w < nw; w++) {
+			if (pipe(go[w]) < 0 || pipe(done[w]) < 0) { perror("pipe"); exit(-1); }
+			if ((pid[w] = fork()) == 0) {
+				pin(1 + w % (ncpu > 1? ncpu-1 : 1));
+				chan_t *wchans = chans_setup(nch, nw, w);
+				while (read(go[w][0], &c, 1) == 1 && c == 0) {
+					chans_block(wchans, nch);
+					if (write(done[w][1], &c, 1) != 1) break;
+				}
+				_exit(0);
+			}
+		}
+	}
+
+	int drops = 0;
+	u64_t busy = 0, worst = 0, due = now_us();
+	for (int blk = 0; blk < nblk_run; blk++) {
+		due += period_us;
+		u64_t start = now_us();
+		if (nw == 0) {
+			chans_block(chans, nch);
+		} else {
+			for (w = 0; w < nw; w++) if (write(go[w][1], &c, 1) != 1) exit(-1);
+			for (w = 0; w < nw; w++) if (read(done[w][0], &c, 1) != 1) exit(-1);
+		}
+		u64_t end = now_us();
+		if (blk < WARMUP) { due = end + period_us; continue; }
+		busy += end - start;
+		if (end - start > worst) worst = end - start;
+		if (end > due) {
+			drops++;
+			due = end;
+		} else {
+			struct timespec ts = { (time_t) (due / 1000000), (long) (due % 1000000) * 1000 };
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		}
+	}
+
+	if (nw == 0) {
+		for (int ch = 0; ch < nch; ch++) delete chans[ch].fir;
+		delete[] chans;
+	} else {
+		c = 1;		// stop, every worker holds the others' pipe ends so there's no EOF
+		for (w = 0; w < nw; w++) {
+			if (write(go[w][1], &c, 1) != 1) exit(-1);
+			waitpid(pid[w], NULL, 0);
+			close(go[w][1]);
+			close(go[w][0]); close(done[w][0]); close(done[w][1]);
+		}
+	}
+
+	*busy_pct = 100.0 * busy / ((nblk_run - WARMUP) * period_us);
+	*worst_ms = worst / 1e3;
+	return drops == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	double secs = 5;
+	srate = 12000;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-r") == 0 && i+1 < argc) srate = atoi(argv[++i]);
+		if (strcmp(argv[i], "-t") == 0 && i+1 < argc) secs = atof(argv[++i]);
+	}
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	snd_rate = srate;
+	period_us = 1e6 * FASTFIR_OUTBUF_SIZE / srate;
+	nblk_run = WARMUP + secs * 1e6 / period_us;
+	fft_plan_init(FFTW_ESTIMATE);
+
+	// carrier 1 kHz up plus noise, the same block over and over
+	srandom(1);
+	for (int i = 0; i < FASTFIR_OUTBUF_SIZE; i++) {
+		double ph = K_2PI * 1000 * i / srate;
+		in_samps[i].re = 1000 * cos(ph) + (random() % 200) - 100;
+		in_samps[i].im = 1000 * sin(ph) + (random() % 200) - 100;
+	}
+
+	printf("%d cores, %d Hz audio, block %d samples every %.1f ms, %.0f s per channel count\n",
+		ncpu, srate, FASTFIR_OUTBUF_SIZE, period_us / 1e3, secs);
+	int nw_max = MIN(MAX(ncpu - 1, 1), N_SND_WORKERS);
+	for (int nw = 0; nw <= nw_max; nw++) {
+		double busy, worst;
+		int good = 0, bad = 0;
+
+		// double until a block is late, then bisect
+		for (int nch = 1; nch <= NCH_MAX; nch *= 2) {
+			if (run(nch, nw, &busy, &worst)) good = nch; else { bad = nch; break; }
+		}
+		while (bad && bad - good > 1) {
+			int nch = (good + bad) / 2;
+			if (run(nch, nw, &busy, &worst)) good = nch; else bad = nch;
+		}
+		run(good, nw, &busy, &worst);
+		printf("%d worker%s: max %4d chans%s, block %5.1f%% busy, worst %.2f ms (%.1f us per channel)\n",
+			nw, (nw == 1)? " " : "s", good, bad? "" : "+", busy, worst, busy / 100 * period_us / (good? good : 1));
+	}
+	return 0;
+}
@@ -1,4 +1,10 @@
-/* Test viterbi decoder speeds */
+/* Test viterbi decoder speeds
+ * Without -e: time trials of the portable butterflies against the SIMD ones
+ * update_viterbi27_blk() picks at run time, and a check that both give the
+ * same metrics, decisions and decoded data on random soft symbols
+ *
+ * make UTIL=viterbi27_test ARGS="-l 120 -n 100000" run
+ */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,6 +20,7 @@
 #endif
 
 #include "fec.h"
+#include "viterbi27.h"
 
 #define	MAX_RANDOM	0x7fffffff
 
@@ -205,24 +212,68 @@ printf("\n");
 
   } else {
     /* Do time trials */
-    memset(symbols,127,sizeof(symbols));
-    printf("Starting time trials\n");
-    getrusage(RUSAGE_SELF,&start);
-    for(tr=0;tr < trials;tr++){
-      /* Initialize Viterbi decoder */
-      init_viterbi27_port(vp,0);
+    static const char *mode_s[] = { "unknown", "port", "mmx", "sse", "sse2", "altivec", "neon" };
+    double speed[2];
+    void *vp2;
+
+    find_cpu_mode();
+    if((vp2 = create_viterbi27(framebits)) == NULL){
+      printf("create_viterbi27 failed\n");
+      exit(1);
+    }
+    for(i=0;i<2*(framebits+6);i++)
+      symbols[i] = random() & 255;
+
+    printf("Starting time trials, run time selection: %s\n",mode_s[Cpu_mode]);
+    for(int simd=0;simd < 2;simd++){
+      getrusage(RUSAGE_SELF,&start);
+      for(tr=0;tr < trials;tr++){
+        /* Initialize Viterbi decoder */
+        init_viterbi27_port(vp,0);
       
-      /* Decode block */
-      update_viterbi27_blk_port(vp,symbols,framebits);
+        /* Decode block */
+        if(simd)
+          update_viterbi27_blk(vp,symbols,framebits);
+        else
+          update_viterbi27_blk_port(vp,symbols,framebits);
       
-      /* Do Viterbi chainback */
+        /* Do Viterbi chainback */
+        chainback_viterbi27_port(vp,data,framebits,0);
+      }
+      getrusage(RUSAGE_SELF,&finish);
+      extime = finish.ru_utime.tv_sec - start.ru_utime.tv_sec + 1e-6*(finish.ru_utime.tv_usec - start.ru_utime.tv_usec);
+      speed[simd] = trials*framebits/extime;
+      printf("Viterbi27 %s execution time for %d %d-bit frames: %.2f sec\n",simd? mode_s[Cpu_mode] : "port",trials,
+	     framebits,extime);
+      printf("decoder speed: %g bits/s\n",speed[simd]);
+    }
+    printf("speedup %.2fx\n",speed[1]/speed[0]);
+
+    /* Same metrics, decisions and data from both on random frames */
+    int diffs = 0;
+    for(tr=0;tr < trials && tr < 10000;tr++){
+      struct v27 *v0 = (struct v27 *) vp, *v1 = (struct v27 *) vp2;
+
+      for(i=0;i<2*(framebits+6);i++)
+        symbols[i] = random() & 255;
+      init_viterbi27_port(vp,0);
+      init_viterbi27(vp2,0);
+      memset(v0->decisions,0,(framebits+6)*sizeof(decision_t));
+      memset(v1->decisions,0,(framebits+6)*sizeof(decision_t));
+      update_viterbi27_blk_port(vp,symbols,framebits+6);
+      update_viterbi27_blk(vp2,symbols,framebits+6);
       chainback_viterbi27_port(vp,data,framebits,0);
+      chainback_viterbi27(vp2,xordata,framebits,0);
+
+      if(memcmp(v0->old_metrics,v1->old_metrics,sizeof(metric_t)) != 0 ||
+         memcmp(v0->decisions,v1->decisions,(framebits+6)*sizeof(decision_t)) != 0 ||
+         memcmp(data,xordata,framebits/8) != 0)
+        diffs++;
     }
-    getrusage(RUSAGE_SELF,&finish);
-    extime = finish.ru_utime.tv_sec - start.ru_utime.tv_sec + 1e-6*(finish.ru_utime.tv_usec - start.ru_utime.tv_usec);
-    printf("Viterbi27 execution time for %d %d-bit frames: %.2f sec\n",trials,
-	   framebits,extime);
-    printf("decoder speed: %g bits/s\n",trials*framebits/extime);
+    printf("%d of %d random frames differ between port and %s\n",diffs,tr,mode_s[Cpu_mode]);
+    delete_viterbi27(vp2);
+    if(diffs)
+      exit(1);
   }
   exit(0);
 }
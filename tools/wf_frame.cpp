@@ -0,0 +1,122 @@
+// Benchmark of the waterfall compute_frame() power/bin-collapse/dB pipeline:
+// the original scalar log10f() code versus the support/simd.cpp kernels.
+// Synthetic FFT output, zoom 0 geometry (4096 fft bins -> 1024 plot bins).
+//
+// make UTIL=wf_frame run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../types.h"
+#include "simd.h"
+
+#define WF_WIDTH	1024
+#define FFT_USED	4096
+#define NFRAMES		20000
+
+static fftwf_complex fft[FFT_USED];
+static float fft_scale[WF_WIDTH];
+static u2_t fft2wf_map[FFT_USED];
+static u2_t run_bin[WF_WIDTH+1], run_len[WF_WIDTH+1];
+static int n_runs;
+
+static double cpu_secs(struct rusage *start, struct rusage *finish)
+{
+	return finish->ru_utime.tv_sec - start->ru_utime.tv_sec +
+		1e-6 * (finish->ru_utime.tv_usec - start->ru_utime.tv_usec);
+}
+
+// the code compute_frame() used before the simd kernels
+static void frame_scalar(u1_t *bp)
+{
+	int i, bin, _bin = -1;
+	float pwr[FFT_USED], p, dB, pwr_out_peak[WF_WIDTH];
+
+	for (i=0; i < FFT_USED; i++) {
+		float re = fft[i][0], im = fft[i][1];
+		pwr[i] = re*re + im*im;
+	}
+	pwr[0] = pwr[1] = 0;
+	memset(pwr_out_peak, 0, sizeof(pwr_out_peak));
+
+	for (i=0; i < FFT_USED; i++) {
+		p = pwr[i];
+		bin = fft2wf_map[i];
+		if (bin == _bin) {
+			if (p > pwr_out_peak[bin]) pwr_out_peak[bin] = p;
+		} else {
+			pwr_out_peak[bin] = p;
+			_bin = bin;
+		}
+	}
+
+	for (i=0; i < WF_WIDTH; i++) {
+		dB = 10.0 * log10f(pwr_out_peak[i] * fft_scale[i] + (float) 1e-30) - 0.8;
+		if (dB > 0) dB = 0;
+		if (dB < -200.0) dB = -200.0;
+		dB--;
+		*bp++ = (u1_t) (int) dB;
+	}
+}
+
+static void frame_simd(u1_t *bp)
+{
+	float pwr[FFT_USED], pwr_out_peak[WF_WIDTH];
+
+	simd_mag2_cf(FFT_USED, fft, pwr);
+	pwr[0] = pwr[1] = 0;
+	memset(pwr_out_peak, 0, sizeof(pwr_out_peak));
+	simd_bin_reduce(n_runs, run_bin, run_len, pwr, pwr_out_peak, NULL);
+	simd_pwr2dB_u8(WF_WIDTH, pwr_out_peak, fft_scale, -0.8, bp);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, f, diffs = 0;
+	u1_t out_scalar[WF_WIDTH], out_simd[WF_WIDTH];
+	struct rusage start, finish;
+
+	srandom(1);
+	float maxmag = FFT_USED/2;
+	for (i=0; i < WF_WIDTH; i++)
+		fft_scale[i] = 5.0 / (maxmag * maxmag);
+	for (i=0; i < FFT_USED; i++) {
+		// noise floor spanning ~100 dB plus a few carriers
+		float a = powf(10, (random() % 5000) / 1000.0 - 3);
+		if ((i % 317) == 0) a *= 1e4;
+		fft[i][0] = a * cosf(i);
+		fft[i][1] = a * sinf(i);
+		fft2wf_map[i] = WF_WIDTH * i / FFT_USED;
+	}
+	for (i=0; i < FFT_USED; i++) {
+		if (n_runs == 0 || run_bin[n_runs-1] != fft2wf_map[i]) {
+			run_bin[n_runs] = fft2wf_map[i];
+			run_len[n_runs++] = 0;
+		}
+		run_len[n_runs-1]++;
+	}
+
+	frame_scalar(out_scalar);
+	frame_simd(out_simd);
+	for (i=0; i < WF_WIDTH; i++)
+		if (out_scalar[i] != out_simd[i]) diffs++;
+	printf("output bytes differing: %d/%d\n", diffs, WF_WIDTH);
+
+	getrusage(RUSAGE_SELF, &start);
+	for (f=0; f < NFRAMES; f++) frame_scalar(out_scalar);
+	getrusage(RUSAGE_SELF, &finish);
+	double t_scalar = cpu_secs(&start, &finish);
+
+	getrusage(RUSAGE_SELF, &start);
+	for (f=0; f < NFRAMES; f++) frame_simd(out_simd);
+	getrusage(RUSAGE_SELF, &finish);
+	double t_simd = cpu_secs(&start, &finish);
+
+	printf("scalar %.0f frames/sec/core, simd %.0f frames/sec/core, speedup %.2fx\n",
+		NFRAMES / t_scalar, NFRAMES / t_simd, t_scalar / t_simd);
+	return 0;
+}
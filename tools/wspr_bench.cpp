@@ -0,0 +1,375 @@
+// Benchmark of the WSPR decoder on the recorded test vector (wspr.wav.h, one 2 minute capture at 375 Hz).
+// First sync_and_demodulate() as it was (double precision cos/sin recursions for every symbol of every call)
+// versus the cached float tone oscillator tables, on the calls one candidate makes, with the soft symbols compared.
+// Then wspr_decode() on several channels at once (autorun on several bands) as separate decode processes,
+// like kiwi.wspr-NN, without the pool of workers and with 1 .. cores-1 workers (the pool leaves
+// core 0 to the server): decodes found versus wall time, to see how the pool scales with cores.
+//
+// make UTIL=wspr_bench run
+// make UTIL=wspr_bench ARGS="-t 30 -c 4" run    (decode time limit, max channels)
+
+#include "types.h"
+#include "datatypes.h"
+#include "wspr.h"
+#include "shmem.h"
+#include "cfg.h"
+#include "misc.h"
+#include "fft_plan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define WSPR_DEMO_NSAMPS 45000
+
+static TYPECPX wspr_demo_samps[WSPR_DEMO_NSAMPS] = {
+	#include "wspr.wav.h"
+};
+
+#define NCH_MAX		4
+
+shmem_t *shmem;
+int rx_chans;
+int nffts, nbins_411, hbins_205;
+cfg_t cfg_cfg;
+wspr_conf_t wspr_c;
+
+// stand-ins for what the decoder uses from the rest of the server not in server_stubs.cpp
+void kiwi_usleep(u4_t usec) { usleep(usec); }
+char *stprintf(const char *fmt, ...) { static char s[64]; va_list ap; va_start(ap, fmt); vsnprintf(s, sizeof(s), fmt, ap); va_end(ap); return s; }
+void _cfg_default_object(cfg_t *cfg, const char *name, const char *val, bool *error) {}
+int _cfg_default_int(cfg_t *cfg, const char *name, int val, bool *error) { return val; }
+void _cfg_default_string(cfg_t *cfg, const char *name, const char *val, bool *error) {}
+const char *_cfg_string(cfg_t *cfg, const char *name, bool *error, u4_t flags) { return ""; }
+void _cfg_free(cfg_t *cfg, const char *str) {}
+bool _cfg_default_bool(cfg_t *cfg, const char *name, u4_t val, bool *error) { return val; }
+void grid_to_latLon(char *grid, latLon_t *loc) { loc->lat = loc->lon = 999.0; }
+void time_hour_min_sec(time_t t, int *hour, int *min, int *sec) { *hour = *min = 0; if (sec) *sec = 0; }
+
+void set_cpu_affinity(int cpu)
+{
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(cpu, &cpu_set);
+	sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set);
+}
+
+// the decode processes, the pool workers are in WSPR_SHMEM->pool.pid[]
+static pid_t pids[NCH_MAX];
+static int npids;
+
+static double secs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// sync_and_demodulate() as it was
+static const unsigned char pr3[NSYM_162]=
+{1,1,0,0,0,0,0,0,1,0,0,0,1,1,1,0,0,0,1,0,
+    0,1,0,1,1,1,1,0,0,0,0,0,0,0,1,0,0,1,0,1,
+    0,0,0,0,0,0,1,0,1,1,0,0,1,1,0,1,0,0,0,1,
+    1,0,1,0,0,0,0,1,1,0,1,0,1,0,1,0,1,0,0,1,
+    0,0,1,0,1,1,0,0,0,1,1,0,1,0,1,0,0,0,1,0,
+    0,0,0,0,1,0,0,1,0,0,1,1,1,0,1,1,0,0,1,1,
+    0,1,0,0,0,1,1,1,0,0,0,0,0,1,0,1,0,0,1,1,
+    0,0,0,0,0,0,0,1,1,0,1,0,1,1,0,0,0,1,1,0,
+    0,0};
+
+static void ref_sync_and_demodulate(
+	float *id, float *qd, long np,
+	unsigned char *symbols, float *f1, int ifmin, int ifmax, float fstep,
+	int *shift1,
+	int lagmin, int lagmax, int lagstep,
+	float drift1, int symfac, float *sync, wspr_mode_e mode)
+{
+    static float fplast=-10000.0;
+    static float dt=1.0/FSRATE, df=FSRATE/FSPS;
+    static float pi=K_PI;
+    float twopidt, df15=df*1.5, df05=df*0.5;
+
+    int i, j, k, lag;
+    float i0[NSYM_162], q0[NSYM_162], i1[NSYM_162], q1[NSYM_162],
+		i2[NSYM_162], q2[NSYM_162], i3[NSYM_162], q3[NSYM_162];
+    double p0, p1, p2, p3, cmet, totp, syncmax, fac;
+    double c0[SPS], s0[SPS], c1[SPS], s1[SPS], c2[SPS], s2[SPS], c3[SPS], s3[SPS];
+    double dphi0, cdphi0, sdphi0, dphi1, cdphi1, sdphi1, dphi2, cdphi2, sdphi2, dphi3, cdphi3, sdphi3;
+    float f0=0.0, fp, ss, fbest=0.0, fsum=0.0, f2sum=0.0, fsymb[NSYM_162];
+    int best_shift = 0, ifreq;
+
+    syncmax=-1e30;
+    if (mode == FIND_BEST_TIME_LAG) { ifmin=0; ifmax=0; fstep=0.0; }
+    if (mode == FIND_BEST_FREQ)     { lagmin=*shift1; lagmax=*shift1; }
+    if (mode == CALC_SOFT_SYMS)     { lagmin=*shift1; lagmax=*shift1; ifmin=0; ifmax=0; }
+
+    twopidt=2*pi*dt;
+    for(ifreq=ifmin; ifreq<=ifmax; ifreq++) {
+        f0=*f1+ifreq*fstep;
+        for(lag=lagmin; lag<=lagmax; lag=lag+lagstep) {
+            ss=0.0;
+            totp=0.0;
+            for (i=0; i<NSYM_162; i++) {
+                fp = f0 + (drift1/2.0)*((float)i-FHSYM_81)/FHSYM_81;
+                if( i==0 || (fp != fplast) ) {
+                    dphi0=twopidt*(fp-df15); cdphi0=cos(dphi0); sdphi0=sin(dphi0);
+                    dphi1=twopidt*(fp-df05); cdphi1=cos(dphi1); sdphi1=sin(dphi1);
+                    dphi2=twopidt*(fp+df05); cdphi2=cos(dphi2); sdphi2=sin(dphi2);
+                    dphi3=twopidt*(fp+df15); cdphi3=cos(dphi3); sdphi3=sin(dphi3);
+                    c0[0]=1; s0[0]=0; c1[0]=1; s1[0]=0; c2[0]=1; s2[0]=0; c3[0]=1; s3[0]=0;
+                    for (j=1; j<SPS; j++) {
+                        c0[j]=c0[j-1]*cdphi0 - s0[j-1]*sdphi0; s0[j]=c0[j-1]*sdphi0 + s0[j-1]*cdphi0;
+                        c1[j]=c1[j-1]*cdphi1 - s1[j-1]*sdphi1; s1[j]=c1[j-1]*sdphi1 + s1[j-1]*cdphi1;
+                        c2[j]=c2[j-1]*cdphi2 - s2[j-1]*sdphi2; s2[j]=c2[j-1]*sdphi2 + s2[j-1]*cdphi2;
+                        c3[j]=c3[j-1]*cdphi3 - s3[j-1]*sdphi3; s3[j]=c3[j-1]*sdphi3 + s3[j-1]*cdphi3;
+                    }
+                    fplast = fp;
+                }
+                i0[i]=0.0; q0[i]=0.0; i1[i]=0.0; q1[i]=0.0; i2[i]=0.0; q2[i]=0.0; i3[i]=0.0; q3[i]=0.0;
+                for (j=0; j<SPS; j++) {
+                    k=lag+i*SPS+j;
+                    if( (k>0) && (k<np) ) {
+                        i0[i]=i0[i] + id[k]*c0[j] + qd[k]*s0[j]; q0[i]=q0[i] - id[k]*s0[j] + qd[k]*c0[j];
+                        i1[i]=i1[i] + id[k]*c1[j] + qd[k]*s1[j]; q1[i]=q1[i] - id[k]*s1[j] + qd[k]*c1[j];
+                        i2[i]=i2[i] + id[k]*c2[j] + qd[k]*s2[j]; q2[i]=q2[i] - id[k]*s2[j] + qd[k]*c2[j];
+                        i3[i]=i3[i] + id[k]*c3[j] + qd[k]*s3[j]; q3[i]=q3[i] - id[k]*s3[j] + qd[k]*c3[j];
+                    }
+                }
+                p0=sqrt(i0[i]*i0[i] + q0[i]*q0[i]); p1=sqrt(i1[i]*i1[i] + q1[i]*q1[i]);
+                p2=sqrt(i2[i]*i2[i] + q2[i]*q2[i]); p3=sqrt(i3[i]*i3[i] + q3[i]*q3[i]);
+                totp=totp+p0+p1+p2+p3;
+                cmet=(p1+p3)-(p0+p2);
+                ss = (pr3[i] == 1) ? ss+cmet : ss-cmet;
+                if (mode == CALC_SOFT_SYMS) fsymb[i] = (pr3[i]==1)? p3-p1 : p2-p0;
+            }
+            ss=ss/totp;
+            if( ss > syncmax ) { syncmax=ss; best_shift=lag; fbest=f0; }
+        }
+    }
+
+    if (mode == FIND_BEST_TIME_LAG || mode == FIND_BEST_FREQ) { *sync=syncmax; *shift1=best_shift; *f1=fbest; return; }
+    *sync=syncmax;
+    for (i=0; i<NSYM_162; i++) { fsum=fsum+fsymb[i]/FNSYM_162; f2sum=f2sum+fsymb[i]*fsymb[i]/FNSYM_162; }
+    fac=sqrt(f2sum-fsum*fsum);
+    for (i=0; i<NSYM_162; i++) {
+        fsymb[i]=symfac*fsymb[i]/fac;
+        if( fsymb[i] > 127) fsymb[i]=127.0;
+        if( fsymb[i] < -128 ) fsymb[i]=-128.0;
+        symbols[i] = fsymb[i] + 128;
+    }
+}
+
+// the spectra WSPR_FFT() computes during the capture
+static void spectra(wspr_buf_t *wb)
+{
+	int i, j, k;
+	static float window[NFFT];
+	fftwf_complex *in = (fftwf_complex *) fftwf_malloc(sizeof(fftwf_complex) * NFFT);
+	fftwf_complex *out = (fftwf_complex *) fftwf_malloc(sizeof(fftwf_complex) * NFFT);
+	fft_plan_t *plan = fft_plan_dft_1d("WSPR", NFFT, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
+
+	for (i = 0; i < NFFT; i++) window[i] = sin(i * K_PI/(NFFT-1));
+	memset(wb->pwr_sampavg[0], 0, sizeof(wb->pwr_sampavg[0]));
+
+	for (i = 0; i < nffts; i++) {
+		for (j = 0; j < NFFT; j++) {
+			k = i*HSPS+j;
+			in[j][0] = wb->i_data[0][k] * window[j];
+			in[j][1] = wb->q_data[0][k] * window[j];
+		}
+		fft_execute_dft(plan, in, out);
+		for (j = 0; j < NFFT; j++) {
+			k = j+SPS;
+			if (k > (NFFT-1)) k -= NFFT;
+			float pwr = out[k][0]*out[k][0] + out[k][1]*out[k][1];
+			wb->pwr_samp[0][j][i] = pwr;
+			wb->pwr_sampavg[0][j] += pwr;
+		}
+	}
+	fftwf_free(in); fftwf_free(out);
+}
+
+// sync_and_demodulate() calls of a candidate: lag and freq searches, then soft symbols for the DT jiggering
+#define N_CAND 4
+#define N_JIG 65
+
+static void candidate(bool ref, wspr_osc_t *osc, wspr_buf_t *wb, int n, float drift1, unsigned char sym[N_JIG][NSYM_162])
+{
+	float *id = wb->i_data[0], *qd = wb->q_data[0];
+	float f1 = -60 + 40*n, sync1;
+	int shift1 = 256 + 64*n;
+
+	#define SD(...) if (ref) ref_sync_and_demodulate(__VA_ARGS__); else sync_and_demodulate(osc, __VA_ARGS__)
+	SD(id, qd, TPOINTS, sym[0], &f1, 0, 0, 0, &shift1, shift1-128, shift1+128, 64, drift1, 50, &sync1, FIND_BEST_TIME_LAG);
+	SD(id, qd, TPOINTS, sym[0], &f1, -2, 2, 0.25, &shift1, 0, 0, 1, drift1, 50, &sync1, FIND_BEST_FREQ);
+	SD(id, qd, TPOINTS, sym[0], &f1, -2, 2, 0.05, &shift1, shift1-32, shift1+32, 16, drift1, 50, &sync1, FIND_BEST_TIME_LAG);
+	for (int jig = 0; jig < N_JIG; jig++) {
+		int js = shift1 + ((jig&1)? -1:1) * 2*((jig+1)/2);
+		SD(id, qd, TPOINTS, sym[jig], &f1, 0, 0, 0, &js, 0, 0, 1, drift1, 50, &sync1, CALC_SOFT_SYMS);
+	}
+	#undef SD
+}
+
+static void demod_bench(wspr_buf_t *wb)
+{
+	static unsigned char sym[2][N_CAND][N_JIG][NSYM_162];
+	static const float drifts[] = { 0, 1.5 };
+	wspr_osc_t *osc = (wspr_osc_t *) malloc(sizeof(wspr_osc_t));
+	int n, i, j, r;
+
+	for (int d = 0; d < ARRAY_LEN(drifts); d++) {
+		double t[2];
+		memset(osc, 0, sizeof(wspr_osc_t));
+		for (r = 0; r < 2; r++) {
+			double start = secs();
+			for (n = 0; n < N_CAND; n++)
+				candidate(r == 0, osc, wb, n, drifts[d], sym[r][n]);
+			t[r] = secs() - start;
+		}
+
+		int diff = 0, maxdiff = 0;
+		for (n = 0; n < N_CAND; n++)
+			for (j = 0; j < N_JIG; j++)
+				for (i = 0; i < NSYM_162; i++) {
+					int e = abs(sym[0][n][j][i] - sym[1][n][j][i]);
+					if (e) diff++;
+					if (e > maxdiff) maxdiff = e;
+				}
+		printf("sync_and_demodulate drift %.1f: orig %.3f s, tone tables %.3f s, %.1fx  soft symbols differing %d of %d (max %d)\n",
+			drifts[d], t[0], t[1], t[0] / t[1], diff, N_CAND * N_JIG * NSYM_162, maxdiff);
+	}
+	free(osc);
+}
+
+static void stop_children()
+{
+	int i;
+	wspr_pool_t *pool = &WSPR_SHMEM->pool;
+
+	for (i = 0; i < pool->n; i++)
+		if (pool->pid[i]) { kill(pool->pid[i], SIGKILL); waitpid(pool->pid[i], NULL, 0); }
+	for (i = 0; i < npids; i++)
+		if (pids[i]) { kill(pids[i], SIGKILL); waitpid(pids[i], NULL, 0); }
+	npids = 0;
+}
+
+static void decode_chan(void *param)
+{
+	int ch = (int) FROM_VOID_PARAM(param);
+	set_cpu_affinity(1 % sysconf(_SC_NPROCESSORS_ONLN));	// like shmem_child_task()
+	wspr_decode(ch);
+}
+
+// channels decoding the capture at once, decodes found against time
+static void decode_bench(int nch, int nworkers, double limit)
+{
+	int ch, i;
+	#define N_MARK 6
+	static const double marks[N_MARK] = { 1, 2, 5, 10, 20, 60 };
+	int found[N_MARK];
+
+	rx_chans = nch;
+	for (ch = 0; ch < nch; ch++) {
+		wspr_t *w = &WSPR_SHMEM->wspr[ch];
+		w->abort_decode = false;
+		w->uniques = 0;
+		w->send_peaks_seq = w->send_decode_seq = 0;
+		w->next_job = WSPR_JOBS_CLOSED;
+	}
+
+	if (nworkers) {
+		wspr_pool_init(nworkers);
+		wspr_pool_t *pool = &WSPR_SHMEM->pool;
+		for (i = 0; i < pool->n; i++) while (pool->pid[i] == 0) usleep(1000);
+	} else {
+		memset(&WSPR_SHMEM->pool, 0, sizeof(wspr_pool_t));
+	}
+
+	double start = secs(), t_last = 0;
+	for (ch = 0; ch < nch; ch++)
+		pids[npids++] = child_task("decode", decode_chan, NO_WAIT, TO_VOID_PARAM(ch));
+
+	int done = 0, mark = 0, last = 0;
+	while (done < nch) {
+		usleep(2000);
+		double t = secs() - start;
+		int total = 0;
+		for (ch = 0; ch < nch; ch++) total += WSPR_SHMEM->wspr[ch].send_decode_seq;
+		if (total > last) { last = total; t_last = t; }
+		while (mark < N_MARK && t >= marks[mark]) found[mark++] = total;
+		if (t >= limit)
+			for (ch = 0; ch < nch; ch++) WSPR_SHMEM->wspr[ch].abort_decode = true;
+		for (i = 0; i < npids; i++)
+			if (pids[i] && waitpid(pids[i], NULL, WNOHANG) == pids[i]) { pids[i] = 0; done++; }
+	}
+	double t = secs() - start;
+	while (mark < N_MARK) found[mark++] = last;
+	stop_children();
+
+	printf("%d chan %d worker%s: %2d decodes (%2d/chan), last at %5.1f s, done %5.1f s%s  found by",
+		nch, nworkers, (nworkers == 1)? " " : "s", last, last/nch, t_last, t, (t >= limit)? " (aborted)" : "");
+	for (i = 0; i < N_MARK && marks[i] <= limit; i++) printf(" %gs:%d", marks[i], found[i]);
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int i, ch;
+	double limit = 30;
+	int nch_max = NCH_MAX;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i+1 < argc) limit = atof(argv[++i]);
+		if (strcmp(argv[i], "-c") == 0 && i+1 < argc) nch_max = atoi(argv[++i]);
+	}
+
+	nch_max = CLAMP(nch_max, 1, NCH_MAX);
+
+	nffts = FPG * floor(GROUPS-1) -1;
+	nbins_411 = ceilf(NFFT * BW_MAX / FSRATE) +1;
+	hbins_205 = (nbins_411-1)/2;
+
+	shmem = (shmem_t *) mmap(NULL, sizeof(shmem_t), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	assert(shmem != MAP_FAILED);
+	fft_plan_init(FFTW_ESTIMATE);
+	wspr_init();
+
+	for (ch = 0; ch < NCH_MAX; ch++) {
+		wspr_t *w = &WSPR_SHMEM->wspr[ch];
+		w->rx_chan = ch;
+		w->buf = &WSPR_SHMEM->wspr_buf[ch];
+		w->wspr_type = WSPR_TYPE_2MIN;
+		w->dialfreq_MHz = 7.0386;
+		w->bfo = 1500;
+		w->decode_ping_pong = 0;
+		for (i = 0; i < TPOINTS; i++) {
+			w->buf->i_data[0][i] = wspr_demo_samps[i].re;
+			w->buf->q_data[0][i] = wspr_demo_samps[i].im;
+		}
+		spectra(w->buf);
+	}
+
+	demod_bench(WSPR_SHMEM->wspr[0].buf);
+
+	int ncores = sysconf(_SC_NPROCESSORS_ONLN);
+	printf("\ndecoding %d cores, %.0f s limit:\n", ncores, limit);
+	int nw_max = CLAMP(ncores - 1, 1, N_WSPR_WORKERS);
+	for (int nch = 1; nch <= nch_max; nch *= 2) {
+		decode_bench(nch, 0, limit);
+		for (int nw = 1; nw <= nw_max; nw++)
+			decode_bench(nch, nw, limit);
+	}
+
+	wspr_t *w = &WSPR_SHMEM->wspr[0];
+	for (i = 0; i < w->uniques; i++)
+		printf("%s%s", i? ", " : "decoded: ", w->deco[i].c_l_p);
+	printf("\n");
+	return 0;
+}
@@ -1090,6 +1090,13 @@ void c2s_admin(void *param)
 				continue;
 			}
 
+			int ntop;
+			i = sscanf(cmd, "SET malloc_dump=%d", &ntop);
+			if (i == 1) {
+				kiwi_malloc_dump(ntop);
+				continue;
+			}
+
 			i = strcmp(cmd, "SET log_clear_hist");
 			if (i == 0) {
 		        TaskDump(TDUMP_CLR_HIST);
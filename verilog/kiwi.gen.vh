@@ -43,12 +43,12 @@
 `define DEF_FPGA_ID_GPS
 	parameter NUM_CMDS_BASE = 13;    // DEFp 0xd
 `define DEF_NUM_CMDS_BASE
-	parameter NUM_CMDS_GPS = 16;    // DEFp 0x10
+	parameter NUM_CMDS_GPS = 17;    // DEFp 0x11
 `define DEF_NUM_CMDS_GPS
 	parameter NUM_CMDS_SDR = 12;    // DEFp 0xc
 `define DEF_NUM_CMDS_SDR
 //`define CFG_GPS_ONLY    // DEFh 0x0
-	parameter NUM_CMDS = 41;    // DEFp 0x29
+	parameter NUM_CMDS = 42;    // DEFp 0x2a
 `define DEF_NUM_CMDS
 `define SPI_32    // DEFh 0x1
 	parameter SPIBUF_W = 2048;    // DEFp 0x800
@@ -26,7 +26,8 @@ function status_html()
             ),
             w3_div('w3-container',
                w3_div('id-status-dp-hist'),
-               w3_div('id-status-in-hist')
+               w3_div('id-status-in-hist'),
+               w3_div('id-status-in-ring')
             )
          )
       ) : '';
@@ -2326,7 +2327,8 @@ function log_html()
 		   w3_div('',
             w3_label('w3-show-inline', 'KiwiSDR server log (scrollable list, first and last set of messages)') +
             w3_button('w3-aqua|margin-left:10px', 'Dump', 'log_dump_cb') +
-            w3_button('w3-blue|margin-left:10px', 'Clear Histogram', 'log_clear_hist_cb')
+            w3_button('w3-blue|margin-left:10px', 'Clear Histogram', 'log_clear_hist_cb') +
+            w3_button('w3-aqua|margin-left:10px', 'Top Allocators', 'log_malloc_dump_cb')
          ),
 			w3_div('id-log-msg w3-margin-T-8 w3-text-output w3-small w3-text-black', '')
 		)
@@ -2358,6 +2360,11 @@ function log_clear_hist_cb(id, idx)
 	ext_send('SET log_clear_hist');
 }
 
+function log_malloc_dump_cb(id, idx)
+{
+	ext_send('SET malloc_dump=20');
+}
+
 
 function log_resize()
 {
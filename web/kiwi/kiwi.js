@@ -1067,7 +1067,7 @@ function gps_stats_cb(acquiring, tracking, good, fixes, adc_clock, adc_gps_clk_c
 	}
 }
 
-function admin_stats_cb(audio_dropped, underruns, seq_errors, dp_resets, dp_hist_cnt, dp_hist, in_hist_cnt, in_hist)
+function admin_stats_cb(audio_dropped, underruns, seq_errors, dp_resets, dp_hist_cnt, dp_hist, in_hist_cnt, in_hist, in_ring)
 {
    if (audio_dropped == undefined) return;
    
@@ -1095,6 +1095,17 @@ function admin_stats_cb(audio_dropped, underruns, seq_errors, dp_resets, dp_hist
 		}
       el.innerHTML = s;
 	}
+
+   // per-channel overruns/underruns/high-water mark, admin only
+	el = w3_el('id-status-in-ring');
+	if (el && in_ring) {
+	   var s = 'SoundInRing (overrun/underrun/hiwat): ';
+		for (var i = 0; i < in_ring.length; i++) {
+		   var q = in_ring[i];
+		   s += (i? ', ':'') +'rx'+ i +' '+ q.o.toUnits() +'/'+ q.u.toUnits() +'/'+ q.h;
+		}
+      el.innerHTML = s;
+	}
 }
 
 function kiwi_too_busy(rx_chans)
@@ -1669,7 +1680,7 @@ function kiwi_msg(param, ws)
 				   kiwi.GPS_fixes = o.gf;
 				   //console.log('stat kiwi.WSPR_rgrid='+ kiwi.WSPR_rgrid);
 				}
-				admin_stats_cb(o.ad, o.au, o.ae, o.ar, o.an, o.ap, o.an2, o.ai);
+				admin_stats_cb(o.ad, o.au, o.ae, o.ar, o.an, o.ap, o.an2, o.ai, o.aq);
 				time_display_cb(o);
 			} catch(ex) {
 				console.log('<'+ param[1] +'>');
@@ -89,6 +89,7 @@ void web_to_app_done(conn_t *c, nbuf_t *nb);
 
 // server to client
 void app_to_web(conn_t *c, char *s, int sl);
+void app_to_web_buf(conn_t *c, char *buf, int sl);
 char *rx_server_ajax(struct mg_connection *mc);
 int web_request(struct mg_connection *mc, enum mg_event ev);
 void reload_index_params();
@@ -96,4 +97,5 @@ void iparams_add(const char *id, char *val);
 
 typedef enum {WS_INIT_CREATE, WS_INIT_START} ws_init_t;
 void web_server_init(ws_init_t type);
+void web_server_stats();
 void services_start();
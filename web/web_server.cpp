@@ -64,6 +64,8 @@ void webserver_connection_cleanup(conn_t *c)
 		// server demand push of websocket stream data
 		app_to_web(buf)
 			buf => nbuf_allocq(s2c)
+		app_to_web_buf(nbuf_buf_alloc() buf)
+			buf ref => nbuf_allocq_buf(s2c)
 
 		// server demand push of websocket message data (no need to use nbufs)
 		send_msg*()
@@ -141,6 +143,19 @@ void web_to_app_done(conn_t *c, nbuf_t *nb)
 // 2) websocket: {MSG, ADM, MFG, EXT, DAT} messages sent by send_msg*(), received via open_websocket() msg_cb/recv_cb routines
 // 3) 
 
+static u4_t ws_wakeups;
+
+// Only the first frame queued since web_server() last looked wakes it. The ones that follow
+// before it runs go out in the same batch.
+static void web_server_wakeup(conn_t *c)
+{
+	user_iface_t *ui = c->ui;
+	if (ui == NULL || ui->web_server_tid == 0 || ui->output_pending) return;
+	ui->output_pending = true;
+	ws_wakeups++;
+	TaskWakeup(ui->web_server_tid, TWF_CANCEL_DEADLINE);
+}
+
 void app_to_web(conn_t *c, char *s, int sl)
 {
 	if (c->stop_data) return;
@@ -149,9 +164,19 @@ void app_to_web(conn_t *c, char *s, int sl)
 	    return;
 	}
 	nbuf_allocq(&c->s2c, s, sl);
+	web_server_wakeup(c);
 	//NextTask("s2c");
 }
 
+// zero-copy version: buf from nbuf_buf_alloc(), may be sent to multiple conns
+void app_to_web_buf(conn_t *c, char *buf, int sl)
+{
+	if (c->stop_data) return;
+	if (c->internal_connection) return;
+	nbuf_allocq_buf(&c->s2c, buf, sl);
+	web_server_wakeup(c);
+}
+
 
 // event requests _from_ web server:
 // (prompted by data coming into web server)
@@ -179,18 +204,55 @@ static int ev_handler(struct mg_connection *mc, enum mg_event evt) {
     }
 }
 
+// Histogram of the time from app_to_web() to the frame being handed to mongoose.
+// Bin 0 is < 128 usec, then doubling up to >= 128 msec in the last bin.
+#define WS_LAT_NBINS 12
+static u4_t ws_lat_hist[WS_LAT_NBINS], ws_lat_max, ws_polls;
+
+static void web_server_latency(u4_t lat_us)
+{
+	int bin;
+	u4_t t = lat_us >> 7;
+	for (bin = 0; t && bin < WS_LAT_NBINS-1; bin++)
+		t >>= 1;
+	ws_lat_hist[bin]++;
+	if (lat_us > ws_lat_max) ws_lat_max = lat_us;
+}
+
+void web_server_stats()
+{
+	int i;
+	
+	if (print_stats & STATS_TASK) {
+		lprintf("WEB polls %d wakeups %d, send latency max %.3f ms:", ws_polls, ws_wakeups, (float) ws_lat_max / 1e3);
+		for (i = 0; i < WS_LAT_NBINS; i++)
+			real_printf(" %s%d", (i == WS_LAT_NBINS-1)? ">":"<", ws_lat_hist[i]);
+		real_printf(" (bins <128us x2)\n");
+	}
+	
+	memset(ws_lat_hist, 0, sizeof(ws_lat_hist));
+	ws_lat_max = ws_polls = ws_wakeups = 0;
+}
+
 // polled send of data _to_ web server
 static int iterate_callback(struct mg_connection *mc, enum mg_event evt)
 {
-	int ret;
+	int i, ret;
 	nbuf_t *nb;
 	
+	// all queued frames of a connection are written to the mongoose send buffer in one go
+	// and then drained to the socket with a single send()
+	#define WS_BATCH (ND_HIWAT + 1)
+	nbuf_t *batch[WS_BATCH];
+	struct mg_ws_frame frames[WS_BATCH];
+	int nbatch = 0;
+	
 	if (evt == MG_POLL && mc->is_websocket) {
 		conn_t *c = rx_server_websocket(WS_MODE_LOOKUP, mc);
 		if (c == NULL)  return MG_FALSE;
 
         evWS(EC_EVENT, EV_WS, 0, "WEB_SERVER", "iterate_callback..");
-		while (TRUE) {
+		while (nbatch < WS_BATCH) {
 			if (c->stop_data) break;
 			nb = nbuf_dequeue(&c->s2c);
 			//printf("s2c CHK port %d nb %p\n", mc->remote_port, nb);
@@ -234,13 +296,27 @@ static int iterate_callback(struct mg_connection *mc, enum mg_event evt)
 				#endif
 
 				//printf("s2c %d WEBSOCKET: %d %p\n", mc->remote_port, nb->len, nb->buf);
-				ret = mg_websocket_write(mc, WS_OPCODE_BINARY, nb->buf, nb->len);
-				if (ret<=0) printf("$$$$$$$$ socket write ret %d\n", ret);
-				nb->done = TRUE;
+				batch[nbatch] = nb;
+				frames[nbatch].data = nb->buf;
+				frames[nbatch].len = nb->len;
+				nbatch++;
 			} else {
 				break;
 			}
 		}
+		
+		if (nbatch) {
+			ret = mg_websocket_write_frames(mc, WS_OPCODE_BINARY, frames, nbatch);
+			if (ret<=0) printf("$$$$$$$$ socket write ret %d\n", ret);
+			u4_t now = timer_us();
+			for (i = 0; i < nbatch; i++) {
+				web_server_latency(now - batch[i]->enq_us);
+				batch[i]->done = TRUE;
+			}
+			
+			// stopped at the batch cap: the rest of the queue goes out on the next pass, not after a poll interval
+			if (nbatch == WS_BATCH && c->ui) c->ui->output_pending = true;
+		}
         evWS(EC_EVENT, EV_WS, 0, "WEB_SERVER", "..iterate_callback");
 	} else {
 		if (evt != MG_POLL) printf("$$$$$$$$ s2c %d OTHER: %d len %d\n", mc->remote_port, (int) evt, (int) mc->content_len);
@@ -257,33 +333,24 @@ void web_server(void *param)
 	struct mg_server *server = ui->server;
 	const char *err;
 	
+	ui->web_server_tid = TaskID();
+	
+	// Output is event driven: app_to_web() wakes us when the first frame is queued so it goes out
+	// without waiting for a poll interval. Input and new connections are still polled every
+	// WEB_SERVER_POLL_US. Blocking in epoll/select here isn't possible because it would block
+	// every other task in the process.
 	while (1) {
-		mg_poll_server(server, 0);		// passing 0 effects a poll
-		mg_iterate_over_connections(server, iterate_callback);
+		ui->output_pending = false;     // cleared before draining: frames queued from here on wake us again
+		mg_iterate_over_connections(server, iterate_callback);      // queue pending output
+		mg_poll_server(server, 0);		// passing 0 effects a poll, sends the output just queued
+		ws_polls++;
 		
-		//#define MEAS_WEB_SERVER
-		#ifdef MEAS_WEB_SERVER
-		    u4_t quanta = FROM_VOID_PARAM(TaskSleepUsec(WEB_SERVER_POLL_US));
-            static u4_t last, cps, max_quanta, sum_quanta;
-            u4_t now = timer_sec();
-            if (last != now) {
-                for (; last < now; last++) {
-                    if (last < (now-1))
-                        real_printf("w- ");
-                    else
-                        real_printf("w%d|%d/%d ", cps, sum_quanta/(cps? cps:1), max_quanta);
-                    fflush(stdout);
-                }
-                max_quanta = sum_quanta = 0;
-                cps = 0;
-            } else {
-                if (quanta > max_quanta) max_quanta = quanta;
-                sum_quanta += quanta;
-                cps++;
-            }
-        #else
-            TaskSleepUsec(WEB_SERVER_POLL_US);
-        #endif
+		// output queued while we were running (e.g. by an ev_handler) or left over from a full batch shouldn't wait
+		if (ui->output_pending) {
+			NextTask("web output");
+		} else {
+			TaskSleepReasonUsec("web idle", WEB_SERVER_POLL_US);
+		}
 		
 		//#define CHECK_ECPU_STACK
 		#ifdef CHECK_ECPU_STACK